@@ -0,0 +1,251 @@
+// Micro-benchmark for the spratpack composition kernels: rotated blits,
+// extrusion, dilation and color quantization. Each kernel is timed against
+// the per-pixel loop spratpack used before, on every supported instruction set.
+#include "core/pixel_kernels.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using sprat::core::PixelKernelIsa;
+
+constexpr PixelKernelIsa k_isas[] = {
+    PixelKernelIsa::scalar, PixelKernelIsa::sse2, PixelKernelIsa::avx2, PixelKernelIsa::neon
+};
+
+// A square atlas tiled with `sprite` x `sprite` sprites separated by a
+// transparent gutter, with some transparent pixels inside each sprite.
+struct Atlas {
+    int width = 0;
+    int height = 0;
+    int sprite = 0;
+    int gutter = 0;
+    std::vector<unsigned char> rgba;
+};
+
+Atlas make_atlas(int size, int sprite, int gutter) {
+    Atlas atlas;
+    atlas.width = size;
+    atlas.height = size;
+    atlas.sprite = sprite;
+    atlas.gutter = gutter;
+    atlas.rgba.assign(static_cast<size_t>(size) * static_cast<size_t>(size) * 4, 0);
+    unsigned int seed = 1;
+    const int pitch = sprite + gutter;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            if (x % pitch >= sprite || y % pitch >= sprite) {
+                continue;
+            }
+            seed = seed * 1664525u + 1013904223u;
+            unsigned char* p = atlas.rgba.data() + (static_cast<size_t>(y) * static_cast<size_t>(size) + static_cast<size_t>(x)) * 4;
+            p[0] = static_cast<unsigned char>(seed >> 8);
+            p[1] = static_cast<unsigned char>(seed >> 16);
+            p[2] = static_cast<unsigned char>(seed >> 24);
+            p[3] = (seed & 0x70u) == 0 ? 0 : 255;
+        }
+    }
+    return atlas;
+}
+
+template <typename Fn>
+double time_ms(int repeats, Fn&& fn) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; ++r) {
+        fn();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / repeats;
+}
+
+void report(const std::string& name, double ms, double baseline_ms) {
+    std::cout << std::left << std::setw(28) << name
+              << std::right << std::setw(10) << std::fixed << std::setprecision(3) << ms << " ms"
+              << std::setw(9) << std::setprecision(2) << (baseline_ms / ms) << "x\n";
+}
+
+// The loops below are the per-pixel versions spratpack shipped before the
+// kernels in core/pixel_kernels.
+
+void rotated_blit_per_pixel(const unsigned char* src, size_t src_stride, int width, int rows,
+                            unsigned char* dest, size_t dest_stride) {
+    for (int r = 0; r < rows; ++r) {
+        unsigned char* row = dest + static_cast<size_t>(r) * dest_stride;
+        for (int col = 0; col < width; ++col) {
+            const size_t py = static_cast<size_t>(width - 1 - col);
+            std::memcpy(row + static_cast<size_t>(col) * 4, src + py * src_stride + static_cast<size_t>(r) * 4, 4);
+        }
+    }
+}
+
+void extrude_per_pixel(std::vector<unsigned char>& atlas, int atlas_width, int atlas_height,
+                       int sx, int sy, int sw, int sh, int extrude) {
+    auto set_pixel = [&](int dx, int dy, int px, int py) {
+        if (dx < 0 || dy < 0 || dx >= atlas_width || dy >= atlas_height ||
+            px < 0 || py < 0 || px >= atlas_width || py >= atlas_height) {
+            return;
+        }
+        std::memcpy(&atlas[(static_cast<size_t>(dy) * atlas_width + dx) * 4],
+                    &atlas[(static_cast<size_t>(py) * atlas_width + px) * 4], 4);
+    };
+    for (int e = 1; e <= extrude; ++e) {
+        for (int y = 0; y < sh; ++y) {
+            set_pixel(sx - e, sy + y, sx, sy + y);
+            set_pixel(sx + sw - 1 + e, sy + y, sx + sw - 1, sy + y);
+        }
+        for (int x = 0; x < sw; ++x) {
+            set_pixel(sx + x, sy - e, sx + x, sy);
+            set_pixel(sx + x, sy + sh - 1 + e, sx + x, sy + sh - 1);
+        }
+    }
+    for (int ey = 1; ey <= extrude; ++ey) {
+        for (int ex = 1; ex <= extrude; ++ex) {
+            set_pixel(sx - ex, sy - ey, sx, sy);
+            set_pixel(sx + sw - 1 + ex, sy - ey, sx + sw - 1, sy);
+            set_pixel(sx - ex, sy + sh - 1 + ey, sx, sy + sh - 1);
+            set_pixel(sx + sw - 1 + ex, sy + sh - 1 + ey, sx + sw - 1, sy + sh - 1);
+        }
+    }
+}
+
+void dilate_per_pixel(const std::vector<unsigned char>& read, std::vector<unsigned char>& write,
+                      int width, int height) {
+    auto alpha_at = [&](int x, int y) -> unsigned char {
+        if (x < 0 || y < 0 || x >= width || y >= height) {
+            return 0;
+        }
+        return read[(static_cast<size_t>(y) * width + x) * 4 + 3];
+    };
+    constexpr int dx[] = {-1, 1, 0, 0};
+    constexpr int dy[] = {0, 0, -1, 1};
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (alpha_at(x, y) != 0) {
+                continue;
+            }
+            for (int dir = 0; dir < 4; ++dir) {
+                if (alpha_at(x + dx[dir], y + dy[dir]) != 0) {
+                    const size_t from = (static_cast<size_t>(y + dy[dir]) * width + (x + dx[dir])) * 4;
+                    const size_t to = (static_cast<size_t>(y) * width + x) * 4;
+                    write[to] = read[from];
+                    write[to + 1] = read[from + 1];
+                    write[to + 2] = read[from + 2];
+                    break;
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int size = argc > 1 ? std::atoi(argv[1]) : 2048;
+    const int sprite = argc > 2 ? std::atoi(argv[2]) : 64;
+    const int repeats = argc > 3 ? std::atoi(argv[3]) : 5;
+    if (size < 8 || sprite < 2 || sprite > size || repeats <= 0) {
+        std::cerr << "Usage: atlas_kernels_bench [atlas size] [sprite size] [repeats]\n";
+        return 1;
+    }
+    const Atlas source = make_atlas(size, sprite, 4);
+    const size_t stride = static_cast<size_t>(size) * 4;
+    std::cout << size << "x" << size << " atlas of " << sprite << "x" << sprite << " sprites, " << repeats
+              << " repeats, active kernel: "
+              << sprat::core::pixel_kernel_isa_name(sprat::core::active_pixel_kernel_isa()) << "\n\n";
+
+    volatile unsigned sink = 0;
+    std::vector<unsigned char> work(source.rgba.size());
+
+    std::cout << "rotated blit (whole atlas as one sprite)\n";
+    const double rotate_ref = time_ms(repeats, [&]() {
+        rotated_blit_per_pixel(source.rgba.data(), stride, size, size, work.data(), stride);
+        sink = sink + work[work.size() / 2];
+    });
+    report("  per-pixel memcpy", rotate_ref, rotate_ref);
+    for (PixelKernelIsa isa : k_isas) {
+        if (!sprat::core::pixel_kernel_isa_supported(isa)) {
+            continue;
+        }
+        const double ms = time_ms(repeats, [&]() {
+            sprat::core::blit_rotated_cw(source.rgba.data(), stride, size, 0, size, work.data(), stride, isa);
+            sink = sink + work[work.size() / 2];
+        });
+        report(std::string("  tiled ") + sprat::core::pixel_kernel_isa_name(isa), ms, rotate_ref);
+    }
+
+    std::cout << "extrude 2px around every sprite\n";
+    const int pitch = sprite + source.gutter;
+    auto for_each_sprite = [&](auto&& fn) {
+        for (int y = 2; y + sprite + 2 <= size; y += pitch) {
+            for (int x = 2; x + sprite + 2 <= size; x += pitch) {
+                fn(x, y);
+            }
+        }
+    };
+    // Extrusion and dilation give the same result when repeated, so the
+    // atlas is reset once per kernel rather than inside the timed loop.
+    work = source.rgba;
+    const double extrude_ref = time_ms(repeats, [&]() {
+        for_each_sprite([&](int x, int y) { extrude_per_pixel(work, size, size, x, y, sprite - 4, sprite - 4, 2); });
+        sink = sink + work[work.size() / 2];
+    });
+    report("  per-pixel", extrude_ref, extrude_ref);
+    work = source.rgba;
+    const double extrude_ms = time_ms(repeats, [&]() {
+        for_each_sprite([&](int x, int y) {
+            sprat::core::extrude_rect(work.data(), size, size, stride, x, y, sprite - 4, sprite - 4, 2);
+        });
+        sink = sink + work[work.size() / 2];
+    });
+    report("  row copies", extrude_ms, extrude_ref);
+
+    std::cout << "dilate one pass over the atlas\n";
+    work = source.rgba;
+    const double dilate_ref = time_ms(repeats, [&]() {
+        dilate_per_pixel(source.rgba, work, size, size);
+        sink = sink + work[work.size() / 2];
+    });
+    report("  per-pixel", dilate_ref, dilate_ref);
+    for (PixelKernelIsa isa : k_isas) {
+        if (!sprat::core::pixel_kernel_isa_supported(isa)) {
+            continue;
+        }
+        work = source.rgba;
+        const double ms = time_ms(repeats, [&]() {
+            for (int y = 0; y < size; ++y) {
+                sprat::core::dilate_row(source.rgba.data(), work.data(), size, size, stride, y, 0, size - 1, isa);
+            }
+            sink = sink + work[work.size() / 2];
+        });
+        report(std::string("  rows ") + sprat::core::pixel_kernel_isa_name(isa), ms, dilate_ref);
+    }
+
+    std::cout << "quantize to 16 levels with dithering\n";
+    const double quantize_ref = time_ms(repeats, [&]() {
+        work = source.rgba;
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                unsigned char* p = work.data() + static_cast<size_t>(y) * stride + static_cast<size_t>(x) * 4;
+                for (int c = 0; c < 3; ++c) {
+                    p[c] = sprat::core::quantize_channel(p[c], 16, x, y, true);
+                }
+            }
+        }
+        sink = sink + work[work.size() / 2];
+    });
+    report("  per-channel float", quantize_ref, quantize_ref);
+    const double quantize_ms = time_ms(repeats, [&]() {
+        work = source.rgba;
+        sprat::core::quantize_rgb(work.data(), size, size, stride, 16, true, 0, 0);
+        sink = sink + work[work.size() / 2];
+    });
+    report("  lookup tables", quantize_ms, quantize_ref);
+    return sink == 0xFFFFFFFFu ? 1 : 0;
+}
@@ -0,0 +1,97 @@
+// Micro-benchmark for sprat::core::parse_layout. Times the in-memory entry
+// point against the std::istream one on a generated layout, and reports the
+// parse throughput of each.
+#include "core/layout_parser.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+namespace {
+
+// A multipack layout in the shape spratlayout writes: trimmed sprites with
+// long paths, some rotated or sliced, plus the marker lines spratconvert
+// passes through.
+std::string make_layout(int sprites) {
+    constexpr int k_atlas_size = 4096;
+    constexpr int k_sprites_per_atlas = 1024;
+    std::string text = "multipack true\nscale 1\nextrude 1\nroot \"/assets/characters\"\n";
+    for (int i = 0; i < sprites; ++i) {
+        if (i % k_sprites_per_atlas == 0) {
+            text += "atlas " + std::to_string(k_atlas_size) + "," + std::to_string(k_atlas_size) + "\n";
+        }
+        const int slot = i % k_sprites_per_atlas;
+        text += "sprite \"hero/animations/run_cycle/frame_" + std::to_string(i) + ".png\" ";
+        text += std::to_string((slot % 32) * 128) + "," + std::to_string((slot / 32) * 128) + " ";
+        text += "120,118 3,5 2,7";
+        if (i % 7 == 0) {
+            text += " rotated";
+        }
+        if (i % 11 == 0) {
+            text += " slice=4,4,4,4,stretch,repeat";
+        }
+        text += "\n";
+        if (i % 5 == 0) {
+            text += "- marker \"pivot\" point 60,110\n";
+        }
+    }
+    return text;
+}
+
+template <typename Fn>
+double time_ms(int repeats, Fn&& fn) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; ++r) {
+        fn();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / repeats;
+}
+
+void report(const std::string& name, double ms, double bytes, double baseline_ms) {
+    std::cout << std::left << std::setw(28) << name
+              << std::right << std::setw(10) << std::fixed << std::setprecision(3) << ms << " ms"
+              << std::setw(10) << std::setprecision(1) << (bytes / (ms * 1000.0)) << " MB/s"
+              << std::setw(9) << std::setprecision(2) << (baseline_ms / ms) << "x\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int sprites = argc > 1 ? std::atoi(argv[1]) : 100000;
+    const int repeats = argc > 2 ? std::atoi(argv[2]) : 10;
+    if (sprites <= 0 || repeats <= 0) {
+        std::cerr << "Usage: layout_parse_bench [sprites] [repeats]\n";
+        return 1;
+    }
+    const std::string text = make_layout(sprites);
+    const double bytes = static_cast<double>(text.size());
+    std::cout << sprites << " sprites, " << text.size() << " bytes, " << repeats << " repeats\n\n";
+
+    volatile size_t sink = 0;
+    std::string error;
+    const double stream_ms = time_ms(repeats, [&]() {
+        std::istringstream in(text);
+        sprat::core::Layout layout;
+        if (!sprat::core::parse_layout(in, layout, error)) {
+            std::cerr << error << "\n";
+            std::exit(1);
+        }
+        sink = sink + layout.sprites.size();
+    });
+    report("  parse_layout(istream)", stream_ms, bytes, stream_ms);
+    const double text_ms = time_ms(repeats, [&]() {
+        sprat::core::Layout layout;
+        if (!sprat::core::parse_layout(std::string_view(text), layout, error)) {
+            std::cerr << error << "\n";
+            std::exit(1);
+        }
+        sink = sink + layout.sprites.size();
+    });
+    report("  parse_layout(string_view)", text_ms, bytes, stream_ms);
+    return sink == 0 ? 1 : 0;
+}
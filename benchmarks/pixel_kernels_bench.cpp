@@ -0,0 +1,127 @@
+// Micro-benchmark for the RGBA scanning and hashing kernels used on
+// spratlayout cache misses. Compares every supported instruction set
+// against the scalar path, and XXH64 against byte-wise FNV-1a.
+#include "core/fnv1a.h"
+#include "core/pixel_kernels.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using sprat::core::PixelKernelIsa;
+
+struct Image {
+    int w = 0;
+    int h = 0;
+    std::vector<unsigned char> rgba;
+};
+
+// Sprites with an opaque blob surrounded by wide transparent margins, the
+// shape trimming is meant for.
+std::vector<Image> make_images(int count, int size) {
+    std::vector<Image> images;
+    images.reserve(static_cast<size_t>(count));
+    unsigned int seed = 1;
+    auto next = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+    for (int i = 0; i < count; ++i) {
+        Image image;
+        image.w = size;
+        image.h = size;
+        image.rgba.assign(static_cast<size_t>(size) * static_cast<size_t>(size) * 4, 0);
+        const int x0 = static_cast<int>(next() % static_cast<unsigned>(size / 2));
+        const int y0 = static_cast<int>(next() % static_cast<unsigned>(size / 2));
+        const int bw = 1 + static_cast<int>(next() % static_cast<unsigned>(size - x0));
+        const int bh = 1 + static_cast<int>(next() % static_cast<unsigned>(size - y0));
+        for (int y = y0; y < y0 + bh; ++y) {
+            for (int x = x0; x < x0 + bw; ++x) {
+                unsigned char* p = image.rgba.data() + (static_cast<size_t>(y) * static_cast<size_t>(size) + static_cast<size_t>(x)) * 4;
+                const unsigned int v = next();
+                p[0] = static_cast<unsigned char>(v);
+                p[1] = static_cast<unsigned char>(v >> 8);
+                p[2] = static_cast<unsigned char>(v >> 16);
+                p[3] = 255;
+            }
+        }
+        images.push_back(std::move(image));
+    }
+    return images;
+}
+
+template <typename Fn>
+double time_ms(int repeats, Fn&& fn) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; ++r) {
+        fn();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / repeats;
+}
+
+void report(const std::string& name, double ms, double baseline_ms) {
+    std::cout << std::left << std::setw(28) << name
+              << std::right << std::setw(10) << std::fixed << std::setprecision(3) << ms << " ms"
+              << std::setw(9) << std::setprecision(2) << (baseline_ms / ms) << "x\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int count = argc > 1 ? std::atoi(argv[1]) : 256;
+    const int size = argc > 2 ? std::atoi(argv[2]) : 256;
+    const int repeats = argc > 3 ? std::atoi(argv[3]) : 10;
+    if (count <= 0 || size < 2 || repeats <= 0) {
+        std::cerr << "Usage: pixel_kernels_bench [images] [size] [repeats]\n";
+        return 1;
+    }
+    const std::vector<Image> images = make_images(count, size);
+    std::cout << count << " images of " << size << "x" << size << ", " << repeats
+              << " repeats, active kernel: "
+              << sprat::core::pixel_kernel_isa_name(sprat::core::active_pixel_kernel_isa()) << "\n\n";
+
+    volatile long long sink = 0;
+    std::cout << "trim bounds\n";
+    double scalar_ms = 0.0;
+    for (PixelKernelIsa isa : {PixelKernelIsa::scalar, PixelKernelIsa::sse2, PixelKernelIsa::avx2, PixelKernelIsa::neon}) {
+        if (!sprat::core::pixel_kernel_isa_supported(isa)) {
+            continue;
+        }
+        const double ms = time_ms(repeats, [&]() {
+            for (const Image& image : images) {
+                int min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+                sprat::core::find_opaque_bounds(image.rgba.data(), image.w, image.h,
+                                                static_cast<size_t>(image.w) * 4,
+                                                min_x, min_y, max_x, max_y, isa);
+                sink = sink + min_x + min_y + max_x + max_y;
+            }
+        });
+        if (isa == PixelKernelIsa::scalar) {
+            scalar_ms = ms;
+        }
+        report(std::string("  ") + sprat::core::pixel_kernel_isa_name(isa), ms, scalar_ms);
+    }
+
+    std::cout << "content hash\n";
+    const double fnv_ms = time_ms(repeats, [&]() {
+        for (const Image& image : images) {
+            sink = sink + static_cast<long long>(sprat::core::fnv1a_hash(image.rgba.data(), image.rgba.size()) & 1);
+        }
+    });
+    report("  fnv1a (bytewise)", fnv_ms, fnv_ms);
+    const double xxh_ms = time_ms(repeats, [&]() {
+        for (const Image& image : images) {
+            sink = sink + static_cast<long long>(sprat::core::hash_rgba_region(
+                image.rgba.data(), image.w, image.h, static_cast<size_t>(image.w) * 4) & 1);
+        }
+    });
+    report("  xxh64", xxh_ms, fnv_ms);
+    return sink == -1 ? 1 : 0;
+}
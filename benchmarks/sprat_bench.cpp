@@ -0,0 +1,813 @@
+// End-to-end benchmark suite. Generates synthetic sprite corpora at several
+// scales, times every pipeline stage on them separately and writes the
+// results as JSON, one record per (corpus, scale, stage), so runs from two
+// releases can be diffed.
+//
+// Layout, convert and frames stages run the built executables as child
+// processes with a fresh HOME and TMPDIR per run, so spratlayout never
+// answers from its caches. The other stages call the library routines the
+// tools use directly, on pixels rendered in memory: dedup:* hashes and
+// groups the trimmed sprites, parse_layout parses the fast layout, blit
+// composes its atlas with spratpack's blit, and encode:* compresses it with
+// spratpack's encoders. The webp, avif, dxt1/dxt5 and zopfli stages only
+// exist when spratcore was built with their libraries.
+#include "core/atlas_encoders.h"
+#include "core/hamming_index.h"
+#include "core/layout_parser.h"
+#include "core/pixel_kernels.h"
+#include "core/png_stream_writer.h"
+
+#include "stb_image_write.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int k_channels = 4;
+constexpr int k_default_repeats = 3;
+constexpr int k_animation_frames = 12;
+constexpr int k_duplicate_frame_period = 3;
+constexpr int k_dhash_threshold = 5;
+constexpr int k_band_rows = 256;
+// Zopfli takes minutes on the larger atlases, so it only runs at this scale.
+constexpr const char* k_zopfli_scale = "small";
+
+struct Scale {
+    const char* name;
+    int sprites;
+};
+
+constexpr Scale k_scales[] = {
+    {"small", 256},
+    {"medium", 2048},
+    {"large", 8192},
+};
+
+constexpr const char* k_corpora[] = {"icons", "skewed", "strips"};
+constexpr const char* k_layout_modes[] = {"fast", "compact", "pot", "grid"};
+
+struct SpriteSpec {
+    std::string name;
+    int w = 0;
+    int h = 0;
+    int border = 0;
+    uint32_t seed = 0;
+};
+
+struct Corpus {
+    std::string name;
+    std::string scale;
+    fs::path dir;
+    std::vector<SpriteSpec> sprites;
+    bool uniform = false;
+};
+
+struct StageResult {
+    std::string corpus;
+    std::string scale;
+    size_t sprites = 0;
+    std::string stage;
+    bool ok = false;
+    std::string error;
+    std::vector<double> runs_ms;
+};
+
+struct Options {
+    std::vector<std::string> scales = {"small", "medium"};
+    std::vector<std::string> corpora = {"icons", "skewed", "strips"};
+    int repeats = k_default_repeats;
+    unsigned int threads = 0;
+    fs::path work_dir;
+    fs::path output;
+    bool keep = false;
+};
+
+uint32_t next_random(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state;
+}
+
+double next_unit(uint32_t& state) {
+    return static_cast<double>(next_random(state) >> 8) / static_cast<double>(1u << 24);
+}
+
+// Opaque content in 4x4 blocks of seeded color inside a transparent border,
+// so trimming, hashing and PNG filtering all see realistic work.
+std::vector<unsigned char> render_sprite(const SpriteSpec& spec) {
+    std::vector<unsigned char> rgba(static_cast<size_t>(spec.w) * static_cast<size_t>(spec.h) * k_channels, 0);
+    for (int y = spec.border; y < spec.h - spec.border; ++y) {
+        for (int x = spec.border; x < spec.w - spec.border; ++x) {
+            uint32_t state = spec.seed ^ (static_cast<uint32_t>(x / 4) * 73856093u) ^
+                             (static_cast<uint32_t>(y / 4) * 19349663u);
+            const uint32_t color = next_random(state);
+            unsigned char* p = rgba.data() + (static_cast<size_t>(y) * static_cast<size_t>(spec.w) + static_cast<size_t>(x)) * k_channels;
+            p[0] = static_cast<unsigned char>(color >> 8);
+            p[1] = static_cast<unsigned char>(color >> 16);
+            p[2] = static_cast<unsigned char>(color >> 24);
+            p[3] = 255;
+        }
+    }
+    return rgba;
+}
+
+std::vector<SpriteSpec> make_specs(const std::string& corpus, int count) {
+    std::vector<SpriteSpec> specs;
+    specs.reserve(static_cast<size_t>(count));
+    uint32_t state = 12345;
+    if (corpus == "icons") {
+        // Uniform 32x32 icons, the grid-mode case.
+        for (int i = 0; i < count; ++i) {
+            specs.push_back({"icon_" + std::to_string(i) + ".png", 32, 32, 2, next_random(state)});
+        }
+    } else if (corpus == "skewed") {
+        // Mostly small sprites with a long tail of large ones.
+        for (int i = 0; i < count; ++i) {
+            const double a = next_unit(state);
+            const double b = next_unit(state);
+            const int w = 8 + static_cast<int>(248.0 * a * a * a);
+            const int h = 8 + static_cast<int>(248.0 * b * b * b);
+            specs.push_back({"sprite_" + std::to_string(i) + ".png", w, h, std::min(w, h) / 8, next_random(state)});
+        }
+    } else {
+        // Animation strips in per-animation folders; every few frames repeat
+        // the previous one so deduplication has work to do.
+        int animation = 0;
+        for (int i = 0; i < count; ++animation) {
+            const int side = 48 + static_cast<int>(next_random(state) % 49);
+            uint32_t seed = next_random(state);
+            for (int frame = 0; frame < k_animation_frames && i < count; ++frame, ++i) {
+                if (frame % k_duplicate_frame_period != k_duplicate_frame_period - 1) {
+                    seed = next_random(state);
+                }
+                specs.push_back({"anim_" + std::to_string(animation) + "/frame_" + std::to_string(frame) + ".png",
+                                 side, side, 4, seed});
+            }
+        }
+    }
+    return specs;
+}
+
+bool write_corpus(const Corpus& corpus) {
+    for (const SpriteSpec& spec : corpus.sprites) {
+        const fs::path path = corpus.dir / spec.name;
+        std::error_code ec;
+        fs::create_directories(path.parent_path(), ec);
+        const std::vector<unsigned char> rgba = render_sprite(spec);
+        if (stbi_write_png(path.string().c_str(), spec.w, spec.h, k_channels, rgba.data(), spec.w * k_channels) == 0) {
+            std::cerr << "Failed to write " << path.string() << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string quote_arg(const std::string& arg) {
+#ifdef _WIN32
+    return "\"" + arg + "\"";
+#else
+    std::string quoted = "'";
+    for (char c : arg) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted += c;
+        }
+    }
+    quoted += "'";
+    return quoted;
+#endif
+}
+
+void set_env(const char* name, const std::string& value) {
+#ifdef _WIN32
+    _putenv_s(name, value.c_str());
+#else
+    setenv(name, value.c_str(), 1);
+#endif
+}
+
+struct Command {
+    std::vector<std::string> args;
+    fs::path stdin_path;
+    fs::path stdout_path;
+};
+
+// Points HOME and the temp directory at an empty `home`, so the next tool
+// run starts without user config or caches.
+void reset_tool_home(const fs::path& home) {
+    std::error_code ec;
+    fs::remove_all(home, ec);
+    fs::create_directories(home / "tmp", ec);
+    set_env("HOME", home.string());
+    set_env("TMPDIR", (home / "tmp").string());
+    set_env("TMP", (home / "tmp").string());
+    set_env("TEMP", (home / "tmp").string());
+}
+
+bool run_command(const Command& command, const fs::path& home, std::string& error) {
+    std::string line;
+    for (const std::string& arg : command.args) {
+        if (!line.empty()) {
+            line += ' ';
+        }
+        line += quote_arg(arg);
+    }
+    if (!command.stdin_path.empty()) {
+        line += " < " + quote_arg(command.stdin_path.string());
+    }
+    line += " > " + quote_arg(command.stdout_path.empty() ? (home / "stdout").string() : command.stdout_path.string());
+    line += " 2> " + quote_arg((home.parent_path() / "last_stderr.txt").string());
+#ifdef _WIN32
+    line = "\"" + line + "\"";
+#endif
+    int status = std::system(line.c_str());
+#ifndef _WIN32
+    if (status != -1 && WIFEXITED(status)) {
+        status = WEXITSTATUS(status);
+    }
+#endif
+    if (status != 0) {
+        error = "exit status " + std::to_string(status);
+        std::ifstream err(home.parent_path() / "last_stderr.txt");
+        std::string first;
+        if (std::getline(err, first) && !first.empty()) {
+            error += ": " + first;
+        }
+        return false;
+    }
+    return true;
+}
+
+class Bench {
+public:
+    explicit Bench(const Options& options) : options_(options) {}
+
+    const std::vector<StageResult>& results() const { return results_; }
+
+    // Times `fn` options_.repeats times, calling `prepare` untimed before
+    // each run; a failing run ends the stage.
+    void stage(const Corpus& corpus, const std::string& name, const std::function<bool(std::string&)>& fn,
+               const std::function<void()>& prepare = {}) {
+        StageResult result;
+        result.corpus = corpus.name;
+        result.scale = corpus.scale;
+        result.sprites = corpus.sprites.size();
+        result.stage = name;
+        result.ok = true;
+        for (int r = 0; r < options_.repeats; ++r) {
+            if (prepare) {
+                prepare();
+            }
+            const auto start = std::chrono::steady_clock::now();
+            const bool ok = fn(result.error);
+            const auto end = std::chrono::steady_clock::now();
+            if (!ok) {
+                result.ok = false;
+                result.runs_ms.clear();
+                break;
+            }
+            result.runs_ms.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        std::cerr << "  " << corpus.name << "/" << corpus.scale << " " << name << ": "
+                  << (result.ok ? "ok" : "failed (" + result.error + ")") << "\n";
+        results_.push_back(std::move(result));
+    }
+
+    void tool_stage(const Corpus& corpus, const std::string& name, const Command& command) {
+        const fs::path home = options_.work_dir / "home";
+        stage(corpus, name,
+              [&](std::string& error) { return run_command(command, home, error); },
+              [&]() { reset_tool_home(home); });
+    }
+
+private:
+    const Options& options_;
+    std::vector<StageResult> results_;
+};
+
+std::vector<std::string> with_threads(std::vector<std::string> args, unsigned int threads) {
+    if (threads > 0) {
+        args.push_back("--threads");
+        args.push_back(std::to_string(threads));
+    }
+    return args;
+}
+
+bool read_file(const fs::path& path, std::string& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    out = buffer.str();
+    return true;
+}
+
+// Composes every atlas of `layout` from regenerated sprite pixels with the
+// blit spratpack uses.
+bool blit_layout(const sprat::core::Layout& layout,
+                 const std::unordered_map<std::string, std::vector<unsigned char>>& pixels,
+                 const std::unordered_map<std::string, const SpriteSpec*>& specs,
+                 std::vector<std::vector<unsigned char>>& atlases,
+                 std::string& error) {
+    atlases.resize(layout.atlases.size());
+    for (size_t i = 0; i < layout.atlases.size(); ++i) {
+        atlases[i].assign(static_cast<size_t>(layout.atlases[i].width) *
+                          static_cast<size_t>(layout.atlases[i].height) * k_channels, 0);
+    }
+    for (const sprat::core::Sprite& s : layout.sprites) {
+        if (!s.alias_of.empty()) {
+            continue;
+        }
+        const auto spec_it = specs.find(s.path);
+        if (spec_it == specs.end() || s.atlas_index < 0 ||
+            static_cast<size_t>(s.atlas_index) >= atlases.size()) {
+            error = "unknown sprite " + s.path;
+            return false;
+        }
+        const size_t src_stride = static_cast<size_t>(spec_it->second->w) * k_channels;
+        const unsigned char* src = pixels.at(s.path).data() +
+                                   static_cast<size_t>(s.src_y) * src_stride +
+                                   static_cast<size_t>(s.src_x) * k_channels;
+        const sprat::core::Atlas& atlas = layout.atlases[s.atlas_index];
+        sprat::core::blit_sprite_rows(src, src_stride, s.x, s.y, s.w, s.h, s.rotated,
+                                      atlases[s.atlas_index].data(), atlas.width, 0, atlas.height);
+    }
+    return true;
+}
+
+// Trims every sprite to its opaque bounds and hashes the region, as
+// spratlayout does while loading: XXH64 grouped by (hash, size) for exact
+// deduplication, dHash grouped by Hamming distance within a size for
+// perceptual. Returns the number of sprites that became aliases.
+size_t deduplicate(const std::vector<SpriteSpec>& sprites,
+                   const std::unordered_map<std::string, std::vector<unsigned char>>& pixels,
+                   bool perceptual,
+                   unsigned int workers) {
+    std::vector<uint64_t> hashes(sprites.size(), 0);
+    std::vector<uint64_t> size_keys(sprites.size(), 0);
+    for (size_t i = 0; i < sprites.size(); ++i) {
+        const SpriteSpec& spec = sprites[i];
+        const unsigned char* rgba = pixels.at(spec.name).data();
+        const size_t stride = static_cast<size_t>(spec.w) * k_channels;
+        int min_x = 0;
+        int min_y = 0;
+        int max_x = 0;
+        int max_y = 0;
+        if (!sprat::core::find_opaque_bounds(rgba, spec.w, spec.h, stride, min_x, min_y, max_x, max_y)) {
+            continue;
+        }
+        const int w = max_x - min_x + 1;
+        const int h = max_y - min_y + 1;
+        const unsigned char* region = rgba + static_cast<size_t>(min_y) * stride + static_cast<size_t>(min_x) * k_channels;
+        hashes[i] = perceptual ? sprat::core::compute_dhash(region, w, h, stride)
+                               : sprat::core::hash_rgba_region(region, w, h, stride);
+        size_keys[i] = (static_cast<uint64_t>(static_cast<uint32_t>(w)) << 32) | static_cast<uint32_t>(h);
+    }
+
+    size_t aliases = 0;
+    if (perceptual) {
+        const std::vector<size_t> first_in_group =
+            sprat::core::group_near_duplicate_hashes(hashes, size_keys, k_dhash_threshold, workers);
+        for (size_t i = 0; i < first_in_group.size(); ++i) {
+            aliases += first_in_group[i] != i ? 1 : 0;
+        }
+        return aliases;
+    }
+    std::unordered_map<uint64_t, std::vector<uint64_t>> seen;
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        if (hashes[i] == 0) {
+            continue;
+        }
+        std::vector<uint64_t>& sizes = seen[hashes[i]];
+        if (std::find(sizes.begin(), sizes.end(), size_keys[i]) != sizes.end()) {
+            ++aliases;
+        } else {
+            sizes.push_back(size_keys[i]);
+        }
+    }
+    return aliases;
+}
+
+enum class PngEncoder {
+    whole,
+    band_rows,
+    zopfli,
+};
+
+// Encodes every atlas as PNG the way spratpack does: whole images through
+// encode_png_parallel, k_band_rows at a time through PngStreamWriter, or
+// for --zopfli through Zopfli on the parallel encoder's pieces (or
+// ZopfliPNG when only that library was found).
+bool encode_atlases(const sprat::core::Layout& layout,
+                    const std::vector<std::vector<unsigned char>>& atlases,
+                    PngEncoder encoder,
+                    unsigned int workers,
+                    std::vector<std::vector<unsigned char>>& encoded,
+                    std::string& error) {
+    encoded.assign(atlases.size(), {});
+    for (size_t i = 0; i < atlases.size(); ++i) {
+        const int width = layout.atlases[i].width;
+        const int height = layout.atlases[i].height;
+        const size_t stride = static_cast<size_t>(width) * k_channels;
+        std::vector<unsigned char>& out = encoded[i];
+        if (encoder == PngEncoder::zopfli) {
+#if defined(SPRAT_HAS_ZOPFLI_DEFLATE)
+            if (!sprat::core::encode_png_zopfli_parallel(atlases[i].data(), width, height, stride, workers, out)) {
+                error = "encode_png_zopfli_parallel failed";
+                return false;
+            }
+#else
+            std::vector<unsigned char> png;
+            if (!sprat::core::encode_png_parallel(atlases[i].data(), width, height, stride, workers, png) ||
+                !sprat::core::zopfli_optimize_png(png, workers, out)) {
+                error = "zopfli_optimize_png failed";
+                return false;
+            }
+#endif
+            continue;
+        }
+        if (encoder == PngEncoder::whole) {
+            if (!sprat::core::encode_png_parallel(atlases[i].data(), width, height, stride, workers, out)) {
+                error = "encode_png_parallel failed";
+                return false;
+            }
+            continue;
+        }
+        sprat::core::PngStreamWriter writer;
+        bool ok = writer.begin(width, height, [&](const unsigned char* data, size_t size) {
+            out.insert(out.end(), data, data + size);
+            return true;
+        });
+        for (int y = 0; ok && y < height; y += k_band_rows) {
+            ok = writer.write_rows(atlases[i].data() + static_cast<size_t>(y) * stride,
+                                   std::min(k_band_rows, height - y), stride);
+        }
+        if (!ok || !writer.finish()) {
+            error = "PngStreamWriter failed";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Runs one of spratpack's non-PNG encoders on every atlas; `encode` returns
+// an empty buffer on failure, as those encoders do.
+bool encode_atlases_with(const std::vector<std::vector<unsigned char>>& atlases,
+                         const char* encoder_name,
+                         const std::function<std::vector<unsigned char>(size_t)>& encode,
+                         std::string& error) {
+    for (size_t i = 0; i < atlases.size(); ++i) {
+        if (encode(i).empty()) {
+            error = std::string(encoder_name) + " failed";
+            return false;
+        }
+    }
+    return true;
+}
+
+void run_corpus(Bench& bench, const Options& options, Corpus& corpus) {
+    const fs::path out_dir = options.work_dir / "out" / (corpus.name + "_" + corpus.scale);
+    std::error_code ec;
+    fs::create_directories(out_dir, ec);
+    const std::string dir = corpus.dir.string();
+
+    for (const char* mode : k_layout_modes) {
+        if (std::string_view(mode) == "grid" && !corpus.uniform) {
+            continue;
+        }
+        bench.tool_stage(corpus, std::string("layout:") + mode,
+                         {with_threads({SPRAT_BENCH_SPRATLAYOUT, dir, "--mode", mode}, options.threads),
+                          {}, out_dir / (std::string("layout_") + mode + ".txt")});
+    }
+
+    const unsigned int workers = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    std::unordered_map<std::string, const SpriteSpec*> specs;
+    std::unordered_map<std::string, std::vector<unsigned char>> pixels;
+    for (const SpriteSpec& spec : corpus.sprites) {
+        specs.emplace(spec.name, &spec);
+        pixels.emplace(spec.name, render_sprite(spec));
+    }
+    for (const bool perceptual : {false, true}) {
+        bench.stage(corpus, perceptual ? "dedup:perceptual" : "dedup:exact", [&](std::string& error) {
+            if (deduplicate(corpus.sprites, pixels, perceptual, workers) >= corpus.sprites.size()) {
+                error = "no sprite kept";
+                return false;
+            }
+            return true;
+        });
+    }
+
+    // Every later stage works from the fast layout.
+    const fs::path layout_path = out_dir / "layout_fast.txt";
+    std::string layout_text;
+    if (!read_file(layout_path, layout_text) || layout_text.empty()) {
+        std::cerr << "  " << corpus.name << "/" << corpus.scale << ": no layout, skipping later stages\n";
+        return;
+    }
+
+    sprat::core::Layout layout;
+    bench.stage(corpus, "parse_layout", [&](std::string& error) {
+        layout = sprat::core::Layout();
+        return sprat::core::parse_layout(std::string_view(layout_text), layout, error);
+    });
+
+    std::vector<fs::path> transforms;
+    for (const auto& entry : fs::directory_iterator(SPRAT_BENCH_TRANSFORMS_DIR, ec)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".jsonnet") {
+            transforms.push_back(entry.path());
+        }
+    }
+    std::sort(transforms.begin(), transforms.end());
+    for (const fs::path& transform : transforms) {
+        bench.tool_stage(corpus, "convert:" + transform.stem().string(),
+                         {{SPRAT_BENCH_SPRATCONVERT, "--transform", transform.string()}, layout_path,
+                          out_dir / ("convert_" + transform.stem().string())});
+    }
+
+    std::vector<std::vector<unsigned char>> atlases;
+    bench.stage(corpus, "blit", [&](std::string& error) {
+        return blit_layout(layout, pixels, specs, atlases, error);
+    });
+    pixels.clear();
+    if (atlases.size() != layout.atlases.size() || !sprat::core::PngStreamWriter::available()) {
+        std::cerr << "  " << corpus.name << "/" << corpus.scale << ": no atlas or no zlib, skipping encode and frames\n";
+        return;
+    }
+
+    std::vector<std::vector<unsigned char>> encoded;
+    bench.stage(corpus, "encode:png", [&](std::string& error) {
+        return encode_atlases(layout, atlases, PngEncoder::whole, workers, encoded, error);
+    });
+    if (encoded.empty() || encoded.front().empty()) {
+        return;
+    }
+    const fs::path atlas_path = out_dir / "atlas.png";
+    {
+        std::ofstream out(atlas_path, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(encoded.front().data()), static_cast<std::streamsize>(encoded.front().size()));
+    }
+    bench.stage(corpus, "encode:png-band-rows", [&](std::string& error) {
+        return encode_atlases(layout, atlases, PngEncoder::band_rows, workers, encoded, error);
+    });
+    encoded.clear();
+    if (corpus.scale == k_zopfli_scale) {
+#ifdef SPRAT_HAS_ZOPFLI
+        bench.stage(corpus, "encode:zopfli", [&](std::string& error) {
+            return encode_atlases(layout, atlases, PngEncoder::zopfli, workers, encoded, error);
+        });
+        encoded.clear();
+#endif
+    }
+#ifdef SPRAT_HAS_WEBP
+    bench.stage(corpus, "encode:webp", [&](std::string& error) {
+        return encode_atlases_with(atlases, "encode_webp", [&](size_t i) {
+            return sprat::core::encode_webp(atlases[i].data(), layout.atlases[i].width, layout.atlases[i].height, 100);
+        }, error);
+    });
+#endif
+#ifdef SPRAT_HAS_AVIF
+    bench.stage(corpus, "encode:avif", [&](std::string& error) {
+        return encode_atlases_with(atlases, "encode_avif", [&](size_t i) {
+            return sprat::core::encode_avif(atlases[i].data(), layout.atlases[i].width, layout.atlases[i].height, 100);
+        }, error);
+    });
+#endif
+#ifdef SPRAT_HAS_SQUISH
+    {
+        // spratpack only block-compresses atlases whose sides are multiples
+        // of 4, so these stages compress copies padded with transparent
+        // pixels, prepared outside the timed stage.
+        std::vector<std::vector<unsigned char>> padded(atlases.size());
+        std::vector<std::pair<int, int>> padded_sizes(atlases.size());
+        std::vector<std::vector<sprat::core::Sprite>> atlas_sprites(atlases.size());
+        for (size_t i = 0; i < atlases.size(); ++i) {
+            const int width = layout.atlases[i].width;
+            const int height = layout.atlases[i].height;
+            const int padded_width = (width + 3) / 4 * 4;
+            padded_sizes[i] = {padded_width, (height + 3) / 4 * 4};
+            padded[i].assign(static_cast<size_t>(padded_width) * padded_sizes[i].second * k_channels, 0);
+            for (int y = 0; y < height; ++y) {
+                std::memcpy(padded[i].data() + static_cast<size_t>(y) * padded_width * k_channels,
+                            atlases[i].data() + static_cast<size_t>(y) * width * k_channels,
+                            static_cast<size_t>(width) * k_channels);
+            }
+        }
+        for (const sprat::core::Sprite& sprite : layout.sprites) {
+            if (sprite.atlas_index >= 0 && static_cast<size_t>(sprite.atlas_index) < atlases.size()) {
+                atlas_sprites[static_cast<size_t>(sprite.atlas_index)].push_back(sprite);
+            }
+        }
+        for (const char* format : {"dxt1", "dxt5"}) {
+            bench.stage(corpus, std::string("encode:") + format, [&](std::string& error) {
+                return encode_atlases_with(padded, "compress_to_dds", [&](size_t i) {
+                    return sprat::core::compress_to_dds(padded[i], padded_sizes[i].first, padded_sizes[i].second,
+                                                        format, atlas_sprites[i], 0, workers);
+                }, error);
+            });
+        }
+    }
+#endif
+    atlases.clear();
+
+    bench.tool_stage(corpus, "frames",
+                     {with_threads({SPRAT_BENCH_SPRATFRAMES, atlas_path.string()}, options.threads),
+                      {}, out_dir / "frames.txt"});
+}
+
+std::string json_escape(std::string_view text) {
+    std::string out;
+    for (char c : text) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                static const char k_hex[] = "0123456789abcdef";
+                out += "\\u00";
+                out += k_hex[(c >> 4) & 0xf];
+                out += k_hex[c & 0xf];
+            } else {
+                out += c;
+            }
+        }
+    }
+    return out;
+}
+
+void write_json(std::ostream& out, const Options& options, const std::vector<StageResult>& results) {
+    out << "{\n"
+        << "  \"version\": \"" << json_escape(SPRAT_VERSION) << "\",\n"
+        << "  \"repeats\": " << options.repeats << ",\n"
+        << "  \"threads\": " << options.threads << ",\n"
+        << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const StageResult& r = results[i];
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"corpus\": \"" << r.corpus << "\", \"scale\": \"" << r.scale
+            << "\", \"sprites\": " << r.sprites << ", \"stage\": \"" << json_escape(r.stage)
+            << "\", \"ok\": " << (r.ok ? "true" : "false");
+        if (!r.ok) {
+            out << ", \"error\": \"" << json_escape(r.error) << "\"}";
+            continue;
+        }
+        std::vector<double> sorted = r.runs_ms;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.0;
+        out << ", \"runs_ms\": [";
+        for (size_t k = 0; k < r.runs_ms.size(); ++k) {
+            out << (k == 0 ? "" : ", ") << r.runs_ms[k];
+            total += r.runs_ms[k];
+        }
+        const size_t mid = sorted.size() / 2;
+        const double median = sorted.size() % 2 == 1 ? sorted[mid] : (sorted[mid - 1] + sorted[mid]) / 2.0;
+        out << "], \"min_ms\": " << sorted.front()
+            << ", \"median_ms\": " << median
+            << ", \"mean_ms\": " << total / static_cast<double>(sorted.size()) << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+std::vector<std::string> split_list(const std::string& value) {
+    std::vector<std::string> items;
+    std::stringstream in(value);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+void print_usage() {
+    std::cout << "Usage: sprat_bench [OPTIONS]\n"
+              << "\n"
+              << "Generate synthetic sprite corpora, time each pipeline stage and print JSON.\n"
+              << "\n"
+              << "Options:\n"
+              << "  --scales LIST     Comma-separated scales: small, medium, large (default: small,medium)\n"
+              << "  --corpora LIST    Comma-separated corpora: icons, skewed, strips (default: all)\n"
+              << "  --repeats N       Timed runs per stage (default: " << k_default_repeats << ")\n"
+              << "  --threads N       Worker threads passed to the tools (default: auto)\n"
+              << "  --work-dir PATH   Scratch directory (default: <temp>/sprat_bench)\n"
+              << "  --output PATH     Write JSON to PATH instead of stdout\n"
+              << "  --keep            Keep the scratch directory\n";
+}
+
+bool parse_options(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--scales" && has_value) {
+            options.scales = split_list(argv[++i]);
+        } else if (arg == "--corpora" && has_value) {
+            options.corpora = split_list(argv[++i]);
+        } else if (arg == "--repeats" && has_value) {
+            options.repeats = std::atoi(argv[++i]);
+        } else if (arg == "--threads" && has_value) {
+            options.threads = static_cast<unsigned int>(std::max(0, std::atoi(argv[++i])));
+        } else if (arg == "--work-dir" && has_value) {
+            options.work_dir = argv[++i];
+        } else if (arg == "--output" && has_value) {
+            options.output = argv[++i];
+        } else if (arg == "--keep") {
+            options.keep = true;
+        } else {
+            return false;
+        }
+    }
+    for (const std::string& scale : options.scales) {
+        if (std::none_of(std::begin(k_scales), std::end(k_scales),
+                         [&](const Scale& s) { return scale == s.name; })) {
+            return false;
+        }
+    }
+    for (const std::string& corpus : options.corpora) {
+        if (std::none_of(std::begin(k_corpora), std::end(k_corpora),
+                         [&](const char* c) { return corpus == c; })) {
+            return false;
+        }
+    }
+    return options.repeats > 0 && !options.scales.empty() && !options.corpora.empty();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage();
+        return 1;
+    }
+    std::error_code ec;
+    if (options.work_dir.empty()) {
+        options.work_dir = fs::temp_directory_path(ec) / "sprat_bench";
+    }
+    options.work_dir = fs::absolute(options.work_dir, ec);
+    fs::remove_all(options.work_dir, ec);
+    fs::create_directories(options.work_dir, ec);
+    if (ec) {
+        std::cerr << "Failed to create " << options.work_dir.string() << "\n";
+        return 1;
+    }
+
+    Bench bench(options);
+    for (const std::string& scale_name : options.scales) {
+        const Scale& scale = *std::find_if(std::begin(k_scales), std::end(k_scales),
+                                           [&](const Scale& s) { return scale_name == s.name; });
+        for (const std::string& corpus_name : options.corpora) {
+            Corpus corpus;
+            corpus.name = corpus_name;
+            corpus.scale = scale.name;
+            corpus.dir = options.work_dir / "corpora" / (corpus_name + "_" + scale.name);
+            corpus.sprites = make_specs(corpus_name, scale.sprites);
+            corpus.uniform = corpus_name == "icons";
+            std::cerr << "Generating " << corpus_name << "/" << scale.name << " ("
+                      << corpus.sprites.size() << " sprites)\n";
+            if (!write_corpus(corpus)) {
+                return 1;
+            }
+            run_corpus(bench, options, corpus);
+        }
+    }
+
+    if (options.output.empty()) {
+        write_json(std::cout, options, bench.results());
+    } else {
+        std::ofstream out(options.output);
+        write_json(out, options, bench.results());
+        if (!out) {
+            std::cerr << "Failed to write " << options.output.string() << "\n";
+            return 1;
+        }
+    }
+    if (!options.keep) {
+        fs::remove_all(options.work_dir, ec);
+    }
+    return 0;
+}
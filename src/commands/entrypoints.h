@@ -1,7 +1,24 @@
 #pragma once
 
+#include <string>
+
+namespace sprat::core {
+struct Layout;
+}
+
 int run_spratlayout(int argc, char** argv);
 int run_spratpack(int argc, char** argv);
 int run_spratconvert(int argc, char** argv);
 int run_spratframes(int argc, char** argv);
 int run_spratunpack(int argc, char** argv);
+int run_sprat(int argc, char** argv);
+
+// Variants for tools run in one process. spratlayout hands back the layout
+// it built along with its text instead of writing the text to stdout; the
+// others take that layout instead of reading layout text from stdin.
+// spratconvert also needs the text, which carries the marker and animation
+// lines.
+int run_spratlayout_layout(int argc, char** argv, sprat::core::Layout& layout, std::string& layout_text);
+int run_spratpack_layout(int argc, char** argv, const sprat::core::Layout& layout);
+int run_spratconvert_layout(int argc, char** argv, const std::string& layout_text,
+                            const sprat::core::Layout& layout);
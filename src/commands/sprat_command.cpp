@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "core/i18n.h"
+#include "core/layout_parser.h"
+#include "core/pixel_cache.h"
+#include "core/profiler.h"
+#include "commands/entrypoints.h"
+
+namespace {
+
+namespace fs = std::filesystem;
+using sprat::core::tr;
+
+struct Tool {
+    const char* name;
+    int (*run)(int argc, char** argv);
+};
+
+constexpr Tool k_tools[] = {
+    {"layout", run_spratlayout},
+    {"pack", run_spratpack},
+    {"convert", run_spratconvert},
+    {"frames", run_spratframes},
+    {"unpack", run_spratunpack},
+};
+
+// Arguments handed to one tool; argv[0] stays the sprat executable so the
+// tools still find spratprofiles.cfg and transforms/ beside it.
+class ToolArgs {
+public:
+    ToolArgs(const char* program, const std::vector<std::string>& args) : values_(args) {
+        pointers_.reserve(values_.size() + 2);
+        pointers_.push_back(const_cast<char*>(program));
+        for (std::string& value : values_) {
+            pointers_.push_back(value.data());
+        }
+        pointers_.push_back(nullptr);
+    }
+
+    int argc() const { return static_cast<int>(pointers_.size() - 1); }
+    char** argv() { return pointers_.data(); }
+
+private:
+    std::vector<std::string> values_;
+    std::vector<char*> pointers_;
+};
+
+// Sprites decoded by the layout stage stay in memory for the pack stage.
+class InMemoryPixelCache {
+public:
+    InMemoryPixelCache() { sprat::core::set_pixel_cache_in_memory(true); }
+    ~InMemoryPixelCache() { sprat::core::set_pixel_cache_in_memory(false); }
+    InMemoryPixelCache(const InMemoryPixelCache&) = delete;
+    InMemoryPixelCache& operator=(const InMemoryPixelCache&) = delete;
+};
+
+struct BuildArgs {
+    std::vector<std::string> layout_args;
+    std::vector<std::string> pack_args;
+    std::vector<std::string> convert_args;
+    fs::path output_dir = ".";
+    std::string atlas_pattern;
+    std::string save_layout_path;
+    std::string trace_path;
+};
+
+void print_usage() {
+    std::cout << tr("Usage: sprat COMMAND [ARGS...]\n")
+              << tr("\n")
+              << tr("Commands:\n")
+              << tr("  layout|pack|convert|frames|unpack ARGS...\n")
+              << tr("                     Run spratlayout, spratpack, ... with ARGS\n")
+              << tr("  build [LAYOUT ARGS] [--pack PACK ARGS] [--convert CONVERT ARGS]\n")
+              << tr("                     Lay out, pack and convert in one process\n")
+              << tr("\n")
+              << tr("Build options (before --pack):\n")
+              << tr("  --output-dir DIR   Directory for atlases and metadata (default: .)\n")
+              << tr("  --atlas PATTERN    Atlas file name (default: atlas.png, or atlas_%d.png\n")
+              << tr("                     for several atlases; the extension follows --format)\n")
+              << tr("  --save-layout FILE Also write the layout text to FILE\n")
+              << tr("  --trace FILE       Write stage timings of all steps as Chrome trace JSON\n")
+              << tr("\n")
+              << tr("  --help, -h         Show this help message\n")
+              << tr("  --version, -v      Show version\n");
+}
+
+// Returns -1 to continue, otherwise the exit code.
+int parse_build_args(int argc, char** argv, BuildArgs& args) {
+    std::vector<std::string>* section = &args.layout_args;
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--pack") {
+            section = &args.pack_args;
+        } else if (arg == "--convert") {
+            section = &args.convert_args;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            // One trace covers every stage, wherever the option was given.
+            args.trace_path = argv[++i];
+        } else if (section != &args.layout_args) {
+            section->push_back(arg);
+        } else if (arg == "--help" || arg == "-h") {
+            print_usage();
+            return 0;
+        } else if (arg == "--output-dir" && i + 1 < argc) {
+            args.output_dir = argv[++i];
+        } else if (arg == "--atlas" && i + 1 < argc) {
+            args.atlas_pattern = argv[++i];
+        } else if (arg == "--save-layout" && i + 1 < argc) {
+            args.save_layout_path = argv[++i];
+        } else {
+            section->push_back(arg);
+        }
+    }
+    return -1;
+}
+
+std::string atlas_extension(const std::vector<std::string>& pack_args) {
+    std::string extension = ".png";
+    for (size_t i = 0; i + 1 < pack_args.size(); ++i) {
+        if (pack_args[i] == "--format") {
+            extension = "." + pack_args[i + 1];
+            std::transform(extension.begin(), extension.end(), extension.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        } else if (pack_args[i] == "--gpu-compress") {
+            return ".dds";
+        }
+    }
+    return extension;
+}
+
+// Runs spratlayout, spratpack and spratconvert in this process. The layout
+// spratlayout builds is handed straight to both later stages, which run side
+// by side; sprites decoded for the layout are blitted from memory.
+int run_build(int argc, char** argv) {
+    BuildArgs args;
+    const int early_exit = parse_build_args(argc, argv, args);
+    if (early_exit >= 0) {
+        return early_exit;
+    }
+    sprat::core::ProfileSession profile_session("sprat");
+    if (!args.trace_path.empty()) {
+        profile_session.start(args.trace_path);
+    }
+
+    std::error_code ec;
+    fs::create_directories(args.output_dir, ec);
+    if (ec) {
+        std::cerr << tr("Failed to create output directory: ") << ec.message() << "\n";
+        return 1;
+    }
+
+    InMemoryPixelCache pixel_cache;
+    sprat::core::Layout layout;
+    std::string layout_text;
+    {
+        std::vector<std::string> layout_args = args.layout_args;
+        layout_args.push_back("--pixel-cache");
+        ToolArgs tool_args(argv[0], layout_args);
+        const int code = run_spratlayout_layout(tool_args.argc(), tool_args.argv(), layout, layout_text);
+        if (code != 0) {
+            return code;
+        }
+    }
+    if (layout.atlases.empty()) {
+        std::cerr << tr("No atlas defined in layout") << "\n";
+        return 1;
+    }
+    if (!args.save_layout_path.empty()) {
+        std::ofstream out(args.save_layout_path, std::ios::binary);
+        out << layout_text;
+        if (!out) {
+            std::cerr << tr("Failed to write layout: ") << args.save_layout_path << "\n";
+            return 1;
+        }
+    }
+
+    std::string atlas_pattern = args.atlas_pattern;
+    if (atlas_pattern.empty()) {
+        atlas_pattern = (layout.multipack || layout.atlases.size() > 1 ? "atlas_%d" : "atlas") +
+                        atlas_extension(args.pack_args);
+    }
+
+    std::vector<std::string> pack_args = args.pack_args;
+    pack_args.insert(pack_args.end(), {"--pixel-cache", "--output", (args.output_dir / atlas_pattern).string()});
+    std::vector<std::string> convert_args = args.convert_args;
+    convert_args.insert(convert_args.end(), {"--atlas", atlas_pattern, "--output-dir", args.output_dir.string()});
+    ToolArgs pack_tool_args(argv[0], pack_args);
+    ToolArgs convert_tool_args(argv[0], convert_args);
+
+    // Metadata only needs the layout, so it is converted while the atlases
+    // are packed.
+    int convert_code = 0;
+    auto convert = [&]() {
+        convert_code = run_spratconvert_layout(convert_tool_args.argc(), convert_tool_args.argv(),
+                                               layout_text, layout);
+    };
+#ifdef __EMSCRIPTEN__
+    convert();
+    const int pack_code = run_spratpack_layout(pack_tool_args.argc(), pack_tool_args.argv(), layout);
+#else
+    std::thread convert_thread(convert);
+    const int pack_code = run_spratpack_layout(pack_tool_args.argc(), pack_tool_args.argv(), layout);
+    convert_thread.join();
+#endif
+    return pack_code != 0 ? pack_code : convert_code;
+}
+
+} // namespace
+
+int run_sprat(int argc, char** argv) {
+    if (argc < 2) {
+        print_usage();
+        return 1;
+    }
+    const std::string command = argv[1];
+    if (command == "--help" || command == "-h") {
+        print_usage();
+        return 0;
+    }
+    if (command == "--version" || command == "-v") {
+        std::cout << tr("sprat version ") << SPRAT_VERSION << "\n";
+        return 0;
+    }
+    if (command == "build") {
+        return run_build(argc, argv);
+    }
+    for (const Tool& tool : k_tools) {
+        if (command == tool.name) {
+            ToolArgs tool_args(argv[0], std::vector<std::string>(argv + 2, argv + argc));
+            return tool.run(tool_args.argc(), tool_args.argv());
+        }
+    }
+    std::cerr << tr("Unknown command: ") << command << "\n";
+    print_usage();
+    return 1;
+}
@@ -17,25 +17,34 @@
 #endif
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cctype>
+#include <charconv>
+#include <cmath>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <filesystem>
 namespace fs = std::filesystem;
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 #include <optional>
 #include <system_error>
+#include <thread>
 #include "core/layout_parser.h"
 #include "core/cli_parse.h"
 #include "core/i18n.h"
 #include "core/output_pattern.h"
 #include "core/fnv1a.h"
+#include "core/profiler.h"
+#include "commands/entrypoints.h"
 #include <libjsonnet++.h>
 
 namespace {
@@ -117,9 +126,7 @@ bool read_text_file(const fs::path& path, std::string& out, std::string& error)
     return true;
 }
 
-std::string escape_json(const std::string& s) {
-    std::string out;
-    out.reserve(s.size() + k_string_growth_padding);
+void append_json_escaped(std::string& out, std::string_view s) {
     for (char c : s) {
         switch (c) {
             case '"': out += "\\\""; break;
@@ -141,13 +148,27 @@ std::string escape_json(const std::string& s) {
                 break;
         }
     }
+}
+
+std::string escape_json(const std::string& s) {
+    std::string out;
+    out.reserve(s.size() + k_string_growth_padding);
+    append_json_escaped(out, s);
     return out;
 }
 
-std::string format_double(double value) {
+// Appends value the way "%.*g" prints it with k_default_precision digits.
+void append_decimal(std::string& out, double value) {
     std::array<char, 32> buf{};
-    int n = std::snprintf(buf.data(), buf.size(), "%.*g", k_default_precision, value);
-    return std::string(buf.data(), n > 0 ? static_cast<size_t>(n) : 0);
+    const auto r = std::to_chars(buf.data(), buf.data() + buf.size(), value,
+                                 std::chars_format::general, k_default_precision);
+    out.append(buf.data(), r.ptr);
+}
+
+std::string format_double(double value) {
+    std::string out;
+    append_decimal(out, value);
+    return out;
 }
 
 std::string sprite_name_from_path(const std::string& path) {
@@ -622,8 +643,288 @@ std::string extract_variant(const std::string& stem) {
 
 // ─── Jsonnet helpers ──────────────────────────────────────────────────────────
 
-// Build the JSON data string passed as std.extVar("sprat") to all transforms.
-std::string build_sprat_json(
+// The sprat JSON document without its per-output fields. output_stem and
+// output_stem_hash_hex differ between the transforms of one run, so they are
+// spliced in at stem_offset by sprat_json_for_stem and the rest is built once.
+struct SpratJson {
+    std::string text;
+    size_t stem_offset = 0;
+};
+
+std::string to_hex16(uint64_t v) {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(v));
+    return std::string(buf);
+}
+
+// Room reserved in SpratJson::text for the fields spliced in per output stem.
+constexpr size_t k_stem_fields_bytes = 128;
+
+std::string stem_fields_json(const std::string& output_pattern_arg,
+                             const std::string& output_stem) {
+    // Global hash for output_stem
+    const std::string& hash_source = output_pattern_arg.empty() ? output_stem : output_pattern_arg;
+    const uint64_t stem_hash = sprat::core::fnv1a_hash(
+        reinterpret_cast<const unsigned char*>(hash_source.c_str()), hash_source.size());
+    std::string fields;
+    fields.reserve(k_stem_fields_bytes + output_stem.size());
+    fields += ",\"output_stem\":\"";
+    append_json_escaped(fields, output_stem);
+    fields += "\",\"output_stem_hash_hex\":\"";
+    fields += to_hex16(stem_hash);
+    fields += '"';
+    return fields;
+}
+
+std::string sprat_json_for_stem(const SpratJson& doc,
+                                const std::string& output_pattern_arg,
+                                const std::string& output_stem) {
+    const std::string fields = stem_fields_json(output_pattern_arg, output_stem);
+    std::string j;
+    j.reserve(doc.text.size() + fields.size());
+    j.append(doc.text, 0, doc.stem_offset);
+    j += fields;
+    j.append(doc.text, doc.stem_offset, std::string::npos);
+    return j;
+}
+
+// Like sprat_json_for_stem, but splices the fields into doc's own buffer; for
+// a run with a single transform, which then never copies the document.
+std::string take_sprat_json_for_stem(SpratJson&& doc,
+                                     const std::string& output_pattern_arg,
+                                     const std::string& output_stem) {
+    doc.text.insert(doc.stem_offset, stem_fields_json(output_pattern_arg, output_stem));
+    return std::move(doc.text);
+}
+
+// Build CSS-safe identifier
+std::string to_css_name(const std::string& name) {
+    std::string out;
+    for (char c : name) {
+        if (std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_') {
+            out.push_back(c);
+        } else {
+            out.push_back('-');
+        }
+    }
+    if (!out.empty() && std::isdigit(static_cast<unsigned char>(out[0]))) {
+        out.insert(0, 1, '_');
+    }
+    return out;
+}
+
+// Per-sprite values derived from the layout, shared by build_sprat_json and
+// the native emitters so both describe a sprite the same way.
+struct SpriteFacts {
+    int content_w = 0;
+    int content_h = 0;
+    int source_w = 0;
+    int source_h = 0;
+    bool has_trim = false;
+    int unity_y = 0;
+    int pivot_x = 0;
+    int pivot_y = 0;
+    double pivot_x_norm = 0.0;
+    double pivot_y_norm = 0.0;
+    double pivot_y_norm_raw = 0.0;
+};
+
+SpriteFacts sprite_facts(const Layout& layout,
+                         size_t i,
+                         const std::vector<std::vector<MarkerItem>>& sprite_markers,
+                         int global_pivot_x,
+                         int global_pivot_y,
+                         bool has_global_pivot) {
+    const Sprite& s = layout.sprites[i];
+    SpriteFacts f;
+    f.content_w = s.rotated ? s.h : s.w;
+    f.content_h = s.rotated ? s.w : s.h;
+    f.source_w  = f.content_w + s.src_x + s.trim_right;
+    f.source_h  = f.content_h + s.src_y + s.trim_bottom;
+    f.has_trim = (s.src_x != 0) || (s.src_y != 0) ||
+                 (s.trim_right != 0) || (s.trim_bottom != 0);
+
+    if (s.atlas_index >= 0 && static_cast<size_t>(s.atlas_index) < layout.atlases.size()) {
+        f.unity_y = layout.atlases[static_cast<size_t>(s.atlas_index)].height - s.y - s.h;
+    }
+
+    f.pivot_x = has_global_pivot ? global_pivot_x : 0;
+    f.pivot_y = has_global_pivot ? global_pivot_y : 0;
+    for (const auto& marker : sprite_markers[i]) {
+        if (marker.name == "pivot" && marker.type == "point") {
+            f.pivot_x = marker.x;
+            f.pivot_y = marker.y;
+            break;
+        }
+    }
+
+    f.pivot_x_norm = (f.source_w > 0) ? (static_cast<double>(f.pivot_x) / f.source_w) : 0.0;
+    f.pivot_y_norm = (f.source_h > 0) ? (1.0 - static_cast<double>(f.pivot_y) / f.source_h) : 0.0;
+    f.pivot_y_norm_raw = (f.source_h > 0) ? (static_cast<double>(f.pivot_y) / f.source_h) : 0.0;
+    return f;
+}
+
+// Appends compact JSON to a single caller-owned buffer. Strings are escaped
+// and numbers formatted straight into that buffer, so a document of any size
+// is written without per-field temporaries or intermediate copies.
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) : out_(out) {}
+
+    void begin_object() { open('{'); }
+    void end_object() { close('}'); }
+    void begin_array() { open('['); }
+    void end_array() { close(']'); }
+
+    // Starts an object member; k is written verbatim and must need no escaping.
+    void key(std::string_view k) {
+        next_member();
+        out_ += '"';
+        out_ += k;
+        out_ += "\":";
+    }
+    // Starts an array element; its value is written next.
+    void element() { next_member(); }
+
+    void string_value(std::string_view s) {
+        out_ += '"';
+        append_json_escaped(out_, s);
+        out_ += '"';
+    }
+    void int_value(long long v) { append_chars(v); }
+    void uint_value(unsigned long long v) { append_chars(v); }
+    // An unsigned integer written as a JSON string, for 64-bit values that
+    // must survive readers that parse numbers as doubles.
+    void uint_string_value(unsigned long long v) {
+        out_ += '"';
+        append_chars(v);
+        out_ += '"';
+    }
+    void number_value(double v) { append_decimal(out_, v); }
+    void bool_value(bool v) { out_ += v ? "true" : "false"; }
+    void hex16_value(uint64_t v) {
+        out_ += '"';
+        for (int shift = 60; shift >= 0; shift -= BITS_PER_NIBBLE) {
+            out_ += HEX_DIGITS[(v >> shift) & HEX_NIBBLE_MASK];
+        }
+        out_ += '"';
+    }
+
+    size_t offset() const { return out_.size(); }
+    // Writes bytes [begin, end) of the buffer again as the next value; used
+    // for a value that appears more than once in the document.
+    void repeat_value(size_t begin, size_t end) {
+        const size_t len = end - begin;
+        if (out_.capacity() < out_.size() + len) {
+            out_.reserve(std::max(out_.capacity() * 2, out_.size() + len));
+        }
+        out_.append(out_.data() + begin, len);
+    }
+
+private:
+    template <typename T>
+    void append_chars(T v) {
+        std::array<char, 24> buf{};
+        const auto r = std::to_chars(buf.data(), buf.data() + buf.size(), v);
+        out_.append(buf.data(), r.ptr);
+    }
+    void open(char c) {
+        out_ += c;
+        first_.push_back(true);
+    }
+    void close(char c) {
+        out_ += c;
+        first_.pop_back();
+    }
+    void next_member() {
+        if (!first_.empty()) {
+            if (!first_.back()) {
+                out_ += ',';
+            }
+            first_.back() = false;
+        }
+    }
+
+    std::string& out_;
+    std::vector<bool> first_;
+};
+
+// Rough serialized sizes used to reserve the sprat JSON buffer up front, so
+// it is not reallocated and copied while it grows.
+constexpr size_t k_sprite_json_bytes = 768;
+constexpr size_t k_marker_json_bytes = 192;
+constexpr size_t k_frame_json_bytes = 96;
+constexpr size_t k_animation_json_bytes = 160;
+constexpr size_t k_document_json_bytes = 1024;
+
+size_t estimate_sprat_json_size(const Layout& layout,
+                                const std::vector<std::string>& sprite_names,
+                                const std::vector<MarkerItem>& marker_items,
+                                const std::vector<AnimationItem>& animations) {
+    size_t sprites = 0;
+    for (size_t i = 0; i < layout.sprites.size(); ++i) {
+        sprites += k_sprite_json_bytes + layout.sprites[i].path.size() + 2 * sprite_names[i].size();
+    }
+    size_t markers = 0;
+    for (const MarkerItem& m : marker_items) {
+        markers += k_marker_json_bytes + m.name.size() + m.sprite_name.size() + m.sprite_path.size();
+    }
+    size_t anims = 0;
+    for (const AnimationItem& a : animations) {
+        anims += k_animation_json_bytes + a.name.size() + a.sprite_indexes.size() * k_frame_json_bytes;
+    }
+    // Sprites are listed twice: in sprat.sprites and in their atlas. Markers
+    // appear globally and once more under their sprite.
+    return k_document_json_bytes + 2 * sprites + 2 * markers + anims;
+}
+
+// One marker object, as found in sprat.markers and each sprite's markers.
+void write_sprat_marker(JsonWriter& w, const MarkerItem& m) {
+    w.begin_object();
+    w.key("name");
+    w.string_value(m.name);
+    w.key("type");
+    w.string_value(m.type);
+    w.key("x");
+    w.int_value(m.x);
+    w.key("y");
+    w.int_value(m.y);
+    if (m.type == "circle") {
+        w.key("radius");
+        w.int_value(m.radius);
+    } else if (m.type == "rectangle") {
+        w.key("w");
+        w.int_value(m.w);
+        w.key("h");
+        w.int_value(m.h);
+    } else if (m.type == "polygon") {
+        w.key("vertices");
+        w.begin_array();
+        for (const auto& v : m.vertices) {
+            w.element();
+            w.begin_object();
+            w.key("x");
+            w.int_value(v.first);
+            w.key("y");
+            w.int_value(v.second);
+            w.end_object();
+        }
+        w.end_array();
+    }
+    w.key("sprite_index");
+    w.int_value(m.sprite_index);
+    w.key("sprite_name");
+    w.string_value(m.sprite_name);
+    w.key("sprite_path");
+    w.string_value(m.sprite_path);
+    w.key("index");
+    w.uint_value(m.index);
+    w.end_object();
+}
+
+// Build the JSON data passed as std.extVar("sprat") to all transforms; pass
+// it through sprat_json_for_stem to get the string a transform sees.
+SpratJson build_sprat_json(
     const Layout& layout,
     const std::vector<std::string>& sprite_names,
     const std::vector<MarkerItem>& marker_items,
@@ -633,167 +934,114 @@ std::string build_sprat_json(
     int global_pivot_y,
     bool has_global_pivot,
     const std::string& output_pattern_arg,
-    const std::string& output_stem,
     const std::string& markers_path_arg,
     const std::string& animations_path_arg,
     int animation_fps)
 {
-    // Helper: format uint64 as 16-char hex string
-    auto to_hex16 = [](uint64_t v) -> std::string {
-        char buf[17];
-        std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(v));
-        return std::string(buf);
-    };
-
-    // Helper: build CSS-safe identifier
-    auto to_css_name = [](const std::string& name) -> std::string {
-        std::string out;
-        for (char c : name) {
-            if (std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_') {
-                out.push_back(c);
-            } else {
-                out.push_back('-');
-            }
-        }
-        if (!out.empty() && std::isdigit(static_cast<unsigned char>(out[0]))) {
-            out.insert(0, 1, '_');
-        }
-        return out;
-    };
+    SpratJson doc;
+    std::string& j = doc.text;
+    j.reserve(estimate_sprat_json_size(layout, sprite_names, marker_items, normalized_animations) +
+              k_stem_fields_bytes);
+    JsonWriter w(j);
 
-    // Helper: build JSON array of marker objects
-    auto marker_to_json = [&](const MarkerItem& m) -> std::string {
-        std::string o = "{\"name\":\"" + escape_json(m.name) + "\"";
-        o += ",\"type\":\"" + escape_json(m.type) + "\"";
-        o += ",\"x\":" + std::to_string(m.x);
-        o += ",\"y\":" + std::to_string(m.y);
-        if (m.type == "circle") {
-            o += ",\"radius\":" + std::to_string(m.radius);
-        } else if (m.type == "rectangle") {
-            o += ",\"w\":" + std::to_string(m.w);
-            o += ",\"h\":" + std::to_string(m.h);
-        } else if (m.type == "polygon") {
-            o += ",\"vertices\":[";
-            for (size_t vi = 0; vi < m.vertices.size(); ++vi) {
-                if (vi > 0) o += ',';
-                o += "{\"x\":" + std::to_string(m.vertices[vi].first);
-                o += ",\"y\":" + std::to_string(m.vertices[vi].second) + "}";
-            }
-            o += "]";
-        }
-        o += ",\"sprite_index\":" + std::to_string(m.sprite_index);
-        o += ",\"sprite_name\":\"" + escape_json(m.sprite_name) + "\"";
-        o += ",\"sprite_path\":\"" + escape_json(m.sprite_path) + "\"";
-        o += ",\"index\":" + std::to_string(m.index);
-        o += "}";
-        return o;
-    };
-
-    // Helper: build full sprite JSON object
-    auto sprite_to_json = [&](size_t i) -> std::string {
+    auto write_sprite = [&](size_t i) {
         const Sprite& s = layout.sprites[i];
         const std::string& sname = sprite_names[i];
-
-        const int content_w = s.rotated ? s.h : s.w;
-        const int content_h = s.rotated ? s.w : s.h;
-        const int source_w  = content_w + s.src_x + s.trim_right;
-        const int source_h  = content_h + s.src_y + s.trim_bottom;
-        const bool has_trim = (s.src_x != 0) || (s.src_y != 0) ||
-                              (s.trim_right != 0) || (s.trim_bottom != 0);
-
-        int unity_y = 0;
-        if (s.atlas_index >= 0 && static_cast<size_t>(s.atlas_index) < layout.atlases.size()) {
-            unity_y = layout.atlases[static_cast<size_t>(s.atlas_index)].height - s.y - s.h;
-        }
-
-        int px = has_global_pivot ? global_pivot_x : 0;
-        int py = has_global_pivot ? global_pivot_y : 0;
-        for (const auto& marker : sprite_markers[i]) {
-            if (marker.name == "pivot" && marker.type == "point") {
-                px = marker.x;
-                py = marker.y;
-                break;
-            }
-        }
-
-        double pivot_x_norm = (source_w > 0) ? (static_cast<double>(px) / source_w) : 0.0;
-        double pivot_y_norm = (source_h > 0) ? (1.0 - static_cast<double>(py) / source_h) : 0.0;
-        double pivot_y_norm_raw = (source_h > 0) ? (static_cast<double>(py) / source_h) : 0.0;
-
+        const SpriteFacts f = sprite_facts(layout, i, sprite_markers,
+                                           global_pivot_x, global_pivot_y, has_global_pivot);
         const uint64_t nh = sprat::core::fnv1a_hash(
             reinterpret_cast<const unsigned char*>(sname.c_str()), sname.size());
-        const std::string nh_hex = to_hex16(nh);
-        const std::string nh_dec = std::to_string(nh);
-
-        std::string a_path = format_atlas_path(output_pattern_arg, s.atlas_index);
-
-        std::string o = "{";
-        o += "\"index\":" + std::to_string(i);
-        o += ",\"name\":\"" + escape_json(sname) + "\"";
-        o += ",\"path\":\"" + escape_json(s.path) + "\"";
-        o += ",\"atlas_index\":" + std::to_string(s.atlas_index);
-        o += ",\"atlas_path\":\"" + escape_json(a_path) + "\"";
-        o += ",\"x\":" + std::to_string(s.x);
-        o += ",\"y\":" + std::to_string(s.y);
-        o += ",\"w\":" + std::to_string(s.w);
-        o += ",\"h\":" + std::to_string(s.h);
-        o += ",\"trim_left\":" + std::to_string(s.src_x);
-        o += ",\"trim_top\":" + std::to_string(s.src_y);
-        o += ",\"trim_right\":" + std::to_string(s.trim_right);
-        o += ",\"trim_bottom\":" + std::to_string(s.trim_bottom);
-        o += ",\"has_trim\":" + std::string(has_trim ? "true" : "false");
-        o += ",\"rotated\":" + std::string(s.rotated ? "true" : "false");
-        if (s.has_slice) {
-            o += ",\"slice_left\":" + std::to_string(s.slice_left);
-            o += ",\"slice_top\":" + std::to_string(s.slice_top);
-            o += ",\"slice_right\":" + std::to_string(s.slice_right);
-            o += ",\"slice_bottom\":" + std::to_string(s.slice_bottom);
-            o += ",\"slice_h\":\"" + s.slice_h + "\"";
-            o += ",\"slice_v\":\"" + s.slice_v + "\"";
-        }
-        o += ",\"content_w\":" + std::to_string(content_w);
-        o += ",\"content_h\":" + std::to_string(content_h);
-        o += ",\"source_w\":" + std::to_string(source_w);
-        o += ",\"source_h\":" + std::to_string(source_h);
-        o += ",\"unity_y\":" + std::to_string(unity_y);
-        o += ",\"pivot_x\":" + std::to_string(px);
-        o += ",\"pivot_y\":" + std::to_string(py);
-        o += ",\"pivot_x_norm\":" + format_double(pivot_x_norm);
-        o += ",\"pivot_y_norm\":" + format_double(pivot_y_norm);
-        o += ",\"pivot_y_norm_raw\":" + format_double(pivot_y_norm_raw);
-        o += ",\"name_hash_hex\":\"" + nh_hex + "\"";
-        o += ",\"name_hash_decimal\":\"" + nh_dec + "\"";
-        o += ",\"name_css\":\"" + escape_json(to_css_name(sname)) + "\"";
-
-        // sprite_markers array
-        o += ",\"markers\":[";
-        const auto& sm = sprite_markers[i];
-        for (size_t j = 0; j < sm.size(); ++j) {
-            if (j > 0) o += ',';
-            o += marker_to_json(sm[j]);
-        }
-        o += "]";
 
-        // atlas dimensions (for per-sprite access)
-        if (s.atlas_index >= 0 && static_cast<size_t>(s.atlas_index) < layout.atlases.size()) {
-            o += ",\"atlas_width\":" +
-                 std::to_string(layout.atlases[static_cast<size_t>(s.atlas_index)].width);
-            o += ",\"atlas_height\":" +
-                 std::to_string(layout.atlases[static_cast<size_t>(s.atlas_index)].height);
-        } else {
-            o += ",\"atlas_width\":0,\"atlas_height\":0";
+        w.begin_object();
+        w.key("index");
+        w.uint_value(i);
+        w.key("name");
+        w.string_value(sname);
+        w.key("path");
+        w.string_value(s.path);
+        w.key("atlas_index");
+        w.int_value(s.atlas_index);
+        w.key("atlas_path");
+        w.string_value(format_atlas_path(output_pattern_arg, s.atlas_index));
+        w.key("x");
+        w.int_value(s.x);
+        w.key("y");
+        w.int_value(s.y);
+        w.key("w");
+        w.int_value(s.w);
+        w.key("h");
+        w.int_value(s.h);
+        w.key("trim_left");
+        w.int_value(s.src_x);
+        w.key("trim_top");
+        w.int_value(s.src_y);
+        w.key("trim_right");
+        w.int_value(s.trim_right);
+        w.key("trim_bottom");
+        w.int_value(s.trim_bottom);
+        w.key("has_trim");
+        w.bool_value(f.has_trim);
+        w.key("rotated");
+        w.bool_value(s.rotated);
+        if (s.has_slice) {
+            w.key("slice_left");
+            w.int_value(s.slice_left);
+            w.key("slice_top");
+            w.int_value(s.slice_top);
+            w.key("slice_right");
+            w.int_value(s.slice_right);
+            w.key("slice_bottom");
+            w.int_value(s.slice_bottom);
+            w.key("slice_h");
+            w.string_value(s.slice_h);
+            w.key("slice_v");
+            w.string_value(s.slice_v);
         }
+        w.key("content_w");
+        w.int_value(f.content_w);
+        w.key("content_h");
+        w.int_value(f.content_h);
+        w.key("source_w");
+        w.int_value(f.source_w);
+        w.key("source_h");
+        w.int_value(f.source_h);
+        w.key("unity_y");
+        w.int_value(f.unity_y);
+        w.key("pivot_x");
+        w.int_value(f.pivot_x);
+        w.key("pivot_y");
+        w.int_value(f.pivot_y);
+        w.key("pivot_x_norm");
+        w.number_value(f.pivot_x_norm);
+        w.key("pivot_y_norm");
+        w.number_value(f.pivot_y_norm);
+        w.key("pivot_y_norm_raw");
+        w.number_value(f.pivot_y_norm_raw);
+        w.key("name_hash_hex");
+        w.hex16_value(nh);
+        w.key("name_hash_decimal");
+        w.uint_string_value(nh);
+        w.key("name_css");
+        w.string_value(to_css_name(sname));
+
+        w.key("markers");
+        w.begin_array();
+        for (const MarkerItem& m : sprite_markers[i]) {
+            w.element();
+            write_sprat_marker(w, m);
+        }
+        w.end_array();
 
-        o += "}";
-        return o;
+        // atlas dimensions (for per-sprite access)
+        const bool in_atlas =
+            s.atlas_index >= 0 && static_cast<size_t>(s.atlas_index) < layout.atlases.size();
+        w.key("atlas_width");
+        w.int_value(in_atlas ? layout.atlases[static_cast<size_t>(s.atlas_index)].width : 0);
+        w.key("atlas_height");
+        w.int_value(in_atlas ? layout.atlases[static_cast<size_t>(s.atlas_index)].height : 0);
+        w.end_object();
     };
 
-    // Global hash for output_stem
-    const std::string& hash_source = output_pattern_arg.empty() ? output_stem : output_pattern_arg;
-    const uint64_t stem_hash = sprat::core::fnv1a_hash(
-        reinterpret_cast<const unsigned char*>(hash_source.c_str()), hash_source.size());
-    const std::string stem_hash_hex = to_hex16(stem_hash);
-
     const std::string atlas_path_0 = format_atlas_path(output_pattern_arg, 0);
     const std::string atlas_stem_0 = fs::path(atlas_path_0).stem().string();
 
@@ -801,121 +1049,212 @@ std::string build_sprat_json(
     const int atlas_w0 = layout.atlases.empty() ? 0 : layout.atlases[0].width;
     const int atlas_h0 = layout.atlases.empty() ? 0 : layout.atlases[0].height;
 
-    std::string j = "{";
+    w.begin_object();
 
     // Global scalars
-    j += "\"atlas_path\":\"" + escape_json(atlas_path_0) + "\"";
-    j += ",\"atlas_stem\":\"" + escape_json(atlas_stem_0) + "\"";
-    j += ",\"atlas_width\":" + std::to_string(atlas_w0);
-    j += ",\"atlas_height\":" + std::to_string(atlas_h0);
-    j += ",\"atlas_count\":" + std::to_string(layout.atlases.size());
-    j += ",\"multipack\":" + std::string(layout.multipack ? "true" : "false");
-    j += ",\"scale\":" + format_double(layout.scale);
-    j += ",\"extrude\":" + std::to_string(layout.extrude);
-    j += ",\"sprite_count\":" + std::to_string(layout.sprites.size());
-    j += ",\"animation_count\":" + std::to_string(normalized_animations.size());
-    j += ",\"marker_count\":" + std::to_string(marker_items.size());
-    j += ",\"output_pattern\":\"" + escape_json(output_pattern_arg) + "\"";
-    j += ",\"output_stem\":\"" + escape_json(output_stem) + "\"";
-    j += ",\"output_stem_hash_hex\":\"" + stem_hash_hex + "\"";
-    j += ",\"has_animations\":" + std::string(normalized_animations.empty() ? "false" : "true");
-    j += ",\"has_markers\":" + std::string(marker_items.empty() ? "false" : "true");
-    j += ",\"animations_path\":\"" + escape_json(animations_path_arg) + "\"";
-    j += ",\"markers_path\":\"" + escape_json(markers_path_arg) + "\"";
-    j += ",\"fps\":" + std::to_string(eff_fps);
-
-    // sprites array (all sprites flat)
-    j += ",\"sprites\":[";
+    w.key("atlas_path");
+    w.string_value(atlas_path_0);
+    w.key("atlas_stem");
+    w.string_value(atlas_stem_0);
+    w.key("atlas_width");
+    w.int_value(atlas_w0);
+    w.key("atlas_height");
+    w.int_value(atlas_h0);
+    w.key("atlas_count");
+    w.uint_value(layout.atlases.size());
+    w.key("multipack");
+    w.bool_value(layout.multipack);
+    w.key("scale");
+    w.number_value(layout.scale);
+    w.key("extrude");
+    w.int_value(layout.extrude);
+    w.key("sprite_count");
+    w.uint_value(layout.sprites.size());
+    w.key("animation_count");
+    w.uint_value(normalized_animations.size());
+    w.key("marker_count");
+    w.uint_value(marker_items.size());
+    w.key("output_pattern");
+    w.string_value(output_pattern_arg);
+    doc.stem_offset = w.offset();
+    w.key("has_animations");
+    w.bool_value(!normalized_animations.empty());
+    w.key("has_markers");
+    w.bool_value(!marker_items.empty());
+    w.key("animations_path");
+    w.string_value(animations_path_arg);
+    w.key("markers_path");
+    w.string_value(markers_path_arg);
+    w.key("fps");
+    w.int_value(eff_fps);
+
+    // sprites array (all sprites flat); each object's span is kept so the
+    // atlases array can repeat it instead of serializing the sprite again.
+    std::vector<std::pair<size_t, size_t>> sprite_spans(layout.sprites.size());
+    w.key("sprites");
+    w.begin_array();
     for (size_t i = 0; i < layout.sprites.size(); ++i) {
-        if (i > 0) j += ',';
-        j += sprite_to_json(i);
+        w.element();
+        sprite_spans[i].first = w.offset();
+        write_sprite(i);
+        sprite_spans[i].second = w.offset();
     }
-    j += "]";
+    w.end_array();
 
     // atlases array
-    j += ",\"atlases\":[";
+    w.key("atlases");
+    w.begin_array();
     for (size_t ai = 0; ai < layout.atlases.size(); ++ai) {
-        if (ai > 0) j += ',';
         const auto& atlas = layout.atlases[ai];
-        const std::string a_path = format_atlas_path(output_pattern_arg, static_cast<int>(ai));
-        j += "{\"index\":" + std::to_string(ai);
-        j += ",\"width\":" + std::to_string(atlas.width);
-        j += ",\"height\":" + std::to_string(atlas.height);
-        j += ",\"path\":\"" + escape_json(a_path) + "\"";
+        w.element();
+        w.begin_object();
+        w.key("index");
+        w.uint_value(ai);
+        w.key("width");
+        w.int_value(atlas.width);
+        w.key("height");
+        w.int_value(atlas.height);
+        w.key("path");
+        w.string_value(format_atlas_path(output_pattern_arg, static_cast<int>(ai)));
         // sprites in this atlas
-        j += ",\"sprites\":[";
-        bool first_as = true;
+        w.key("sprites");
+        w.begin_array();
         for (size_t si = 0; si < layout.sprites.size(); ++si) {
             if (layout.sprites[si].atlas_index == static_cast<int>(ai)) {
-                if (!first_as) j += ',';
-                first_as = false;
-                j += sprite_to_json(si);
+                w.element();
+                w.repeat_value(sprite_spans[si].first, sprite_spans[si].second);
             }
         }
-        j += "]}";
+        w.end_array();
+        w.end_object();
     }
-    j += "]";
+    w.end_array();
 
     // animations array
-    j += ",\"animations\":[";
+    w.key("animations");
+    w.begin_array();
     for (size_t ai = 0; ai < normalized_animations.size(); ++ai) {
-        if (ai > 0) j += ',';
         const AnimationItem& anim = normalized_animations[ai];
         const bool is_alias = !anim.alias_source.empty();
         const int eff_anim_fps = anim.fps > 0 ? anim.fps : DEFAULT_ANIMATION_FPS;
 
-        j += "{\"index\":" + std::to_string(ai);
-        j += ",\"name\":\"" + escape_json(anim.name) + "\"";
-        j += ",\"fps\":" + std::to_string(eff_anim_fps);
-        j += ",\"is_alias\":" + std::string(is_alias ? "true" : "false");
-        j += ",\"alias_source\":\"" + escape_json(anim.alias_source) + "\"";
-        j += ",\"flip\":\"" + escape_json(anim.flip) + "\"";
-
-        // frame_indices
-        j += ",\"frame_indices\":[";
-        for (size_t fi = 0; fi < anim.sprite_indexes.size(); ++fi) {
-            if (fi > 0) j += ',';
-            j += std::to_string(anim.sprite_indexes[fi]);
+        w.element();
+        w.begin_object();
+        w.key("index");
+        w.uint_value(ai);
+        w.key("name");
+        w.string_value(anim.name);
+        w.key("fps");
+        w.int_value(eff_anim_fps);
+        w.key("is_alias");
+        w.bool_value(is_alias);
+        w.key("alias_source");
+        w.string_value(anim.alias_source);
+        w.key("flip");
+        w.string_value(anim.flip);
+
+        w.key("frame_indices");
+        w.begin_array();
+        for (int sidx : anim.sprite_indexes) {
+            w.element();
+            w.int_value(sidx);
         }
-        j += "]";
+        w.end_array();
 
-        // duration
-        double dur = anim.sprite_indexes.empty() ? 0.0
+        const double dur = anim.sprite_indexes.empty() ? 0.0
             : static_cast<double>(anim.sprite_indexes.size()) / static_cast<double>(eff_anim_fps);
-        j += ",\"duration\":" + format_double(dur);
+        w.key("duration");
+        w.number_value(dur);
 
         // frames: resolved sprite info per frame
-        j += ",\"frames\":[";
-        for (size_t fi = 0; fi < anim.sprite_indexes.size(); ++fi) {
-            if (fi > 0) j += ',';
-            const int sidx = anim.sprite_indexes[fi];
+        w.key("frames");
+        w.begin_array();
+        for (int sidx : anim.sprite_indexes) {
             const std::string& fname = sprite_names[static_cast<size_t>(sidx)];
             const uint64_t fnh = sprat::core::fnv1a_hash(
                 reinterpret_cast<const unsigned char*>(fname.c_str()), fname.size());
-            j += "{\"index\":" + std::to_string(sidx);
-            j += ",\"name\":\"" + escape_json(fname) + "\"";
-            j += ",\"name_hash_hex\":\"" + to_hex16(fnh) + "\"";
-            j += ",\"name_hash_decimal\":\"" + std::to_string(fnh) + "\"";
-            j += "}";
+            w.element();
+            w.begin_object();
+            w.key("index");
+            w.int_value(sidx);
+            w.key("name");
+            w.string_value(fname);
+            w.key("name_hash_hex");
+            w.hex16_value(fnh);
+            w.key("name_hash_decimal");
+            w.uint_string_value(fnh);
+            w.end_object();
         }
-        j += "]";
+        w.end_array();
 
-        j += "}";
+        w.end_object();
     }
-    j += "]";
+    w.end_array();
 
     // global markers array
-    j += ",\"markers\":[";
-    for (size_t mi = 0; mi < marker_items.size(); ++mi) {
-        if (mi > 0) j += ',';
-        j += marker_to_json(marker_items[mi]);
+    w.key("markers");
+    w.begin_array();
+    for (const MarkerItem& m : marker_items) {
+        w.element();
+        write_sprat_marker(w, m);
     }
-    j += "]";
+    w.end_array();
 
-    j += "}";
-    return j;
+    w.end_object();
+    return doc;
 }
 
+// Jsonnet state reused across evaluations: one initialized VM with the
+// transforms directory already on its import path, and the source of every
+// transform file read so far. Listing transforms or rendering a group then
+// pays for VM setup, the directory probe and each file read only once.
+// A VM must not be shared between threads; evaluate_transform keeps one
+// evaluator per thread.
+class TransformEvaluator {
+public:
+    bool evaluate(const fs::path& transform_path,
+                  const std::string& sprat_json,
+                  std::string& output,
+                  std::string& error) {
+        if (!ready_) {
+            if (!vm_.init()) {
+                error = "Failed to initialize Jsonnet VM";
+                return false;
+            }
+            // Always add the built-in transforms directory to the import path so that
+            // `import "sprat.libsonnet"` resolves from custom transforms outside that dir.
+            const fs::path transforms_dir = find_transforms_dir();
+            if (!transforms_dir.empty())
+                vm_.addImportPath(transforms_dir.string());
+            ready_ = true;
+        }
+
+        const std::string key = transform_path.string();
+        auto it = sources_.find(key);
+        if (it == sources_.end()) {
+            std::string source;
+            if (!read_text_file(transform_path, source, error)) {
+                return false;
+            }
+            it = sources_.emplace(key, std::move(source)).first;
+        }
+
+        vm_.bindExtCodeVar("sprat", sprat_json);
+        // The snippet keeps the file's path as its name, so relative imports
+        // and error locations behave as they do for evaluateFile.
+        if (!vm_.evaluateSnippet(key, it->second, &output)) {
+            error = vm_.lastError();
+            return false;
+        }
+        return true;
+    }
+
+private:
+    jsonnet::Jsonnet vm_;
+    bool ready_ = false;
+    std::unordered_map<std::string, std::string> sources_;
+};
+
 // Evaluate a Jsonnet file with the given sprat JSON data.
 // Returns the evaluated output string, or empty string on error (sets error).
 std::string evaluate_transform(
@@ -923,21 +1262,9 @@ std::string evaluate_transform(
     const std::string& sprat_json,
     std::string& error)
 {
-    jsonnet::Jsonnet vm;
-    if (!vm.init()) {
-        error = "Failed to initialize Jsonnet VM";
-        return "";
-    }
-    vm.bindExtCodeVar("sprat", sprat_json);
-    // Always add the built-in transforms directory to the import path so that
-    // `import "sprat.libsonnet"` resolves from custom transforms outside that dir.
-    const fs::path transforms_dir = find_transforms_dir();
-    if (!transforms_dir.empty())
-        vm.addImportPath(transforms_dir.string());
+    thread_local TransformEvaluator evaluator;
     std::string output;
-    bool ok = vm.evaluateFile(transform_path.string(), &output);
-    if (!ok) {
-        error = vm.lastError();
+    if (!evaluator.evaluate(transform_path, sprat_json, output, error)) {
         return "";
     }
     return output;
@@ -1137,6 +1464,810 @@ fs::path resolve_transform_path(const std::string& transform_arg) {
     return find_transforms_dir() / (transform_arg + ".jsonnet");
 }
 
+// ─── Native emitters ──────────────────────────────────────────────────────────
+//
+// The most used built-in transforms are also implemented in C++, since the
+// Jsonnet interpreter dominates run time on large layouts. Each emitter must
+// produce exactly what its .jsonnet file produces, so it follows Jsonnet's
+// own rules: std.manifestJsonEx layout, sorted object keys, std.escapeStringJson
+// and the interpreter's number formatting. An emitter returns false for any
+// input it does not mirror, and the caller then evaluates the .jsonnet file.
+
+// Everything the emitters read; the same data build_sprat_json serializes.
+struct TransformInput {
+    const Layout& layout;
+    const std::vector<std::string>& sprite_names;
+    const std::vector<MarkerItem>& marker_items;
+    const std::vector<AnimationItem>& animations;
+    const std::vector<std::vector<MarkerItem>>& sprite_markers;
+    int global_pivot_x = 0;
+    int global_pivot_y = 0;
+    bool has_global_pivot = false;
+    const std::string& output_pattern;
+};
+
+// Jsonnet turns numbers into text with "%.0f" when they are integral and
+// "%.17g" otherwise.
+std::string jsonnet_number(double v) {
+    std::array<char, 64> buf{};
+    const int n = (v == std::floor(v))
+        ? std::snprintf(buf.data(), buf.size(), "%.0f", v)
+        : std::snprintf(buf.data(), buf.size(), "%.17g", v);
+    return std::string(buf.data(), n > 0 ? static_cast<size_t>(n) : 0);
+}
+
+// A double as a transform sees it: written with format_double into the sprat
+// JSON, then parsed back by Jsonnet.
+double sprat_decimal(double v) {
+    return std::strtod(format_double(v).c_str(), nullptr);
+}
+
+// std.escapeStringJson for valid UTF-8: besides the usual escapes, control
+// characters and U+007F..U+009F become \u00XX.
+void append_jsonnet_string(std::string& out, const std::string& s) {
+    auto append_u00 = [&out](unsigned int cp) {
+        out += "\\u00";
+        out += HEX_DIGITS[(cp >> BITS_PER_NIBBLE) & HEX_NIBBLE_MASK];
+        out += HEX_DIGITS[cp & HEX_NIBBLE_MASK];
+    };
+    out += '"';
+    for (size_t i = 0; i < s.size(); ++i) {
+        const auto c = static_cast<unsigned char>(s[i]);
+        if (c >= 0x80) {
+            // U+0080..U+009F are encoded as C2 80..C2 9F.
+            if (c == 0xC2 && i + 1 < s.size() && static_cast<unsigned char>(s[i + 1]) <= 0x9F) {
+                append_u00(static_cast<unsigned char>(s[++i]));
+            } else {
+                out.push_back(static_cast<char>(c));
+            }
+            continue;
+        }
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < k_json_control_char_limit || c == 0x7F) {
+                    append_u00(c);
+                } else {
+                    out.push_back(static_cast<char>(c));
+                }
+                break;
+        }
+    }
+    out += '"';
+}
+
+// Jsonnet replaces malformed UTF-8 while reading the sprat JSON; emitters only
+// handle text that survives that unchanged.
+bool is_valid_utf8(const std::string& s) {
+    size_t i = 0;
+    while (i < s.size()) {
+        const auto c = static_cast<unsigned char>(s[i]);
+        size_t len = 0;
+        unsigned int cp = 0;
+        if (c < 0x80) {
+            ++i;
+            continue;
+        } else if ((c & 0xE0) == 0xC0) {
+            len = 2;
+            cp = c & 0x1Fu;
+        } else if ((c & 0xF0) == 0xE0) {
+            len = 3;
+            cp = c & 0x0Fu;
+        } else if ((c & 0xF8) == 0xF0) {
+            len = 4;
+            cp = c & 0x07u;
+        } else {
+            return false;
+        }
+        if (i + len > s.size()) {
+            return false;
+        }
+        for (size_t k = 1; k < len; ++k) {
+            const auto cc = static_cast<unsigned char>(s[i + k]);
+            if ((cc & 0xC0) != 0x80) {
+                return false;
+            }
+            cp = (cp << 6) | (cc & 0x3Fu);
+        }
+        constexpr unsigned int k_min_for_len[] = {0, 0, 0x80, 0x800, 0x10000};
+        if (cp < k_min_for_len[len] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+            return false;
+        }
+        i += len;
+    }
+    return true;
+}
+
+bool transform_input_is_utf8(const TransformInput& in) {
+    if (!is_valid_utf8(in.output_pattern)) {
+        return false;
+    }
+    for (size_t i = 0; i < in.layout.sprites.size(); ++i) {
+        if (!is_valid_utf8(in.layout.sprites[i].path) || !is_valid_utf8(in.sprite_names[i])) {
+            return false;
+        }
+    }
+    for (const MarkerItem& m : in.marker_items) {
+        if (!is_valid_utf8(m.name) || !is_valid_utf8(m.type) ||
+            !is_valid_utf8(m.sprite_name) || !is_valid_utf8(m.sprite_path)) {
+            return false;
+        }
+    }
+    for (const AnimationItem& a : in.animations) {
+        if (!is_valid_utf8(a.name) || !is_valid_utf8(a.alias_source) || !is_valid_utf8(a.flip)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Writes JSON laid out as std.manifestJsonEx(value, "  ") does: one member per
+// line, and empty containers as their brackets around a blank line. Object
+// members must be written in std.objectFields order, i.e. sorted by key.
+class ManifestWriter {
+public:
+    explicit ManifestWriter(std::string& out) : out_(out) {}
+
+    void begin_object() { open('{'); }
+    void end_object() { close('}'); }
+    void begin_array() { open('['); }
+    void end_array() { close(']'); }
+
+    // Starts an object member; its value is written next.
+    void key(const std::string& k) {
+        next_member();
+        append_jsonnet_string(out_, k);
+        out_ += ": ";
+    }
+    // Starts an array element; its value is written next.
+    void element() { next_member(); }
+
+    void string_value(const std::string& s) { append_jsonnet_string(out_, s); }
+    void int_value(long long v) { out_ += std::to_string(v); }
+    void number_value(double v) { out_ += jsonnet_number(v); }
+    void bool_value(bool v) { out_ += v ? "true" : "false"; }
+
+private:
+    void open(char c) {
+        out_ += c;
+        out_ += '\n';
+        indent_ += "  ";
+        first_.push_back(true);
+    }
+    void close(char c) {
+        indent_.resize(indent_.size() - 2);
+        out_ += '\n';
+        out_ += indent_;
+        out_ += c;
+        first_.pop_back();
+    }
+    void next_member() {
+        if (!first_.back()) {
+            out_ += ",\n";
+        }
+        first_.back() = false;
+        out_ += indent_;
+    }
+
+    std::string& out_;
+    std::string indent_;
+    std::vector<bool> first_;
+};
+
+int effective_fps(const AnimationItem& anim) {
+    return anim.fps > 0 ? anim.fps : DEFAULT_ANIMATION_FPS;
+}
+
+// One sprat.markers entry; its members are those marker_to_json emits.
+void write_marker_object(ManifestWriter& w, const MarkerItem& m) {
+    w.begin_object();
+    if (m.type == "rectangle") {
+        w.key("h");
+        w.int_value(m.h);
+    }
+    w.key("index");
+    w.int_value(static_cast<long long>(m.index));
+    w.key("name");
+    w.string_value(m.name);
+    if (m.type == "circle") {
+        w.key("radius");
+        w.int_value(m.radius);
+    }
+    w.key("sprite_index");
+    w.int_value(m.sprite_index);
+    w.key("sprite_name");
+    w.string_value(m.sprite_name);
+    w.key("sprite_path");
+    w.string_value(m.sprite_path);
+    w.key("type");
+    w.string_value(m.type);
+    if (m.type == "polygon") {
+        w.key("vertices");
+        w.begin_array();
+        for (const auto& v : m.vertices) {
+            w.element();
+            w.begin_object();
+            w.key("x");
+            w.int_value(v.first);
+            w.key("y");
+            w.int_value(v.second);
+            w.end_object();
+        }
+        w.end_array();
+    }
+    if (m.type == "rectangle") {
+        w.key("w");
+        w.int_value(m.w);
+    }
+    w.key("x");
+    w.int_value(m.x);
+    w.key("y");
+    w.int_value(m.y);
+    w.end_object();
+}
+
+// transforms/json.jsonnet
+bool emit_json(const TransformInput& in, std::string& content) {
+    const Layout& layout = in.layout;
+    ManifestWriter w(content);
+    w.begin_object();
+    if (!in.animations.empty()) {
+        w.key("animations");
+        w.begin_array();
+        for (const AnimationItem& a : in.animations) {
+            w.element();
+            w.begin_object();
+            if (!a.alias_source.empty()) {
+                w.key("alias");
+                w.string_value(a.alias_source);
+            }
+            if (!a.flip.empty()) {
+                w.key("flip");
+                w.string_value(a.flip);
+            }
+            if (a.alias_source.empty()) {
+                w.key("fps");
+                w.int_value(effective_fps(a));
+            }
+            w.key("name");
+            w.string_value(a.name);
+            if (a.alias_source.empty()) {
+                w.key("sprite_indexes");
+                w.begin_array();
+                for (int idx : a.sprite_indexes) {
+                    w.element();
+                    w.int_value(idx);
+                }
+                w.end_array();
+                w.key("sprite_names");
+                w.begin_array();
+                for (int idx : a.sprite_indexes) {
+                    w.element();
+                    w.string_value(in.sprite_names[static_cast<size_t>(idx)]);
+                }
+                w.end_array();
+            }
+            w.end_object();
+        }
+        w.end_array();
+    }
+    w.key("atlases");
+    w.begin_array();
+    for (size_t ai = 0; ai < layout.atlases.size(); ++ai) {
+        w.element();
+        w.begin_object();
+        w.key("height");
+        w.int_value(layout.atlases[ai].height);
+        w.key("path");
+        w.string_value(format_atlas_path(in.output_pattern, static_cast<int>(ai)));
+        w.key("width");
+        w.int_value(layout.atlases[ai].width);
+        w.end_object();
+    }
+    w.end_array();
+    w.key("extrude");
+    w.int_value(layout.extrude);
+    w.key("multipack");
+    w.bool_value(layout.multipack);
+    w.key("scale");
+    w.number_value(sprat_decimal(layout.scale));
+    w.key("sprites");
+    w.begin_array();
+    for (size_t i = 0; i < layout.sprites.size(); ++i) {
+        const Sprite& s = layout.sprites[i];
+        const SpriteFacts f = sprite_facts(layout, i, in.sprite_markers,
+                                           in.global_pivot_x, in.global_pivot_y, in.has_global_pivot);
+        w.element();
+        w.begin_object();
+        w.key("atlas_index");
+        w.int_value(s.atlas_index);
+        w.key("markers");
+        w.begin_array();
+        for (const MarkerItem& m : in.sprite_markers[i]) {
+            w.element();
+            write_marker_object(w, m);
+        }
+        w.end_array();
+        w.key("name");
+        w.string_value(in.sprite_names[i]);
+        w.key("path");
+        w.string_value(s.path);
+        w.key("pivot");
+        w.begin_object();
+        w.key("x");
+        w.int_value(f.pivot_x);
+        w.key("y");
+        w.int_value(f.pivot_y);
+        w.end_object();
+        w.key("rect");
+        w.begin_object();
+        w.key("h");
+        w.int_value(s.h);
+        w.key("w");
+        w.int_value(s.w);
+        w.key("x");
+        w.int_value(s.x);
+        w.key("y");
+        w.int_value(s.y);
+        w.end_object();
+        w.key("rotation");
+        w.int_value(s.rotated ? 90 : 0);
+        w.key("trim");
+        w.begin_object();
+        w.key("bottom");
+        w.int_value(s.trim_bottom);
+        w.key("left");
+        w.int_value(s.src_x);
+        w.key("right");
+        w.int_value(s.trim_right);
+        w.key("top");
+        w.int_value(s.src_y);
+        w.end_object();
+        w.end_object();
+    }
+    w.end_array();
+    w.end_object();
+    content += '\n';
+    return true;
+}
+
+std::string csv_escape(const std::string& s) {
+    if (s.find_first_of("\",\n\r") == std::string::npos) {
+        return s;
+    }
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    out += '"';
+    return out;
+}
+
+// csv.jsonnet's marker_json: one marker as compact JSON in a sprite row.
+void append_csv_marker_json(std::string& out, const MarkerItem& m) {
+    out += "{\"name\":";
+    append_jsonnet_string(out, m.name);
+    out += ",\"type\":\"" + m.type + "\"";
+    out += ",\"x\":" + std::to_string(m.x) + ",\"y\":" + std::to_string(m.y);
+    if (m.type == "circle") {
+        out += ",\"radius\":" + std::to_string(m.radius);
+    }
+    if (m.type == "rectangle") {
+        out += ",\"w\":" + std::to_string(m.w) + ",\"h\":" + std::to_string(m.h);
+    }
+    if (m.type == "polygon") {
+        out += ",\"vertices\":[";
+        for (size_t vi = 0; vi < m.vertices.size(); ++vi) {
+            if (vi > 0) out += ',';
+            out += "{\"x\":" + std::to_string(m.vertices[vi].first) +
+                   ",\"y\":" + std::to_string(m.vertices[vi].second) + "}";
+        }
+        out += ']';
+    }
+    out += '}';
+}
+
+// transforms/csv.jsonnet
+bool emit_csv(const TransformInput& in, std::string& content) {
+    const Layout& layout = in.layout;
+    content += "index,name,path,atlas_index,atlas_path,x,y,w,h,pivot_x,pivot_y,"
+               "trim_left,trim_top,trim_right,trim_bottom,marker_count,markers_json,rotation\n";
+    for (size_t i = 0; i < layout.sprites.size(); ++i) {
+        const Sprite& s = layout.sprites[i];
+        const SpriteFacts f = sprite_facts(layout, i, in.sprite_markers,
+                                           in.global_pivot_x, in.global_pivot_y, in.has_global_pivot);
+        content += std::to_string(i) + ",";
+        content += csv_escape(in.sprite_names[i]) + ",";
+        content += csv_escape(s.path) + ",";
+        content += std::to_string(s.atlas_index) + ",";
+        content += csv_escape(format_atlas_path(in.output_pattern, s.atlas_index)) + ",";
+        content += std::to_string(s.x) + "," + std::to_string(s.y) + ",";
+        content += std::to_string(s.w) + "," + std::to_string(s.h) + ",";
+        content += std::to_string(f.pivot_x) + "," + std::to_string(f.pivot_y) + ",";
+        content += std::to_string(s.src_x) + "," + std::to_string(s.src_y) + ",";
+        content += std::to_string(s.trim_right) + "," + std::to_string(s.trim_bottom) + ",";
+        const std::vector<MarkerItem>& markers = in.sprite_markers[i];
+        content += std::to_string(markers.size()) + ",[";
+        for (size_t mi = 0; mi < markers.size(); ++mi) {
+            if (mi > 0) content += ',';
+            append_csv_marker_json(content, markers[mi]);
+        }
+        content += "],";
+        content += std::string(s.rotated ? "90" : "0") + "\n";
+    }
+    // Marker rows leave the fields of other marker types empty.
+    for (const MarkerItem& m : in.marker_items) {
+        content += "marker," + std::to_string(m.index) + "," + csv_escape(m.name) + "," + m.type + ",";
+        content += std::to_string(m.x) + "," + std::to_string(m.y) + ",";
+        content += (m.type == "circle" ? std::to_string(m.radius) : std::string()) + ",";
+        content += (m.type == "rectangle" ? std::to_string(m.w) : std::string()) + ",";
+        content += (m.type == "rectangle" ? std::to_string(m.h) : std::string()) + ",";
+        if (m.type == "polygon") {
+            for (size_t vi = 0; vi < m.vertices.size(); ++vi) {
+                if (vi > 0) content += '|';
+                content += std::to_string(m.vertices[vi].first) + "," + std::to_string(m.vertices[vi].second);
+            }
+        }
+        content += ",";
+        content += std::to_string(m.sprite_index) + ",";
+        content += csv_escape(m.sprite_name) + ",";
+        content += csv_escape(m.sprite_path) + "\n";
+    }
+    for (size_t ai = 0; ai < in.animations.size(); ++ai) {
+        const AnimationItem& a = in.animations[ai];
+        content += "animation," + std::to_string(ai) + "," + csv_escape(a.name) + ",";
+        if (!a.alias_source.empty()) {
+            content += "alias," + csv_escape(a.alias_source);
+        } else {
+            content += std::to_string(effective_fps(a)) + ",";
+            for (size_t fi = 0; fi < a.sprite_indexes.size(); ++fi) {
+                if (fi > 0) content += '|';
+                content += std::to_string(a.sprite_indexes[fi]);
+            }
+        }
+        if (!a.flip.empty()) {
+            content += "," + a.flip;
+        }
+        content += "\n";
+    }
+    return true;
+}
+
+// transforms/css.jsonnet
+bool emit_css(const TransformInput& in, std::string& content) {
+    const Layout& layout = in.layout;
+    const int atlas_w0 = layout.atlases.empty() ? 0 : layout.atlases[0].width;
+    const int atlas_h0 = layout.atlases.empty() ? 0 : layout.atlases[0].height;
+    content += ":root {\n";
+    content += "  --atlas-width: " + std::to_string(atlas_w0) + "px;\n";
+    content += "  --atlas-height: " + std::to_string(atlas_h0) + "px;\n";
+    content += "  --atlas-scale: " + jsonnet_number(sprat_decimal(layout.scale)) + ";\n";
+    content += "}\n\n";
+    content += ".sprat-sprite {\n";
+    content += "  background-repeat: no-repeat;\n";
+    content += "  display: inline-block;\n";
+    content += "}\n";
+    for (size_t i = 0; i < layout.sprites.size(); ++i) {
+        const Sprite& s = layout.sprites[i];
+        const std::string atlas_path = format_atlas_path(in.output_pattern, s.atlas_index);
+        if (i > 0) content += "\n";
+        content += ".sprite-" + to_css_name(in.sprite_names[i]) + " {\n";
+        if (!atlas_path.empty()) {
+            content += "  background-image: url('" + atlas_path + "');\n";
+        }
+        content += "  background-position: -" + std::to_string(s.x) + "px -" + std::to_string(s.y) + "px;\n";
+        content += "  width: " + std::to_string(s.w) + "px;\n";
+        content += "  height: " + std::to_string(s.h) + "px;\n";
+        content += "  /* source: " + s.path + " */\n";
+        content += "  /* name: " + in.sprite_names[i] + " */\n";
+        content += "  /* atlas_index: " + std::to_string(s.atlas_index) + " */\n";
+        if (s.rotated) {
+            content += "  transform: rotate(-90deg) translate(-100%, 0);\n  transform-origin: top left;\n";
+        }
+        content += "}\n";
+    }
+    return true;
+}
+
+std::string xml_escape(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        switch (c) {
+            case '&': out += "&amp;"; break;
+            case '<': out += "&lt;"; break;
+            case '>': out += "&gt;"; break;
+            case '"': out += "&quot;"; break;
+            case '\'': out += "&apos;"; break;
+            default: out += c; break;
+        }
+    }
+    return out;
+}
+
+// transforms/xml.jsonnet
+bool emit_xml(const TransformInput& in, std::string& content) {
+    const Layout& layout = in.layout;
+    content += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    content += std::string("<layout multipack=\"") + (layout.multipack ? "true" : "false") +
+               "\" scale=\"" + jsonnet_number(sprat_decimal(layout.scale)) +
+               "\" extrude=\"" + std::to_string(layout.extrude) + "\">\n";
+    content += "  <atlases>\n";
+    for (size_t ai = 0; ai < layout.atlases.size(); ++ai) {
+        if (ai > 0) content += "\n";
+        content += "    <atlas index=\"" + std::to_string(ai) +
+                   "\" width=\"" + std::to_string(layout.atlases[ai].width) +
+                   "\" height=\"" + std::to_string(layout.atlases[ai].height) +
+                   "\" path=\"" + xml_escape(format_atlas_path(in.output_pattern, static_cast<int>(ai))) + "\">\n";
+        content += "      <sprites>\n        ";
+        bool first_sprite = true;
+        for (size_t i = 0; i < layout.sprites.size(); ++i) {
+            const Sprite& s = layout.sprites[i];
+            if (s.atlas_index != static_cast<int>(ai)) {
+                continue;
+            }
+            const SpriteFacts f = sprite_facts(layout, i, in.sprite_markers,
+                                               in.global_pivot_x, in.global_pivot_y, in.has_global_pivot);
+            const std::vector<MarkerItem>& markers = in.sprite_markers[i];
+            if (!first_sprite) content += "\n        ";
+            first_sprite = false;
+            content += "<sprite index=\"" + std::to_string(i) +
+                       "\" name=\"" + xml_escape(in.sprite_names[i]) +
+                       "\" path=\"" + xml_escape(s.path) +
+                       "\" x=\"" + std::to_string(s.x) + "\" y=\"" + std::to_string(s.y) +
+                       "\" w=\"" + std::to_string(s.w) + "\" h=\"" + std::to_string(s.h) +
+                       "\" pivot_x=\"" + std::to_string(f.pivot_x) +
+                       "\" pivot_y=\"" + std::to_string(f.pivot_y) +
+                       "\" trim_left=\"" + std::to_string(s.src_x) +
+                       "\" trim_top=\"" + std::to_string(s.src_y) +
+                       "\" trim_right=\"" + std::to_string(s.trim_right) +
+                       "\" trim_bottom=\"" + std::to_string(s.trim_bottom) +
+                       "\" marker_count=\"" + std::to_string(markers.size()) +
+                       "\" rotation=\"" + (s.rotated ? "90" : "0") + "\">";
+            if (!markers.empty()) {
+                content += "\n  <markers>\n    ";
+                for (size_t mi = 0; mi < markers.size(); ++mi) {
+                    const MarkerItem& m = markers[mi];
+                    if (mi > 0) content += "\n    ";
+                    const std::string head = "<marker name=\"" + xml_escape(m.name) + "\" type=\"" + m.type + "\"";
+                    const std::string xy = " x=\"" + std::to_string(m.x) + "\" y=\"" + std::to_string(m.y) + "\"";
+                    if (m.type == "point") {
+                        content += head + xy + " />";
+                    } else if (m.type == "circle") {
+                        content += head + xy + " radius=\"" + std::to_string(m.radius) + "\" />";
+                    } else if (m.type == "rectangle") {
+                        content += head + xy + " w=\"" + std::to_string(m.w) +
+                                   "\" h=\"" + std::to_string(m.h) + "\" />";
+                    } else if (m.type == "polygon") {
+                        content += head + "><vertices>";
+                        for (size_t vi = 0; vi < m.vertices.size(); ++vi) {
+                            if (vi > 0) content += '|';
+                            content += std::to_string(m.vertices[vi].first) + "," +
+                                       std::to_string(m.vertices[vi].second);
+                        }
+                        content += "</vertices></marker>";
+                    }
+                }
+                content += "\n  </markers>\n";
+            }
+            content += "</sprite>";
+        }
+        content += "\n      </sprites>\n    </atlas>";
+    }
+    content += "\n  </atlases>\n";
+    if (!in.animations.empty()) {
+        content += "  <animations>\n";
+        for (size_t ai = 0; ai < in.animations.size(); ++ai) {
+            const AnimationItem& a = in.animations[ai];
+            if (ai > 0) content += "\n";
+            content += "    <animation index=\"" + std::to_string(ai) + "\" name=\"" + xml_escape(a.name) + "\"";
+            if (!a.alias_source.empty()) {
+                content += " alias=\"" + xml_escape(a.alias_source) + "\"";
+                if (!a.flip.empty()) {
+                    content += " flip=\"" + a.flip + "\"";
+                }
+                content += " />";
+            } else {
+                content += " fps=\"" + std::to_string(effective_fps(a)) + "\" sprite_indexes=\"";
+                for (size_t fi = 0; fi < a.sprite_indexes.size(); ++fi) {
+                    if (fi > 0) content += ',';
+                    content += std::to_string(a.sprite_indexes[fi]);
+                }
+                content += "\" />";
+            }
+        }
+        content += "\n  </animations>\n";
+    }
+    content += "</layout>\n";
+    return true;
+}
+
+// transforms/phaser-hash.jsonnet
+bool emit_phaser_hash(const TransformInput& in, std::string& content) {
+    const Layout& layout = in.layout;
+    // Frames are keyed by sprite name; like the object fold in the transform,
+    // a later sprite with the same name replaces an earlier one.
+    std::map<std::string, size_t> frames;
+    for (size_t i = 0; i < layout.sprites.size(); ++i) {
+        frames.insert_or_assign(in.sprite_names[i], i);
+    }
+    ManifestWriter w(content);
+    w.begin_object();
+    w.key("frames");
+    w.begin_object();
+    for (const auto& [name, i] : frames) {
+        const Sprite& s = layout.sprites[i];
+        const SpriteFacts f = sprite_facts(layout, i, in.sprite_markers,
+                                           in.global_pivot_x, in.global_pivot_y, in.has_global_pivot);
+        w.key(name);
+        w.begin_object();
+        w.key("frame");
+        w.begin_object();
+        w.key("h");
+        w.int_value(s.h);
+        w.key("w");
+        w.int_value(s.w);
+        w.key("x");
+        w.int_value(s.x);
+        w.key("y");
+        w.int_value(s.y);
+        w.end_object();
+        w.key("pivot");
+        w.begin_object();
+        w.key("x");
+        w.number_value(sprat_decimal(f.pivot_x_norm));
+        w.key("y");
+        w.number_value(sprat_decimal(f.pivot_y_norm_raw));
+        w.end_object();
+        w.key("rotated");
+        w.bool_value(s.rotated);
+        w.key("sourceSize");
+        w.begin_object();
+        w.key("h");
+        w.int_value(f.source_h);
+        w.key("w");
+        w.int_value(f.source_w);
+        w.end_object();
+        w.key("spriteSourceSize");
+        w.begin_object();
+        w.key("h");
+        w.int_value(f.content_h);
+        w.key("w");
+        w.int_value(f.content_w);
+        w.key("x");
+        w.int_value(s.src_x);
+        w.key("y");
+        w.int_value(s.src_y);
+        w.end_object();
+        w.key("trimmed");
+        w.bool_value(f.has_trim);
+        w.end_object();
+    }
+    w.end_object();
+    w.key("meta");
+    w.begin_object();
+    w.key("format");
+    w.string_value("RGBA8888");
+    w.key("image");
+    w.string_value(format_atlas_path(in.output_pattern, 0));
+    w.key("scale");
+    w.string_value(jsonnet_number(sprat_decimal(layout.scale)));
+    w.key("size");
+    w.begin_object();
+    w.key("h");
+    w.int_value(layout.atlases.empty() ? 0 : layout.atlases[0].height);
+    w.key("w");
+    w.int_value(layout.atlases.empty() ? 0 : layout.atlases[0].width);
+    w.end_object();
+    w.end_object();
+    w.end_object();
+    content += '\n';
+    return true;
+}
+
+struct NativeTransform {
+    const char* name;           // file name without .jsonnet
+    bool (*emit)(const TransformInput& in, std::string& content);
+};
+
+constexpr NativeTransform k_native_transforms[] = {
+    {"json", emit_json},
+    {"csv", emit_csv},
+    {"css", emit_css},
+    {"xml", emit_xml},
+    {"phaser-hash", emit_phaser_hash},
+};
+
+// Reads the name, description, extension and icon string fields of the object
+// a built-in .jsonnet file evaluates to, without running the interpreter. Each
+// is written as a `key: "literal"` line; the last one in the file wins, so
+// fields of helper objects defined earlier do not match.
+bool read_transform_metadata(const fs::path& path, TransformResult& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    struct Field {
+        std::string_view key;
+        std::string* value;
+    };
+    const Field fields[] = {
+        {"name", &out.name},
+        {"description", &out.description},
+        {"extension", &out.extension},
+        {"icon", &out.icon},
+    };
+    std::string line;
+    while (std::getline(in, line)) {
+        const size_t key_start = line.find_first_not_of(" \t");
+        if (key_start == std::string::npos) {
+            continue;
+        }
+        for (const Field& field : fields) {
+            if (line.compare(key_start, field.key.size(), field.key) != 0) {
+                continue;
+            }
+            size_t pos = key_start + field.key.size();
+            if (pos >= line.size() || line[pos] != ':') {
+                continue;
+            }
+            pos = line.find_first_not_of(" \t", pos + 1);
+            if (pos == std::string::npos || line[pos] != '"') {
+                continue;
+            }
+            const size_t value_start = pos + 1;
+            for (pos = value_start; pos < line.size() && line[pos] != '"'; ++pos) {
+                if (line[pos] == '\\') {
+                    ++pos;
+                }
+            }
+            if (pos < line.size()) {
+                *field.value = json_unescape_string(line, value_start, pos);
+            }
+        }
+    }
+    return !out.extension.empty();
+}
+
+// The native emitter for a --transform argument, or nullptr when the
+// argument is a path, is not one of the built-ins above, or names a file in
+// the user transforms directory, which overrides the built-in.
+const NativeTransform* find_native_transform(const std::string& transform_arg) {
+    const NativeTransform* found = nullptr;
+    for (const NativeTransform& t : k_native_transforms) {
+        if (transform_arg == t.name) {
+            found = &t;
+            break;
+        }
+    }
+    if (found == nullptr) {
+        return nullptr;
+    }
+    const std::optional<fs::path> user_dir = resolve_user_transforms_dir();
+    if (user_dir && resolve_transform_path(transform_arg).parent_path() == *user_dir) {
+        std::error_code ec;
+        if (fs::exists(*user_dir / (transform_arg + ".jsonnet"), ec)) {
+            return nullptr;
+        }
+    }
+    return found;
+}
+
+// Metadata comes from the transform's .jsonnet file so the two never drift
+// apart; when it cannot be read the caller evaluates the file instead.
+bool run_native_transform(const NativeTransform& t, const fs::path& path,
+                          const TransformInput& in, TransformResult& result) {
+    result = TransformResult{};
+    return read_transform_metadata(path, result) && t.emit(in, result.content);
+}
+
 std::vector<GroupMember> discover_group_transforms(const std::string& group_name,
                                                    const fs::path& transforms_dir) {
     std::vector<GroupMember> members;
@@ -1318,7 +2449,8 @@ void print_usage() {
               << tr("Read layout text from stdin and transform it into other formats.\n")
               << tr("\n")
               << tr("Options:\n")
-              << tr("  --transform NAME|PATH      Transform name or path (default: json)\n")
+              << tr("  --transform NAME|PATH      Transform name or path (default: json);\n")
+              << tr("                             separate several with commas to render them in one run\n")
               << tr("  --atlas, -a PATTERN        Atlas path pattern for atlas_* placeholders\n")
               << tr("  --output-dir PATH          Write output to PATH/{variant}{extension} instead of stdout\n")
               << tr("  --list-transforms          Print available transforms and exit\n")
@@ -1327,18 +2459,20 @@ void print_usage() {
               << tr("  --markers PATH             Load external markers file\n")
               << tr("  --animations PATH          Load external animations file\n")
               << tr("  --auto-animations          Group frames into animations by name pattern\n")
+              << tr("  --trace FILE               Write stage timings and counters as Chrome trace JSON\n")
               << tr("  --help, -h                 Show this help message\n")
               << tr("  --version, -v              Show version\n");
 }
 
-} // namespace
-
-int run_spratconvert(int argc, char** argv) {
+// `layout_text` and `parsed_layout` are set when sprat build hands over the
+// layout it already parsed; the tool itself reads layout text from stdin.
+int run_convert(int argc, char** argv, const std::string* layout_text, const Layout* parsed_layout) {
 #ifdef _WIN32
     if (_setmode(_fileno(stdout), _O_BINARY) == -1) {
         std::cerr << tr("Failed to set stdout to binary mode\n");
     }
 #endif
+    sprat::core::ProfileSession profile_session("spratconvert");
     g_exec_dir = sprat::core::get_executable_dir(argv[0]);
     std::string transform_arg = "json";
     std::string markers_path_arg;
@@ -1364,6 +2498,8 @@ int run_spratconvert(int argc, char** argv) {
             animations_path_arg = argv[++i];
         } else if (arg == "--auto-animations") {
             auto_animations = true;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            profile_session.start(argv[++i]);
         } else if (arg == "--list-transforms") {
             list_only = true;
         } else if (arg == "--list-transforms-json") {
@@ -1398,18 +2534,23 @@ int run_spratconvert(int argc, char** argv) {
     }
 
     // Read stdin and parse layout
-    std::string input_text;
-    {
-        input_text.assign(std::istreambuf_iterator<char>(std::cin),
+    sprat::core::ProfileScope parse_scope("parse_layout");
+    std::string stdin_text;
+    if (layout_text == nullptr) {
+        stdin_text.assign(std::istreambuf_iterator<char>(std::cin),
                           std::istreambuf_iterator<char>());
     }
-    std::istringstream layout_iss(input_text);
-    Layout layout;
+    const std::string& input_text = layout_text != nullptr ? *layout_text : stdin_text;
+    Layout stdin_layout;
+    const Layout& layout = parsed_layout != nullptr ? *parsed_layout : stdin_layout;
     std::string layout_error;
-    if (!parse_layout(layout_iss, layout, layout_error)) {
+    if (parsed_layout == nullptr && !parse_layout(std::string_view(input_text), stdin_layout, layout_error)) {
         std::cerr << layout_error << "\n";
         return 1;
     }
+    parse_scope.arg("bytes", static_cast<int64_t>(input_text.size()));
+    parse_scope.arg("sprites", static_cast<int64_t>(layout.sprites.size()));
+    parse_scope.stop();
 
     if (output_pattern_arg.empty()) {
         if (layout.multipack || layout.atlases.size() > 1) {
@@ -1429,26 +2570,27 @@ int run_spratconvert(int argc, char** argv) {
     std::vector<std::string> sprite_names;
     collect_sprite_name_indexes(layout, sprite_index_by_path, sprite_index_by_name, sprite_names);
 
-    std::string markers_text;
-    std::string animations_text;
+    // Markers and animations come from the layout text itself unless given
+    // as separate files; the layout text is then read in place, not copied.
+    std::string markers_file_text;
+    std::string animations_file_text;
     if (!markers_path_arg.empty()) {
         std::string file_error;
-        if (!read_text_file(fs::path(markers_path_arg), markers_text, file_error)) {
+        if (!read_text_file(fs::path(markers_path_arg), markers_file_text, file_error)) {
             std::cerr << file_error << "\n";
             return 1;
         }
-    } else {
-        markers_text = input_text;
     }
     if (!animations_path_arg.empty()) {
         std::string file_error;
-        if (!read_text_file(fs::path(animations_path_arg), animations_text, file_error)) {
+        if (!read_text_file(fs::path(animations_path_arg), animations_file_text, file_error)) {
             std::cerr << file_error << "\n";
             return 1;
         }
-    } else {
-        animations_text = input_text;
     }
+    const std::string& markers_text = markers_path_arg.empty() ? input_text : markers_file_text;
+    const std::string& animations_text =
+        animations_path_arg.empty() ? input_text : animations_file_text;
 
     std::vector<std::vector<MarkerItem>> sprite_markers;
     const std::vector<MarkerItem> marker_items =
@@ -1479,7 +2621,9 @@ int run_spratconvert(int argc, char** argv) {
     }
 
     const int sprite_count_limit = static_cast<int>(layout.sprites.size());
-    std::vector<AnimationItem> normalized_animations = animation_items;
+    // Frames outside the layout are dropped in place; nothing reads the
+    // unfiltered list afterwards.
+    std::vector<AnimationItem> normalized_animations = std::move(animation_items);
     for (AnimationItem& item : normalized_animations) {
         std::vector<int> filtered;
         filtered.reserve(item.sprite_indexes.size());
@@ -1503,13 +2647,22 @@ int run_spratconvert(int argc, char** argv) {
         }
     }
 
-    // Mode detection: group vs single
-    const bool has_dot = transform_arg.find('.') != std::string::npos;
-    bool group_mode = false;
-    std::vector<GroupMember> group_members;
-    if (!output_dir_arg.empty() && !has_dot) {
-        group_members = discover_group_transforms(transform_arg, find_transforms_dir());
-        group_mode = !group_members.empty();
+    // Each comma-separated --transform entry is a transform name, a path, or
+    // (with --output-dir) a group name that expands to every group member.
+    std::vector<std::string> transform_args;
+    {
+        size_t begin = 0;
+        while (begin <= transform_arg.size()) {
+            size_t end = transform_arg.find(',', begin);
+            if (end == std::string::npos) end = transform_arg.size();
+            std::string entry = trim_copy(transform_arg.substr(begin, end - begin));
+            if (!entry.empty()) transform_args.push_back(std::move(entry));
+            begin = end + 1;
+        }
+    }
+    if (transform_args.empty()) {
+        std::cerr << tr("Missing transform name\n");
+        return 1;
     }
 
     // Helper to compute output_stem from a transform path
@@ -1520,6 +2673,40 @@ int run_spratconvert(int argc, char** argv) {
         return stem;
     };
 
+    struct TransformJob {
+        fs::path path;
+        const NativeTransform* native = nullptr;
+        std::string output_stem;
+        TransformResult result;
+        std::string error;
+        bool ok = false;
+    };
+    std::vector<TransformJob> jobs;
+    bool group_mode = false;
+    for (const std::string& targ : transform_args) {
+        // Mode detection: group vs single
+        const bool has_dot = targ.find('.') != std::string::npos;
+        if (!output_dir_arg.empty() && !has_dot) {
+            std::vector<GroupMember> group_members =
+                discover_group_transforms(targ, find_transforms_dir());
+            if (!group_members.empty()) {
+                group_mode = true;
+                for (GroupMember& member : group_members) {
+                    TransformJob job;
+                    job.path = std::move(member.path);
+                    job.output_stem = std::move(member.variant);
+                    jobs.push_back(std::move(job));
+                }
+                continue;
+            }
+        }
+        TransformJob job;
+        job.path = resolve_transform_path(targ);
+        job.native = find_native_transform(targ);
+        job.output_stem = !output_dir_arg.empty() ? compute_output_stem(targ) : "";
+        jobs.push_back(std::move(job));
+    }
+
     // Helper to write a single TransformResult to a destination
     auto write_result = [&](const TransformResult& result,
                             const std::string& out_dir,
@@ -1583,61 +2770,101 @@ int run_spratconvert(int argc, char** argv) {
             std::cerr << tr("Failed to create output directory: ") << ec.message() << "\n";
             return 1;
         }
-        int exit_code = 0;
-        for (const GroupMember& member : group_members) {
-            const std::string sprat_json = build_sprat_json(
+    }
+
+    // The layout-derived JSON is the same for every transform; only the
+    // output stem fields are filled in per job. It is built on first use, so
+    // runs served entirely by native emitters never build it.
+    std::once_flag sprat_json_once;
+    SpratJson sprat_json;
+    auto shared_sprat_json = [&]() -> const SpratJson& {
+        std::call_once(sprat_json_once, [&]() {
+            sprat::core::ProfileScope build_scope("build_json");
+            sprat_json = build_sprat_json(
                 layout, sprite_names, marker_items, normalized_animations, sprite_markers,
                 global_pivot_x, global_pivot_y, has_global_pivot,
-                output_pattern_arg, member.variant,
-                markers_path_arg, animations_path_arg, animation_fps);
-
-            std::string eval_error;
-            std::string output = evaluate_transform(member.path, sprat_json, eval_error);
-            if (output.empty() && !eval_error.empty()) {
-                std::cerr << eval_error << "\n";
-                exit_code = 1;
-                continue;
-            }
+                output_pattern_arg, markers_path_arg, animations_path_arg, animation_fps);
+        });
+        return sprat_json;
+    };
 
-            TransformResult result;
-            std::string parse_error;
-            if (!parse_transform_result(output, result, parse_error)) {
-                std::cerr << parse_error << "\n";
-                exit_code = 1;
-                continue;
-            }
+    const TransformInput transform_input{
+        layout, sprite_names, marker_items, normalized_animations, sprite_markers,
+        global_pivot_x, global_pivot_y, has_global_pivot, output_pattern_arg};
+    const bool native_allowed = std::any_of(jobs.begin(), jobs.end(),
+                                            [](const TransformJob& job) { return job.native != nullptr; }) &&
+                                transform_input_is_utf8(transform_input);
+
+    auto run_job = [&](TransformJob& job) {
+        sprat::core::ProfileScope transform_scope("transform");
+        if (native_allowed && job.native != nullptr &&
+            run_native_transform(*job.native, job.path, transform_input, job.result)) {
+            transform_scope.arg("native", 1);
+            sprat::core::profile_count("transforms.native");
+            job.ok = true;
+            return;
+        }
+        transform_scope.arg("native", 0);
+        sprat::core::profile_count("transforms.jsonnet");
+        // A lone transform takes the shared document over instead of copying it.
+        const SpratJson& doc = shared_sprat_json();
+        const std::string job_json = jobs.size() == 1
+            ? take_sprat_json_for_stem(std::move(sprat_json), output_pattern_arg, job.output_stem)
+            : sprat_json_for_stem(doc, output_pattern_arg, job.output_stem);
+        std::string eval_error;
+        const std::string output = evaluate_transform(job.path, job_json, eval_error);
+        if (output.empty() && !eval_error.empty()) {
+            job.error = eval_error;
+            return;
+        }
+        job.ok = parse_transform_result(output, job.result, job.error);
+    };
 
-            const int r = write_result(result, output_dir_arg, member.variant, nullptr);
-            if (r != 0) exit_code = r;
+    // Transforms are independent, so several of them evaluate in parallel,
+    // each worker on its own VM. Results are still written in request order.
+    const size_t worker_count = std::min<size_t>(
+        jobs.size(), std::max(1u, std::thread::hardware_concurrency()));
+    if (worker_count <= 1) {
+        for (TransformJob& job : jobs) {
+            run_job(job);
+        }
+    } else {
+        std::atomic<size_t> next_job{0};
+        std::vector<std::thread> workers;
+        workers.reserve(worker_count);
+        for (size_t w = 0; w < worker_count; ++w) {
+            workers.emplace_back([&]() {
+                for (size_t i = next_job.fetch_add(1); i < jobs.size(); i = next_job.fetch_add(1)) {
+                    run_job(jobs[i]);
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
         }
-        return exit_code;
     }
 
-    // Single transform mode
-    const fs::path transform_path = resolve_transform_path(transform_arg);
-    const std::string output_stem = !output_dir_arg.empty()
-        ? compute_output_stem(transform_arg)
-        : "";
-
-    const std::string sprat_json = build_sprat_json(
-        layout, sprite_names, marker_items, normalized_animations, sprite_markers,
-        global_pivot_x, global_pivot_y, has_global_pivot,
-        output_pattern_arg, output_stem,
-        markers_path_arg, animations_path_arg, animation_fps);
-
-    std::string eval_error;
-    std::string output = evaluate_transform(transform_path, sprat_json, eval_error);
-    if (output.empty() && !eval_error.empty()) {
-        std::cerr << eval_error << "\n";
-        return 1;
+    sprat::core::ProfileScope write_scope("write");
+    int exit_code = 0;
+    for (const TransformJob& job : jobs) {
+        if (!job.ok) {
+            std::cerr << job.error << "\n";
+            exit_code = 1;
+            continue;
+        }
+        const int r = write_result(job.result, output_dir_arg, job.output_stem, &std::cout);
+        if (r != 0) exit_code = r;
     }
+    return exit_code;
+}
 
-    TransformResult result;
-    std::string parse_error;
-    if (!parse_transform_result(output, result, parse_error)) {
-        std::cerr << parse_error << "\n";
-        return 1;
-    }
+} // namespace
+
+int run_spratconvert(int argc, char** argv) {
+    return run_convert(argc, argv, nullptr, nullptr);
+}
 
-    return write_result(result, output_dir_arg, output_stem, &std::cout);
+int run_spratconvert_layout(int argc, char** argv, const std::string& layout_text,
+                            const sprat::core::Layout& layout) {
+    return run_convert(argc, argv, &layout_text, &layout);
 }
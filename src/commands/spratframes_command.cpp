@@ -36,8 +36,11 @@ namespace fs = std::filesystem;
 #include <cstddef>
 #include <sstream>
 #include <thread>
+#include <atomic>
+#include <unordered_map>
 #include "core/cli_parse.h"
 #include "core/i18n.h"
+#include "core/profiler.h"
 
 #include <stb_image.h>
 
@@ -124,6 +127,71 @@ struct FramesConfig {
     bool force = false;
 };
 
+// Per-pixel classes for connected-component labeling. Seed pixels start a
+// component; member pixels only join one they touch.
+constexpr std::uint8_t k_mask_none = 0;
+constexpr std::uint8_t k_mask_member = 1;
+constexpr std::uint8_t k_mask_seed = 2;
+// Labels are pixel indices, so 32 bits cover every image load_image accepts
+// at half the memory of size_t labels.
+using Label = std::uint32_t;
+constexpr Label k_no_label = std::numeric_limits<Label>::max();
+static_assert(k_max_total_pixels < k_no_label, "pixel indices must fit in a Label");
+
+// Fewest rows worth giving a labeling thread of its own.
+constexpr int k_min_strip_rows = 64;
+
+struct ComponentStats {
+    size_t first_seed = std::numeric_limits<size_t>::max(); // raster index
+    int size = 0;
+    int min_x = std::numeric_limits<int>::max();
+    int min_y = std::numeric_limits<int>::max();
+    int max_x = -1;
+    int max_y = -1;
+
+    void add(int x, int y) {
+        ++size;
+        min_x = std::min(min_x, x);
+        min_y = std::min(min_y, y);
+        max_x = std::max(max_x, x);
+        max_y = std::max(max_y, y);
+    }
+
+    void merge(const ComponentStats& other) {
+        first_seed = std::min(first_seed, other.first_seed);
+        size += other.size;
+        min_x = std::min(min_x, other.min_x);
+        min_y = std::min(min_y, other.min_y);
+        max_x = std::max(max_x, other.max_x);
+        max_y = std::max(max_y, other.max_y);
+    }
+
+    [[nodiscard]] Rectangle bounds() const {
+        return Rectangle{.x = min_x, .y = min_y, .w = max_x - min_x + 1, .h = max_y - min_y + 1};
+    }
+};
+
+// Runs fn(begin, end) over [0, count) split into at most `parts` contiguous
+// ranges, one thread per range.
+template <typename Fn>
+void for_each_range(int count, unsigned int parts, Fn&& fn) {
+    parts = std::max(1U, std::min(parts, static_cast<unsigned int>(std::max(count, 1))));
+    if (parts == 1) {
+        fn(0, count);
+        return;
+    }
+    std::vector<std::thread> workers;
+    workers.reserve(parts);
+    for (unsigned int i = 0; i < parts; ++i) {
+        const int begin = static_cast<int>((static_cast<long long>(count) * i) / parts);
+        const int end = static_cast<int>((static_cast<long long>(count) * (i + 1)) / parts);
+        workers.emplace_back([&fn, begin, end]() { fn(begin, end); });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
 class SpriteFramesDetector {
 private:
     FramesConfig config_;
@@ -132,13 +200,11 @@ private:
     int channels_ = 0;
     std::vector<unsigned char> image_data_;
     
-    // Connected component analysis
-    std::vector<int> component_labels_;
+    // Connected component analysis; component_labels_ doubles as the
+    // union-find forest while labeling.
+    std::vector<Label> component_labels_;
     std::vector<Rectangle> component_bounds_;
     std::vector<int> component_sizes_;
-
-    // Reusable flood fill stack
-    std::vector<std::pair<int, int>> fill_stack_;
     
     // Rectangle detection
     std::vector<Rectangle> detected_rectangles_;
@@ -183,18 +249,25 @@ public:
     }
     
     bool detect_frames() {
+        sprat::core::ProfileScope decode_scope("decode");
         if (!load_image()) {
             return false;
         }
+        decode_scope.arg("width", width_);
+        decode_scope.arg("height", height_);
+        decode_scope.stop();
         
         // Preprocess image: check first pixel and make it transparent if not already
+        sprat::core::ProfileScope preprocess_scope("preprocess");
         if (!preprocess_image()) {
             std::cerr << tr("Error: Failed to preprocess image") << '\n';
             return false;
         }
+        preprocess_scope.stop();
         
         std::vector<SpriteFrame> frames;
         
+        sprat::core::ProfileScope detect_scope("detect");
         if (config_.has_rectangles) {
             if (!detect_rectangles()) {
                 std::cerr << tr("Error: Failed to detect rectangles") << '\n';
@@ -208,12 +281,15 @@ public:
             }
             frames = extract_from_components();
         }
+        detect_scope.arg("frames", static_cast<int64_t>(frames.size()));
+        detect_scope.stop();
         
         if (frames.empty()) {
             std::cerr << tr("Warning: No frames found") << '\n';
             return true;
         }
         
+        sprat::core::ProfileScope output_scope("output");
         return output_frames(frames);
     }
     
@@ -221,17 +297,22 @@ private:
     bool detect_rectangles() {
         detected_rectangles_.clear();
         
-        std::vector<std::uint8_t> visited(static_cast<size_t>(width_) * height_, 0);
-        
-        for (int y = 0; y < height_; ++y) {
-            for (int x = 0; x < width_; ++x) {
-                if ((visited.at((static_cast<size_t>(y) * width_) + x) == 0U) && is_rectangle_pixel(x, y)) {
-                    Rectangle rect = flood_fill_rectangle(x, y, visited);
-                    if (rect.w > 0 && rect.h > 0 && rect.area() >= config_.min_sprite_size) {
-                        detected_rectangles_.push_back(rect);
+        std::vector<std::uint8_t> mask(static_cast<size_t>(width_) * height_, k_mask_none);
+        for_each_range(height_, config_.threads, [&](int y0, int y1) {
+            for (int y = y0; y < y1; ++y) {
+                for (int x = 0; x < width_; ++x) {
+                    if (is_rectangle_pixel(x, y)) {
+                        mask[(static_cast<size_t>(y) * width_) + x] = k_mask_seed;
                     }
                 }
             }
+        });
+        
+        for (const ComponentStats& component : label_components(mask, false)) {
+            const Rectangle rect = component.bounds();
+            if (rect.w > 0 && rect.h > 0 && rect.area() >= config_.min_sprite_size) {
+                detected_rectangles_.push_back(rect);
+            }
         }
         
         // Merge overlapping rectangles
@@ -258,49 +339,6 @@ private:
                + std::abs(static_cast<int>(a.b) - static_cast<int>(b.b));
     }
     
-    Rectangle flood_fill_rectangle(int start_x, int start_y, std::vector<std::uint8_t>& visited) {
-        fill_stack_.clear();
-        fill_stack_.emplace_back(start_x, start_y);
-        visited.at((static_cast<size_t>(start_y) * width_) + start_x) = 1;
-
-        int min_x = start_x;
-        int max_x = start_x;
-        int min_y = start_y;
-        int max_y = start_y;
-
-        constexpr std::array<int, 4> dx = {-1, 1, 0, 0};
-        constexpr std::array<int, 4> dy = {0, 0, -1, 1};
-
-        while (!fill_stack_.empty()) {
-            auto [x, y] = fill_stack_.back();
-            fill_stack_.pop_back();
-
-            min_x = std::min(min_x, x);
-            max_x = std::max(max_x, x);
-            min_y = std::min(min_y, y);
-            max_y = std::max(max_y, y);
-
-            for (size_t i = 0; i < 4; ++i) {
-                int nx = x + dx[i];
-                int ny = y + dy[i];
-
-                if (nx >= 0 && nx < width_ && ny >= 0 && ny < height_
-                    && (visited.at((static_cast<size_t>(ny) * width_) + nx) == 0U) && is_rectangle_pixel(nx, ny)) {
-                    visited.at((static_cast<size_t>(ny) * width_) + nx) = 1;
-                    fill_stack_.emplace_back(nx, ny);
-                }
-            }
-        }
-
-        Rectangle bounds{};
-        bounds.x = min_x;
-        bounds.y = min_y;
-        bounds.w = max_x - min_x + 1;
-        bounds.h = max_y - min_y + 1;
-
-        return bounds;
-    }
-    
     static void merge_rectangles(std::vector<Rectangle>& rects) {
         if (rects.size() <= 1) {
             return;
@@ -393,24 +431,13 @@ private:
     }
     
     bool find_connected_components() {
-        component_labels_.assign(static_cast<size_t>(width_) * height_, -1);
         component_bounds_.clear();
         component_sizes_.clear();
         
-        int component_id = 0;
-        
-        for (int y = 0; y < height_; ++y) {
-            for (int x = 0; x < width_; ++x) {
-                if (component_labels_[(static_cast<size_t>(y) * width_) + x] == -1 && is_sprite_pixel(x, y)) {
-                    Rectangle bounds{};
-                    int size = flood_fill_component(x, y, component_id, bounds);
-                    
-                    if (size >= config_.min_sprite_size) {
-                        component_bounds_.push_back(bounds);
-                        component_sizes_.push_back(size);
-                        component_id++;
-                    }
-                }
+        for (const ComponentStats& component : label_components(component_mask(), true)) {
+            if (component.size >= config_.min_sprite_size) {
+                component_bounds_.push_back(component.bounds());
+                component_sizes_.push_back(component.size);
             }
         }
         
@@ -422,6 +449,196 @@ private:
         return true;
     }
     
+    // Sprite pixels are seeds. Pixels within tolerance of one are members:
+    // tolerance defines the minimum distance between frames, so tolerance=1
+    // connects sprites through 0 transparent pixels, tolerance=2 through 1,
+    // and so on, measured as Manhattan distance.
+    [[nodiscard]] std::vector<std::uint8_t> component_mask() const {
+        std::vector<std::uint8_t> mask(static_cast<size_t>(width_) * height_, k_mask_none);
+        for_each_range(height_, config_.threads, [&](int y0, int y1) {
+            for (int y = y0; y < y1; ++y) {
+                for (int x = 0; x < width_; ++x) {
+                    if (is_sprite_pixel(x, y)) {
+                        mask[(static_cast<size_t>(y) * width_) + x] = k_mask_seed;
+                    }
+                }
+            }
+        });
+        if (config_.tolerance <= 1) {
+            return mask;
+        }
+        
+        // Distance to the nearest seed, capped at `cap`, as a separable L1
+        // distance transform: first along each row, then down each column.
+        const int reach = config_.tolerance - 1;
+        const auto cap = static_cast<std::uint16_t>(
+            std::min(reach + 1, static_cast<int>(std::numeric_limits<std::uint16_t>::max())));
+        std::vector<std::uint16_t> dist(mask.size());
+        for_each_range(height_, config_.threads, [&](int y0, int y1) {
+            for (int y = y0; y < y1; ++y) {
+                const size_t row = static_cast<size_t>(y) * width_;
+                std::uint16_t d = cap;
+                for (int x = 0; x < width_; ++x) {
+                    d = mask[row + x] == k_mask_seed ? 0 : static_cast<std::uint16_t>(std::min<int>(d + 1, cap));
+                    dist[row + x] = d;
+                }
+                d = cap;
+                for (int x = width_ - 1; x >= 0; --x) {
+                    d = mask[row + x] == k_mask_seed ? 0 : static_cast<std::uint16_t>(std::min<int>(d + 1, cap));
+                    dist[row + x] = std::min(dist[row + x], d);
+                }
+            }
+        });
+        // Columns are split into blocks and walked row by row, keeping the
+        // running distance of each column in `run`.
+        for_each_range(width_, config_.threads, [&](int x0, int x1) {
+            std::vector<std::uint16_t> run(static_cast<size_t>(x1 - x0), cap);
+            for (int y = 0; y < height_; ++y) {
+                const size_t row = static_cast<size_t>(y) * width_;
+                for (int x = x0; x < x1; ++x) {
+                    std::uint16_t& r = run[static_cast<size_t>(x - x0)];
+                    r = std::min(dist[row + x], static_cast<std::uint16_t>(std::min<int>(r + 1, cap)));
+                    dist[row + x] = r;
+                }
+            }
+            std::fill(run.begin(), run.end(), cap);
+            for (int y = height_ - 1; y >= 0; --y) {
+                const size_t row = static_cast<size_t>(y) * width_;
+                for (int x = x0; x < x1; ++x) {
+                    std::uint16_t& r = run[static_cast<size_t>(x - x0)];
+                    r = std::min(dist[row + x], static_cast<std::uint16_t>(std::min<int>(r + 1, cap)));
+                    if (mask[row + x] == k_mask_none && r <= reach) {
+                        mask[row + x] = k_mask_member;
+                    }
+                }
+            }
+        });
+        return mask;
+    }
+    
+    // Two-pass union-find labeling of the non-empty mask pixels, 8-connected
+    // when `diagonal` is set and 4-connected otherwise. Each horizontal strip
+    // is labeled by its own thread, the trees are joined across strip
+    // boundaries, and every component is then reported once, in raster order
+    // of its first seed pixel; that is the order a scan-line flood fill finds
+    // them in. Components without a seed are dropped.
+    std::vector<ComponentStats> label_components(const std::vector<std::uint8_t>& mask, bool diagonal) {
+        const size_t total = static_cast<size_t>(width_) * height_;
+        component_labels_.assign(total, k_no_label);
+        std::vector<Label>& parent = component_labels_;
+        
+        // Roots are always the smallest pixel index of their tree.
+        auto find = [&parent](Label p) {
+            while (parent[p] != p) {
+                parent[p] = parent[parent[p]];
+                p = parent[p];
+            }
+            return p;
+        };
+        auto unite = [&](Label a, Label b) {
+            a = find(a);
+            b = find(b);
+            if (a < b) {
+                parent[b] = a;
+            } else if (b < a) {
+                parent[a] = b;
+            }
+        };
+        // Joins pixel (x, y) with its already-visited neighbours on row y - 1.
+        auto unite_above = [&](int x, int y) {
+            const auto p = static_cast<Label>((static_cast<size_t>(y) * width_) + x);
+            const Label up = p - static_cast<Label>(width_);
+            if (mask[up] != k_mask_none) {
+                unite(p, up);
+            }
+            if (diagonal) {
+                if (x > 0 && mask[up - 1] != k_mask_none) {
+                    unite(p, up - 1);
+                }
+                if (x + 1 < width_ && mask[up + 1] != k_mask_none) {
+                    unite(p, up + 1);
+                }
+            }
+        };
+        
+        const unsigned int strips = std::max(1U, std::min(config_.threads,
+            static_cast<unsigned int>(std::max(1, height_ / k_min_strip_rows))));
+        for_each_range(height_, strips, [&](int y0, int y1) {
+            for (int y = y0; y < y1; ++y) {
+                for (int x = 0; x < width_; ++x) {
+                    const auto p = static_cast<Label>((static_cast<size_t>(y) * width_) + x);
+                    if (mask[p] == k_mask_none) {
+                        continue;
+                    }
+                    parent[p] = p;
+                    if (x > 0 && mask[p - 1] != k_mask_none) {
+                        unite(p, p - 1);
+                    }
+                    if (y > y0) {
+                        unite_above(x, y);
+                    }
+                }
+            }
+        });
+        for (unsigned int i = 1; i < strips; ++i) {
+            const int y = static_cast<int>((static_cast<long long>(height_) * i) / strips);
+            for (int x = 0; x < width_; ++x) {
+                if (mask[(static_cast<size_t>(y) * width_) + x] != k_mask_none) {
+                    unite_above(x, y);
+                }
+            }
+        }
+        
+        // Trees now span strips, so the final pass reads and flattens them
+        // through atomic_ref; every value a reader can see is an ancestor.
+        std::vector<std::unordered_map<Label, ComponentStats>> partial(strips);
+        std::atomic<unsigned int> next_part{0};
+        for_each_range(height_, strips, [&](int y0, int y1) {
+            std::unordered_map<Label, ComponentStats>& stats = partial[next_part.fetch_add(1)];
+            Label last_root = k_no_label;
+            ComponentStats* last = nullptr;
+            for (int y = y0; y < y1; ++y) {
+                for (int x = 0; x < width_; ++x) {
+                    const auto p = static_cast<Label>((static_cast<size_t>(y) * width_) + x);
+                    if (mask[p] == k_mask_none) {
+                        continue;
+                    }
+                    Label root = p;
+                    for (Label next = std::atomic_ref<Label>(parent[root]).load(std::memory_order_relaxed);
+                         next != root;
+                         next = std::atomic_ref<Label>(parent[root]).load(std::memory_order_relaxed)) {
+                        root = next;
+                    }
+                    std::atomic_ref<Label>(parent[p]).store(root, std::memory_order_relaxed);
+                    if (root != last_root) {
+                        last_root = root;
+                        last = &stats[root];
+                    }
+                    last->add(x, y);
+                    if (mask[p] == k_mask_seed) {
+                        last->first_seed = std::min(last->first_seed, static_cast<size_t>(p));
+                    }
+                }
+            }
+        });
+        
+        std::unordered_map<Label, ComponentStats> merged;
+        for (const auto& stats : partial) {
+            for (const auto& [root, component] : stats) {
+                merged[root].merge(component);
+            }
+        }
+        std::vector<ComponentStats> components;
+        components.reserve(merged.size());
+        for (const auto& [root, component] : merged) {
+            if (component.first_seed != std::numeric_limits<size_t>::max()) {
+                components.push_back(component);
+            }
+        }
+        std::ranges::sort(components, {}, &ComponentStats::first_seed);
+        return components;
+    }
+    
     [[nodiscard]] bool is_sprite_pixel(int x, int y) const {
         if (x < 0 || x >= width_ || y < 0 || y >= height_) {
             return false;
@@ -443,83 +660,6 @@ private:
         return true;
     }
     
-    int flood_fill_component(int start_x, int start_y, int component_id, Rectangle& bounds) {
-        fill_stack_.clear();
-        fill_stack_.emplace_back(start_x, start_y);
-        component_labels_.at((static_cast<size_t>(start_y) * width_) + start_x) = component_id;
-
-        int min_x = start_x;
-        int max_x = start_x;
-        int min_y = start_y;
-        int max_y = start_y;
-        int size = 0;
-
-        constexpr std::array<int, 8> dx = {-1, 1, 0, 0, -1, 1, -1, 1};
-        constexpr std::array<int, 8> dy = {0, 0, -1, 1, -1, -1, 1, 1};
-
-        while (!fill_stack_.empty()) {
-            auto [x, y] = fill_stack_.back();
-            fill_stack_.pop_back();
-            size++;
-
-            min_x = std::min(min_x, x);
-            max_x = std::max(max_x, x);
-            min_y = std::min(min_y, y);
-            max_y = std::max(max_y, y);
-
-            for (size_t i = 0; i < dx.size(); ++i) {
-                int nx = x + dx[i];
-                int ny = y + dy[i];
-
-                if (nx >= 0 && nx < width_ && ny >= 0 && ny < height_
-                    && component_labels_.at((static_cast<size_t>(ny) * width_) + nx) == -1
-                    && (is_sprite_pixel(nx, ny) || is_near_sprite_pixel(nx, ny))) {
-                    component_labels_.at((static_cast<size_t>(ny) * width_) + nx) = component_id;
-                    fill_stack_.emplace_back(nx, ny);
-                }
-            }
-        }
-
-        bounds.x = min_x;
-        bounds.y = min_y;
-        bounds.w = max_x - min_x + 1;
-        bounds.h = max_y - min_y + 1;
-
-        return size;
-    }
-    
-    [[nodiscard]] bool is_near_sprite_pixel(int x, int y) const {
-        if (x < 0 || x >= width_ || y < 0 || y >= height_) {
-            return false;
-        }
-        
-        // Check if this pixel is within tolerance distance of any sprite pixel
-        // Tolerance defines minimum distance between frames
-        // Tolerance=1 means at least 1 transparent pixel between colored pixels
-        // This means sprites separated by 1 transparent pixel should be separate
-        for (int dy = -config_.tolerance; dy <= config_.tolerance; ++dy) {
-            for (int dx = -config_.tolerance; dx <= config_.tolerance; ++dx) {
-                int nx = x + dx;
-                int ny = y + dy;
-                
-                if (nx >= 0 && nx < width_ && ny >= 0 && ny < height_) {
-                    if (is_sprite_pixel(nx, ny)) {
-                        // Calculate Manhattan distance (number of transparent pixels between)
-                        int distance = std::abs(dx) + std::abs(dy);
-                        // Connect sprites if distance is less than tolerance
-                        // This means tolerance=1 allows connection through 0 transparent pixels
-                        // tolerance=2 allows connection through 1 transparent pixel
-                        if (distance < config_.tolerance) {
-                            return true;
-                        }
-                    }
-                }
-            }
-        }
-        
-        return false;
-    }
-    
     std::vector<SpriteFrame> extract_from_components() {
         std::vector<SpriteFrame> frames;
         frames.reserve(component_bounds_.size());
@@ -755,6 +895,7 @@ void print_usage() {
         << tr("  --min-size N             Minimum sprite size in pixels (default: ") << k_default_min_sprite_size << ")\n"
         << tr("  --max-sprites N          Maximum number of sprites to extract (default: ") << k_default_max_sprites << ")\n"
         << tr("  --threads N              Number of threads to use (default: ") << k_default_threads << tr(" = auto)\n")
+        << tr("  --trace FILE             Write stage timings and counters as Chrome trace JSON\n")
         << tr("  --help, -h               Show this help message\n")
         << tr("  --version, -v            Show version\n\n")
         << tr("Examples:\n")
@@ -772,6 +913,7 @@ int run_spratframes(int argc, char** argv) {
         std::cerr << tr("Failed to set stdout to binary mode\n");
     }
 #endif
+    sprat::core::ProfileSession profile_session("spratframes");
     FramesConfig config;
     bool show_help = false;
     
@@ -813,6 +955,8 @@ int run_spratframes(int argc, char** argv) {
                 return 1;
             }
             config.threads = static_cast<unsigned int>(threads_int);
+        } else if (arg == "--trace" && i + 1 < argc) {
+            profile_session.start(argv[++i]);
         } else if (arg.empty() || arg[0] == '-') {
             std::cerr << tr("Error: Unknown option: ") << arg << '\n';
             print_usage();
@@ -21,13 +21,8 @@
 #endif
 #endif
 
-#ifdef _MSC_VER
-static inline int popcount64(unsigned long long x) { return (int)__popcnt64(x); }
-#else
-static inline int popcount64(unsigned long long x) { return __builtin_popcountll(x); }
-#endif
-
 #include <algorithm>
+#include <bit>
 #include <iostream>
 #include <utility>
 #include <vector>
@@ -50,6 +45,10 @@ namespace fs = std::filesystem;
 #include <iomanip>
 #include <sstream>
 #include <atomic>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <condition_variable>
 #include <thread>
 #include <unordered_map>
 #include <unordered_set>
@@ -60,19 +59,32 @@ namespace fs = std::filesystem;
 #include <archive.h>
 #include <archive_entry.h>
 #include "core/cli_parse.h"
+#include "core/directory_scan.h"
 #include "core/i18n.h"
+#include "core/image_probe.h"
+#include "core/layout_parser.h"
 #include "core/fnv1a.h"
+#include "core/hamming_index.h"
+#include "core/mapped_file.h"
+#include "core/temp_dir.h"
+#include "core/pixel_cache.h"
+#include "core/pixel_kernels.h"
+#include "core/profiler.h"
+#include "commands/entrypoints.h"
 
 #include <stb_image.h>
 
 constexpr int k_output_cache_format_version = 3;
 constexpr int k_seed_cache_format_version = 3;
+constexpr uint32_t k_binary_image_cache_format_version = 2;
+constexpr uint32_t k_binary_seed_cache_format_version = 1;
 #ifndef SPRAT_GLOBAL_PROFILE_CONFIG
 #define SPRAT_GLOBAL_PROFILE_CONFIG "/usr/local/share/sprat/spratprofiles.cfg"
 #endif
 
 namespace {
 using sprat::core::parse_non_negative_int;
+using sprat::core::parse_non_negative_uint;
 using sprat::core::parse_positive_int;
 using sprat::core::parse_positive_uint;
 using sprat::core::tr;
@@ -151,6 +163,7 @@ constexpr long long k_max_cache_age_seconds_limit = 31536000; // 1 year
 constexpr long long k_default_cache_age_seconds = 86400; // 1 day
 constexpr uintmax_t k_max_file_size = 1000000000; // 1GB
 constexpr size_t k_tar_read_buffer_size = 10240;
+constexpr unsigned int k_default_archive_memory_mib = 256;
 constexpr size_t k_max_extension_len = 10;
 constexpr size_t k_content_detection_buffer_size = 512;
 constexpr size_t k_tar_magic_offset = 257;
@@ -193,9 +206,13 @@ constexpr std::array<RectHeuristic, k_guided_heuristic_count> k_guided_heuristic
     RectHeuristic::BestAreaFit,
     RectHeuristic::BottomLeft
 };
+constexpr int k_free_rect_size_class_count = 32;
+constexpr size_t k_free_rect_grid_max_cells = 4096;
+constexpr size_t k_free_rect_large_cell_span = 64;
 constexpr long long k_cache_max_age_seconds = 3600;
 constexpr size_t k_cache_max_layout_files = 16;
 constexpr size_t k_cache_max_seed_files = 8;
+constexpr size_t k_max_warm_cache_files = 64;
 
 std::string to_lower_copy(std::string value) {
     std::ranges::transform(value, value.begin(),
@@ -702,6 +719,8 @@ struct ImageSource {
     fs::path file_path;
     std::string path;
     ImageMeta meta;
+    // Encoded image bytes for archive members held in memory, else null.
+    const std::vector<unsigned char>* encoded = nullptr;
 };
 
 struct ImageCacheEntry {
@@ -715,16 +734,35 @@ struct ImageCacheEntry {
     int trim_right = 0;
     int trim_bottom = 0;
     long long cached_at_unix = 0;
-    uint64_t content_hash = 0;     // FNV-1a hash of visible pixel region (0 = not computed)
+    uint64_t content_hash = 0;     // XXH64 of visible pixel region   (0 = not computed)
     uint64_t perceptual_hash = 0;  // dHash of visible pixel region   (0 = not computed)
 };
 
+// Packing input: sprite sizes in packing order, kept apart from the rest of
+// Sprite so search passes stream through plain ints instead of copying paths.
+// index is the sprite's position in the vector the items were built from.
+struct PackItems {
+    std::vector<int> w;
+    std::vector<int> h;
+    std::vector<std::uint32_t> index;
+
+    size_t size() const { return index.size(); }
+};
+
+// Where a packer put the item at the same position in its PackItems.
+struct Placement {
+    int x = 0;
+    int y = 0;
+    bool rotated = false;
+};
+
 struct LayoutCandidate {
     bool valid = false;
     size_t area = 0;
     int w = 0;
     int h = 0;
-    std::vector<Sprite> sprites;
+    size_t sort_idx = 0;
+    std::vector<Placement> placements;
 };
 
 struct LayoutSeedEntry {
@@ -748,6 +786,77 @@ struct LayoutSeedCache {
     std::vector<LayoutSeedEntry> entries;
 };
 
+// Binary cache files: a header, an array of fixed-size records and a string
+// table holding each path once. Integers use native byte order; the byte order
+// mark makes a file written on a foreign machine fail validation instead.
+constexpr std::array<char, 8> k_binary_image_cache_magic = {'S', 'P', 'R', 'A', 'T', 'I', 'M', 'G'};
+constexpr std::array<char, 8> k_binary_seed_cache_magic = {'S', 'P', 'R', 'A', 'T', 'S', 'E', 'D'};
+constexpr uint32_t k_binary_cache_byte_order_mark = 0x01020304u;
+
+struct BinaryCacheHeader {
+    std::array<char, 8> magic{};
+    uint32_t version = 0;
+    uint32_t byte_order = 0;
+    uint64_t record_count = 0;
+    uint64_t string_bytes = 0;
+};
+
+struct BinaryImageCacheRecord {
+    uint64_t file_size = 0;
+    int64_t mtime_ticks = 0;
+    int64_t cached_at_unix = 0;
+    uint64_t content_hash = 0;
+    uint64_t perceptual_hash = 0;
+    uint32_t path_offset = 0;
+    uint32_t path_size = 0;
+    int32_t w = 0;
+    int32_t h = 0;
+    int32_t trim_left = 0;
+    int32_t trim_top = 0;
+    int32_t trim_right = 0;
+    int32_t trim_bottom = 0;
+    uint32_t trim_transparent = 0;
+    uint32_t reserved = 0;
+};
+
+// The image cache header is followed by `bucket_count` hash buckets (a power of
+// two), then the records and the string table. A bucket holds a record index
+// plus one, or zero when empty; collisions probe linearly.
+struct BinaryImageCacheHeader {
+    BinaryCacheHeader base;
+    uint64_t bucket_count = 0;
+};
+
+// The seed signature is stored at the start of the string table.
+struct BinarySeedCacheHeader {
+    BinaryCacheHeader base;
+    uint32_t signature_size = 0;
+    int32_t padding = 0;
+    int32_t atlas_width = 0;
+    int32_t atlas_height = 0;
+};
+
+struct BinarySeedCacheRecord {
+    uint32_t path_offset = 0;
+    uint32_t path_size = 0;
+    int32_t x = 0;
+    int32_t y = 0;
+    int32_t w = 0;
+    int32_t h = 0;
+    int32_t trim_left = 0;
+    int32_t trim_top = 0;
+    int32_t trim_right = 0;
+    int32_t trim_bottom = 0;
+    uint32_t rotated = 0;
+    uint32_t reserved = 0;
+};
+
+static_assert(sizeof(BinaryCacheHeader) == 32);
+static_assert(sizeof(BinaryImageCacheRecord) == 80);
+static_assert(sizeof(BinaryImageCacheHeader) == 40);
+static_assert(sizeof(BinarySeedCacheHeader) == 48);
+static_assert(sizeof(BinarySeedCacheRecord) == 48);
+
 struct Node {
     int x, y, w, h;
     bool used = false;
@@ -796,78 +905,8 @@ bool compute_trim_bounds(const unsigned char* rgba,
         return false;
     }
 
-    // Use direct pointer arithmetic for alpha channel access.
-    // Bounds are already validated above (w > 0, h > 0, w/h <= k_max_image_dimension).
-    const size_t stride = static_cast<size_t>(w) * 4;
-
-    int top_hit_x = -1;
-    for (int y = 0; y < h; ++y) {
-        const unsigned char* row_alpha = rgba + static_cast<size_t>(y) * stride + 3;
-        for (int x = 0; x < w; ++x) {
-            if (row_alpha[static_cast<size_t>(x) * 4] != 0) {
-                min_y = y;
-                top_hit_x = x;
-                break;
-            }
-        }
-        if (top_hit_x >= 0) {
-            break;
-        }
-    }
-    if (top_hit_x < 0) {
-        return false;
-    }
-
-    int bottom_hit_x = -1;
-    for (int y = h - 1; y >= min_y; --y) {
-        const unsigned char* row_alpha = rgba + static_cast<size_t>(y) * stride + 3;
-        for (int x = w - 1; x >= 0; --x) {
-            if (row_alpha[static_cast<size_t>(x) * 4] != 0) {
-                max_y = y;
-                bottom_hit_x = x;
-                break;
-            }
-        }
-        if (bottom_hit_x >= 0) {
-            break;
-        }
-    }
-
-    const int left_search_end = std::min(top_hit_x, bottom_hit_x);
-    min_x = left_search_end;
-    for (int x = 0; x <= left_search_end; ++x) {
-        bool found = false;
-        const unsigned char* col_alpha = rgba + static_cast<size_t>(x) * 4 + 3;
-        for (int y = min_y; y <= max_y; ++y) {
-            if (col_alpha[static_cast<size_t>(y) * stride] != 0) {
-                min_x = x;
-                found = true;
-                break;
-            }
-        }
-        if (found) {
-            break;
-        }
-    }
-
-    const int right_search_start = std::max(top_hit_x, bottom_hit_x);
-    max_x = right_search_start;
-    for (int x = w - 1; x >= right_search_start; --x) {
-        bool found = false;
-        const unsigned char* col_alpha = rgba + static_cast<size_t>(x) * 4 + 3;
-        for (int y = min_y; y <= max_y; ++y) {
-            if (col_alpha[static_cast<size_t>(y) * stride] != 0) {
-                max_x = x;
-                found = true;
-                break;
-            }
-        }
-        if (found) {
-            break;
-        }
-    }
-
-    return max_x >= min_x && max_y >= min_y;
+    return sprat::core::find_opaque_bounds(rgba, w, h, static_cast<size_t>(w) * 4,
+                                           min_x, min_y, max_x, max_y);
 }
 
 bool read_image_meta(const fs::path& path, ImageMeta& out) {
@@ -984,33 +1023,25 @@ fs::path safe_extract_path(const fs::path& output_dir, const char* entry_name) {
     return candidate;
 }
 
-bool extract_tar_file(const fs::path& tar_path, const fs::path& output_dir) {
-    struct archive* a = archive_read_new();
-    if (a == nullptr) {
-        std::cerr << tr("Error: Failed to create archive reader") << '\n';
-        return false;
-    }
-
-    // Enable all supported formats and compression
-    archive_read_support_format_all(a);
-    archive_read_support_filter_all(a);
-
-    if (archive_read_open_filename(a, tar_path.string().c_str(), k_tar_read_buffer_size) != ARCHIVE_OK) {
-        std::cerr << tr("Error: Failed to open archive file: ") << archive_error_string(a) << '\n';
-        archive_read_free(a);
-        return false;
-    }
-
-    struct archive* ext = archive_write_disk_new();
-    if (ext == nullptr) {
-        std::cerr << tr("Error: Failed to create archive writer") << '\n';
-        archive_read_free(a);
-        return false;
-    }
-
-    archive_write_disk_set_options(ext, ARCHIVE_EXTRACT_TIME | ARCHIVE_EXTRACT_PERM | ARCHIVE_EXTRACT_ACL | ARCHIVE_EXTRACT_FFLAGS);
+// An image entry read from an archive. Entries that fit the memory budget keep
+// their encoded bytes here; the rest are spilled to `path` on disk.
+struct ArchiveMember {
+    fs::path path;
+    ImageMeta meta;
+    bool spilled = false;
+    std::vector<unsigned char> encoded;
+};
 
+// Shared by file and stdin archives: reads every image entry straight from the
+// stream, keeping up to `memory_budget` bytes of encoded images in memory and
+// extracting the remainder below `output_dir`, which is created on first use.
+// A member name that repeats replaces the earlier entry, as extraction would.
+bool read_archive_members(struct archive* a, const fs::path& output_dir, size_t memory_budget,
+                          std::vector<ArchiveMember>& members) {
+    struct archive* ext = nullptr;
     bool had_error = false;
+    size_t memory_used = 0;
+    std::unordered_map<std::string, size_t> member_index;
     struct archive_entry* entry = nullptr;
 
     while (true) {
@@ -1024,62 +1055,148 @@ bool extract_tar_file(const fs::path& tar_path, const fs::path& output_dir) {
             break;
         }
 
-        // Skip directories
-        if (archive_entry_filetype(entry) == AE_IFDIR) {
+        // Only regular image files take part in the layout
+        if (archive_entry_filetype(entry) != AE_IFREG) {
             continue;
         }
 
-        // Validate and resolve extraction path (guards against Zip Slip)
+        // Validate and resolve the member path (guards against Zip Slip)
         fs::path output_path = safe_extract_path(output_dir, archive_entry_pathname(entry));
         if (output_path.empty()) {
             std::cerr << tr("Warning: Skipping archive entry with unsafe path: ")
                       << (archive_entry_pathname(entry) ? archive_entry_pathname(entry) : "(null)") << '\n';
             continue;
         }
+        if (!is_supported_image_extension(output_path)) {
+            continue;
+        }
+        const la_int64_t declared_size = archive_entry_size_is_set(entry) ? archive_entry_size(entry) : 0;
+        if (declared_size < 0 || static_cast<uintmax_t>(declared_size) > k_max_file_size) {
+            continue;
+        }
 
-        // Create parent directory if needed
-        std::error_code ec;
-        fs::create_directories(output_path.parent_path(), ec);
-
-        // Set the extraction path
-        archive_entry_set_pathname(entry, output_path.string().c_str());
-
-        // Extract the file
-        r = archive_write_header(ext, entry);
-        if (r < ARCHIVE_OK) {
-            std::cerr << tr("Error: Failed to write archive header: ") << archive_error_string(ext) << '\n';
+        ArchiveMember member;
+        member.path = output_path;
+        member.meta.file_size = static_cast<uintmax_t>(declared_size);
+        member.meta.mtime_ticks = static_cast<long long>(archive_entry_mtime(entry)) * 1000000000LL
+            + static_cast<long long>(archive_entry_mtime_nsec(entry));
+
+        const void* buff = nullptr;
+        size_t size = 0;
+        la_int64_t offset = 0;
+        bool block_error = false;
+        // Buffer blocks while the entry fits the budget. Crossing it switches the
+        // entry to disk: the header goes out and the buffered prefix is replayed.
+        member.spilled = memory_used + static_cast<size_t>(declared_size) > memory_budget;
+        auto start_spill = [&]() -> bool {
+            if (ext == nullptr) {
+                ext = archive_write_disk_new();
+                if (ext == nullptr) {
+                    std::cerr << tr("Error: Failed to create archive writer") << '\n';
+                    return false;
+                }
+                archive_write_disk_set_options(ext, ARCHIVE_EXTRACT_TIME | ARCHIVE_EXTRACT_PERM | ARCHIVE_EXTRACT_ACL | ARCHIVE_EXTRACT_FFLAGS);
+            }
+            std::error_code ec;
+            fs::create_directories(output_path.parent_path(), ec);
+            archive_entry_set_pathname(entry, output_path.string().c_str());
+            if (archive_write_header(ext, entry) < ARCHIVE_OK) {
+                std::cerr << tr("Error: Failed to write archive header: ") << archive_error_string(ext) << '\n';
+                return false;
+            }
+            if (!member.encoded.empty() &&
+                archive_write_data_block(ext, member.encoded.data(), member.encoded.size(), 0) < ARCHIVE_OK) {
+                std::cerr << tr("Error: Failed to write archive data: ") << archive_error_string(ext) << '\n';
+                return false;
+            }
+            member.encoded = {};
+            return true;
+        };
+        if (member.spilled && !start_spill()) {
             had_error = true;
-        } else {
-            const void* buff = nullptr;
-            size_t size = 0;
-            la_int64_t offset = 0;
-            bool block_error = false;
-
-            while (archive_read_data_block(a, &buff, &size, &offset) == ARCHIVE_OK) {
-                if (archive_write_data_block(ext, buff, size, offset) < ARCHIVE_OK) {
-                    std::cerr << tr("Error: Failed to write archive data: ") << archive_error_string(ext) << '\n';
-                    had_error = true;
+            continue;
+        }
+
+        while (!block_error && archive_read_data_block(a, &buff, &size, &offset) == ARCHIVE_OK) {
+            if (!member.spilled) {
+                const size_t block_end = static_cast<size_t>(offset) + size;
+                if (memory_used + block_end <= memory_budget && block_end <= k_max_file_size) {
+                    if (member.encoded.size() < block_end) {
+                        member.encoded.resize(block_end);
+                    }
+                    std::memcpy(member.encoded.data() + offset, buff, size);
+                    continue;
+                }
+                member.spilled = true;
+                if (!start_spill()) {
                     block_error = true;
                     break;
                 }
             }
+            if (archive_write_data_block(ext, buff, size, offset) < ARCHIVE_OK) {
+                std::cerr << tr("Error: Failed to write archive data: ") << archive_error_string(ext) << '\n';
+                block_error = true;
+            }
+        }
+        if (block_error) {
+            had_error = true;
+            continue;
+        }
 
-            if (!block_error && archive_write_finish_entry(ext) < ARCHIVE_OK) {
+        if (member.spilled) {
+            if (archive_write_finish_entry(ext) < ARCHIVE_OK) {
                 std::cerr << tr("Error: Failed to finish archive entry: ") << archive_error_string(ext) << '\n';
                 had_error = true;
+                continue;
+            }
+            if (!read_image_meta(output_path, member.meta)) {
+                continue;
             }
+        } else {
+            memory_used += member.encoded.size();
+            member.meta.file_size = member.encoded.size();
+        }
+        const auto [it, inserted] = member_index.emplace(output_path.string(), members.size());
+        if (inserted) {
+            members.push_back(std::move(member));
+        } else {
+            memory_used -= members[it->second].encoded.size();
+            members[it->second] = std::move(member);
         }
     }
 
+    if (ext != nullptr) {
+        archive_write_close(ext);
+        archive_write_free(ext);
+    }
+    return !had_error;
+}
+
+bool extract_tar_file(const fs::path& tar_path, const fs::path& output_dir, size_t memory_budget,
+                      std::vector<ArchiveMember>& members) {
+    struct archive* a = archive_read_new();
+    if (a == nullptr) {
+        std::cerr << tr("Error: Failed to create archive reader") << '\n';
+        return false;
+    }
+
+    // Enable all supported formats and compression
+    archive_read_support_format_all(a);
+    archive_read_support_filter_all(a);
+
+    if (archive_read_open_filename(a, tar_path.string().c_str(), k_tar_read_buffer_size) != ARCHIVE_OK) {
+        std::cerr << tr("Error: Failed to open archive file: ") << archive_error_string(a) << '\n';
+        archive_read_free(a);
+        return false;
+    }
+
+    const bool ok = read_archive_members(a, output_dir, memory_budget, members);
     archive_read_close(a);
     archive_read_free(a);
-    archive_write_close(ext);
-    archive_write_free(ext);
-
-    return !had_error;
+    return ok;
 }
 
-bool extract_tar_from_stdin(const fs::path& output_dir) {
+bool extract_tar_from_stdin(const fs::path& output_dir, size_t memory_budget, std::vector<ArchiveMember>& members) {
     struct archive* a = archive_read_new();
     if (a == nullptr) {
         std::cerr << tr("Error: Failed to create archive reader") << '\n';
@@ -1110,83 +1227,11 @@ bool extract_tar_from_stdin(const fs::path& output_dir) {
         archive_read_free(a);
         return false;
     }
-    
-    struct archive* ext = archive_write_disk_new();
-    if (ext == nullptr) {
-        std::cerr << tr("Error: Failed to create archive writer") << '\n';
-        archive_read_free(a);
-        return false;
-    }
-    
-    archive_write_disk_set_options(ext, ARCHIVE_EXTRACT_TIME | ARCHIVE_EXTRACT_PERM | ARCHIVE_EXTRACT_ACL | ARCHIVE_EXTRACT_FFLAGS);
-
-    bool had_error = false;
-    struct archive_entry* entry = nullptr;
-
-    while (true) {
-        la_ssize_t r = archive_read_next_header(a, &entry);
-        if (r == ARCHIVE_EOF) {
-            break;
-        }
-        if (r < ARCHIVE_OK) {
-            std::cerr << tr("Error: Failed to read archive header: ") << archive_error_string(a) << '\n';
-            had_error = true;
-            break;
-        }
-
-        // Skip directories
-        if (archive_entry_filetype(entry) == AE_IFDIR) {
-            continue;
-        }
-
-        // Validate and resolve extraction path (guards against Zip Slip)
-        fs::path output_path = safe_extract_path(output_dir, archive_entry_pathname(entry));
-        if (output_path.empty()) {
-            std::cerr << tr("Warning: Skipping archive entry with unsafe path: ")
-                      << (archive_entry_pathname(entry) ? archive_entry_pathname(entry) : "(null)") << '\n';
-            continue;
-        }
-
-        // Create parent directory if needed
-        std::error_code ec;
-        fs::create_directories(output_path.parent_path(), ec);
-
-        // Set the extraction path
-        archive_entry_set_pathname(entry, output_path.string().c_str());
-
-        // Extract the file
-        r = archive_write_header(ext, entry);
-        if (r < ARCHIVE_OK) {
-            std::cerr << tr("Error: Failed to write archive header: ") << archive_error_string(ext) << '\n';
-            had_error = true;
-        } else {
-            const void* buff = nullptr;
-            size_t size = 0;
-            la_int64_t offset = 0;
-            bool block_error = false;
-
-            while (archive_read_data_block(a, &buff, &size, &offset) == ARCHIVE_OK) {
-                if (archive_write_data_block(ext, buff, size, offset) < ARCHIVE_OK) {
-                    std::cerr << tr("Error: Failed to write archive data: ") << archive_error_string(ext) << '\n';
-                    had_error = true;
-                    block_error = true;
-                    break;
-                }
-            }
-
-            if (!block_error && archive_write_finish_entry(ext) < ARCHIVE_OK) {
-                std::cerr << tr("Error: Failed to finish archive entry: ") << archive_error_string(ext) << '\n';
-                had_error = true;
-            }
-        }
-    }
 
+    const bool ok = read_archive_members(a, output_dir, memory_budget, members);
     archive_read_close(a);
     archive_read_free(a);
-    archive_write_close(ext);
-    archive_write_free(ext);
-
-    return !had_error;
+    return ok;
 }
 
 enum class InputType : std::uint8_t {
@@ -1201,9 +1246,24 @@ struct InputContext {
     InputType type;
     fs::path working_folder;
     std::vector<fs::path> temp_dirs_to_cleanup;
+    // Archive inputs only: images in archive order, kept in memory or spilled
+    // below working_folder.
+    std::vector<ArchiveMember> archive_members;
+
+    InputContext() = default;
+    InputContext(const InputContext&) = delete;
+    InputContext& operator=(const InputContext&) = delete;
+    // Spilled archive members are removed on every exit path, cache hits included.
+    ~InputContext() {
+        for (const auto& dir : temp_dirs_to_cleanup) {
+            std::error_code ec;
+            fs::remove_all(dir, ec);
+        }
+    }
 };
 
-bool detect_and_extract_tar_content(const fs::path& input_path, InputContext& out_context) {
+bool detect_and_extract_tar_content(const fs::path& input_path, size_t archive_memory_budget,
+                                    InputContext& out_context) {
     const bool is_dir = fs::exists(input_path) && fs::is_directory(input_path);
     const bool is_file = fs::exists(input_path) && fs::is_regular_file(input_path);
     const bool is_tar = is_file && is_tar_file(input_path);
@@ -1214,19 +1274,14 @@ bool detect_and_extract_tar_content(const fs::path& input_path, InputContext& ou
     if (is_tar || is_compressed_tar) {
         // Use a unique directory per invocation to avoid races between concurrent processes.
         static std::atomic<unsigned int> extract_counter{0};
+        // It is only created when entries spill past the memory budget.
         fs::path temp_dir = fs::temp_directory_path()
             / ("spratlayout_extract_" + std::to_string(extract_counter.fetch_add(1)));
         std::error_code ec;
-        fs::create_directories(temp_dir, ec);
-        if (ec) {
-            std::cerr << tr("Error: Failed to create temporary directory for archive extraction\n");
-            return false;
-        }
-        
         out_context.temp_dirs_to_cleanup.push_back(temp_dir);
         
-        // Extract the archive file
-        if (!extract_tar_file(input_path, temp_dir)) {
+        // Read the archive file
+        if (!extract_tar_file(input_path, temp_dir, archive_memory_budget, out_context.archive_members)) {
             std::cerr << tr("Error: Failed to extract archive file: ") << to_quoted(input_path) << "\n";
             // Cleanup on error
             for (const auto& dir : out_context.temp_dirs_to_cleanup) {
@@ -1253,22 +1308,17 @@ bool detect_and_extract_tar_content(const fs::path& input_path, InputContext& ou
     return false;
 }
 
-bool load_content_from_stdin(InputContext& out_context) {
+bool load_content_from_stdin(size_t archive_memory_budget, InputContext& out_context) {
     // Use a unique directory per invocation to avoid races between concurrent processes.
+    // It is only created when entries spill past the memory budget.
     static std::atomic<unsigned int> stdin_counter{0};
     fs::path temp_dir = fs::temp_directory_path()
         / ("spratlayout_extract_stdin_" + std::to_string(stdin_counter.fetch_add(1)));
     std::error_code ec;
-    fs::create_directories(temp_dir, ec);
-    if (ec) {
-        std::cerr << tr("Error: Failed to create temporary directory for stdin tar extraction\n");
-        return false;
-    }
-    
     out_context.temp_dirs_to_cleanup.push_back(temp_dir);
     
-    // Extract from stdin
-    if (!extract_tar_from_stdin(temp_dir)) {
+    // Read from stdin
+    if (!extract_tar_from_stdin(temp_dir, archive_memory_budget, out_context.archive_members)) {
         std::cerr << tr("Error: Failed to extract archive from stdin\n");
         // Cleanup on error
         for (const auto& dir : out_context.temp_dirs_to_cleanup) {
@@ -1290,15 +1340,73 @@ bool load_list_from_stdin(InputContext& out_context, const fs::path& cwd) {
     return true;
 }
 
-void prune_stale_cache_entries(std::unordered_map<std::string, ImageCacheEntry>& entries,
-                               long long now_unix,
-                               long long max_age_seconds) {
+// One kind of warm cache, keyed by cache file path. Lookups and stores mark
+// an entry as most recently used; once k_max_warm_cache_files entries are
+// held, storing a new path drops only the least recently used one.
+template <typename Value>
+class WarmCacheMap {
+public:
+    Value* find(const std::string& key) {
+        const auto it = index_.find(key);
+        if (it == index_.end()) {
+            return nullptr;
+        }
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return &it->second->second;
+    }
+
+    void store(const std::string& key, Value value) {
+        if (Value* existing = find(key)) {
+            *existing = std::move(value);
+            return;
+        }
+        if (entries_.size() >= k_max_warm_cache_files) {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+        entries_.emplace_front(key, std::move(value));
+        index_.emplace(key, entries_.begin());
+    }
+
+private:
+    using Entries = std::list<std::pair<std::string, Value>>;
+    Entries entries_;
+    std::unordered_map<std::string, typename Entries::iterator> index_;
+};
+
+// In-memory copies of the on-disk caches, keyed by cache file path. Only --serve
+// enables them: requests then skip re-reading and re-parsing cache files while
+// every save still writes through to disk for regular invocations.
+struct WarmCaches {
+    bool enabled = false;
+    WarmCacheMap<std::unordered_map<std::string, ImageCacheEntry>> image_caches;
+    WarmCacheMap<LayoutSeedCache> seed_caches;
+    WarmCacheMap<std::pair<std::string, std::string>> output_caches;
+};
+
+WarmCaches& warm_caches() {
+    static WarmCaches caches;
+    return caches;
+}
+
+template <typename Value>
+void store_warm_cache(WarmCacheMap<Value>& map, const fs::path& cache_path, Value value) {
+    map.store(cache_path.string(), std::move(value));
+}
+
+bool is_stale_cache_entry(const ImageCacheEntry& entry, long long now_unix, long long max_age_seconds) {
     if (max_age_seconds < 0 || max_age_seconds > k_max_cache_age_seconds_limit) { // 1 year limit
         max_age_seconds = k_default_cache_age_seconds; // default to 1 day
     }
+    const long long cached_at = entry.cached_at_unix;
+    return cached_at <= 0 || cached_at > now_unix || (now_unix - cached_at) > max_age_seconds;
+}
+
+void prune_stale_cache_entries(std::unordered_map<std::string, ImageCacheEntry>& entries,
+                               long long now_unix,
+                               long long max_age_seconds) {
     for (auto it = entries.begin(); it != entries.end();) {
-        const long long cached_at = it->second.cached_at_unix;
-        if (cached_at <= 0 || cached_at > now_unix || (now_unix - cached_at) > max_age_seconds) {
+        if (is_stale_cache_entry(it->second, now_unix, max_age_seconds)) {
             it = entries.erase(it);
         } else {
             ++it;
@@ -1306,49 +1414,268 @@ void prune_stale_cache_entries(std::unordered_map<std::string, ImageCacheEntry>&
     }
 }
 
-bool load_image_cache(const fs::path& cache_path,
-                      std::unordered_map<std::string, ImageCacheEntry>& out) {
-    out.clear();
-    std::ifstream in(cache_path);
-    if (!in) {
+template <typename T>
+bool read_binary_value(const sprat::core::MappedFile& file, size_t offset, T& out) {
+    if (offset > file.size() || file.size() - offset < sizeof(T)) {
         return false;
     }
+    std::memcpy(&out, file.data() + offset, sizeof(T));
+    return true;
+}
 
-    std::string header_tag;
-    int version = 0;
-    if (!(in >> header_tag >> version)) {
+template <typename T>
+void append_binary_value(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+bool has_binary_cache_magic(const sprat::core::MappedFile& file, const std::array<char, 8>& magic) {
+    return file.size() >= magic.size() && std::memcmp(file.data(), magic.data(), magic.size()) == 0;
+}
+
+// Checks the header against the file size and locates the string table that
+// follows `header.record_count` records of `record_size` bytes.
+bool locate_binary_cache_strings(const sprat::core::MappedFile& file,
+                                 const BinaryCacheHeader& header,
+                                 const std::array<char, 8>& magic,
+                                 uint32_t version,
+                                 size_t header_size,
+                                 size_t record_size,
+                                 std::string_view& strings) {
+    if (header.magic != magic || header.version != version ||
+        header.byte_order != k_binary_cache_byte_order_mark || file.size() < header_size) {
         return false;
     }
-    if (header_tag != "spratlayout_cache" || (version != 1 && version != 2 && version != 3)) {
+    const size_t payload = file.size() - header_size;
+    if (header.record_count > payload / record_size) {
         return false;
     }
+    const size_t records_bytes = static_cast<size_t>(header.record_count) * record_size;
+    if (payload - records_bytes != header.string_bytes) {
+        return false;
+    }
+    strings = std::string_view(reinterpret_cast<const char*>(file.data()) + header_size + records_bytes,
+                               static_cast<size_t>(header.string_bytes));
+    return true;
+}
 
-    std::string path;
-    int trim_flag = 0;
-    ImageCacheEntry entry;
-    while (true) {
-        entry = ImageCacheEntry{};
-        if (!(in >> std::quoted(path)
-                 >> trim_flag
-                 >> entry.file_size
-                 >> entry.mtime_ticks
-                 >> entry.w
-                 >> entry.h
-                 >> entry.trim_left
-                 >> entry.trim_top
-                 >> entry.trim_right
-                 >> entry.trim_bottom)) {
-            break;
-        }
-        if (version >= 2) {
-            if (!(in >> entry.cached_at_unix)) {
-                break;
+bool binary_cache_string(std::string_view strings, uint32_t offset, uint32_t size, std::string_view& out) {
+    if (offset > strings.size() || strings.size() - offset < size) {
+        return false;
+    }
+    out = strings.substr(offset, size);
+    return true;
+}
+
+// Interns strings for a binary cache string table. The table keeps views of
+// the interned values, so they must outlive it.
+class CacheStringTable {
+public:
+    bool intern(std::string_view value, uint32_t& offset) {
+        auto it = offsets_.find(value);
+        if (it != offsets_.end()) {
+            offset = it->second;
+            return true;
+        }
+        if (value.size() > std::numeric_limits<uint32_t>::max() - bytes_.size()) {
+            return false;
+        }
+        offset = static_cast<uint32_t>(bytes_.size());
+        bytes_ += value;
+        offsets_.emplace(value, offset);
+        return true;
+    }
+
+    const std::string& bytes() const { return bytes_; }
+
+private:
+    std::string bytes_;
+    std::unordered_map<std::string_view, uint32_t> offsets_;
+};
+
+bool write_cache_file(const fs::path& cache_path, const std::string& bytes) {
+    const fs::path tmp = sprat::core::unique_temp_path(cache_path);
+
+    std::error_code ec;
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        out.close();
+        if (!out) {
+            fs::remove(tmp, ec);
+            return false;
+        }
+    }
+
+    fs::rename(tmp, cache_path, ec);
+    if (ec) {
+        fs::remove(cache_path, ec);
+        ec.clear();
+        fs::rename(tmp, cache_path, ec);
+        if (ec) {
+            fs::remove(tmp, ec);
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t image_cache_key_hash(std::string_view path, bool trim_transparent) {
+    const uint64_t hash = sprat::core::fnv1a_hash(reinterpret_cast<const unsigned char*>(path.data()), path.size());
+    return trim_transparent ? hash ^ 0x9E3779B97F4A7C15ULL : hash;
+}
+
+ImageCacheEntry image_cache_entry_from_record(const BinaryImageCacheRecord& record) {
+    ImageCacheEntry entry;
+    entry.trim_transparent = record.trim_transparent != 0;
+    entry.file_size = record.file_size;
+    entry.mtime_ticks = record.mtime_ticks;
+    entry.w = record.w;
+    entry.h = record.h;
+    entry.trim_left = record.trim_left;
+    entry.trim_top = record.trim_top;
+    entry.trim_right = record.trim_right;
+    entry.trim_bottom = record.trim_bottom;
+    entry.cached_at_unix = record.cached_at_unix;
+    entry.content_hash = record.content_hash;
+    entry.perceptual_hash = record.perceptual_hash;
+    return entry;
+}
+
+// Read-only view of a binary image cache file. Lookups go through the on-disk
+// hash index and compare paths in the mapped string table, so a warm run reads
+// only the records of the files it scans and allocates nothing per record.
+class MappedImageCache {
+public:
+    bool open(const fs::path& cache_path) {
+        close();
+        if (!file_.open(cache_path) || !has_binary_cache_magic(file_, k_binary_image_cache_magic)) {
+            close();
+            return false;
+        }
+        BinaryImageCacheHeader header;
+        if (!read_binary_value(file_, 0, header) ||
+            header.bucket_count > (file_.size() / sizeof(uint32_t)) ||
+            (header.bucket_count & (header.bucket_count - 1)) != 0 ||
+            header.base.record_count >= std::numeric_limits<uint32_t>::max() ||
+            header.base.record_count > header.bucket_count) {
+            close();
+            return false;
+        }
+        const size_t buckets_offset = sizeof(BinaryImageCacheHeader);
+        const size_t records_offset = buckets_offset + static_cast<size_t>(header.bucket_count) * sizeof(uint32_t);
+        if (!locate_binary_cache_strings(file_, header.base, k_binary_image_cache_magic,
+                                         k_binary_image_cache_format_version, records_offset,
+                                         sizeof(BinaryImageCacheRecord), strings_)) {
+            close();
+            return false;
+        }
+        buckets_offset_ = buckets_offset;
+        records_offset_ = records_offset;
+        bucket_count_ = static_cast<size_t>(header.bucket_count);
+        record_count_ = static_cast<size_t>(header.base.record_count);
+        return true;
+    }
+
+    void close() {
+        file_.close();
+        strings_ = {};
+        bucket_count_ = 0;
+        record_count_ = 0;
+    }
+
+    size_t size() const { return record_count_; }
+
+    // Copies out record `index`; false when its path lies outside the string table.
+    bool record(size_t index, std::string_view& path, ImageCacheEntry& entry) const {
+        BinaryImageCacheRecord record;
+        if (index >= record_count_ ||
+            !read_binary_value(file_, records_offset_ + index * sizeof(BinaryImageCacheRecord), record) ||
+            !binary_cache_string(strings_, record.path_offset, record.path_size, path)) {
+            return false;
+        }
+        entry = image_cache_entry_from_record(record);
+        return true;
+    }
+
+    bool find(std::string_view path, bool trim_transparent, ImageCacheEntry& out) const {
+        if (bucket_count_ == 0) {
+            return false;
+        }
+        const size_t mask = bucket_count_ - 1;
+        size_t bucket = static_cast<size_t>(image_cache_key_hash(path, trim_transparent)) & mask;
+        for (size_t probe = 0; probe < bucket_count_; ++probe, bucket = (bucket + 1) & mask) {
+            uint32_t slot = 0;
+            read_binary_value(file_, buckets_offset_ + bucket * sizeof(uint32_t), slot);
+            if (slot == 0) {
+                return false;
+            }
+            std::string_view record_path;
+            ImageCacheEntry entry;
+            if (record(slot - 1, record_path, entry) &&
+                entry.trim_transparent == trim_transparent && record_path == path) {
+                out = entry;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    sprat::core::MappedFile file_;
+    std::string_view strings_;
+    size_t buckets_offset_ = 0;
+    size_t records_offset_ = 0;
+    size_t bucket_count_ = 0;
+    size_t record_count_ = 0;
+};
+
+bool parse_text_image_cache(const fs::path& cache_path,
+                            std::unordered_map<std::string, ImageCacheEntry>& out) {
+    std::ifstream in(cache_path);
+    if (!in) {
+        return false;
+    }
+
+    std::string header_tag;
+    int version = 0;
+    if (!(in >> header_tag >> version)) {
+        return false;
+    }
+    if (header_tag != "spratlayout_cache" || (version != 1 && version != 2 && version != 3)) {
+        return false;
+    }
+
+    std::string path;
+    int trim_flag = 0;
+    ImageCacheEntry entry;
+    while (true) {
+        entry = ImageCacheEntry{};
+        if (!(in >> std::quoted(path)
+                 >> trim_flag
+                 >> entry.file_size
+                 >> entry.mtime_ticks
+                 >> entry.w
+                 >> entry.h
+                 >> entry.trim_left
+                 >> entry.trim_top
+                 >> entry.trim_right
+                 >> entry.trim_bottom)) {
+            break;
+        }
+        if (version >= 2) {
+            if (!(in >> entry.cached_at_unix)) {
+                break;
             }
         }
         if (version >= 3) {
             if (!(in >> entry.content_hash >> entry.perceptual_hash)) {
                 break;
             }
+            // Text caches hold FNV-1a content hashes; recompute them as XXH64.
+            entry.content_hash = 0;
         }
         if (entry.w <= 0 || entry.h <= 0 || entry.w > k_max_image_dimension || entry.h > k_max_image_dimension) {
             continue;
@@ -1360,114 +1687,161 @@ bool load_image_cache(const fs::path& cache_path,
             break;
         }
     }
-
     return true;
 }
 
-bool save_image_cache(const fs::path& cache_path,
-                      const std::unordered_map<std::string, ImageCacheEntry>& entries) {
-    fs::path tmp = cache_path;
-    tmp += ".tmp";
+// Binary caches stay on disk and are read through `mapped`; `out` receives
+// warm --serve entries or a legacy text cache, which take precedence.
+bool load_image_cache(const fs::path& cache_path,
+                      std::unordered_map<std::string, ImageCacheEntry>& out,
+                      MappedImageCache& mapped) {
+    out.clear();
+    mapped.close();
+    WarmCaches& warm = warm_caches();
+    if (warm.enabled) {
+        if (const auto* warm_entries = warm.image_caches.find(cache_path.string())) {
+            out = *warm_entries;
+            return true;
+        }
+    }
 
-    std::ofstream out(tmp, std::ios::trunc);
-    if (!out) {
+    if (mapped.open(cache_path)) {
+        return true;
+    }
+    // Caches written before the binary format are still read once and then
+    // rewritten in binary form by save_image_cache.
+    if (!parse_text_image_cache(cache_path, out)) {
+        out.clear();
         return false;
     }
+    return true;
+}
 
+// Writes `entries` plus the still-fresh records of `mapped` that `entries`
+// does not replace, then closes `mapped` so the file can be replaced.
+bool save_image_cache(const fs::path& cache_path,
+                      const std::unordered_map<std::string, ImageCacheEntry>& entries,
+                      MappedImageCache& mapped,
+                      long long now_unix) {
+    auto is_valid = [](const ImageCacheEntry& e) {
+        return e.w > 0 && e.h > 0 && e.w <= k_max_image_dimension && e.h <= k_max_image_dimension;
+    };
     // Collect valid entries; if over the limit, keep only the most recently used.
-    using KV = std::pair<const std::string*, const ImageCacheEntry*>;
+    // Paths are views into `entries` keys (without the "|0"/"|1" suffix) or into
+    // the mapped string table, both of which outlive this function's use of them.
+    using KV = std::pair<std::string_view, ImageCacheEntry>;
     std::vector<KV> valid;
-    valid.reserve(entries.size());
-    for (const auto& kv : entries) {
-        const ImageCacheEntry& e = kv.second;
-        if (e.w > 0 && e.h > 0 && e.w <= k_max_image_dimension && e.h <= k_max_image_dimension) {
-            valid.push_back({&kv.first, &e});
+    valid.reserve(entries.size() + mapped.size());
+    for (const auto& [key, e] : entries) {
+        if (!is_valid(e)) {
+            continue;
+        }
+        std::string_view path = key;
+        if (path.size() > 2 &&
+            path[path.size() - 2] == '|' &&
+            (path.back() == '0' || path.back() == '1')) {
+            path.remove_suffix(2);
+        }
+        valid.emplace_back(path, e);
+    }
+    std::string key;
+    for (size_t i = 0; i < mapped.size(); ++i) {
+        std::string_view path;
+        ImageCacheEntry e;
+        if (!mapped.record(i, path, e) || !is_valid(e) ||
+            is_stale_cache_entry(e, now_unix, k_cache_max_age_seconds)) {
+            continue;
+        }
+        key.assign(path);
+        key.append(e.trim_transparent ? "|1" : "|0");
+        if (entries.find(key) == entries.end()) {
+            valid.emplace_back(path, e);
         }
     }
     if (valid.size() > k_max_cache_entries) {
         std::ranges::sort(valid, [](const KV& a, const KV& b) {
-            return a.second->cached_at_unix > b.second->cached_at_unix; // newest first
+            return a.second.cached_at_unix > b.second.cached_at_unix; // newest first
         });
         valid.resize(k_max_cache_entries);
     }
 
-    out << "spratlayout_cache 3\n";
-    for (const auto& [key_ptr, e_ptr] : valid) {
-        std::string path = *key_ptr;
-        if (path.size() > 2 &&
-            path[path.size() - 2] == '|' &&
-            (path.back() == '0' || path.back() == '1')) {
-            path = path.substr(0, path.size() - 2);
-        }
-        const ImageCacheEntry& e = *e_ptr;
-        out << std::quoted(path) << " "
-            << (e.trim_transparent ? 1 : 0) << " "
-            << e.file_size << " "
-            << e.mtime_ticks << " "
-            << e.w << " "
-            << e.h << " "
-            << e.trim_left << " "
-            << e.trim_top << " "
-            << e.trim_right << " "
-            << e.trim_bottom << " "
-            << e.cached_at_unix << " "
-            << e.content_hash << " "
-            << e.perceptual_hash << "\n";
-    }
-    out.close();
-    if (!out) {
-        return false;
-    }
-
-    std::error_code ec;
-    fs::rename(tmp, cache_path, ec);
-    if (ec) {
-        fs::remove(cache_path, ec);
-        ec.clear();
-        fs::rename(tmp, cache_path, ec);
-        if (ec) {
-            fs::remove(tmp, ec);
-            return false;
+    WarmCaches& warm = warm_caches();
+    if (warm.enabled) {
+        std::unordered_map<std::string, ImageCacheEntry> kept;
+        kept.reserve(valid.size());
+        for (const auto& [path, e] : valid) {
+            std::string kept_key(path);
+            kept_key.append(e.trim_transparent ? "|1" : "|0");
+            kept.emplace(std::move(kept_key), e);
         }
-    }
-    return true;
-}
-
-fs::path default_temp_dir() {
-    std::error_code ec;
-    fs::path path = fs::temp_directory_path(ec);
-    if (!ec && !path.empty()) {
-        return path;
+        store_warm_cache(warm.image_caches, cache_path, std::move(kept));
     }
 
-    const char* tmp = std::getenv("TMP");
-    if (tmp != nullptr && *tmp != '\0') {
-        return fs::path(tmp);
-    }
-    const char* temp = std::getenv("TEMP");
-    if (temp != nullptr && *temp != '\0') {
-        return fs::path(temp);
-    }
-    const char* tmpdir = std::getenv("TMPDIR");
-    if (tmpdir != nullptr && *tmpdir != '\0') {
-        return fs::path(tmpdir);
+    size_t bucket_count = 1;
+    while (bucket_count < valid.size() * 2) {
+        bucket_count <<= 1;
     }
+    std::vector<uint32_t> buckets(bucket_count, 0);
+    const size_t mask = bucket_count - 1;
 
-#ifdef _WIN32
-    return fs::path(".");
-#else
-    return fs::path("/tmp");
-#endif
+    CacheStringTable strings;
+    std::string records;
+    records.reserve(valid.size() * sizeof(BinaryImageCacheRecord));
+    for (size_t i = 0; i < valid.size(); ++i) {
+        const auto& [path, e] = valid[i];
+        BinaryImageCacheRecord record;
+        if (!strings.intern(path, record.path_offset)) {
+            return false;
+        }
+        record.path_size = static_cast<uint32_t>(path.size());
+        record.file_size = static_cast<uint64_t>(e.file_size);
+        record.mtime_ticks = e.mtime_ticks;
+        record.cached_at_unix = e.cached_at_unix;
+        record.content_hash = e.content_hash;
+        record.perceptual_hash = e.perceptual_hash;
+        record.w = e.w;
+        record.h = e.h;
+        record.trim_left = e.trim_left;
+        record.trim_top = e.trim_top;
+        record.trim_right = e.trim_right;
+        record.trim_bottom = e.trim_bottom;
+        record.trim_transparent = e.trim_transparent ? 1u : 0u;
+        append_binary_value(records, record);
+
+        size_t bucket = static_cast<size_t>(image_cache_key_hash(path, e.trim_transparent)) & mask;
+        while (buckets[bucket] != 0) {
+            bucket = (bucket + 1) & mask;
+        }
+        buckets[bucket] = static_cast<uint32_t>(i + 1);
+    }
+
+    BinaryImageCacheHeader header;
+    header.base.magic = k_binary_image_cache_magic;
+    header.base.version = k_binary_image_cache_format_version;
+    header.base.byte_order = k_binary_cache_byte_order_mark;
+    header.base.record_count = valid.size();
+    header.base.string_bytes = strings.bytes().size();
+    header.bucket_count = bucket_count;
+
+    std::string bytes;
+    bytes.reserve(sizeof(header) + buckets.size() * sizeof(uint32_t) + records.size() + strings.bytes().size());
+    append_binary_value(bytes, header);
+    bytes.append(reinterpret_cast<const char*>(buckets.data()), buckets.size() * sizeof(uint32_t));
+    bytes += records;
+    bytes += strings.bytes();
+    valid.clear();
+    mapped.close();
+    return write_cache_file(cache_path, bytes);
 }
 
 fs::path cache_root_dir() {
-    fs::path root = default_temp_dir() / "sprat";
+    fs::path root = sprat::core::default_temp_dir() / "sprat";
     std::error_code ec;
     fs::create_directories(root, ec);
     if (!ec) {
         return root;
     }
-    return default_temp_dir();
+    return sprat::core::default_temp_dir();
 }
 
 fs::path build_cache_path(const fs::path& folder) {
@@ -1544,8 +1918,13 @@ void print_usage() {
               << tr("                             stable: deterministic sort by size then path; <metric> is\n")
               << tr("                             area (default), maxside, height, width, or perimeter\n")
               << tr("  --threads N                Number of worker threads\n")
+              << tr("  --trace FILE               Write stage timings and counters as Chrome trace JSON\n")
+              << tr("  --pixel-cache              Store decoded sprite pixels for spratpack --pixel-cache\n")
+              << tr("  --archive-memory MIB       Archive bytes kept in memory before spilling to disk (default: 256)\n")
               << tr("  --debug                    Enable detailed error reporting and debug visualization\n")
               << tr("  --stdin-list               Read image paths from stdin (one per line) instead of <folder>\n")
+              << tr("  --serve                    Answer layout requests from stdin, one argument line per request,\n")
+              << tr("                             keeping image, seed and output caches in memory\n")
               << tr("  Directory inputs honor .spratlayoutignore; list files may use exclude \"path\"\n")
               << tr("  --help, -h                 Show this help message\n")
               << tr("  --version, -v              Show version\n");
@@ -1726,6 +2105,14 @@ std::string build_incremental_seed_signature(
 bool load_output_cache(const fs::path& cache_path,
                        const std::string& expected_signature,
                        std::string& output) {
+    WarmCaches& warm = warm_caches();
+    if (warm.enabled) {
+        const auto* warm_output = warm.output_caches.find(cache_path.string());
+        if (warm_output != nullptr && warm_output->first == expected_signature) {
+            output = warm_output->second;
+            return true;
+        }
+    }
     std::ifstream in(cache_path, std::ios::binary);
     if (!in) {
         return false;
@@ -1748,14 +2135,21 @@ bool load_output_cache(const fs::path& cache_path,
         return false;
     }
     output = buffer.str();
+    if (warm.enabled) {
+        store_warm_cache(warm.output_caches, cache_path, std::make_pair(signature, output));
+    }
     return true;
 }
 
 bool save_output_cache(const fs::path& cache_path,
                        const std::string& signature,
                        const std::string& output) {
-    fs::path tmp = cache_path;
-    tmp += ".tmp";
+    WarmCaches& warm = warm_caches();
+    if (warm.enabled) {
+        store_warm_cache(warm.output_caches, cache_path, std::make_pair(signature, output));
+    }
+
+    const fs::path tmp = sprat::core::unique_temp_path(cache_path);
 
     std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
     if (!out) {
@@ -1783,10 +2177,59 @@ bool save_output_cache(const fs::path& cache_path,
     return true;
 }
 
-bool load_layout_seed_cache(const fs::path& cache_path,
-                            const std::string& expected_signature,
-                            LayoutSeedCache& out) {
-    out = LayoutSeedCache{};
+bool parse_binary_layout_seed_cache(const sprat::core::MappedFile& file,
+                                    const std::string& expected_signature,
+                                    LayoutSeedCache& out) {
+    BinarySeedCacheHeader header;
+    std::string_view strings;
+    if (!read_binary_value(file, 0, header) ||
+        !locate_binary_cache_strings(file, header.base, k_binary_seed_cache_magic,
+                                     k_binary_seed_cache_format_version, sizeof(BinarySeedCacheHeader),
+                                     sizeof(BinarySeedCacheRecord), strings)) {
+        return false;
+    }
+
+    std::string_view signature;
+    if (!binary_cache_string(strings, 0, header.signature_size, signature) ||
+        signature != expected_signature) {
+        return false;
+    }
+    if (header.base.record_count == 0 || header.atlas_width <= 0 || header.atlas_height <= 0) {
+        return false;
+    }
+    out.signature = expected_signature;
+    out.padding = header.padding;
+    out.atlas_width = header.atlas_width;
+    out.atlas_height = header.atlas_height;
+
+    const size_t count = static_cast<size_t>(header.base.record_count);
+    out.entries.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        BinarySeedCacheRecord record;
+        read_binary_value(file, sizeof(BinarySeedCacheHeader) + i * sizeof(BinarySeedCacheRecord), record);
+        std::string_view path;
+        if (!binary_cache_string(strings, record.path_offset, record.path_size, path)) {
+            return false;
+        }
+        LayoutSeedEntry entry;
+        entry.path.assign(path);
+        entry.x = record.x;
+        entry.y = record.y;
+        entry.w = record.w;
+        entry.h = record.h;
+        entry.trim_left = record.trim_left;
+        entry.trim_top = record.trim_top;
+        entry.trim_right = record.trim_right;
+        entry.trim_bottom = record.trim_bottom;
+        entry.rotated = record.rotated != 0;
+        out.entries.push_back(std::move(entry));
+    }
+    return true;
+}
+
+bool parse_text_layout_seed_cache(const fs::path& cache_path,
+                                  const std::string& expected_signature,
+                                  LayoutSeedCache& out) {
     std::ifstream in(cache_path);
     if (!in) {
         return false;
@@ -1833,7 +2276,38 @@ bool load_layout_seed_cache(const fs::path& cache_path,
         }
         out.entries.push_back(std::move(entry));
     }
+    return true;
+}
+
+bool load_layout_seed_cache(const fs::path& cache_path,
+                            const std::string& expected_signature,
+                            LayoutSeedCache& out) {
+    out = LayoutSeedCache{};
+    WarmCaches& warm = warm_caches();
+    if (warm.enabled) {
+        const auto* warm_seed = warm.seed_caches.find(cache_path.string());
+        if (warm_seed != nullptr && warm_seed->signature == expected_signature) {
+            out = *warm_seed;
+            return true;
+        }
+    }
+
+    sprat::core::MappedFile file;
+    if (!file.open(cache_path)) {
+        return false;
+    }
+    const bool loaded = has_binary_cache_magic(file, k_binary_seed_cache_magic)
+        ? parse_binary_layout_seed_cache(file, expected_signature, out)
+        : parse_text_layout_seed_cache(cache_path, expected_signature, out);
+    file.close();
+    if (!loaded) {
+        out = LayoutSeedCache{};
+        return false;
+    }
 
+    if (warm.enabled) {
+        store_warm_cache(warm.seed_caches, cache_path, out);
+    }
     return true;
 }
 
@@ -1844,49 +2318,53 @@ bool save_layout_seed_cache(const fs::path& cache_path,
         return false;
     }
 
-    fs::path tmp = cache_path;
-    tmp += ".tmp";
-
-    std::ofstream out(tmp, std::ios::trunc);
-    if (!out) {
-        return false;
+    WarmCaches& warm = warm_caches();
+    if (warm.enabled) {
+        store_warm_cache(warm.seed_caches, cache_path, seed);
     }
 
-    out << "spratlayout_seed_cache " << k_seed_cache_format_version << "\n";
-    out << seed.signature << "\n";
-    out << seed.padding << " "
-        << seed.atlas_width << " "
-        << seed.atlas_height << " "
-        << seed.entries.size() << "\n";
-    for (const auto& entry : seed.entries) {
-        out << std::quoted(entry.path) << " "
-            << entry.x << " "
-            << entry.y << " "
-            << entry.w << " "
-            << entry.h << " "
-            << entry.trim_left << " "
-            << entry.trim_top << " "
-            << entry.trim_right << " "
-            << entry.trim_bottom << " "
-            << (entry.rotated ? 1 : 0) << "\n";
-    }
-    out.close();
-    if (!out) {
+    CacheStringTable strings;
+    uint32_t signature_offset = 0;
+    if (!strings.intern(seed.signature, signature_offset)) {
         return false;
     }
-
-    std::error_code ec;
-    fs::rename(tmp, cache_path, ec);
-    if (ec) {
-        fs::remove(cache_path, ec);
-        ec.clear();
-        fs::rename(tmp, cache_path, ec);
-        if (ec) {
-            fs::remove(tmp, ec);
+    std::string records;
+    records.reserve(seed.entries.size() * sizeof(BinarySeedCacheRecord));
+    for (const auto& entry : seed.entries) {
+        BinarySeedCacheRecord record;
+        if (!strings.intern(entry.path, record.path_offset)) {
             return false;
         }
-    }
-    return true;
+        record.path_size = static_cast<uint32_t>(entry.path.size());
+        record.x = entry.x;
+        record.y = entry.y;
+        record.w = entry.w;
+        record.h = entry.h;
+        record.trim_left = entry.trim_left;
+        record.trim_top = entry.trim_top;
+        record.trim_right = entry.trim_right;
+        record.trim_bottom = entry.trim_bottom;
+        record.rotated = entry.rotated ? 1u : 0u;
+        append_binary_value(records, record);
+    }
+
+    BinarySeedCacheHeader header;
+    header.base.magic = k_binary_seed_cache_magic;
+    header.base.version = k_binary_seed_cache_format_version;
+    header.base.byte_order = k_binary_cache_byte_order_mark;
+    header.base.record_count = seed.entries.size();
+    header.base.string_bytes = strings.bytes().size();
+    header.signature_size = static_cast<uint32_t>(seed.signature.size());
+    header.padding = seed.padding;
+    header.atlas_width = seed.atlas_width;
+    header.atlas_height = seed.atlas_height;
+
+    std::string bytes;
+    bytes.reserve(sizeof(header) + records.size() + strings.bytes().size());
+    append_binary_value(bytes, header);
+    bytes += records;
+    bytes += strings.bytes();
+    return write_cache_file(cache_path, bytes);
 }
 
 void prune_cache_family_group(const fs::path& base_cache_path,
@@ -2025,7 +2503,7 @@ void prune_all_spratlayout_cache_families(long long max_age_seconds,
 }
 
 void remove_legacy_top_level_cache_files() {
-    const fs::path parent = default_temp_dir();
+    const fs::path parent = sprat::core::default_temp_dir();
     const fs::path active_root = cache_root_dir();
     if (parent == active_root) {
         return;
@@ -2167,31 +2645,43 @@ bool try_apply_layout_seed(const LayoutSeedCache& seed,
     return true;
 }
 
-std::string build_layout_output_text(const std::vector<Atlas>& atlases,
-                                     double scale,
-                                     int extrude,
-                                     bool trim_transparent,
-                                     bool multipack,
-                                     const std::vector<Sprite>& sprites,
-                                     const std::vector<std::pair<std::string, std::string>>& aliases,
-                                     bool debug,
-                                     const fs::path& root) {
+// Scale as written on the layout's scale line; the in-memory layout carries
+// the same rounded value, so tools reading either see one scale.
+std::string format_layout_scale(double scale) {
     std::ostringstream output;
-    if (debug) {
-        output << "# Sprat Layout Debug Info\n";
-        output << "# Scale: " << scale << "\n";
-        output << "# Atlases: " << atlases.size() << "\n";
-        output << "# Total Sprites: " << sprites.size() << "\n";
-        output << "# Aliases: " << aliases.size() << "\n";
-        output << "# Multipack: " << (multipack ? "true" : "false") << "\n";
-    }
-    output << "root " << to_quoted(root.string()) << "\n";
-    output << "scale " << std::setprecision(k_output_precision) << scale << "\n";
-    if (extrude > 0) {
-        output << "extrude " << extrude << "\n";
-    }
-    if (multipack) {
-        output << "multipack true\n";
+    output << std::setprecision(k_output_precision) << scale;
+    return output.str();
+}
+
+std::string layout_relative_path(const std::string& path, const fs::path& root) {
+    std::string relative = fs::relative(fs::path(path), root).string();
+    // Standardize path separators to forward slashes for output consistency
+    std::replace(relative.begin(), relative.end(), '\\', '/');
+    return relative;
+}
+
+// Builds the layout the text output describes, the way parse_layout would
+// read it back: sprites grouped by atlas, paths relative to `root`.
+sprat::core::Layout build_core_layout(const std::vector<Atlas>& atlases,
+                                      double scale,
+                                      int extrude,
+                                      bool trim_transparent,
+                                      bool multipack,
+                                      const std::vector<Sprite>& sprites,
+                                      const std::vector<std::pair<std::string, std::string>>& aliases,
+                                      const fs::path& root) {
+    sprat::core::Layout layout;
+    layout.root = root.string();
+    layout.has_root = true;
+    layout.scale = std::strtod(format_layout_scale(scale).c_str(), nullptr);
+    layout.has_scale = true;
+    layout.extrude = extrude;
+    layout.has_extrude = extrude > 0;
+    layout.multipack = multipack;
+    layout.has_multipack = multipack;
+    layout.atlases.reserve(atlases.size());
+    for (const Atlas& atlas : atlases) {
+        layout.atlases.push_back({atlas.width, atlas.height});
     }
     // Pre-group sprite indices by atlas_index to avoid O(sprites * atlases) scan.
     std::vector<std::vector<size_t>> sprites_by_atlas(atlases.size());
@@ -2201,20 +2691,64 @@ std::string build_layout_output_text(const std::vector<Atlas>& atlases,
             sprites_by_atlas[static_cast<size_t>(ai)].push_back(si);
         }
     }
+    layout.sprites.reserve(sprites.size());
     for (size_t i = 0; i < atlases.size(); ++i) {
-        output << "atlas " << atlases[i].width << "," << atlases[i].height << "\n";
         for (size_t si : sprites_by_atlas[i]) {
             const auto& s = sprites[si];
-            fs::path sprite_path(s.path);
-            fs::path relative_path = fs::relative(sprite_path, root);
-            std::string path = relative_path.string();
-            // Standardize path separators to forward slashes for output consistency
-            std::replace(path.begin(), path.end(), '\\', '/');
-            output << "sprite " << to_quoted(path) << " "
+            sprat::core::Sprite& out = layout.sprites.emplace_back();
+            out.path = layout_relative_path(s.path, root);
+            out.x = s.x;
+            out.y = s.y;
+            out.w = s.w;
+            out.h = s.h;
+            if (trim_transparent) {
+                out.src_x = s.trim_left;
+                out.src_y = s.trim_top;
+                out.trim_right = s.trim_right;
+                out.trim_bottom = s.trim_bottom;
+                out.has_trim = true;
+            }
+            out.rotated = s.rotated;
+            out.atlas_index = static_cast<int>(i);
+        }
+    }
+    layout.aliases.reserve(aliases.size());
+    for (const auto& alias_pair : aliases) {
+        layout.aliases.emplace_back(layout_relative_path(alias_pair.first, root),
+                                    layout_relative_path(alias_pair.second, root));
+    }
+    return layout;
+}
+
+std::string build_layout_output_text(const sprat::core::Layout& layout, bool debug) {
+    std::ostringstream output;
+    if (debug) {
+        output << "# Sprat Layout Debug Info\n";
+        output << "# Scale: " << layout.scale << "\n";
+        output << "# Atlases: " << layout.atlases.size() << "\n";
+        output << "# Total Sprites: " << layout.sprites.size() << "\n";
+        output << "# Aliases: " << layout.aliases.size() << "\n";
+        output << "# Multipack: " << (layout.multipack ? "true" : "false") << "\n";
+    }
+    output << "root " << to_quoted(layout.root) << "\n";
+    output << "scale " << format_layout_scale(layout.scale) << "\n";
+    if (layout.has_extrude) {
+        output << "extrude " << layout.extrude << "\n";
+    }
+    if (layout.multipack) {
+        output << "multipack true\n";
+    }
+    size_t next_sprite = 0;
+    for (size_t i = 0; i < layout.atlases.size(); ++i) {
+        output << "atlas " << layout.atlases[i].width << "," << layout.atlases[i].height << "\n";
+        for (; next_sprite < layout.sprites.size() &&
+               layout.sprites[next_sprite].atlas_index == static_cast<int>(i); ++next_sprite) {
+            const auto& s = layout.sprites[next_sprite];
+            output << "sprite " << to_quoted(s.path) << " "
                    << s.x << "," << s.y << " "
                    << s.w << "," << s.h;
-            if (trim_transparent) {
-                output << " " << s.trim_left << "," << s.trim_top
+            if (s.has_trim) {
+                output << " " << s.src_x << "," << s.src_y
                        << " " << s.trim_right << "," << s.trim_bottom;
             }
             if (s.rotated) {
@@ -2223,18 +2757,8 @@ std::string build_layout_output_text(const std::vector<Atlas>& atlases,
             output << "\n";
         }
     }
-    for (const auto& alias_pair : aliases) {
-        fs::path alias_fs_path(alias_pair.first);
-        fs::path relative_alias_path = fs::relative(alias_fs_path, root);
-        std::string alias_str = relative_alias_path.string();
-        std::replace(alias_str.begin(), alias_str.end(), '\\', '/');
-
-        fs::path canonical_fs_path(alias_pair.second);
-        fs::path relative_canonical_path = fs::relative(canonical_fs_path, root);
-        std::string canonical_str = relative_canonical_path.string();
-        std::replace(canonical_str.begin(), canonical_str.end(), '\\', '/');
-
-        output << "alias " << to_quoted(alias_str) << " " << to_quoted(canonical_str) << "\n";
+    for (const auto& alias_pair : layout.aliases) {
+        output << "alias " << to_quoted(alias_pair.first) << " " << to_quoted(alias_pair.second) << "\n";
     }
     return output.str();
 }
@@ -2512,89 +3036,545 @@ bool rect_contains(const Rect& a, const Rect& b) {
            b.y + b.h <= a.y + a.h;
 }
 
-void append_pruned_free_rect(std::vector<Rect>& out, const Rect& candidate) {
-    if (candidate.w <= 0 || candidate.h <= 0) {
-        return;
+// MaxRects free-rectangle set. Rectangles live in stable slots indexed two ways:
+// by size class (floor(log2) of width and height), so best-fit queries only visit
+// rectangles large enough for the item, and by a coarse uniform grid, so a placement
+// only splits and prunes the rectangles around the used area. Each slot also carries
+// an order label matching the position the rectangle would hold in a flat MaxRects
+// list, which keeps heuristic tie-breaks (and therefore layouts) deterministic.
+class FreeRectIndex {
+public:
+    FreeRectIndex(int width, int height, int cell_hint) {
+        cell_size_ = std::max(1, cell_hint);
+        auto cells_along = [&](int extent) {
+            return std::max(1LL, (static_cast<long long>(extent) + cell_size_ - 1) / cell_size_);
+        };
+        while (static_cast<size_t>(cells_along(width)) > k_free_rect_grid_max_cells) {
+            cell_size_ *= 2;
+        }
+        cols_ = static_cast<int>(cells_along(width));
+        // Rows past the budget fold into the last row; packing rarely reaches that deep.
+        const long long max_rows = static_cast<long long>(k_free_rect_grid_max_cells / static_cast<size_t>(cols_));
+        rows_ = static_cast<int>(std::min(cells_along(height), std::max(1LL, max_rows)));
+        cells_.resize(static_cast<size_t>(cols_) * static_cast<size_t>(rows_));
+
+        const std::uint32_t root = allocate_slot({0, 0, width, height});
+        slots_[root].label = std::numeric_limits<std::uint64_t>::max() / 2;
+        head_ = root;
+        linked_count_ = 1;
+        peak_count_ = 1;
+        index_slot(root);
+    }
+
+    ~FreeRectIndex() {
+        sprat::core::profile_count("maxrects.runs");
+        sprat::core::profile_peak("maxrects.free_rects_peak", static_cast<int64_t>(peak_count_));
+    }
+    FreeRectIndex(const FreeRectIndex&) = delete;
+    FreeRectIndex& operator=(const FreeRectIndex&) = delete;
+
+    // Picks the free rectangle for a w x h item (and for its h x w rotation when
+    // try_rotated is set) by heuristic score, breaking ties by y, x and list order.
+    bool find_best(int w, int h, bool try_rotated, RectHeuristic heuristic, Rect& out_rect, bool& out_rotated) const {
+        FitKey best;
+        std::uint32_t best_slot = k_no_slot;
+        scan_fits(w, h, false, heuristic, best, best_slot);
+        if (try_rotated) {
+            scan_fits(h, w, true, heuristic, best, best_slot);
+        }
+        if (best_slot == k_no_slot) {
+            return false;
+        }
+        out_rect = slots_[best_slot].rect;
+        out_rotated = best.rotated;
+        return true;
     }
 
-    for (const Rect& existing : out) {
-        if (rect_contains(existing, candidate)) {
+    // Splits every free rectangle overlapping used and drops the pieces that are
+    // contained in another free rectangle.
+    void place(const Rect& used) {
+        collect_overlapping(used, hits_);
+        if (hits_.empty()) {
             return;
         }
-    }
+        std::ranges::sort(hits_, [&](std::uint32_t a, std::uint32_t b) {
+            return slots_[a].label < slots_[b].label;
+        });
 
-    size_t write = 0;
-    for (size_t i = 0; i < out.size(); ++i) {
-        if (!rect_contains(candidate, out[i])) {
-            if (write != i) {
-                out[write] = out[i];
-            }
-            ++write;
+        pieces_.clear();
+        for (std::uint32_t hit : hits_) {
+            append_split_pieces(slots_[hit].rect, used, hit);
+            unindex_slot(hit);
         }
-    }
-    out.resize(write);
-    out.push_back(candidate);
-}
 
-bool split_free_rect(const Rect& free_rect, const Rect& used_rect, std::vector<Rect>& out) {
-    if (!rects_intersect(free_rect, used_rect)) {
-        append_pruned_free_rect(out, free_rect);
-        return true;
+        // Rectangles untouched by the placement are never dominated by a piece (pieces
+        // are subsets of former free rectangles), so only pieces need pruning.
+        for (Piece& piece : pieces_) {
+            collect_overlapping(piece.rect, neighbors_);
+            for (std::uint32_t neighbor : neighbors_) {
+                if (rect_contains(slots_[neighbor].rect, piece.rect)) {
+                    piece.keep = false;
+                    break;
+                }
+            }
+        }
+        for (size_t i = 0; i < pieces_.size(); ++i) {
+            if (!pieces_[i].keep) {
+                continue;
+            }
+            for (size_t j = 0; j < pieces_.size(); ++j) {
+                if (i == j || !rect_contains(pieces_[j].rect, pieces_[i].rect)) {
+                    continue;
+                }
+                if (j < i || !rect_equals(pieces_[i].rect, pieces_[j].rect)) {
+                    pieces_[i].keep = false;
+                    break;
+                }
+            }
+        }
+
+        size_t piece_index = 0;
+        for (std::uint32_t hit : hits_) {
+            const size_t group_begin = piece_index;
+            size_t kept = 0;
+            while (piece_index < pieces_.size() && pieces_[piece_index].parent == hit) {
+                if (pieces_[piece_index].keep) {
+                    ++kept;
+                }
+                ++piece_index;
+            }
+            if (kept > 0) {
+                if (label_gap_after(hit) < kept) {
+                    relabel();
+                }
+                const std::uint64_t step = label_gap_after(hit) / kept;
+                std::uint64_t label = slots_[hit].label;
+                std::uint32_t insert_after = hit;
+                for (size_t i = group_begin; i < piece_index; ++i) {
+                    if (!pieces_[i].keep) {
+                        continue;
+                    }
+                    const std::uint32_t slot = allocate_slot(pieces_[i].rect);
+                    slots_[slot].label = label;
+                    label += step;
+                    link_after(insert_after, slot);
+                    insert_after = slot;
+                    index_slot(slot);
+                }
+            }
+            unlink(hit);
+            release_slot(hit);
+        }
+    }
+
+private:
+    static constexpr std::uint32_t k_no_slot = std::numeric_limits<std::uint32_t>::max();
+
+    struct Slot {
+        Rect rect;
+        std::uint64_t label = 0;
+        std::uint32_t prev = k_no_slot;
+        std::uint32_t next = k_no_slot;
+        std::uint32_t size_class = 0;
+        std::uint32_t class_pos = 0;
+        std::uint32_t large_pos = k_no_slot;
+    };
+
+    struct Piece {
+        Rect rect;
+        std::uint32_t parent = k_no_slot;
+        bool keep = true;
+    };
+
+    struct FitKey {
+        std::array<long long, 4> score = {};
+        std::uint64_t label = 0;
+        bool rotated = false;
+
+        auto operator<=>(const FitKey&) const = default;
+    };
+
+    static bool rect_equals(const Rect& a, const Rect& b) {
+        return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+    }
+
+    static int size_class(int value) {
+        return std::min(k_free_rect_size_class_count - 1,
+                        static_cast<int>(std::bit_width(static_cast<unsigned int>(std::max(1, value)))) - 1);
+    }
+
+    void scan_fits(int cand_w, int cand_h, bool rotated, RectHeuristic heuristic,
+                   FitKey& best, std::uint32_t& best_slot) const {
+        const int min_w_class = size_class(cand_w);
+        const int min_h_class = size_class(cand_h);
+        for (int w_class = min_w_class; w_class < k_free_rect_size_class_count; ++w_class) {
+            std::uint32_t mask = class_mask_[static_cast<size_t>(w_class)] & (~0u << min_h_class);
+            while (mask != 0) {
+                const int h_class = std::countr_zero(mask);
+                mask &= mask - 1;
+                if (best_slot != k_no_slot && heuristic != RectHeuristic::BottomLeft) {
+                    // Size classes bound the leftover from below; skip buckets that cannot
+                    // reach the current best primary score.
+                    const long long leftover_w = std::max(0LL, (1LL << w_class) - cand_w);
+                    const long long leftover_h = std::max(0LL, (1LL << h_class) - cand_h);
+                    const long long bound = heuristic == RectHeuristic::BestShortSideFit
+                        ? std::min(leftover_w, leftover_h)
+                        : leftover_w * leftover_h;
+                    if (bound > best.score[0]) {
+                        continue;
+                    }
+                }
+                const auto& bucket = classes_[static_cast<size_t>(w_class * k_free_rect_size_class_count + h_class)];
+                for (std::uint32_t slot_index : bucket) {
+                    const Slot& slot = slots_[slot_index];
+                    const Rect& fr = slot.rect;
+                    if (cand_w > fr.w || cand_h > fr.h) {
+                        continue;
+                    }
+                    const long long leftover_h = fr.h - cand_h;
+                    const long long leftover_w = fr.w - cand_w;
+                    const long long short_fit = std::min(leftover_h, leftover_w);
+                    const long long long_fit = std::max(leftover_h, leftover_w);
+                    FitKey key{.score = {}, .label = slot.label, .rotated = rotated};
+                    switch (heuristic) {
+                        case RectHeuristic::BestShortSideFit:
+                            key.score = {short_fit, long_fit, fr.y, fr.x};
+                            break;
+                        case RectHeuristic::BestAreaFit:
+                            key.score = {leftover_h * leftover_w, short_fit, fr.y, fr.x};
+                            break;
+                        case RectHeuristic::BottomLeft:
+                            key.score = {fr.y, fr.x, short_fit, 0};
+                            break;
+                    }
+                    if (best_slot == k_no_slot || key < best) {
+                        best = key;
+                        best_slot = slot_index;
+                    }
+                }
+            }
+        }
+    }
+
+    void append_split_pieces(const Rect& free_rect, const Rect& used_rect, std::uint32_t parent) {
+        const int free_right = free_rect.x + free_rect.w;
+        const int free_bottom = free_rect.y + free_rect.h;
+        const int used_right = used_rect.x + used_rect.w;
+        const int used_bottom = used_rect.y + used_rect.h;
+        const int x0 = std::max(free_rect.x, used_rect.x);
+        const int x1 = std::min(free_right, used_right);
+
+        if (used_rect.x > free_rect.x) {
+            pieces_.push_back({.rect = {free_rect.x, free_rect.y, used_rect.x - free_rect.x, free_rect.h}, .parent = parent});
+        }
+        if (used_right < free_right) {
+            pieces_.push_back({.rect = {used_right, free_rect.y, free_right - used_right, free_rect.h}, .parent = parent});
+        }
+        if (used_rect.y > free_rect.y && x1 > x0) {
+            pieces_.push_back({.rect = {x0, free_rect.y, x1 - x0, used_rect.y - free_rect.y}, .parent = parent});
+        }
+        if (used_bottom < free_bottom && x1 > x0) {
+            pieces_.push_back({.rect = {x0, used_bottom, x1 - x0, free_bottom - used_bottom}, .parent = parent});
+        }
+    }
+
+    int cell_x(int x) const {
+        return std::min(x / cell_size_, cols_ - 1);
+    }
+
+    int cell_y(int y) const {
+        return std::min(y / cell_size_, rows_ - 1);
+    }
+
+    void collect_overlapping(const Rect& area, std::vector<std::uint32_t>& out) {
+        out.clear();
+        if (++stamp_ == 0) {
+            std::ranges::fill(seen_, 0u);
+            stamp_ = 1;
+        }
+        auto visit = [&](std::uint32_t slot) {
+            if (seen_[slot] == stamp_) {
+                return;
+            }
+            seen_[slot] = stamp_;
+            if (rects_intersect(slots_[slot].rect, area)) {
+                out.push_back(slot);
+            }
+        };
+        const int cx1 = cell_x(area.x + area.w - 1);
+        const int cy1 = cell_y(area.y + area.h - 1);
+        for (int cy = cell_y(area.y); cy <= cy1; ++cy) {
+            for (int cx = cell_x(area.x); cx <= cx1; ++cx) {
+                for (std::uint32_t slot : cells_[static_cast<size_t>(cy) * static_cast<size_t>(cols_) + static_cast<size_t>(cx)]) {
+                    visit(slot);
+                }
+            }
+        }
+        for (std::uint32_t slot : large_) {
+            visit(slot);
+        }
     }
 
-    int free_right = free_rect.x + free_rect.w;
-    int free_bottom = free_rect.y + free_rect.h;
-    int used_right = used_rect.x + used_rect.w;
-    int used_bottom = used_rect.y + used_rect.h;
+    std::uint32_t allocate_slot(const Rect& rect) {
+        std::uint32_t slot = 0;
+        if (!free_slots_.empty()) {
+            slot = free_slots_.back();
+            free_slots_.pop_back();
+            slots_[slot] = {};
+        } else {
+            slot = static_cast<std::uint32_t>(slots_.size());
+            slots_.emplace_back();
+            seen_.push_back(0);
+        }
+        slots_[slot].rect = rect;
+        return slot;
+    }
+
+    void release_slot(std::uint32_t slot) {
+        free_slots_.push_back(slot);
+    }
+
+    void index_slot(std::uint32_t slot) {
+        Slot& entry = slots_[slot];
+        const int w_class = size_class(entry.rect.w);
+        const int h_class = size_class(entry.rect.h);
+        entry.size_class = static_cast<std::uint32_t>(w_class * k_free_rect_size_class_count + h_class);
+        auto& bucket = classes_[entry.size_class];
+        entry.class_pos = static_cast<std::uint32_t>(bucket.size());
+        bucket.push_back(slot);
+        class_mask_[static_cast<size_t>(w_class)] |= 1u << h_class;
+
+        const Rect& r = entry.rect;
+        const int cx0 = cell_x(r.x);
+        const int cx1 = cell_x(r.x + r.w - 1);
+        const int cy0 = cell_y(r.y);
+        const int cy1 = cell_y(r.y + r.h - 1);
+        const size_t span = static_cast<size_t>(cx1 - cx0 + 1) * static_cast<size_t>(cy1 - cy0 + 1);
+        if (span > k_free_rect_large_cell_span) {
+            entry.large_pos = static_cast<std::uint32_t>(large_.size());
+            large_.push_back(slot);
+            return;
+        }
+        for (int cy = cy0; cy <= cy1; ++cy) {
+            for (int cx = cx0; cx <= cx1; ++cx) {
+                cells_[static_cast<size_t>(cy) * static_cast<size_t>(cols_) + static_cast<size_t>(cx)].push_back(slot);
+            }
+        }
+    }
+
+    void unindex_slot(std::uint32_t slot) {
+        Slot& entry = slots_[slot];
+        auto& bucket = classes_[entry.size_class];
+        const std::uint32_t moved = bucket.back();
+        bucket[entry.class_pos] = moved;
+        slots_[moved].class_pos = entry.class_pos;
+        bucket.pop_back();
+        if (bucket.empty()) {
+            class_mask_[entry.size_class / k_free_rect_size_class_count] &=
+                ~(1u << (entry.size_class % k_free_rect_size_class_count));
+        }
 
-    if (used_rect.x > free_rect.x) {
-        append_pruned_free_rect(out, {free_rect.x, free_rect.y, used_rect.x - free_rect.x, free_rect.h});
+        if (entry.large_pos != k_no_slot) {
+            const std::uint32_t moved_large = large_.back();
+            large_[entry.large_pos] = moved_large;
+            slots_[moved_large].large_pos = entry.large_pos;
+            large_.pop_back();
+            entry.large_pos = k_no_slot;
+            return;
+        }
+        const Rect& r = entry.rect;
+        const int cx1 = cell_x(r.x + r.w - 1);
+        const int cy1 = cell_y(r.y + r.h - 1);
+        for (int cy = cell_y(r.y); cy <= cy1; ++cy) {
+            for (int cx = cell_x(r.x); cx <= cx1; ++cx) {
+                auto& cell = cells_[static_cast<size_t>(cy) * static_cast<size_t>(cols_) + static_cast<size_t>(cx)];
+                auto it = std::ranges::find(cell, slot);
+                *it = cell.back();
+                cell.pop_back();
+            }
+        }
     }
-    if (used_right < free_right) {
-        append_pruned_free_rect(out, {used_right, free_rect.y, free_right - used_right, free_rect.h});
+
+    std::uint64_t label_gap_after(std::uint32_t slot) const {
+        const Slot& entry = slots_[slot];
+        const std::uint64_t upper = entry.next != k_no_slot
+            ? slots_[entry.next].label
+            : std::numeric_limits<std::uint64_t>::max();
+        return upper - entry.label;
     }
-    if (used_rect.y > free_rect.y) {
-        int x0 = std::max(free_rect.x, used_rect.x);
-        int x1 = std::min(free_right, used_right);
-        if (x1 > x0) {
-            append_pruned_free_rect(out, {x0, free_rect.y, x1 - x0, used_rect.y - free_rect.y});
+
+    void relabel() {
+        const std::uint64_t step = std::numeric_limits<std::uint64_t>::max() / (static_cast<std::uint64_t>(linked_count_) + 1);
+        std::uint64_t label = step;
+        for (std::uint32_t slot = head_; slot != k_no_slot; slot = slots_[slot].next) {
+            slots_[slot].label = label;
+            label += step;
         }
     }
-    if (used_bottom < free_bottom) {
-        int x0 = std::max(free_rect.x, used_rect.x);
-        int x1 = std::min(free_right, used_right);
-        if (x1 > x0) {
-            append_pruned_free_rect(out, {x0, used_bottom, x1 - x0, free_bottom - used_bottom});
+
+    void link_after(std::uint32_t anchor, std::uint32_t slot) {
+        Slot& entry = slots_[slot];
+        entry.prev = anchor;
+        entry.next = slots_[anchor].next;
+        if (entry.next != k_no_slot) {
+            slots_[entry.next].prev = slot;
         }
+        slots_[anchor].next = slot;
+        ++linked_count_;
+        peak_count_ = std::max(peak_count_, linked_count_);
     }
-    return true;
+
+    void unlink(std::uint32_t slot) {
+        Slot& entry = slots_[slot];
+        if (entry.prev != k_no_slot) {
+            slots_[entry.prev].next = entry.next;
+        } else {
+            head_ = entry.next;
+        }
+        if (entry.next != k_no_slot) {
+            slots_[entry.next].prev = entry.prev;
+        }
+        --linked_count_;
+    }
+
+    int cell_size_ = 1;
+    int cols_ = 1;
+    int rows_ = 1;
+    std::vector<Slot> slots_;
+    std::vector<std::uint32_t> free_slots_;
+    std::vector<std::uint32_t> seen_;
+    std::uint32_t stamp_ = 0;
+    std::uint32_t head_ = k_no_slot;
+    size_t linked_count_ = 0;
+    size_t peak_count_ = 0;
+    std::array<std::vector<std::uint32_t>, static_cast<size_t>(k_free_rect_size_class_count) * k_free_rect_size_class_count> classes_;
+    std::array<std::uint32_t, k_free_rect_size_class_count> class_mask_ = {};
+    std::vector<std::vector<std::uint32_t>> cells_;
+    std::vector<std::uint32_t> large_;
+    std::vector<std::uint32_t> hits_;
+    std::vector<std::uint32_t> neighbors_;
+    std::vector<Piece> pieces_;
+};
+
+// Grid cell edge for FreeRectIndex: about two average padded sprite sides, so a
+// placement touches only a handful of cells.
+int free_rect_cell_size(const std::vector<Sprite>& sprites, int padding) {
+    if (sprites.empty()) {
+        return 1;
+    }
+    double total_area = 0.0;
+    for (const auto& s : sprites) {
+        total_area += (static_cast<double>(s.w) + padding) * (static_cast<double>(s.h) + padding);
+    }
+    const double average_side = std::sqrt(total_area / static_cast<double>(sprites.size()));
+    return std::max(1, static_cast<int>(std::lround(average_side * 2.0)));
+}
+
+int free_rect_cell_size(const PackItems& items, int padding) {
+    if (items.size() == 0) {
+        return 1;
+    }
+    double total_area = 0.0;
+    for (size_t i = 0; i < items.size(); ++i) {
+        total_area += (static_cast<double>(items.w[i]) + padding) * (static_cast<double>(items.h[i]) + padding);
+    }
+    const double average_side = std::sqrt(total_area / static_cast<double>(items.size()));
+    return std::max(1, static_cast<int>(std::lround(average_side * 2.0)));
+}
+
+PackItems make_pack_items(const std::vector<Sprite>& sprites) {
+    PackItems items;
+    items.w.reserve(sprites.size());
+    items.h.reserve(sprites.size());
+    items.index.reserve(sprites.size());
+    for (size_t i = 0; i < sprites.size(); ++i) {
+        items.w.push_back(sprites[i].w);
+        items.h.push_back(sprites[i].h);
+        items.index.push_back(static_cast<std::uint32_t>(i));
+    }
+    return items;
+}
+
+// Copies the sprites behind items, in packing order, to their placements.
+std::vector<Sprite> place_pack_items(const std::vector<Sprite>& sources,
+                                     const PackItems& items,
+                                     const std::vector<Placement>& placements) {
+    std::vector<Sprite> placed;
+    placed.reserve(items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+        Sprite s = sources[items.index[i]];
+        const Placement& placement = placements[i];
+        if (placement.rotated) {
+            std::swap(s.w, s.h);
+        }
+        s.rotated = placement.rotated;
+        s.x = placement.x;
+        s.y = placement.y;
+        placed.push_back(std::move(s));
+    }
+    return placed;
+}
+
+// Best atlas a COMPACT search run has to beat. pack_compact_maxrects gives up
+// (setting aborted) as soon as its lower bound proves the layout would lose on
+// both optimize targets.
+struct CompactPackBound {
+    size_t gpu_area = 0;
+    int gpu_max_side = 0;
+    size_t space_area = 0;
+    int space_max_side = 0;
+    size_t total_area = 0;    // padded area of every sprite being packed
+    int min_square_side = 0;  // ceil(sqrt(total_area))
+    bool aborted = false;
+};
+
+bool layout_can_beat_bound(const CompactPackBound& bound, int width_limit, int used_w, int used_h) {
+    // The finished atlas keeps everything placed so far and must hold the padded
+    // area of every sprite within width_limit columns.
+    const size_t width_size = static_cast<size_t>(width_limit);
+    const size_t min_height = std::max(static_cast<size_t>(used_h), (bound.total_area + width_size - 1) / width_size);
+    size_t area_lb = 0;
+    if (!checked_mul_size_t(static_cast<size_t>(used_w), min_height, area_lb)) {
+        return false;
+    }
+    area_lb = std::max(area_lb, bound.total_area);
+    const size_t side_lb = std::max({static_cast<size_t>(used_w), min_height, static_cast<size_t>(bound.min_square_side)});
+
+    const size_t gpu_side = static_cast<size_t>(bound.gpu_max_side);
+    const size_t space_side = static_cast<size_t>(bound.space_max_side);
+    const bool loses_gpu = side_lb > gpu_side || (side_lb == gpu_side && area_lb > bound.gpu_area);
+    const bool loses_space = area_lb > bound.space_area || (area_lb == bound.space_area && side_lb > space_side);
+    return !(loses_gpu && loses_space);
 }
 
 bool pack_compact_maxrects(
-    std::vector<Sprite>& sprites,
+    const PackItems& items,
     int width_limit,
     int padding,
     int max_height,
     RectHeuristic heuristic,
     bool allow_rotate,
+    std::vector<Placement>& placements,
     int& out_width,
-    int& out_height
+    int& out_height,
+    CompactPackBound* bound = nullptr
 ) {
     if (width_limit <= 0 || max_height <= 0) {
         return false;
     }
 
-    std::vector<Rect> free_rects;
-    free_rects.push_back({0, 0, width_limit, max_height});
+    FreeRectIndex free_rects(width_limit, max_height, free_rect_cell_size(items, padding));
+    placements.resize(items.size());
 
     int used_w = 0;
     int used_h = 0;
-    std::vector<Rect> next_free;
 
-    for (auto& s : sprites) {
+    for (size_t i = 0; i < items.size(); ++i) {
+        const int item_w = items.w[i];
+        const int item_h = items.h[i];
         int rw = 0;
         int rh = 0;
-        if (!checked_add_int(s.w, padding, rw) || !checked_add_int(s.h, padding, rh)) {
+        if (!checked_add_int(item_w, padding, rw) || !checked_add_int(item_h, padding, rh)) {
             return false;
         }
         int rrw = rh;
@@ -2605,65 +3585,63 @@ bool pack_compact_maxrects(
             }
         }
 
-        int best_index = -1;
-        int best_short_fit = std::numeric_limits<int>::max();
-        int best_long_fit = std::numeric_limits<int>::max();
-        int best_area_fit = std::numeric_limits<int>::max();
-        int best_top = std::numeric_limits<int>::max();
-        int best_left = std::numeric_limits<int>::max();
+        Rect target;
         bool best_rotated = false;
+        if (!free_rects.find_best(rw, rh, allow_rotate && item_w != item_h, heuristic, target, best_rotated)) {
+            return false;
+        }
 
-        for (size_t i = 0; i < free_rects.size(); ++i) {
-            const Rect& fr = free_rects[i];
-            auto consider_orientation = [&](int cand_w, int cand_h, bool rotated) {
-                if (cand_w > fr.w || cand_h > fr.h) {
-                    return;
-                }
-                int leftover_h = fr.h - cand_h;
-                int leftover_w = fr.w - cand_w;
-                int short_fit = std::min(leftover_h, leftover_w);
-                int long_fit = std::max(leftover_h, leftover_w);
-                int area_fit = leftover_h * leftover_w;
-
-                bool better = false;
-                switch (heuristic) {
-                    case RectHeuristic::BestShortSideFit:
-                        better = short_fit < best_short_fit ||
-                                 (short_fit == best_short_fit && long_fit < best_long_fit) ||
-                                 (short_fit == best_short_fit && long_fit == best_long_fit && fr.y < best_top) ||
-                                 (short_fit == best_short_fit && long_fit == best_long_fit && fr.y == best_top && fr.x < best_left);
-                        break;
-                    case RectHeuristic::BestAreaFit:
-                        better = area_fit < best_area_fit ||
-                                 (area_fit == best_area_fit && short_fit < best_short_fit) ||
-                                 (area_fit == best_area_fit && short_fit == best_short_fit && fr.y < best_top) ||
-                                 (area_fit == best_area_fit && short_fit == best_short_fit && fr.y == best_top && fr.x < best_left);
-                        break;
-                    case RectHeuristic::BottomLeft:
-                        better = fr.y < best_top || (fr.y == best_top && fr.x < best_left) ||
-                                 (fr.y == best_top && fr.x == best_left && short_fit < best_short_fit);
-                        break;
-                }
+        int used_w_dim = rw;
+        int used_h_dim = rh;
+        if (best_rotated) {
+            std::swap(used_w_dim, used_h_dim);
+        }
 
-                if (!better) {
-                    return;
-                }
-                best_index = static_cast<int>(i);
-                best_short_fit = short_fit;
-                best_long_fit = long_fit;
-                best_area_fit = area_fit;
-                best_top = fr.y;
-                best_left = fr.x;
-                best_rotated = rotated;
-            };
+        Rect used = {.x=target.x, .y=target.y, .w=used_w_dim, .h=used_h_dim};
+        placements[i] = {.x=used.x, .y=used.y, .rotated=best_rotated};
 
-            consider_orientation(rw, rh, false);
-            if (allow_rotate && s.w != s.h) {
-                consider_orientation(rrw, rrh, true);
-            }
+        used_w = std::max(used.x + used.w, used_w);
+        used_h = std::max(used.y + used.h, used_h);
+        if (bound != nullptr && !layout_can_beat_bound(*bound, width_limit, used_w, used_h)) {
+            bound->aborted = true;
+            return false;
         }
 
-        if (best_index < 0) {
+        free_rects.place(used);
+    }
+
+    out_width = used_w;
+    out_height = used_h;
+    return out_width > 0 && out_height > 0;
+}
+
+// Places `sprites` into the free space left around `fixed` inside a
+// bounds_w x bounds_h area, best short side fit first.
+bool place_around_fixed(const std::vector<Sprite>& fixed,
+                        std::vector<Sprite>& sprites,
+                        int bounds_w,
+                        int bounds_h,
+                        int padding,
+                        bool allow_rotate,
+                        int cell_hint) {
+    if (bounds_w <= 0 || bounds_h <= 0) {
+        return false;
+    }
+    FreeRectIndex free_rects(bounds_w, bounds_h, cell_hint);
+    for (const auto& s : fixed) {
+        free_rects.place({.x=s.x, .y=s.y, .w=s.w + padding, .h=s.h + padding});
+    }
+
+    for (auto& s : sprites) {
+        int rw = 0;
+        int rh = 0;
+        if (!checked_add_int(s.w, padding, rw) || !checked_add_int(s.h, padding, rh) || rw <= 0 || rh <= 0) {
+            return false;
+        }
+
+        Rect target;
+        bool best_rotated = false;
+        if (!free_rects.find_best(rw, rh, allow_rotate && s.w != s.h, RectHeuristic::BestShortSideFit, target, best_rotated)) {
             return false;
         }
 
@@ -2674,31 +3652,93 @@ bool pack_compact_maxrects(
             std::swap(used_w_dim, used_h_dim);
         }
         s.rotated = best_rotated;
+        s.x = target.x;
+        s.y = target.y;
+        free_rects.place({.x=target.x, .y=target.y, .w=used_w_dim, .h=used_h_dim});
+    }
+    return true;
+}
 
-        Rect used = {.x=free_rects[static_cast<size_t>(best_index)].x,
-                     .y=free_rects[static_cast<size_t>(best_index)].y,
-                     .w=used_w_dim, .h=used_h_dim};
-        s.x = used.x;
-        s.y = used.y;
-
-        used_w = std::max(used.x + used.w, used_w);
-        used_h = std::max(used.y + used.h, used_h);
-
-        next_free.clear();
-        for (const auto& fr : free_rects) {
-            if (!split_free_rect(fr, used, next_free)) {
-                return false;
+// Drops `sprites` into the slots freed by removed or resized sprites. Each
+// goes to the best short side fit among the freed rectangles, which is then
+// split guillotine-style; same-sized replacements (edits, renames) land
+// exactly in their old slot. Fails if any sprite does not fit.
+bool place_in_freed_slots(std::vector<Rect> freed,
+                          std::vector<Sprite>& sprites,
+                          int padding,
+                          bool allow_rotate) {
+    for (auto& s : sprites) {
+        int rw = 0;
+        int rh = 0;
+        if (!checked_add_int(s.w, padding, rw) || !checked_add_int(s.h, padding, rh) || rw <= 0 || rh <= 0) {
+            return false;
+        }
+        size_t best = freed.size();
+        bool best_rotated = false;
+        std::pair<int, int> best_fit{std::numeric_limits<int>::max(), std::numeric_limits<int>::max()};
+        auto consider = [&](size_t index, int w, int h, bool rotated) {
+            const Rect& fr = freed[index];
+            if (w > fr.w || h > fr.h) {
+                return;
+            }
+            const int leftover_w = fr.w - w;
+            const int leftover_h = fr.h - h;
+            const std::pair<int, int> fit{std::min(leftover_w, leftover_h), std::max(leftover_w, leftover_h)};
+            if (fit < best_fit) {
+                best_fit = fit;
+                best = index;
+                best_rotated = rotated;
+            }
+        };
+        for (size_t i = 0; i < freed.size(); ++i) {
+            consider(i, rw, rh, false);
+            if (allow_rotate && s.w != s.h) {
+                consider(i, rh, rw, true);
             }
         }
+        if (best == freed.size()) {
+            return false;
+        }
 
-        std::swap(free_rects, next_free);
+        if (best_rotated) {
+            std::swap(s.w, s.h);
+            std::swap(rw, rh);
+        }
+        s.rotated = best_rotated;
+        const Rect slot = freed[best];
+        s.x = slot.x;
+        s.y = slot.y;
+
+        // Split along the shorter leftover so the larger piece stays whole.
+        Rect right{.x=slot.x + rw, .y=slot.y, .w=slot.w - rw, .h=0};
+        Rect below{.x=slot.x, .y=slot.y + rh, .w=0, .h=slot.h - rh};
+        if (right.w < below.h) {
+            right.h = rh;
+            below.w = slot.w;
+        } else {
+            right.h = slot.h;
+            below.w = rw;
+        }
+        freed[best] = freed.back();
+        freed.pop_back();
+        for (const Rect& piece : {right, below}) {
+            if (piece.w > 0 && piece.h > 0) {
+                freed.push_back(piece);
+            }
+        }
     }
-
-    out_width = used_w;
-    out_height = used_h;
-    return out_width > 0 && out_height > 0;
+    return true;
 }
 
+// Delta relayout against the previous incremental seed. Sprites whose path,
+// size and trim match a seed entry keep their position; positions depend on
+// nothing else, so pixel edits that keep the size are free. The remaining
+// sprites are placed, in order of preference:
+//   1. into the slots the seed no longer uses, without touching anything else;
+//   2. anywhere inside the previous atlas bounds;
+//   3. in space grown beyond those bounds, keeping every pinned sprite.
+// Stages 1 and 2 only build free space as large as the old atlas, which
+// keeps a small change to a large atlas cheap.
 bool pack_incremental_maxrects(
     const LayoutSeedCache& seed,
     int padding,
@@ -2711,22 +3751,22 @@ bool pack_incremental_maxrects(
     int& out_atlas_height) {
 
     // Build lookup of seed entries by path
-    std::unordered_map<std::string, const LayoutSeedEntry*> seed_by_path;
+    std::unordered_map<std::string, size_t> seed_by_path;
     seed_by_path.reserve(seed.entries.size());
-    for (const auto& entry : seed.entries) {
-        seed_by_path.emplace(entry.path, &entry);
+    for (size_t i = 0; i < seed.entries.size(); ++i) {
+        seed_by_path.emplace(seed.entries[i].path, i);
     }
 
     // Classify each sprite as pinned or new
     std::vector<Sprite> pinned_sprites;
     std::vector<Sprite> new_sprites;
+    std::vector<bool> seed_entry_pinned(seed.entries.size(), false);
     pinned_sprites.reserve(source_sprites.size());
-    new_sprites.reserve(source_sprites.size());
 
     for (const auto& src : source_sprites) {
         auto it = seed_by_path.find(src.path);
-        if (it != seed_by_path.end()) {
-            const LayoutSeedEntry& entry = *it->second;
+        if (it != seed_by_path.end() && !seed_entry_pinned[it->second]) {
+            const LayoutSeedEntry& entry = seed.entries[it->second];
             const int expected_w = entry.rotated ? src.h : src.w;
             const int expected_h = entry.rotated ? src.w : src.h;
             if (entry.x >= 0 && entry.y >= 0 &&
@@ -2741,13 +3781,14 @@ bool pack_incremental_maxrects(
                     std::swap(placed.w, placed.h);
                 }
                 pinned_sprites.push_back(std::move(placed));
+                seed_entry_pinned[it->second] = true;
                 continue;
             }
         }
         new_sprites.push_back(src);
     }
 
-    // No benefit from incremental if nothing is pinned
+    // Nothing to keep stable: a full pack gives the better layout.
     if (pinned_sprites.empty()) {
         return false;
     }
@@ -2800,120 +3841,63 @@ bool pack_incremental_maxrects(
         }
     }
 
-    // Build MaxRects free_rects: start with full area, split around each pinned sprite
-    std::vector<Rect> free_rects;
-    free_rects.push_back({0, 0, width_upper_bound, height_upper_bound});
-
-    for (const auto& s : pinned_sprites) {
-        int padded_w = 0;
-        int padded_h = 0;
-        checked_add_int(s.w, padding, padded_w);
-        checked_add_int(s.h, padding, padded_h);
-        Rect used = {.x=s.x, .y=s.y, .w=padded_w, .h=padded_h};
-
-        std::vector<Rect> next_free;
-        for (const auto& fr : free_rects) {
-            if (!split_free_rect(fr, used, next_free)) {
-                return false;
-            }
-        }
-        std::swap(free_rects, next_free);
-    }
-
     // Sort new sprites by area descending
     std::ranges::sort(new_sprites, [](const Sprite& a, const Sprite& b) {
         return (a.w * a.h) > (b.w * b.h);
     });
 
-    // Place each new sprite using BestShortSideFit heuristic
-    for (auto& s : new_sprites) {
-        int rw = 0;
-        int rh = 0;
-        if (!checked_add_int(s.w, padding, rw) || !checked_add_int(s.h, padding, rh)) {
-            return false;
-        }
-        int rrw = rh;
-        int rrh = rw;
-        if (rw <= 0 || rh <= 0 || rw > width_upper_bound || rh > height_upper_bound) {
-            if (!(allow_rotate && rrw > 0 && rrh > 0 && rrw <= width_upper_bound && rrh <= height_upper_bound)) {
-                return false;
-            }
-        }
-
-        int best_index = -1;
-        int best_short_fit = std::numeric_limits<int>::max();
-        int best_long_fit = std::numeric_limits<int>::max();
-        int best_top = std::numeric_limits<int>::max();
-        int best_left = std::numeric_limits<int>::max();
-        bool best_rotated = false;
-
-        for (size_t i = 0; i < free_rects.size(); ++i) {
-            const Rect& fr = free_rects[i];
-            auto consider_orientation = [&](int cand_w, int cand_h, bool rotated) {
-                if (cand_w > fr.w || cand_h > fr.h) {
-                    return;
-                }
-                int leftover_h = fr.h - cand_h;
-                int leftover_w = fr.w - cand_w;
-                int short_fit = std::min(leftover_h, leftover_w);
-                int long_fit = std::max(leftover_h, leftover_w);
-
-                bool better = short_fit < best_short_fit ||
-                              (short_fit == best_short_fit && long_fit < best_long_fit) ||
-                              (short_fit == best_short_fit && long_fit == best_long_fit && fr.y < best_top) ||
-                              (short_fit == best_short_fit && long_fit == best_long_fit && fr.y == best_top && fr.x < best_left);
-
-                if (!better) {
-                    return;
-                }
-                best_index = static_cast<int>(i);
-                best_short_fit = short_fit;
-                best_long_fit = long_fit;
-                best_top = fr.y;
-                best_left = fr.x;
-                best_rotated = rotated;
-            };
-
-            consider_orientation(rw, rh, false);
-            if (allow_rotate && s.w != s.h) {
-                consider_orientation(rrw, rrh, true);
-            }
-        }
-
-        if (best_index < 0) {
-            return false;
-        }
-
-        int used_w_dim = rw;
-        int used_h_dim = rh;
-        if (best_rotated) {
-            std::swap(s.w, s.h);
-            std::swap(used_w_dim, used_h_dim);
-        }
-        s.rotated = best_rotated;
-
-        Rect used = {.x=free_rects[static_cast<size_t>(best_index)].x,
-                     .y=free_rects[static_cast<size_t>(best_index)].y,
-                     .w=used_w_dim, .h=used_h_dim};
-        s.x = used.x;
-        s.y = used.y;
-
-        std::vector<Rect> next_free;
-        for (const auto& fr : free_rects) {
-            if (!split_free_rect(fr, used, next_free)) {
-                return false;
-            }
+    int seed_w = 0;
+    int seed_h = 0;
+    std::vector<Rect> freed;
+    for (size_t i = 0; i < seed.entries.size(); ++i) {
+        const LayoutSeedEntry& entry = seed.entries[i];
+        const Rect slot{.x=entry.x, .y=entry.y, .w=entry.w + padding, .h=entry.h + padding};
+        if (entry.x < 0 || entry.y < 0 || slot.w <= 0 || slot.h <= 0 ||
+            slot.w > width_upper_bound - slot.x || slot.h > height_upper_bound - slot.y) {
+            continue;
         }
-        std::swap(free_rects, next_free);
+        seed_w = std::max(seed_w, slot.x + slot.w);
+        seed_h = std::max(seed_h, slot.y + slot.h);
+        if (!seed_entry_pinned[i]) {
+            freed.push_back(slot);
+        }
+    }
+
+    std::vector<Sprite> placed = new_sprites;
+    bool fits = place_in_freed_slots(std::move(freed), placed, padding, allow_rotate);
+    if (!fits) {
+        const int cell_hint = free_rect_cell_size(source_sprites, padding);
+        placed = new_sprites;
+        fits = place_around_fixed(pinned_sprites, placed, seed_w, seed_h, padding, allow_rotate, cell_hint);
+        if (!fits) {
+            // Grow by at most the new sprites' padded extents: enough room to
+            // line them all up past the old edge, without the cost of
+            // indexing the whole upper bound.
+            long long grow_w = seed_w;
+            long long grow_h = seed_h;
+            for (const auto& s : new_sprites) {
+                const long long side = static_cast<long long>(std::max(s.w, s.h)) + padding;
+                grow_w += side;
+                grow_h += side;
+            }
+            placed = new_sprites;
+            fits = place_around_fixed(pinned_sprites, placed,
+                                      static_cast<int>(std::min<long long>(grow_w, width_upper_bound)),
+                                      static_cast<int>(std::min<long long>(grow_h, height_upper_bound)),
+                                      padding, allow_rotate, cell_hint);
+        }
+    }
+    if (!fits) {
+        return false;
     }
 
     // Combine pinned + newly placed sprites
     out_sprites.clear();
-    out_sprites.reserve(pinned_sprites.size() + new_sprites.size());
+    out_sprites.reserve(pinned_sprites.size() + placed.size());
     for (auto& s : pinned_sprites) {
         out_sprites.push_back(std::move(s));
     }
-    for (auto& s : new_sprites) {
+    for (auto& s : placed) {
         out_sprites.push_back(std::move(s));
     }
 
@@ -2954,9 +3938,7 @@ bool pack_compact_maxrects_partial(
         return false;
     }
 
-    std::vector<Rect> free_rects;
-    free_rects.push_back({0, 0, width_limit, max_height});
-    std::vector<Rect> next_free;
+    FreeRectIndex free_rects(width_limit, max_height, free_rect_cell_size(sprites, padding));
 
     for (const auto& src : sprites) {
         Sprite s = src;
@@ -2965,71 +3947,14 @@ bool pack_compact_maxrects_partial(
         if (!checked_add_int(s.w, padding, rw) || !checked_add_int(s.h, padding, rh)) {
             return false;
         }
-        const int rrw = rh;
-        const int rrh = rw;
         if (rw <= 0 || rh <= 0) {
             out.remaining.push_back(src);
             continue;
         }
 
-        int best_index = -1;
-        int best_short_fit = std::numeric_limits<int>::max();
-        int best_long_fit = std::numeric_limits<int>::max();
-        int best_area_fit = std::numeric_limits<int>::max();
-        int best_top = std::numeric_limits<int>::max();
-        int best_left = std::numeric_limits<int>::max();
+        Rect target;
         bool best_rotated = false;
-
-        for (size_t i = 0; i < free_rects.size(); ++i) {
-            const Rect& fr = free_rects[i];
-            auto consider_orientation = [&](int cand_w, int cand_h, bool rotated) {
-                if (cand_w <= 0 || cand_h <= 0 || cand_w > fr.w || cand_h > fr.h) {
-                    return;
-                }
-                int leftover_h = fr.h - cand_h;
-                int leftover_w = fr.w - cand_w;
-                int short_fit = std::min(leftover_h, leftover_w);
-                int long_fit = std::max(leftover_h, leftover_w);
-                int area_fit = leftover_h * leftover_w;
-
-                bool better = false;
-                switch (heuristic) {
-                    case RectHeuristic::BestShortSideFit:
-                        better = short_fit < best_short_fit ||
-                                 (short_fit == best_short_fit && long_fit < best_long_fit) ||
-                                 (short_fit == best_short_fit && long_fit == best_long_fit && fr.y < best_top) ||
-                                 (short_fit == best_short_fit && long_fit == best_long_fit && fr.y == best_top && fr.x < best_left);
-                        break;
-                    case RectHeuristic::BestAreaFit:
-                        better = area_fit < best_area_fit ||
-                                 (area_fit == best_area_fit && short_fit < best_short_fit) ||
-                                 (area_fit == best_area_fit && short_fit == best_short_fit && fr.y < best_top) ||
-                                 (area_fit == best_area_fit && short_fit == best_short_fit && fr.y == best_top && fr.x < best_left);
-                        break;
-                    case RectHeuristic::BottomLeft:
-                        better = fr.y < best_top || (fr.y == best_top && fr.x < best_left) ||
-                                 (fr.y == best_top && fr.x == best_left && short_fit < best_short_fit);
-                        break;
-                }
-                if (!better) {
-                    return;
-                }
-                best_index = static_cast<int>(i);
-                best_short_fit = short_fit;
-                best_long_fit = long_fit;
-                best_area_fit = area_fit;
-                best_top = fr.y;
-                best_left = fr.x;
-                best_rotated = rotated;
-            };
-
-            consider_orientation(rw, rh, false);
-            if (allow_rotate && s.w != s.h) {
-                consider_orientation(rrw, rrh, true);
-            }
-        }
-
-        if (best_index < 0) {
+        if (!free_rects.find_best(rw, rh, allow_rotate && s.w != s.h, heuristic, target, best_rotated)) {
             out.remaining.push_back(src);
             continue;
         }
@@ -3042,9 +3967,7 @@ bool pack_compact_maxrects_partial(
         }
         s.rotated = best_rotated;
 
-        Rect used = {.x=free_rects[static_cast<size_t>(best_index)].x,
-                     .y=free_rects[static_cast<size_t>(best_index)].y,
-                     .w=used_w_dim, .h=used_h_dim};
+        Rect used = {.x=target.x, .y=target.y, .w=used_w_dim, .h=used_h_dim};
         s.x = used.x;
         s.y = used.y;
 
@@ -3058,13 +3981,7 @@ bool pack_compact_maxrects_partial(
         }
         out.packed_area += sprite_area;
 
-        next_free.clear();
-        for (const auto& fr : free_rects) {
-            if (!split_free_rect(fr, used, next_free)) {
-                return false;
-            }
-        }
-        std::swap(free_rects, next_free);
+        free_rects.place(used);
         out.packed.push_back(s);
     }
 
@@ -3072,10 +3989,11 @@ bool pack_compact_maxrects_partial(
 }
 
 bool pack_fast_shelf(
-    std::vector<Sprite>& sprites,
+    const PackItems& items,
     int max_row_width,
     int padding,
     bool allow_rotate,
+    std::vector<Placement>& placements,
     int& out_width,
     int& out_height
 ) {
@@ -3086,11 +4004,14 @@ bool pack_fast_shelf(
     if (max_row_width <= 0) {
         return false;
     }
+    placements.resize(items.size());
 
-    for (auto& s : sprites) {
+    for (size_t i = 0; i < items.size(); ++i) {
+        const int item_w = items.w[i];
+        const int item_h = items.h[i];
         int w = 0;
         int h = 0;
-        if (!checked_add_int(s.w, padding, w) || !checked_add_int(s.h, padding, h)) {
+        if (!checked_add_int(item_w, padding, w) || !checked_add_int(item_h, padding, h)) {
             return false;
         }
 
@@ -3100,7 +4021,7 @@ bool pack_fast_shelf(
             return (static_cast<long long>(row_y) << 32) + static_cast<long long>(row_h);
         };
 
-        const bool can_rotate = allow_rotate && s.w != s.h;
+        const bool can_rotate = allow_rotate && item_w != item_h;
         int best_place_w = w;
         int best_place_h = h;
         bool best_rotated = false;
@@ -3141,13 +4062,7 @@ bool pack_fast_shelf(
         if (candidate_x > max_row_width) {
             return false;
         }
-        if (best_rotated) {
-            std::swap(s.w, s.h);
-        }
-        s.rotated = best_rotated;
-
-        s.x = x;
-        s.y = y;
+        placements[i] = {.x=x, .y=y, .rotated=best_rotated};
         x = candidate_x;
         row_height = std::max(best_place_h, row_height);
         atlas_width = std::max(x, atlas_width);
@@ -3327,87 +4242,148 @@ bool pick_better_layout_candidate(
     return candidate_w < best_w;
 }
 
-} // namespace
+// Threads behind run_work_stealing. They start on first use and stay parked
+// between searches, so repeated runs (--serve, one search per multipack page)
+// don't pay for thread start-up each time. The pool is never destroyed; its
+// idle threads end with the process.
+class WorkerPool {
+public:
+    static WorkerPool& instance() {
+        static WorkerPool* pool = new WorkerPool();
+        return *pool;
+    }
+
+    // Runs work(0) on the calling thread and work(1..helper_count) on pool
+    // threads, and returns once all of them are done. Helpers no thread has
+    // picked up by the time work(0) returns are withdrawn, so a call made from
+    // inside a pool thread cannot wait on itself.
+    void run(unsigned int helper_count, const std::function<void(unsigned int)>& work) {
+        Batch batch{.work = &work};
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (; thread_count_ < helper_count; ++thread_count_) {
+                std::thread(&WorkerPool::worker_loop, this).detach();
+            }
+            for (unsigned int slot = 1; slot <= helper_count; ++slot) {
+                pending_.push_back({.batch = &batch, .slot = slot});
+            }
+        }
+        wake_.notify_all();
+        work(0);
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::erase_if(pending_, [&](const Helper& helper) { return helper.batch == &batch; });
+        batch.done.wait(lock, [&]() { return batch.running == 0; });
+    }
+
+private:
+    struct Batch {
+        const std::function<void(unsigned int)>* work = nullptr;
+        unsigned int running = 0;
+        std::condition_variable done;
+    };
+    struct Helper {
+        Batch* batch = nullptr;
+        unsigned int slot = 0;
+    };
 
-bool pack_atlases(
-    std::vector<Sprite>& sprites,
-    int max_w,
-    int max_h,
-    int padding,
-    Mode mode,
-    OptimizeTarget optimize_target,
-    bool allow_rotate,
-    bool enforce_sort_order,
-    std::vector<Atlas>& out_atlases
-) {
-    if (sprites.empty()) {
-        return true;
-    }
+    WorkerPool() = default;
 
-    // Grid mode: uniform-cell layout, split into equal-capacity atlases when needed.
-    if (mode == Mode::GRID) {
-        const int ref_w = sprites[0].w;
-        const int ref_h = sprites[0].h;
-        for (const auto& s : sprites) {
-            if (s.w != ref_w || s.h != ref_h) {
-                std::cerr << tr("Error: grid mode requires all sprites to be the same size; ")
-                          << s.path << " is " << s.w << "x" << s.h
-                          << tr(", expected ") << ref_w << "x" << ref_h << '\n';
-                return false;
+    void worker_loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            wake_.wait(lock, [&]() { return !pending_.empty(); });
+            const Helper helper = pending_.front();
+            pending_.pop_front();
+            ++helper.batch->running;
+            lock.unlock();
+            (*helper.batch->work)(helper.slot);
+            lock.lock();
+            if (--helper.batch->running == 0) {
+                helper.batch->done.notify_all();
             }
         }
-        int cell_w = 0;
-        int cell_h = 0;
-        if (!checked_add_int(ref_w, padding, cell_w) || !checked_add_int(ref_h, padding, cell_h)) {
-            return false;
-        }
-        if (cell_w <= 0 || cell_h <= 0 || cell_w > max_w || cell_h > max_h) {
-            return false;
-        }
-        int cols = max_w / cell_w;
-        int rows_per_atlas = max_h / cell_h;
-        if (cols <= 0 || rows_per_atlas <= 0) {
-            return false;
+    }
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Helper> pending_;
+    unsigned int thread_count_ = 0;
+};
+
+// Runs tasks [0, task_count) on worker_count threads: the caller plus
+// WorkerPool threads. Tasks are dealt round-robin into per-worker deques; each
+// worker drains its own deque from the front (lowest task index first) and,
+// once empty, steals from the back of the other deques, so a slow task never
+// leaves the remaining cores idle.
+void run_work_stealing(size_t task_count, unsigned int worker_count, const std::function<void(size_t)>& run_task) {
+    if (task_count == 0) {
+        return;
+    }
+    worker_count = std::max(1u, std::min<unsigned int>(worker_count, static_cast<unsigned int>(std::min<size_t>(task_count, std::numeric_limits<unsigned int>::max()))));
+    if (worker_count == 1) {
+        for (size_t task_index = 0; task_index < task_count; ++task_index) {
+            run_task(task_index);
         }
-        int capacity = cols * rows_per_atlas;
-        int n = static_cast<int>(sprites.size());
-        int atlas_idx = 0;
-        for (int base = 0; base < n; base += capacity, ++atlas_idx) {
-            int count = std::min(capacity, n - base);
-            int atlas_rows = (count + cols - 1) / cols;
-            long long aw = static_cast<long long>(cols) * cell_w;
-            long long ah = static_cast<long long>(atlas_rows) * cell_h;
-            if (aw > std::numeric_limits<int>::max() || ah > std::numeric_limits<int>::max()) {
-                return false;
+        return;
+    }
+
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+    std::vector<TaskQueue> queues(worker_count);
+    for (size_t task_index = 0; task_index < task_count; ++task_index) {
+        queues[task_index % worker_count].tasks.push_back(task_index);
+    }
+
+    auto take_task = [&](unsigned int worker_index, size_t& out_task) {
+        {
+            TaskQueue& own = queues[worker_index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                out_task = own.tasks.front();
+                own.tasks.pop_front();
+                return true;
             }
-            out_atlases.push_back({static_cast<int>(aw), static_cast<int>(ah)});
-            for (int i = 0; i < count; ++i) {
-                int col = i % cols;
-                int row = i / cols;
-                long long x_ll = static_cast<long long>(col) * cell_w;
-                long long y_ll = static_cast<long long>(row) * cell_h;
-                if (x_ll > std::numeric_limits<int>::max() || y_ll > std::numeric_limits<int>::max()) {
-                    return false;
-                }
-                sprites[base + i].x = static_cast<int>(x_ll);
-                sprites[base + i].y = static_cast<int>(y_ll);
-                sprites[base + i].atlas_index = atlas_idx;
+        }
+        for (unsigned int offset = 1; offset < worker_count; ++offset) {
+            TaskQueue& victim = queues[(worker_index + offset) % worker_count];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                out_task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
             }
         }
-        return true;
-    }
+        return false;
+    };
 
+    WorkerPool::instance().run(worker_count - 1, [&](unsigned int worker_index) {
+        size_t task_index = 0;
+        while (take_task(worker_index, task_index)) {
+            run_task(task_index);
+        }
+    });
+}
+
+// Fills multipack pages greedily: each page keeps the trial, over
+// `sort_modes` x widths x heuristics, that packs the most onto it.
+bool pack_multipack_pages(
+    const std::vector<Sprite>& sprites,
+    const std::vector<SortMode>& sort_modes,
+    int max_w,
+    int max_h,
+    int padding,
+    Mode mode,
+    OptimizeTarget optimize_target,
+    bool allow_rotate,
+    unsigned int worker_count,
+    std::vector<Sprite>& out_sprites,
+    std::vector<Atlas>& out_atlases
+) {
     std::vector<Sprite> remaining = sprites;
     std::vector<Sprite> all_packed;
     int atlas_index = 0;
-    const std::array<SortMode, k_sort_mode_count> sort_modes = {
-        SortMode::Area,
-        SortMode::MaxSide,
-        SortMode::Height,
-        SortMode::Width,
-        SortMode::Perimeter,
-        SortMode::None
-    };
     const std::array<RectHeuristic, k_rect_heuristic_count> rect_heuristics = {
         RectHeuristic::BestShortSideFit,
         RectHeuristic::BestAreaFit,
@@ -3495,129 +4471,250 @@ bool pack_atlases(
                 if (candidate.packed_area != best.packed_area) {
                     return candidate.packed_area > best.packed_area;
                 }
-                return pick_better_layout_candidate(
-                    candidate.area, candidate.used_w, candidate.used_h, true,
-                    best.area, best.used_w, best.used_h,
-                    OptimizeTarget::GPU);
+                return pick_better_layout_candidate(
+                    candidate.area, candidate.used_w, candidate.used_h, true,
+                    best.area, best.used_w, best.used_h,
+                    OptimizeTarget::GPU);
+            }
+
+            // For SPACE in multipack, avoid over-fragmenting into tiny dense atlases:
+            // prioritize packing more content this round, then prefer lower area.
+            if (candidate.packed_area != best.packed_area) {
+                return candidate.packed_area > best.packed_area;
+            }
+            if (candidate.packed_count != best.packed_count) {
+                return candidate.packed_count > best.packed_count;
+            }
+            if (candidate.area != best.area) {
+                return candidate.area < best.area;
+            }
+            return pick_better_layout_candidate(
+                candidate.area, candidate.used_w, candidate.used_h, true,
+                best.area, best.used_w, best.used_h,
+                OptimizeTarget::SPACE);
+        };
+
+        // Every (sort mode, width, heuristic) trial for this page runs as its
+        // own task. Equal candidates resolve to the lowest task index, so the
+        // page comes out the same for any worker count.
+        std::vector<std::vector<Sprite>> sorted_by_mode;
+        sorted_by_mode.reserve(sort_modes.size());
+        for (SortMode sort_mode : sort_modes) {
+            std::vector<Sprite> sorted = remaining;
+            if (sort_sprites_by_mode(sorted, sort_mode)) {
+                sorted_by_mode.push_back(std::move(sorted));
+            }
+        }
+        const size_t trials_per_mode = width_candidates.size() * rect_heuristics.size();
+        MultipackCandidate best_candidate;
+        size_t best_task = 0;
+        std::mutex best_mutex;
+        run_work_stealing(sorted_by_mode.size() * trials_per_mode, worker_count, [&](size_t task) {
+            const std::vector<Sprite>& sorted = sorted_by_mode[task / trials_per_mode];
+            const int width = width_candidates[(task % trials_per_mode) / rect_heuristics.size()];
+            const RectHeuristic heuristic = rect_heuristics[task % rect_heuristics.size()];
+            PartialPackResult trial;
+            if (!pack_compact_maxrects_partial(
+                    sorted, width, max_h, padding, heuristic, allow_rotate, trial)) {
+                return;
+            }
+            int final_w = trial.used_w;
+            int final_h = trial.used_h;
+            if (mode == Mode::POT) {
+                final_w = next_power_of_two(final_w);
+                final_h = next_power_of_two(final_h);
+                if (final_w <= 0 || final_h <= 0 || final_w > max_w || final_h > max_h) {
+                    return;
+                }
+            }
+            size_t final_area = 0;
+            if (!checked_mul_size_t(static_cast<size_t>(final_w), static_cast<size_t>(final_h), final_area)) {
+                return;
+            }
+            MultipackCandidate candidate;
+            candidate.valid = true;
+            candidate.used_w = final_w;
+            candidate.used_h = final_h;
+            candidate.area = final_area;
+            candidate.packed_area = trial.packed_area;
+            candidate.packed_count = static_cast<int>(trial.packed.size());
+            candidate.packed = std::move(trial.packed);
+            candidate.left = std::move(trial.remaining);
+            std::lock_guard<std::mutex> lock(best_mutex);
+            if (better_multipack_candidate(candidate, best_candidate) ||
+                (!better_multipack_candidate(best_candidate, candidate) && task < best_task)) {
+                best_candidate = std::move(candidate);
+                best_task = task;
+            }
+        });
+
+        if (!best_candidate.valid || best_candidate.packed.empty()) {
+            return false;
+        }
+        for (auto& s : best_candidate.packed) {
+            s.atlas_index = atlas_index;
+        }
+        out_atlases.push_back({best_candidate.used_w, best_candidate.used_h});
+        all_packed.insert(all_packed.end(), best_candidate.packed.begin(), best_candidate.packed.end());
+        remaining = std::move(best_candidate.left);
+        atlas_index++;
+    }
+
+    out_sprites = std::move(all_packed);
+    return true;
+}
+
+} // namespace
+
+bool pack_atlases(
+    std::vector<Sprite>& sprites,
+    int max_w,
+    int max_h,
+    int padding,
+    Mode mode,
+    OptimizeTarget optimize_target,
+    bool allow_rotate,
+    bool enforce_sort_order,
+    unsigned int worker_count,
+    std::vector<Atlas>& out_atlases
+) {
+    if (sprites.empty()) {
+        return true;
+    }
+
+    // Grid mode: uniform-cell layout, split into equal-capacity atlases when needed.
+    if (mode == Mode::GRID) {
+        const int ref_w = sprites[0].w;
+        const int ref_h = sprites[0].h;
+        for (const auto& s : sprites) {
+            if (s.w != ref_w || s.h != ref_h) {
+                std::cerr << tr("Error: grid mode requires all sprites to be the same size; ")
+                          << s.path << " is " << s.w << "x" << s.h
+                          << tr(", expected ") << ref_w << "x" << ref_h << '\n';
+                return false;
+            }
+        }
+        int cell_w = 0;
+        int cell_h = 0;
+        if (!checked_add_int(ref_w, padding, cell_w) || !checked_add_int(ref_h, padding, cell_h)) {
+            return false;
+        }
+        if (cell_w <= 0 || cell_h <= 0 || cell_w > max_w || cell_h > max_h) {
+            return false;
+        }
+        int cols = max_w / cell_w;
+        int rows_per_atlas = max_h / cell_h;
+        if (cols <= 0 || rows_per_atlas <= 0) {
+            return false;
+        }
+        int capacity = cols * rows_per_atlas;
+        int n = static_cast<int>(sprites.size());
+        int atlas_idx = 0;
+        for (int base = 0; base < n; base += capacity, ++atlas_idx) {
+            int count = std::min(capacity, n - base);
+            int atlas_rows = (count + cols - 1) / cols;
+            long long aw = static_cast<long long>(cols) * cell_w;
+            long long ah = static_cast<long long>(atlas_rows) * cell_h;
+            if (aw > std::numeric_limits<int>::max() || ah > std::numeric_limits<int>::max()) {
+                return false;
+            }
+            out_atlases.push_back({static_cast<int>(aw), static_cast<int>(ah)});
+            for (int i = 0; i < count; ++i) {
+                int col = i % cols;
+                int row = i / cols;
+                long long x_ll = static_cast<long long>(col) * cell_w;
+                long long y_ll = static_cast<long long>(row) * cell_h;
+                if (x_ll > std::numeric_limits<int>::max() || y_ll > std::numeric_limits<int>::max()) {
+                    return false;
+                }
+                sprites[base + i].x = static_cast<int>(x_ll);
+                sprites[base + i].y = static_cast<int>(y_ll);
+                sprites[base + i].atlas_index = atlas_idx;
             }
+        }
+        return true;
+    }
 
-            // For SPACE in multipack, avoid over-fragmenting into tiny dense atlases:
-            // prioritize packing more content this round, then prefer lower area.
-            if (candidate.packed_area != best.packed_area) {
-                return candidate.packed_area > best.packed_area;
-            }
-            if (candidate.packed_count != best.packed_count) {
-                return candidate.packed_count > best.packed_count;
-            }
-            if (candidate.area != best.area) {
-                return candidate.area < best.area;
-            }
-            return pick_better_layout_candidate(
-                candidate.area, candidate.used_w, candidate.used_h, true,
-                best.area, best.used_w, best.used_h,
-                OptimizeTarget::SPACE);
-        };
+    const std::array<SortMode, k_sort_mode_count> sort_modes = {
+        SortMode::Area,
+        SortMode::MaxSide,
+        SortMode::Height,
+        SortMode::Width,
+        SortMode::Perimeter,
+        SortMode::None
+    };
 
-        MultipackCandidate best_candidate;
+    // Candidate partitionings: the greedy run that tries every sort mode on
+    // every page, then one run per sort mode. A single order kept across all
+    // pages often fills the last pages better than the per-page optimum.
+    // A fixed-order run already is first-fit decreasing for its order: each
+    // page takes every remaining sprite that still fits, in order, so a
+    // sprite lands on the first page with room for it.
+    std::vector<std::vector<SortMode>> plans;
+    if (enforce_sort_order) {
+        plans.push_back({SortMode::None});
+    } else {
+        plans.emplace_back(sort_modes.begin(), sort_modes.end());
         for (SortMode sort_mode : sort_modes) {
-            if (enforce_sort_order && sort_mode != SortMode::None) {
-                continue;
-            }
-            std::vector<Sprite> sorted = remaining;
-            if (!sort_sprites_by_mode(sorted, sort_mode)) {
-                continue;
-            }
-            for (int width : width_candidates) {
-                for (RectHeuristic heuristic : rect_heuristics) {
-                    PartialPackResult trial;
-                    if (!pack_compact_maxrects_partial(
-                            sorted, width, max_h, padding, heuristic, allow_rotate, trial)) {
-                        continue;
-                    }
-                    int final_w = trial.used_w;
-                    int final_h = trial.used_h;
-                    if (mode == Mode::POT) {
-                        final_w = next_power_of_two(final_w);
-                        final_h = next_power_of_two(final_h);
-                        if (final_w <= 0 || final_h <= 0 || final_w > max_w || final_h > max_h) {
-                            continue;
-                        }
-                    }
-                    size_t final_area = 0;
-                    if (!checked_mul_size_t(static_cast<size_t>(final_w), static_cast<size_t>(final_h), final_area)) {
-                        continue;
-                    }
-                    MultipackCandidate candidate;
-                    candidate.valid = true;
-                    candidate.used_w = final_w;
-                    candidate.used_h = final_h;
-                    candidate.area = final_area;
-                    candidate.packed_area = trial.packed_area;
-                    candidate.packed_count = static_cast<int>(trial.packed.size());
-                    candidate.packed = std::move(trial.packed);
-                    candidate.left = std::move(trial.remaining);
-                    if (better_multipack_candidate(candidate, best_candidate)) {
-                        best_candidate = std::move(candidate);
-                    }
-                }
+            if (sort_mode != SortMode::None) {
+                plans.push_back({sort_mode});
             }
         }
+    }
 
-        if (!best_candidate.valid || best_candidate.packed.empty()) {
-            return false;
+    struct MultipackPlan {
+        bool valid = false;
+        std::vector<Sprite> sprites;
+        std::vector<Atlas> atlases;
+        size_t total_area = 0;
+        int max_side = 0;
+    };
+    // Fewest pages first; then the optimize target decides between the
+    // largest page and the total area. Ties keep the earlier plan.
+    auto better_plan = [&](const MultipackPlan& candidate, const MultipackPlan& best) {
+        if (!best.valid) {
+            return true;
         }
-        for (auto& s : best_candidate.packed) {
-            s.atlas_index = atlas_index;
+        if (candidate.atlases.size() != best.atlases.size()) {
+            return candidate.atlases.size() < best.atlases.size();
         }
-        out_atlases.push_back({best_candidate.used_w, best_candidate.used_h});
-        all_packed.insert(all_packed.end(), best_candidate.packed.begin(), best_candidate.packed.end());
-        remaining = std::move(best_candidate.left);
-        atlas_index++;
+        if (optimize_target == OptimizeTarget::GPU && candidate.max_side != best.max_side) {
+            return candidate.max_side < best.max_side;
+        }
+        if (candidate.total_area != best.total_area) {
+            return candidate.total_area < best.total_area;
+        }
+        return candidate.max_side < best.max_side;
+    };
+
+    MultipackPlan best_plan;
+    for (const auto& plan_sort_modes : plans) {
+        MultipackPlan plan;
+        if (!pack_multipack_pages(sprites, plan_sort_modes, max_w, max_h, padding, mode, optimize_target,
+                                  allow_rotate, worker_count, plan.sprites, plan.atlases)) {
+            continue;
+        }
+        plan.valid = true;
+        for (const auto& atlas : plan.atlases) {
+            plan.total_area += static_cast<size_t>(atlas.width) * static_cast<size_t>(atlas.height);
+            plan.max_side = std::max({plan.max_side, atlas.width, atlas.height});
+        }
+        if (better_plan(plan, best_plan)) {
+            best_plan = std::move(plan);
+        }
+    }
+    if (!best_plan.valid) {
+        return false;
     }
 
-    sprites = all_packed;
+    sprites = std::move(best_plan.sprites);
+    out_atlases.insert(out_atlases.end(), best_plan.atlases.begin(), best_plan.atlases.end());
     return true;
 }
 
 // Default maximum Hamming distance between two dHashes to consider sprites perceptually equal.
 static constexpr int k_default_dhash_threshold = 5;
 
-// Compute a 64-bit dHash for an RGBA pixel buffer.
-// Algorithm: sample a 9x8 greyscale grid (nearest-neighbor), then for each of the 8 rows
-// compare 8 adjacent column pairs; bit=1 if left < right. Returns 64-bit hash.
-// Alpha-premultiplied luma: grey = (0.299*R + 0.587*G + 0.114*B) * (A/255.0)
-static uint64_t compute_dhash(const unsigned char* rgba, int w, int h) {
-    if (rgba == nullptr || w <= 0 || h <= 0) {
-        return 0;
-    }
-    // Sample a 9x8 grid (9 cols, 8 rows)
-    double grid[8][9];
-    for (int row = 0; row < 8; ++row) {
-        for (int col = 0; col < 9; ++col) {
-            int px = (col * (w - 1)) / 8;
-            int py = (row * (h - 1)) / 7;
-            if (px < 0) px = 0;
-            if (px >= w) px = w - 1;
-            if (py < 0) py = 0;
-            if (py >= h) py = h - 1;
-            const unsigned char* p = rgba + (static_cast<size_t>(py) * static_cast<size_t>(w) + static_cast<size_t>(px)) * 4;
-            double a = p[3] / 255.0;
-            grid[row][col] = (0.299 * p[0] + 0.587 * p[1] + 0.114 * p[2]) * a;
-        }
-    }
-    uint64_t hash = 0;
-    int bit = 0;
-    for (int row = 0; row < 8; ++row) {
-        for (int col = 0; col < 8; ++col) {
-            if (grid[row][col] < grid[row][col + 1]) {
-                hash |= (uint64_t(1) << bit);
-            }
-            ++bit;
-        }
-    }
-    return hash;
-}
-
 // All settings derived from parsing argv.  Fields that express an override
 // (has_*_override == true) indicate that the corresponding value was
 // explicitly supplied on the command line; profile loading will only fill in
@@ -3670,6 +4767,10 @@ struct LayoutArgs {
     bool has_incremental_override = false;
     bool show_profiles_config = false;
     bool stdin_list = false;
+    bool serve = false;
+    bool pixel_cache = false;
+    unsigned int archive_memory_mib = k_default_archive_memory_mib;
+    std::string trace_path;
 };
 
 // Parses argv into args.  Returns -1 to signal the caller should continue, or
@@ -3825,11 +4926,23 @@ int try_parse_args(int argc, char** argv, LayoutArgs& args) {
                 return 1;
             }
             args.has_threads_override = true;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            args.trace_path = argv[++i];
         } else if (arg == "--incremental") {
             args.incremental = true;
             args.has_incremental_override = true;
         } else if (arg == "--stdin-list") {
             args.stdin_list = true;
+        } else if (arg == "--serve") {
+            args.serve = true;
+        } else if (arg == "--pixel-cache") {
+            args.pixel_cache = true;
+        } else if (arg == "--archive-memory" && i + 1 < argc) {
+            const std::string value = argv[++i];
+            if (!parse_non_negative_uint(value, args.archive_memory_mib)) {
+                std::cerr << tr("Invalid archive memory budget: ") << value << "\n";
+                return 1;
+            }
         } else if (arg.starts_with("-")) {
             std::cerr << tr("Unknown argument: ") << arg << "\n";
             return 1;
@@ -3859,18 +4972,93 @@ int try_parse_args(int argc, char** argv, LayoutArgs& args) {
     return -1; // continue
 }
 
-int run_spratlayout(int argc, char** argv) {
+// Temporarily points a standard stream at another buffer.
+class StreamBufferSwap {
+public:
+    StreamBufferSwap(std::ostream& stream, std::streambuf* buffer)
+        : stream_(stream), previous_(stream.rdbuf(buffer)) {}
+    ~StreamBufferSwap() { stream_.rdbuf(previous_); }
+    StreamBufferSwap(const StreamBufferSwap&) = delete;
+    StreamBufferSwap& operator=(const StreamBufferSwap&) = delete;
+
+private:
+    std::ostream& stream_;
+    std::streambuf* previous_;
+};
+
+// Answers layout requests read from stdin until EOF. Each request is one line with
+// the arguments of a regular spratlayout invocation (double quotes group arguments
+// containing spaces). Each reply is a "result <exit_code> <output_bytes> <error_bytes>"
+// line followed by the captured standard output and standard error of that request.
+// Cache files stay parsed in memory between requests so warm requests only pay for
+// the metadata checks of their inputs.
+int serve_layout_requests(const char* program) {
+    warm_caches().enabled = true;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        std::vector<std::string> tokens;
+        std::istringstream tokenizer(line);
+        std::string token;
+        while (tokenizer >> std::quoted(token)) {
+            tokens.push_back(token);
+        }
+        if (tokens.empty()) {
+            continue;
+        }
+
+        std::ostringstream request_out;
+        std::ostringstream request_err;
+        int exit_code = 1;
+        const bool reads_stdin = std::ranges::any_of(tokens, [](const std::string& value) {
+            return value == "-" || value == "--stdin-list" || value == "--serve";
+        });
+        if (reads_stdin) {
+            request_err << tr("Error: stdin input and --serve are not available in server requests\n");
+        } else {
+            std::vector<char*> request_argv;
+            request_argv.reserve(tokens.size() + 2);
+            request_argv.push_back(const_cast<char*>(program));
+            for (std::string& value : tokens) {
+                request_argv.push_back(value.data());
+            }
+            request_argv.push_back(nullptr);
+            StreamBufferSwap out_swap(std::cout, request_out.rdbuf());
+            StreamBufferSwap err_swap(std::cerr, request_err.rdbuf());
+            exit_code = run_spratlayout(static_cast<int>(request_argv.size() - 1), request_argv.data());
+        }
+
+        const std::string output = request_out.str();
+        const std::string errors = request_err.str();
+        std::cout << "result " << exit_code << " " << output.size() << " " << errors.size() << "\n"
+                  << output << errors;
+        std::cout.flush();
+    }
+    return 0;
+}
+
+namespace {
+
+// Writes the layout to stdout, or into `out_layout` and `out_text` when the
+// caller runs the later stages in this process.
+int run_layout(int argc, char** argv, sprat::core::Layout* out_layout, std::string* out_text) {
 #ifdef _WIN32
     // Set stdout to binary mode to avoid \r\n translation in layout output.
     // Suppress failure: when running as a subprocess of a GUI application the
     // pipe handle may not support _setmode; this is non-fatal.
     _setmode(_fileno(stdout), _O_BINARY);
 #endif
+    sprat::core::ProfileSession profile_session("spratlayout");
     LayoutArgs args;
     const int early_exit = try_parse_args(argc, argv, args);
     if (early_exit >= 0) {
         return early_exit;
     }
+    if (!args.trace_path.empty()) {
+        profile_session.start(args.trace_path);
+    }
 #ifdef _WIN32
     // Set stdin to binary mode only when --stdin-list is active so path data
     // read from stdin is not corrupted by \r\n translation.
@@ -3893,6 +5081,14 @@ int run_spratlayout(int argc, char** argv) {
         return 0;
     }
 
+    if (args.serve) {
+        if (!args.folder.empty() || args.stdin_list) {
+            std::cerr << tr("Error: --serve reads requests from stdin and takes no input\n");
+            return 1;
+        }
+        return serve_layout_requests(argv[0]);
+    }
+
     if (args.folder.empty() && !args.stdin_list) {
         print_usage();
         return 1;
@@ -4132,6 +5328,7 @@ int run_spratlayout(int argc, char** argv) {
     }
 
     InputContext input_context;
+    const size_t archive_memory_budget = static_cast<size_t>(args.archive_memory_mib) * 1024 * 1024;
 
     if (stdin_list) {
 #ifdef _WIN32
@@ -4142,12 +5339,12 @@ int run_spratlayout(int argc, char** argv) {
             return 1;
         }
     } else if (folder == "-") {
-        if (!load_content_from_stdin(input_context)) {
+        if (!load_content_from_stdin(archive_memory_budget, input_context)) {
             std::cerr << tr("Error: Failed to load content from stdin\n");
             return 1;
         }
     } else {
-        if (!detect_and_extract_tar_content(folder, input_context)) {
+        if (!detect_and_extract_tar_content(folder, archive_memory_budget, input_context)) {
             return 1;
         }
     }
@@ -4158,6 +5355,17 @@ int run_spratlayout(int argc, char** argv) {
     prune_all_spratlayout_cache_families(k_cache_max_age_seconds, k_cache_max_layout_files, k_cache_max_seed_files);
     prune_cache_family(cache_path, k_cache_max_age_seconds, k_cache_max_layout_files, k_cache_max_seed_files);
 
+    // Tar inputs are extracted to temporary folders that are gone before
+    // spratpack runs, so their pixels are not worth storing.
+    fs::path pixel_cache_dir;
+    if (args.pixel_cache &&
+        input_context.type != InputType::TarFile && input_context.type != InputType::StdinTar) {
+        pixel_cache_dir = sprat::core::default_pixel_cache_dir();
+        std::error_code pixel_cache_ec;
+        fs::create_directories(pixel_cache_dir, pixel_cache_ec);
+        sprat::core::prune_pixel_cache(pixel_cache_dir, k_default_cache_age_seconds);
+    }
+
     std::vector<ImageSource> sources;
     std::unordered_set<std::string> excluded_source_paths;
     auto add_excluded_source = [&](const fs::path& path, const std::string* relative_key = nullptr) {
@@ -4266,33 +5474,57 @@ int run_spratlayout(int argc, char** argv) {
 
     if (input_context.type == InputType::Directory) {
         load_exclusion_file(input_context.working_folder / ".spratlayoutignore", input_context.working_folder, false);
-        for (const auto& entry : fs::recursive_directory_iterator(input_context.working_folder)) {
-            if (!entry.is_regular_file()) {
-                continue;
-            }
-            if (!add_source(entry.path(), false)) {
-                continue;
+        unsigned int scan_worker_count = thread_limit > 0 ? thread_limit : std::thread::hardware_concurrency();
+        if (scan_worker_count == 0) scan_worker_count = 1;
+#ifdef __EMSCRIPTEN__
+        scan_worker_count = 1;
+#endif
+        // Extension and exclude filters run during the walk, before a file
+        // is stat'ed. The scan hands over the path below the root, so the
+        // relative exclude keys need no fs::relative per entry.
+        const bool has_exclusions = !excluded_source_paths.empty();
+        auto keep_source = [&](const fs::path& image_path, std::string_view relative) {
+            if (!is_supported_image_extension(image_path)) {
+                return false;
             }
+            return !has_exclusions ||
+                   (!excluded_source_paths.contains(std::string(relative)) &&
+                    !is_excluded_source(image_path, nullptr));
+        };
+        std::vector<sprat::core::ScannedFile> scanned;
+        fs::path unreadable_dir;
+        sprat::core::ProfileScope scan_scope("scan");
+        if (!sprat::core::scan_image_directory(input_context.working_folder, scan_worker_count, keep_source, scanned, unreadable_dir)) {
+            std::cerr << tr("Failed to read directory: ") << to_quoted(unreadable_dir) << "\n";
+            return 1;
         }
-    } else if (input_context.type == InputType::TarFile) {
-        // Tar files are already extracted to working_folder - search recursively
-        for (const auto& entry : fs::recursive_directory_iterator(input_context.working_folder)) {
-            if (!entry.is_regular_file()) {
-                continue;
-            }
-            if (!add_source(entry.path(), false)) {
+        scan_scope.arg("files", static_cast<int64_t>(scanned.size()));
+        scan_scope.stop();
+        sources.reserve(scanned.size());
+        for (auto& file : scanned) {
+            if (file.file_size > k_max_file_size) {
                 continue;
             }
+            ImageSource source;
+            source.path = file.path.string();
+            source.file_path = std::move(file.path);
+            source.meta = ImageMeta{.file_size = file.file_size, .mtime_ticks = file.mtime_ticks};
+            sources.push_back(std::move(source));
         }
-    } else if (input_context.type == InputType::StdinTar) {
-        // Stdin tar files are already extracted to working_folder - search recursively
-        for (const auto& entry : fs::recursive_directory_iterator(input_context.working_folder)) {
-            if (!entry.is_regular_file()) {
+    } else if (input_context.type == InputType::TarFile || input_context.type == InputType::StdinTar) {
+        // Archive members were read in archive order; spilled ones live on disk.
+        for (const auto& member : input_context.archive_members) {
+            if (is_excluded_source(member.path, nullptr)) {
                 continue;
             }
-            if (!add_source(entry.path(), false)) {
-                continue;
+            ImageSource source;
+            source.file_path = member.path;
+            source.path = member.path.string();
+            source.meta = member.meta;
+            if (!member.spilled) {
+                source.encoded = &member.encoded;
             }
+            sources.push_back(std::move(source));
         }
     } else {
         // Parse a list-format stream (used for both ListFile and StdinList).
@@ -4439,18 +5671,36 @@ int run_spratlayout(int argc, char** argv) {
     if (!is_file_older_than_seconds(output_cache_path, k_cache_max_age_seconds)) {
         std::string cached_output;
         if (load_output_cache(output_cache_path, layout_signature, cached_output)) {
-            std::cout << cached_output;
-            return 0;
+            if (out_layout == nullptr) {
+                std::cout << cached_output;
+                return 0;
+            }
+            // Only the text is cached; a copy that no longer parses is
+            // rebuilt below like a miss.
+            std::string cache_error;
+            if (sprat::core::parse_layout(std::string_view(cached_output), *out_layout, cache_error)) {
+                *out_text = std::move(cached_output);
+                return 0;
+            }
         }
     }
 
     std::unordered_map<std::string, ImageCacheEntry> cache_entries;
-    load_image_cache(cache_path, cache_entries);
+    MappedImageCache mapped_cache;
+    load_image_cache(cache_path, cache_entries, mapped_cache);
     prune_stale_cache_entries(cache_entries, now_unix, k_cache_max_age_seconds);
+    auto find_cache_entry = [&](const std::string& cache_key, const std::string& path, ImageCacheEntry& out) {
+        auto it = cache_entries.find(cache_key);
+        if (it != cache_entries.end()) {
+            out = it->second;
+            return true;
+        }
+        return mapped_cache.find(path, trim_transparent, out) &&
+               !is_stale_cache_entry(out, now_unix, k_cache_max_age_seconds);
+    };
 
     struct SpriteLoadResult {
         bool ok = false;
-        bool from_cache = false;
         bool failed = false;
         std::string fail_reason;
         Sprite sprite;
@@ -4471,9 +5721,8 @@ int run_spratlayout(int argc, char** argv) {
         result.cache_key = cache_key;
 
         // Step 4a: cache hit
-        auto cache_it = cache_entries.find(cache_key);
-        if (cache_it != cache_entries.end()) {
-            const ImageCacheEntry& cached = cache_it->second;
+        ImageCacheEntry cached;
+        if (find_cache_entry(cache_key, path, cached)) {
             if (cached.trim_transparent == trim_transparent &&
                 cached.file_size == meta.file_size &&
                 cached.mtime_ticks == meta.mtime_ticks) {
@@ -4495,12 +5744,25 @@ int run_spratlayout(int argc, char** argv) {
                     s.trim_right = cached.trim_right;
                     s.trim_bottom = cached.trim_bottom;
                     result.ok = true;
-                    result.from_cache = true;
                     result.sprite = std::move(s);
+                    result.new_entry = cached;
+                    result.new_entry.cached_at_unix = now_unix;
+                    sprat::core::profile_count("image_cache.hits");
                     return;
                 }
             }
         }
+        sprat::core::profile_count("image_cache.misses");
+
+        auto load_rgba = [&source, &path](int& w, int& h, int& channels) {
+            sprat::core::ProfileScope scope("decode");
+            sprat::core::profile_count("decode.images");
+            if (source.encoded != nullptr) {
+                return stbi_load_from_memory(source.encoded->data(), static_cast<int>(source.encoded->size()),
+                                             &w, &h, &channels, 4);
+            }
+            return stbi_load(path.c_str(), &w, &h, &channels, 4);
+        };
 
         Sprite loaded_sprite;
         loaded_sprite.path = path;
@@ -4512,23 +5774,31 @@ int run_spratlayout(int argc, char** argv) {
             int h = 0;
             if (deduplicateMode != "none") {
                 int channels = 0;
-                unsigned char* px = stbi_load(path.c_str(), &w, &h, &channels, 4);
+                unsigned char* px = load_rgba(w, h, channels);
                 if (px == nullptr) {
                     result.failed = true;
                     result.fail_reason = stbi_failure_reason();
                     return;
                 }
-                // FNV-1a over the full RGBA buffer
-                const size_t nbytes = static_cast<size_t>(w) * static_cast<size_t>(h) * 4;
-                uint64_t fnv = 14695981039346656037ULL;
-                for (size_t bi = 0; bi < nbytes; ++bi) {
-                    fnv ^= px[bi];
-                    fnv *= 1099511628211ULL;
+                entry_content_hash = sprat::core::hash_rgba_region(px, w, h, static_cast<size_t>(w) * 4);
+                entry_perceptual_hash = sprat::core::compute_dhash(px, w, h, static_cast<size_t>(w) * 4);
+                if (!pixel_cache_dir.empty()) {
+                    const sprat::core::PixelCacheRegion region{.image_w=w, .image_h=h, .x=0, .y=0, .w=w, .h=h};
+                    sprat::core::store_cached_pixels(pixel_cache_dir, source.file_path, meta.file_size,
+                                                     meta.mtime_ticks, region, px, static_cast<size_t>(w) * 4);
                 }
-                entry_content_hash = fnv;
-                entry_perceptual_hash = compute_dhash(px, w, h);
                 stbi_image_free(px);
-            } else {
+            } else if (source.encoded != nullptr) {
+                int channels = 0;
+                if (stbi_info_from_memory(source.encoded->data(), static_cast<int>(source.encoded->size()),
+                                          &w, &h, &channels) == 0) {
+                    result.failed = true;
+                    result.fail_reason = stbi_failure_reason();
+                    return;
+                }
+            } else if (!sprat::core::probe_image_dimensions(source.file_path, w, h)) {
+                // Only the size is needed. Formats the direct PNG probe does not
+                // handle still go through stb_image's header-only path.
                 int channels = 0;
                 if (stbi_info(path.c_str(), &w, &h, &channels) == 0) {
                     result.failed = true;
@@ -4560,7 +5830,7 @@ int run_spratlayout(int argc, char** argv) {
         int w = 0;
         int h = 0;
         int channels = 0;
-        unsigned char* data = stbi_load(path.c_str(), &w, &h, &channels, 4);
+        unsigned char* data = load_rgba(w, h, channels);
         if (data == nullptr) {
             result.failed = true;
             result.fail_reason = stbi_failure_reason();
@@ -4583,29 +5853,11 @@ int run_spratlayout(int argc, char** argv) {
             loaded_sprite.h = max_y - min_y + 1;
 
             if (deduplicateMode != "none") {
-                // FNV-1a over the trimmed pixel region
-                uint64_t fnv = 14695981039346656037ULL;
-                for (int ry = min_y; ry <= max_y; ++ry) {
-                    const unsigned char* row = data + (static_cast<size_t>(ry) * static_cast<size_t>(w) + static_cast<size_t>(min_x)) * 4;
-                    for (int rx = 0; rx < (max_x - min_x + 1); ++rx) {
-                        for (int c = 0; c < 4; ++c) {
-                            fnv ^= row[static_cast<size_t>(rx) * 4 + static_cast<size_t>(c)];
-                            fnv *= 1099511628211ULL;
-                        }
-                    }
-                }
-                entry_content_hash = fnv;
-
-                // Extract trimmed region for dHash
-                const int tw = max_x - min_x + 1;
-                const int th = max_y - min_y + 1;
-                std::vector<unsigned char> trimmed(static_cast<size_t>(tw) * static_cast<size_t>(th) * 4);
-                for (int ry = 0; ry < th; ++ry) {
-                    const unsigned char* src = data + (static_cast<size_t>(min_y + ry) * static_cast<size_t>(w) + static_cast<size_t>(min_x)) * 4;
-                    unsigned char* dst = trimmed.data() + static_cast<size_t>(ry) * static_cast<size_t>(tw) * 4;
-                    std::memcpy(dst, src, static_cast<size_t>(tw) * 4);
-                }
-                entry_perceptual_hash = compute_dhash(trimmed.data(), tw, th);
+                // Hash the trimmed region in place, without copying it out.
+                const size_t stride = static_cast<size_t>(w) * 4;
+                const unsigned char* region = data + static_cast<size_t>(min_y) * stride + static_cast<size_t>(min_x) * 4;
+                entry_content_hash = sprat::core::hash_rgba_region(region, loaded_sprite.w, loaded_sprite.h, stride);
+                entry_perceptual_hash = sprat::core::compute_dhash(region, loaded_sprite.w, loaded_sprite.h, stride);
             }
         } else {
             // Fully transparent image: keep a 1x1 transparent region.
@@ -4623,6 +5875,17 @@ int run_spratlayout(int argc, char** argv) {
             }
         }
 
+        if (!pixel_cache_dir.empty()) {
+            const sprat::core::PixelCacheRegion region{
+                .image_w=w, .image_h=h,
+                .x=loaded_sprite.trim_left, .y=loaded_sprite.trim_top,
+                .w=loaded_sprite.w, .h=loaded_sprite.h
+            };
+            const unsigned char* region_rgba = data +
+                (static_cast<size_t>(region.y) * static_cast<size_t>(w) + static_cast<size_t>(region.x)) * 4;
+            sprat::core::store_cached_pixels(pixel_cache_dir, source.file_path, meta.file_size,
+                                             meta.mtime_ticks, region, region_rgba, static_cast<size_t>(w) * 4);
+        }
         stbi_image_free(data);
         result.ok = true;
         result.sprite = loaded_sprite;
@@ -4651,6 +5914,8 @@ int run_spratlayout(int argc, char** argv) {
     load_worker_count = std::min<unsigned int>(
         load_worker_count, static_cast<unsigned int>(source_count));
 
+    sprat::core::ProfileScope load_scope("load");
+    load_scope.arg("sprites", static_cast<int64_t>(source_count));
     if (load_worker_count <= 1 || source_count <= 1) {
         for (size_t i = 0; i < source_count; ++i) process_source(i);
     } else {
@@ -4665,6 +5930,7 @@ int run_spratlayout(int argc, char** argv) {
         }
         for (auto& t : workers) t.join();
     }
+    load_scope.stop();
 
     // Serial collection pass: merge results in source order.
     // cache_entries writes are deferred here to avoid concurrent map mutations.
@@ -4680,17 +5946,15 @@ int run_spratlayout(int argc, char** argv) {
         }
         if (!r.ok) continue;
         sprites.push_back(r.sprite);
-        if (r.from_cache) {
-            auto it = cache_entries.find(r.cache_key);
-            if (it != cache_entries.end()) it->second.cached_at_unix = now_unix;
-        } else {
-            cache_entries[r.cache_key] = r.new_entry;
-        }
+        // Cache hits carry their entry with a refreshed timestamp, so every
+        // loaded sprite ends up here for the dedup pass below.
+        cache_entries[r.cache_key] = r.new_entry;
     }
 
-    save_image_cache(cache_path, cache_entries);
+    save_image_cache(cache_path, cache_entries, mapped_cache, now_unix);
 
     // Step 5: Deduplication pass
+    sprat::core::ProfileScope dedup_scope("dedup");
     std::vector<std::pair<std::string, std::string>> layout_aliases;
     if (deduplicateMode == "exact") {
         // O(N) hash-map dedup keyed by (content_hash, w, h)
@@ -4731,52 +5995,39 @@ int run_spratlayout(int argc, char** argv) {
         }
         sprites = std::move(deduped);
     } else if (deduplicateMode == "perceptual") {
-        // O(N²) pairwise + union-find dedup
         const size_t N = sprites.size();
-        // Gather hashes
         std::vector<uint64_t> phash(N, 0);
+        std::vector<uint64_t> size_keys(N, 0);
         for (size_t i = 0; i < N; ++i) {
             const std::string ck = sprites[i].path + (trim_transparent ? "|1" : "|0");
             const auto it = cache_entries.find(ck);
             if (it != cache_entries.end()) {
                 phash[i] = it->second.perceptual_hash;
             }
+            size_keys[i] = (static_cast<uint64_t>(static_cast<uint32_t>(sprites[i].w)) << 32)
+                         | static_cast<uint32_t>(sprites[i].h);
         }
-        // Union-find
-        std::vector<size_t> parent(N);
-        std::iota(parent.begin(), parent.end(), 0);
-        std::function<size_t(size_t)> find = [&](size_t x) -> size_t {
-            while (parent[x] != x) { parent[x] = parent[parent[x]]; x = parent[x]; }
-            return x;
-        };
-        for (size_t i = 0; i < N; ++i) {
-            if (phash[i] == 0) continue;
-            for (size_t j = i + 1; j < N; ++j) {
-                if (phash[j] == 0) continue;
-                if (sprites[i].w != sprites[j].w || sprites[i].h != sprites[j].h) continue;
-                if (popcount64(phash[i] ^ phash[j]) <= dedup_threshold) {
-                    size_t ri = find(i), rj = find(j);
-                    if (ri != rj) parent[rj] = ri;
-                }
-            }
-        }
-        // Build deduped list
-        std::unordered_map<size_t, size_t> canonical_map; // root -> first sprite index
-        canonical_map.reserve(N);
+        unsigned int dedup_worker_count =
+            thread_limit > 0 ? thread_limit : std::thread::hardware_concurrency();
+#ifdef __EMSCRIPTEN__
+        dedup_worker_count = 1;
+#endif
+        const std::vector<size_t> first_in_group = sprat::core::group_near_duplicate_hashes(
+            phash, size_keys, dedup_threshold, dedup_worker_count);
         std::vector<Sprite> deduped;
         deduped.reserve(N);
         for (size_t i = 0; i < N; ++i) {
-            size_t root = find(i);
-            auto [ins_it, inserted] = canonical_map.emplace(root, i);
-            if (inserted) {
+            if (first_in_group[i] == i) {
                 deduped.push_back(sprites[i]);
             } else {
-                layout_aliases.push_back({sprites[i].path, sprites[ins_it->second].path});
+                layout_aliases.push_back({sprites[i].path, sprites[first_in_group[i]].path});
             }
         }
         sprites = std::move(deduped);
     }
 
+    dedup_scope.stop();
+
     if (sprites.empty()) {
         std::cerr << tr("Error: no valid images found\n");
         return 1;
@@ -4848,6 +6099,7 @@ int run_spratlayout(int argc, char** argv) {
         sort_sprites_stable(sprites, stable_metric);
     }
 
+    sprat::core::ProfileScope pack_scope("pack");
     bool reused_layout_seed = false;
     bool have_layout_seed = false;
     LayoutSeedCache seed_cache;
@@ -4888,7 +6140,15 @@ int run_spratlayout(int argc, char** argv) {
         atlases.push_back({atlas_width, atlas_height});
         for (auto& s : sprites) { s.atlas_index = 0; }
     } else if (multipack) {
-        if (!pack_atlases(sprites, width_upper_bound, height_upper_bound, padding, mode, optimize_target, allow_rotate, enforce_name_order || enforce_stable_order, atlases)) {
+        unsigned int multipack_worker_count = thread_limit > 0 ? thread_limit : std::thread::hardware_concurrency();
+        if (multipack_worker_count == 0) {
+            multipack_worker_count = 1;
+        }
+#ifdef __EMSCRIPTEN__
+        multipack_worker_count = 1;
+#endif
+        if (!pack_atlases(sprites, width_upper_bound, height_upper_bound, padding, mode, optimize_target, allow_rotate,
+                          enforce_name_order || enforce_stable_order, multipack_worker_count, atlases)) {
             std::cerr << tr("Error: failed to compute multipack layout\n");
             return 1;
         }
@@ -5108,6 +6368,16 @@ int run_spratlayout(int argc, char** argv) {
                 sort_sprites_by_mode(sorted_sprites_by_mode[sort_idx], sort_modes[sort_idx]);
             }
         }
+        // Search tasks pack these sizes; only the selected candidate is turned
+        // back into sprites.
+        std::array<PackItems, k_sort_mode_count> pack_items_by_mode;
+        for (size_t sort_idx = 0; sort_idx < sort_modes.size(); ++sort_idx) {
+            pack_items_by_mode[sort_idx] = make_pack_items(sorted_sprites_by_mode[sort_idx]);
+        }
+        auto candidate_sprites = [&](const LayoutCandidate& candidate) {
+            return place_pack_items(sorted_sprites_by_mode[candidate.sort_idx],
+                                    pack_items_by_mode[candidate.sort_idx], candidate.placements);
+        };
 
         int seed_width = max_width;
         if (total_area > 0) {
@@ -5136,61 +6406,6 @@ int run_spratlayout(int argc, char** argv) {
 
         LayoutCandidate best_gpu_candidate;
         LayoutCandidate best_space_candidate;
-        auto consider_candidate = [&](LayoutCandidate&& candidate) {
-            if (!candidate.valid || candidate.w <= 0 || candidate.h <= 0) {
-                return;
-            }
-            const bool better_gpu =
-                !best_gpu_candidate.valid ||
-                pick_better_layout_candidate(
-                    candidate.area, candidate.w, candidate.h, true,
-                    best_gpu_candidate.area, best_gpu_candidate.w, best_gpu_candidate.h,
-                    OptimizeTarget::GPU);
-            const bool better_space =
-                !best_space_candidate.valid ||
-                pick_better_layout_candidate(
-                    candidate.area, candidate.w, candidate.h, true,
-                    best_space_candidate.area, best_space_candidate.w, best_space_candidate.h,
-                    OptimizeTarget::SPACE);
-
-            if (!better_gpu && !better_space) {
-                return;
-            }
-
-            if (better_gpu && better_space) {
-                best_gpu_candidate = std::move(candidate);
-                best_space_candidate = best_gpu_candidate;
-                return;
-            }
-            if (better_gpu) {
-                best_gpu_candidate = std::move(candidate);
-                return;
-            }
-            best_space_candidate = std::move(candidate);
-        };
-
-        std::vector<Sprite> seed_sprites;
-        for (size_t sort_idx = 0; sort_idx < sort_modes.size(); ++sort_idx) {
-            if (enforce_sort_order_compact && sort_modes[sort_idx] != SortMode::None) {
-                continue;
-            }
-            for (RectHeuristic rect_heuristic : rect_heuristics) {
-                seed_sprites.assign(sorted_sprites_by_mode[sort_idx].begin(), sorted_sprites_by_mode[sort_idx].end());
-                int seed_used_w = 0;
-                int seed_used_h = 0;
-                if (!pack_compact_maxrects(seed_sprites, seed_width, padding, height_upper_bound, rect_heuristic, allow_rotate, seed_used_w, seed_used_h)) {
-                    continue;
-                }
-                size_t seed_area = static_cast<size_t>(seed_used_w) * static_cast<size_t>(seed_used_h);
-                LayoutCandidate seed_candidate;
-                seed_candidate.valid = true;
-                seed_candidate.area = seed_area;
-                seed_candidate.w = seed_used_w;
-                seed_candidate.h = seed_used_h;
-                seed_candidate.sprites = std::move(seed_sprites);
-                consider_candidate(std::move(seed_candidate));
-            }
-        }
 
             // Guided compact search (no brute-force width scan):
             // start from fast/seed anchors, then probe a small nearby window.
@@ -5249,185 +6464,156 @@ int run_spratlayout(int argc, char** argv) {
             }
             std::ranges::sort(width_candidates);
 
-            if (!width_candidates.empty()) {
-                worker_count = std::min<unsigned int>(worker_count, static_cast<unsigned int>(width_candidates.size()));
-                std::vector<LayoutCandidate> worker_gpu(worker_count);
-                std::vector<LayoutCandidate> worker_space(worker_count);
-                const int min_square_side =
-                    total_area > 0
-                        ? static_cast<int>(std::ceil(std::sqrt(static_cast<long double>(total_area))))
-                        : 0;
-                auto select_better_candidate = [&](const LayoutCandidate& local_best, const LayoutCandidate& shared_best, OptimizeTarget target) -> const LayoutCandidate* {
-                    if (!local_best.valid) {
-                        return shared_best.valid ? &shared_best : nullptr;
-                    }
-                    if (!shared_best.valid) {
-                        return &local_best;
-                    }
-                    if (pick_better_layout_candidate(
-                            local_best.area, local_best.w, local_best.h, true,
-                            shared_best.area, shared_best.w, shared_best.h,
-                            target)) {
-                        return &local_best;
-                    }
-                    return &shared_best;
-                };
-                auto width_could_beat_best = [&](int width, const LayoutCandidate& local_best, const LayoutCandidate& shared_best, OptimizeTarget target) {
-                    const LayoutCandidate* best = select_better_candidate(local_best, shared_best, target);
-                    if (best == nullptr || total_area == 0) {
-                        return true;
-                    }
-                    const size_t width_size = static_cast<size_t>(width);
-                    const size_t min_height_size = (total_area + width_size - 1) / width_size;
-                    if (min_height_size > static_cast<size_t>(std::numeric_limits<int>::max())) {
-                        return false;
+            // Every seed-width pack, guided (width, sort, heuristic) pack and
+            // (width, sort) shelf pack is its own task, in the order a sequential
+            // search would visit them. Candidates rank by the optimize target and then
+            // by task index, so the selected layout never depends on which worker ran
+            // what; tasks whose width can no longer win against the shared best are
+            // skipped.
+            struct CompactSearchTask {
+                int width = 0;
+                size_t sort_idx = 0;
+                RectHeuristic heuristic = RectHeuristic::BestShortSideFit;
+                bool shelf = false;
+            };
+            std::vector<CompactSearchTask> search_tasks;
+            for (size_t sort_idx = 0; sort_idx < sort_modes.size(); ++sort_idx) {
+                if (enforce_sort_order_compact && sort_modes[sort_idx] != SortMode::None) {
+                    continue;
+                }
+                for (RectHeuristic rect_heuristic : rect_heuristics) {
+                    search_tasks.push_back({.width = seed_width, .sort_idx = sort_idx, .heuristic = rect_heuristic});
+                }
+            }
+            for (int width : width_candidates) {
+                for (size_t sort_idx : k_guided_sort_indices) {
+                    if (enforce_sort_order_compact && sort_idx != k_sort_mode_index_none) {
+                        continue;
                     }
-                    const int min_height = static_cast<int>(min_height_size);
-                    const int min_max_side = std::max(min_square_side, min_height);
-                    const int optimistic_w = std::min(width, min_max_side);
-                    const int optimistic_h = min_max_side;
-                    return pick_better_layout_candidate(
-                        total_area, optimistic_w, optimistic_h, true,
-                        best->area, best->w, best->h,
-                        target);
-                };
-                auto run_guided_worker = [&](std::atomic<size_t>* next_width_index, size_t begin, size_t end, LayoutCandidate& out_gpu, LayoutCandidate& out_space) {
-                    LayoutCandidate local_best_gpu;
-                    LayoutCandidate local_best_space;
-                    auto consider_local = [&](LayoutCandidate&& candidate) {
-                        if (!candidate.valid || candidate.w <= 0 || candidate.h <= 0) {
-                            return;
-                        }
-                        const bool better_gpu =
-                            !local_best_gpu.valid ||
-                            pick_better_layout_candidate(
-                                candidate.area, candidate.w, candidate.h, true,
-                                local_best_gpu.area, local_best_gpu.w, local_best_gpu.h,
-                                OptimizeTarget::GPU);
-                        const bool better_space =
-                            !local_best_space.valid ||
-                            pick_better_layout_candidate(
-                                candidate.area, candidate.w, candidate.h, true,
-                                local_best_space.area, local_best_space.w, local_best_space.h,
-                                OptimizeTarget::SPACE);
-                        if (!better_gpu && !better_space) {
-                            return;
-                        }
-                        if (better_gpu && better_space) {
-                            local_best_gpu = std::move(candidate);
-                            local_best_space = local_best_gpu;
-                            return;
-                        }
-                        if (better_gpu) {
-                            local_best_gpu = std::move(candidate);
-                            return;
-                        }
-                        local_best_space = std::move(candidate);
-                    };
-
-                    std::vector<Sprite> trial_sprites;
-                    std::vector<Sprite> shelf_sprites;
-                    while (true) {
-                        size_t width_index = begin;
-                        if (next_width_index != nullptr) {
-                            width_index = next_width_index->fetch_add(1, std::memory_order_relaxed);
-                            if (width_index >= end) {
-                                break;
-                            }
-                        } else if (width_index < end) {
-                            ++begin;
-                        } else {
-                            break;
-                        }
-
-                        const int width = width_candidates[width_index];
-                        if (!width_could_beat_best(width, local_best_gpu, best_gpu_candidate, OptimizeTarget::GPU) &&
-                            !width_could_beat_best(width, local_best_space, best_space_candidate, OptimizeTarget::SPACE)) {
-                            continue;
-                        }
-
-                        bool continue_width_search = true;
-                        for (size_t sort_idx : k_guided_sort_indices) {
-                            if (enforce_sort_order_compact && sort_idx != k_sort_mode_index_none) {
-                                continue;
-                            }
-
-                            for (RectHeuristic rect_heuristic : k_guided_heuristics) {
-                                trial_sprites.assign(sorted_sprites_by_mode[sort_idx].begin(), sorted_sprites_by_mode[sort_idx].end());
-                                int used_w = 0;
-                                int used_h = 0;
-                                if (!pack_compact_maxrects(trial_sprites, width, padding, height_upper_bound, rect_heuristic, allow_rotate, used_w, used_h)) {
-                                    continue;
-                                }
-                                size_t area = static_cast<size_t>(used_w) * static_cast<size_t>(used_h);
-                                LayoutCandidate candidate;
-                                candidate.valid = true;
-                                candidate.area = area;
-                                candidate.w = used_w;
-                                candidate.h = used_h;
-                                candidate.sprites = std::move(trial_sprites);
-                                consider_local(std::move(candidate));
-                                if (!width_could_beat_best(width, local_best_gpu, best_gpu_candidate, OptimizeTarget::GPU) &&
-                                    !width_could_beat_best(width, local_best_space, best_space_candidate, OptimizeTarget::SPACE)) {
-                                    continue_width_search = false;
-                                    break;
-                                }
-                            }
-                            if (!continue_width_search) {
-                                break;
-                            }
-
-                            shelf_sprites.assign(sorted_sprites_by_mode[sort_idx].begin(), sorted_sprites_by_mode[sort_idx].end());
-                            int shelf_w = 0;
-                            int shelf_h = 0;
-                            if (!pack_fast_shelf(shelf_sprites, width, padding, allow_rotate, shelf_w, shelf_h)) {
-                                continue;
-                            }
-                            if (shelf_h > height_upper_bound) {
-                                continue;
-                            }
-                            size_t shelf_area = static_cast<size_t>(shelf_w) * static_cast<size_t>(shelf_h);
-                            LayoutCandidate shelf_candidate;
-                            shelf_candidate.valid = true;
-                            shelf_candidate.area = shelf_area;
-                            shelf_candidate.w = shelf_w;
-                            shelf_candidate.h = shelf_h;
-                            shelf_candidate.sprites = std::move(shelf_sprites);
-                            consider_local(std::move(shelf_candidate));
-                            if (!width_could_beat_best(width, local_best_gpu, best_gpu_candidate, OptimizeTarget::GPU) &&
-                                !width_could_beat_best(width, local_best_space, best_space_candidate, OptimizeTarget::SPACE)) {
-                                break;
-                            }
-                        }
+                    for (RectHeuristic rect_heuristic : k_guided_heuristics) {
+                        search_tasks.push_back({.width = width, .sort_idx = sort_idx, .heuristic = rect_heuristic});
                     }
+                    search_tasks.push_back({.width = width, .sort_idx = sort_idx, .shelf = true});
+                }
+            }
 
-                    out_gpu = std::move(local_best_gpu);
-                    out_space = std::move(local_best_space);
-                };
-
-                if (worker_count == 1) {
-                    run_guided_worker(nullptr, 0, width_candidates.size(), worker_gpu[0], worker_space[0]);
-                } else {
-                    std::atomic<size_t> next_width_index{0};
-                    std::vector<std::thread> workers;
-                    workers.reserve(worker_count);
-                    for (unsigned int worker_index = 0; worker_index < worker_count; ++worker_index) {
-                        workers.emplace_back([&, worker_index]() {
-                            run_guided_worker(&next_width_index, 0, width_candidates.size(), worker_gpu[worker_index], worker_space[worker_index]);
-                        });
+            const int min_square_side =
+                total_area > 0
+                    ? static_cast<int>(std::ceil(std::sqrt(static_cast<long double>(total_area))))
+                    : 0;
+            std::mutex best_mutex;
+            size_t best_gpu_task = 0;
+            size_t best_space_task = 0;
+            auto ranks_ahead = [&](size_t area, int w, int h, size_t task_index,
+                                   const LayoutCandidate& best, size_t best_task, OptimizeTarget target) {
+                if (!best.valid ||
+                    pick_better_layout_candidate(area, w, h, true, best.area, best.w, best.h, target)) {
+                    return true;
+                }
+                if (pick_better_layout_candidate(best.area, best.w, best.h, true, area, w, h, target)) {
+                    return false;
+                }
+                return task_index < best_task;
+            };
+            // Caller holds best_mutex.
+            auto task_could_win = [&](int width, size_t task_index) {
+                if (total_area == 0 || !best_gpu_candidate.valid) {
+                    return true;
+                }
+                const size_t width_size = static_cast<size_t>(width);
+                const size_t min_height_size = (total_area + width_size - 1) / width_size;
+                if (min_height_size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+                    return false;
+                }
+                const int min_height = static_cast<int>(min_height_size);
+                const int min_max_side = std::max(min_square_side, min_height);
+                const int optimistic_w = std::min(width, min_max_side);
+                const int optimistic_h = min_max_side;
+                return ranks_ahead(total_area, optimistic_w, optimistic_h, task_index,
+                                   best_gpu_candidate, best_gpu_task, OptimizeTarget::GPU) ||
+                       ranks_ahead(total_area, optimistic_w, optimistic_h, task_index,
+                                   best_space_candidate, best_space_task, OptimizeTarget::SPACE);
+            };
+            std::atomic<size_t> skipped_tasks{0};
+            std::atomic<size_t> aborted_tasks{0};
+            auto run_search_task = [&](size_t task_index) {
+                const CompactSearchTask& task = search_tasks[task_index];
+                CompactPackBound bound;
+                bool have_bound = false;
+                {
+                    std::lock_guard<std::mutex> lock(best_mutex);
+                    if (!task_could_win(task.width, task_index)) {
+                        skipped_tasks.fetch_add(1, std::memory_order_relaxed);
+                        return;
                     }
-                    for (auto& worker : workers) {
-                        worker.join();
+                    if (best_gpu_candidate.valid && best_space_candidate.valid) {
+                        bound.gpu_area = best_gpu_candidate.area;
+                        bound.gpu_max_side = std::max(best_gpu_candidate.w, best_gpu_candidate.h);
+                        bound.space_area = best_space_candidate.area;
+                        bound.space_max_side = std::max(best_space_candidate.w, best_space_candidate.h);
+                        bound.total_area = total_area;
+                        bound.min_square_side = min_square_side;
+                        have_bound = true;
                     }
                 }
-                for (unsigned int i = 0; i < worker_count; ++i) {
-                    if (worker_gpu[i].valid) {
-                        consider_candidate(std::move(worker_gpu[i]));
+
+                // Each worker packs into its own buffer; a winning task hands the
+                // buffer to its candidate and takes over the one it replaces.
+                thread_local std::vector<Placement> placements;
+                const PackItems& items = pack_items_by_mode[task.sort_idx];
+                int used_w = 0;
+                int used_h = 0;
+                if (task.shelf) {
+                    if (!pack_fast_shelf(items, task.width, padding, allow_rotate, placements, used_w, used_h) ||
+                        used_h > height_upper_bound) {
+                        return;
                     }
-                    if (worker_space[i].valid) {
-                        consider_candidate(std::move(worker_space[i]));
+                } else if (!pack_compact_maxrects(items, task.width, padding, height_upper_bound, task.heuristic, allow_rotate, placements, used_w, used_h,
+                                                  have_bound ? &bound : nullptr)) {
+                    if (bound.aborted) {
+                        aborted_tasks.fetch_add(1, std::memory_order_relaxed);
                     }
+                    return;
+                }
+                if (used_w <= 0 || used_h <= 0) {
+                    return;
+                }
+                const size_t area = static_cast<size_t>(used_w) * static_cast<size_t>(used_h);
+
+                std::lock_guard<std::mutex> lock(best_mutex);
+                const bool better_gpu = ranks_ahead(area, used_w, used_h, task_index,
+                                                    best_gpu_candidate, best_gpu_task, OptimizeTarget::GPU);
+                const bool better_space = ranks_ahead(area, used_w, used_h, task_index,
+                                                      best_space_candidate, best_space_task, OptimizeTarget::SPACE);
+                if (!better_gpu && !better_space) {
+                    return;
+                }
+                LayoutCandidate& winner = better_gpu ? best_gpu_candidate : best_space_candidate;
+                winner.valid = true;
+                winner.area = area;
+                winner.w = used_w;
+                winner.h = used_h;
+                winner.sort_idx = task.sort_idx;
+                winner.placements.swap(placements);
+                if (better_gpu && better_space) {
+                    best_space_candidate = best_gpu_candidate;
+                    best_gpu_task = task_index;
+                    best_space_task = task_index;
+                } else if (better_gpu) {
+                    best_gpu_task = task_index;
+                } else {
+                    best_space_task = task_index;
                 }
+            };
+            run_work_stealing(search_tasks.size(), worker_count, run_search_task);
+            sprat::core::profile_count("compact.candidate_widths", static_cast<int64_t>(width_candidates.size()));
+            sprat::core::profile_count("compact.search_tasks", static_cast<int64_t>(search_tasks.size()));
+            sprat::core::profile_count("compact.skipped_tasks", static_cast<int64_t>(skipped_tasks.load()));
+            sprat::core::profile_count("compact.aborted_tasks", static_cast<int64_t>(aborted_tasks.load()));
+            if (debug) {
+                std::cerr << "[compact-debug] search_tasks=" << search_tasks.size()
+                          << " skipped=" << skipped_tasks.load()
+                          << " aborted=" << aborted_tasks.load() << "\n";
             }
 
             const LayoutCandidate* selected_candidate = nullptr;
@@ -5451,7 +6637,7 @@ int run_spratlayout(int argc, char** argv) {
                 return 1;
             }
 
-            sprites = selected_candidate->sprites;
+            sprites = candidate_sprites(*selected_candidate);
             atlas_width = selected_candidate->w;
             atlas_height = selected_candidate->h;
 
@@ -5520,15 +6706,17 @@ int run_spratlayout(int argc, char** argv) {
                         ? input_context.working_folder.parent_path()
                         : input_context.working_folder;
                     const std::string prewarm_output = build_layout_output_text(
-                        prewarm_atlases,
-                        prewarm_scale,
-                        extrude,
-                        prewarm_trim_transparent,
-                        false,
-                        prewarm_candidate.sprites,
-                        empty_prewarm_aliases,
-                        false,
-                        prewarm_root
+                        build_core_layout(
+                            prewarm_atlases,
+                            prewarm_scale,
+                            extrude,
+                            prewarm_trim_transparent,
+                            false,
+                            candidate_sprites(prewarm_candidate),
+                            empty_prewarm_aliases,
+                            prewarm_root
+                        ),
+                        false
                     );
                     save_output_cache(
                         build_output_cache_path(cache_path, prewarm_signature),
@@ -5591,18 +6779,19 @@ int run_spratlayout(int argc, char** argv) {
                 sort_sprites_by_mode(sorted_sprites, SortMode::Height);
             }
 
+            const PackItems items = make_pack_items(sorted_sprites);
+            std::vector<Placement> placements;
             bool packed = false;
             for (int width = target_width; width <= width_upper_bound; ++width) {
-                std::vector<Sprite> trial_sprites = sorted_sprites;
                 int packed_width = 0;
                 int packed_height = 0;
-                if (!pack_fast_shelf(trial_sprites, width, padding, allow_rotate, packed_width, packed_height)) {
+                if (!pack_fast_shelf(items, width, padding, allow_rotate, placements, packed_width, packed_height)) {
                     continue;
                 }
                 if (packed_height > height_upper_bound) {
                     continue;
                 }
-                sprites = std::move(trial_sprites);
+                sprites = place_pack_items(sorted_sprites, items, placements);
                 atlas_width = packed_width;
                 atlas_height = packed_height;
                 packed = true;
@@ -5700,10 +6889,13 @@ int run_spratlayout(int argc, char** argv) {
         }
     }
 
+    pack_scope.stop();
+
+    sprat::core::ProfileScope output_scope("output");
     const fs::path output_root = (input_context.type == InputType::ListFile)
         ? input_context.working_folder.parent_path()
         : input_context.working_folder;
-    const std::string output_text = build_layout_output_text(
+    sprat::core::Layout layout = build_core_layout(
         atlases,
         scale,
         extrude,
@@ -5711,26 +6903,36 @@ int run_spratlayout(int argc, char** argv) {
         multipack,
         sprites,
         layout_aliases,
-        debug,
         output_root
     );
+    std::string output_text = build_layout_output_text(layout, debug);
 
 #ifdef _WIN32
     // Suppress failure: non-fatal when running embedded or as a GUI subprocess.
     _setmode(_fileno(stdout), _O_BINARY);
 #endif
 
-    std::cout << output_text;
+    if (out_layout == nullptr) {
+        std::cout << output_text;
+    }
     if (!multipack) {
         save_output_cache(output_cache_path, layout_signature, output_text);
     }
     prune_cache_family(cache_path, k_cache_max_age_seconds, k_cache_max_layout_files, k_cache_max_seed_files);
-
-    // Cleanup temporary directories for tar files
-    for (const auto& dir : input_context.temp_dirs_to_cleanup) {
-        std::error_code ec;
-        fs::remove_all(dir, ec);
+    if (out_layout != nullptr) {
+        *out_layout = std::move(layout);
+        *out_text = std::move(output_text);
     }
 
     return 0;
 }
+
+} // namespace
+
+int run_spratlayout(int argc, char** argv) {
+    return run_layout(argc, argv, nullptr, nullptr);
+}
+
+int run_spratlayout_layout(int argc, char** argv, sprat::core::Layout& layout, std::string& layout_text) {
+    return run_layout(argc, argv, &layout, &layout_text);
+}
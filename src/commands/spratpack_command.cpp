@@ -27,35 +27,31 @@
 #include <string>
 #include <cstring>
 #include <limits>
+#include <cmath>
+#include <cstdint>
 #include <array>
 #include <atomic>
+#include <condition_variable>
 #include <mutex>
 #include <thread>
 #include <utility>
 #include <fstream>
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <unordered_map>
 #include <archive.h>
 #include <archive_entry.h>
+#include "core/atlas_encoders.h"
 #include "core/layout_parser.h"
 #include "core/cli_parse.h"
 #include "core/i18n.h"
 #include "core/output_pattern.h"
-
-#ifdef SPRAT_HAS_ZOPFLI
-#include <zopflipng/zopflipng_lib.h>
-#endif
-
-#ifdef SPRAT_HAS_SQUISH
-#include <squish.h>
-#endif
-
-#ifdef SPRAT_HAS_WEBP
-#include <webp/encode.h>
-#endif
-
-#ifdef SPRAT_HAS_AVIF
-#include <avif/avif.h>
-#endif
+#include "core/pixel_cache.h"
+#include "core/pixel_kernels.h"
+#include "core/png_stream_writer.h"
+#include "core/profiler.h"
+#include "commands/entrypoints.h"
 
 namespace {
 
@@ -189,35 +185,86 @@ bool rectangles_overlap(const Sprite& a, const Sprite& b) {
     return a_right > b.x && b_right > a.x && a_bottom > b.y && b_bottom > a.y;
 }
 
-bool sprites_have_overlap(const std::vector<Sprite>& sprites) {
-    if (sprites.size() < 2) {
-        return false;
+// Groups sprites whose rectangles overlap, directly or through a chain of
+// other sprites. Each set lists its sprites in layout order, so blitting a
+// set front to back keeps the painter's order, while different sets never
+// touch the same pixels and can be blitted concurrently. Candidate pairs come
+// from a uniform grid sized to the average sprite, so only sprites sharing a
+// cell are compared.
+std::vector<std::vector<size_t>> overlap_conflict_sets(const std::vector<Sprite>& sprites) {
+    const size_t count = sprites.size();
+    std::vector<size_t> parent(count);
+    for (size_t i = 0; i < count; ++i) {
+        parent[i] = i;
     }
-    std::vector<size_t> order(sprites.size());
-    for (size_t i = 0; i < sprites.size(); ++i) {
-        order[i] = i;
+    auto find = [&](size_t i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    };
+
+    double area = 0.0;
+    size_t sized = 0;
+    for (const auto& s : sprites) {
+        if (s.w > 0 && s.h > 0) {
+            area += static_cast<double>(s.w) * static_cast<double>(s.h);
+            ++sized;
+        }
     }
-    std::ranges::sort(order, [&](size_t lhs, size_t rhs) {
-        if (sprites[lhs].x != sprites[rhs].x) {
-            return sprites[lhs].x < sprites[rhs].x;
+    if (sized > 1) {
+        const int cell = std::max(1, static_cast<int>(std::ceil(std::sqrt(area / static_cast<double>(sized)))));
+        // (cell key, sprite) pairs; sorting brings sprites sharing a cell together.
+        std::vector<std::pair<uint64_t, size_t>> cells;
+        cells.reserve(sized * 4);
+        for (size_t i = 0; i < count; ++i) {
+            const Sprite& s = sprites[i];
+            if (s.w <= 0 || s.h <= 0) {
+                continue;
+            }
+            const int cx0 = std::max(0, s.x) / cell;
+            const int cy0 = std::max(0, s.y) / cell;
+            const int cx1 = std::max(0, s.x + s.w - 1) / cell;
+            const int cy1 = std::max(0, s.y + s.h - 1) / cell;
+            for (int cy = cy0; cy <= cy1; ++cy) {
+                for (int cx = cx0; cx <= cx1; ++cx) {
+                    cells.emplace_back((static_cast<uint64_t>(static_cast<uint32_t>(cy)) << 32) | static_cast<uint32_t>(cx), i);
+                }
+            }
         }
-        return sprites[lhs].y < sprites[rhs].y;
-    });
-
-    for (size_t i = 0; i < order.size(); ++i) {
-        const Sprite& a = sprites[order[i]];
-        const int a_right = a.x + a.w;
-        for (size_t j = i + 1; j < order.size(); ++j) {
-            const Sprite& b = sprites[order[j]];
-            if (b.x >= a_right) {
-                break;
+        std::ranges::sort(cells);
+        for (size_t begin = 0; begin < cells.size();) {
+            size_t end = begin + 1;
+            while (end < cells.size() && cells[end].first == cells[begin].first) {
+                ++end;
             }
-            if (rectangles_overlap(a, b)) {
-                return true;
+            for (size_t i = begin; i < end; ++i) {
+                for (size_t j = i + 1; j < end; ++j) {
+                    const size_t a = find(cells[i].second);
+                    const size_t b = find(cells[j].second);
+                    if (a != b && rectangles_overlap(sprites[cells[i].second], sprites[cells[j].second])) {
+                        parent[std::max(a, b)] = std::min(a, b);
+                    }
+                }
             }
+            begin = end;
         }
     }
-    return false;
+
+    // Roots are the lowest index of their set, so sets come out ordered by
+    // their first sprite and members are appended in layout order.
+    std::vector<std::vector<size_t>> sets;
+    std::vector<size_t> set_of_root(count, count);
+    for (size_t i = 0; i < count; ++i) {
+        const size_t root = find(i);
+        if (set_of_root[root] == count) {
+            set_of_root[root] = sets.size();
+            sets.emplace_back();
+        }
+        sets[set_of_root[root]].push_back(i);
+    }
+    return sets;
 }
 
 
@@ -231,48 +278,9 @@ void extrude_atlas(
     if (extrude <= 0) {
         return;
     }
-
-    auto set_pixel = [&](int dx, int dy, int sx, int sy) {
-        if (dx < 0 || dy < 0 || dx >= atlas_width || dy >= atlas_height ||
-            sx < 0 || sy < 0 || sx >= atlas_width || sy >= atlas_height) {
-            return;
-        }
-        size_t dest_offset = (static_cast<size_t>(dy) * atlas_width + dx) * NUM_CHANNELS;
-        size_t src_offset = (static_cast<size_t>(sy) * atlas_width + sx) * NUM_CHANNELS;
-        std::memcpy(&atlas[dest_offset], &atlas[src_offset], NUM_CHANNELS);
-    };
-
+    const size_t stride = static_cast<size_t>(atlas_width) * NUM_CHANNELS;
     for (const auto& s : sprites) {
-        if (s.w <= 0 || s.h <= 0) {
-            continue;
-        }
-        // Extrude sides
-        for (int e = 1; e <= extrude; ++e) {
-            // Left & Right sides
-            for (int y = 0; y < s.h; ++y) {
-                set_pixel(s.x - e, s.y + y, s.x, s.y + y);
-                set_pixel(s.x + s.w - 1 + e, s.y + y, s.x + s.w - 1, s.y + y);
-            }
-            // Top & Bottom sides
-            for (int x = 0; x < s.w; ++x) {
-                set_pixel(s.x + x, s.y - e, s.x + x, s.y);
-                set_pixel(s.x + x, s.y + s.h - 1 + e, s.x + x, s.y + s.h - 1);
-            }
-        }
-
-        // Extrude corners
-        for (int ey = 1; ey <= extrude; ++ey) {
-            for (int ex = 1; ex <= extrude; ++ex) {
-                // Top-Left
-                set_pixel(s.x - ex, s.y - ey, s.x, s.y);
-                // Top-Right
-                set_pixel(s.x + s.w - 1 + ex, s.y - ey, s.x + s.w - 1, s.y);
-                // Bottom-Left
-                set_pixel(s.x - ex, s.y + s.h - 1 + ey, s.x, s.y + s.h - 1);
-                // Bottom-Right
-                set_pixel(s.x + s.w - 1 + ex, s.y + s.h - 1 + ey, s.x + s.w - 1, s.y + s.h - 1);
-            }
-        }
+        sprat::core::extrude_rect(atlas.data(), atlas_width, atlas_height, stride, s.x, s.y, s.w, s.h, extrude);
     }
 }
 
@@ -291,23 +299,7 @@ void dilate_sprite_colors(
     // After each pass we copy only the affected sprite region back instead of the full atlas.
     std::vector<unsigned char> read_buf = atlas;
 
-    auto get_pixel = [&](const std::vector<unsigned char>& buf, int px, int py, size_t channel) -> unsigned char {
-        if (px < 0 || py < 0 || px >= atlas_width || py >= atlas_height) {
-            return 0;
-        }
-        size_t offset = (static_cast<size_t>(py) * atlas_width + px) * NUM_CHANNELS + channel;
-        return buf[offset];
-    };
-
-    auto set_pixel_rgb = [&](int px, int py, unsigned char r, unsigned char g, unsigned char b) {
-        if (px < 0 || py < 0 || px >= atlas_width || py >= atlas_height) {
-            return;
-        }
-        size_t offset = (static_cast<size_t>(py) * atlas_width + px) * NUM_CHANNELS;
-        atlas[offset + CHANNEL_R] = r;
-        atlas[offset + CHANNEL_G] = g;
-        atlas[offset + CHANNEL_B] = b;
-    };
+    const size_t stride = static_cast<size_t>(atlas_width) * NUM_CHANNELS;
 
     for (const auto& s : sprites) {
         if (s.w <= 0 || s.h <= 0) {
@@ -331,207 +323,56 @@ void dilate_sprite_colors(
 
             // Check pixels around (and outside) each sprite
             for (int y = region_y0; y <= region_y1; ++y) {
-                for (int x = region_x0; x <= region_x1; ++x) {
-                    // Only process transparent pixels
-                    if (get_pixel(read_buf, x, y, CHANNEL_A) != 0) {
-                        continue;
-                    }
-
-                    // Check 4 cardinal directions for opaque neighbors
-                    constexpr int dx[] = {-1, 1, 0, 0};
-                    constexpr int dy[] = {0, 0, -1, 1};
-                    for (int dir = 0; dir < 4; ++dir) {
-                        int nx = x + dx[dir];
-                        int ny = y + dy[dir];
-                        unsigned char alpha = get_pixel(read_buf, nx, ny, CHANNEL_A);
-                        if (alpha != 0) {
-                            // Found opaque neighbor, copy its RGB
-                            unsigned char r = get_pixel(read_buf, nx, ny, CHANNEL_R);
-                            unsigned char g = get_pixel(read_buf, nx, ny, CHANNEL_G);
-                            unsigned char b = get_pixel(read_buf, nx, ny, CHANNEL_B);
-                            set_pixel_rgb(x, y, r, g, b);
-                            break;  // Only copy from first opaque neighbor
-                        }
-                    }
-                }
+                sprat::core::dilate_row(read_buf.data(), atlas.data(), atlas_width, atlas_height, stride,
+                                        y, region_x0, region_x1);
             }
         }
     }
 }
 
-#ifdef SPRAT_HAS_SQUISH
-std::vector<unsigned char> compress_to_dds(
-    const std::vector<unsigned char>& rgba_data,
-    int width,
-    int height,
-    const std::string& format
-) {
-    std::vector<unsigned char> dds_output;
-
-    // Validate dimensions are multiple of 4 (DXT requirement)
-    if (width % 4 != 0 || height % 4 != 0) {
-        return dds_output;  // Return empty on error
-    }
-
-    // Determine compression flags
-    int squish_flags = 0;
-    if (format == "dxt1" || format == "DXT1") {
-        squish_flags = squish::kDxt1 | squish::kColourClusterFit;
-    } else {
-        squish_flags = squish::kDxt5 | squish::kColourClusterFit;
-    }
-
-    // Compute compressed size (DXT1: width*height/2, DXT5: width*height)
-    size_t compressed_bytes = (format == "dxt1" || format == "DXT1")
-                              ? (static_cast<size_t>(width) * static_cast<size_t>(height)) / 2
-                              : static_cast<size_t>(width) * static_cast<size_t>(height);
-
-    // Build minimal DDS header (128 bytes)
-    struct DdsHeader {
-        uint32_t magic;               // 0x20534444 = "DDS "
-        uint32_t size;                // Header size (124 bytes)
-        uint32_t flags;               // Surface descriptor flags
-        uint32_t height;              // Texture height
-        uint32_t width;               // Texture width
-        uint32_t pitch_or_linear;     // Pitch or linear size
-        uint32_t depth;               // Texture depth (0 for 2D)
-        uint32_t mipmap_count;        // Number of mipmaps
-        uint32_t reserved[11];        // Reserved/unused
-        // PixelFormat (32 bytes)
-        struct {
-            uint32_t size;            // PixelFormat size (32 bytes)
-            uint32_t flags;           // Flags
-            uint32_t fourcc;          // FourCC code
-            uint32_t rgb_bit_count;   // RGB bits
-            uint32_t r_mask;          // Red mask
-            uint32_t g_mask;          // Green mask
-            uint32_t b_mask;          // Blue mask
-            uint32_t a_mask;          // Alpha mask
-        } pixel_format;
-        // Caps (16 bytes)
-        uint32_t caps1;
-        uint32_t caps2;
-        uint32_t caps3;
-        uint32_t caps4;
-        uint32_t reserved2;
-    };
-    static_assert(sizeof(DdsHeader) == 128, "DDS header must be 128 bytes");
-
-    DdsHeader header = {};
-    header.magic = 0x20534444;  // "DDS "
-    header.size = 124;
-    header.flags = 0x0001 | 0x0002 | 0x0004 | 0x1000;  // CAPS | HEIGHT | WIDTH | LINEARSIZE
-    header.height = static_cast<uint32_t>(height);
-    header.width = static_cast<uint32_t>(width);
-    header.pitch_or_linear = static_cast<uint32_t>(compressed_bytes);
-    header.depth = 0;
-    header.mipmap_count = 1;
-
-    header.pixel_format.size = 32;
-    header.pixel_format.flags = 0x0004;  // FOURCC
-    header.pixel_format.fourcc = (format == "dxt1" || format == "DXT1") ? 0x31545844 : 0x35545844;  // "DXT1" or "DXT5"
-
-    header.caps1 = 0x1000;  // TEXTURE
-
-    // Write header
-    const unsigned char* header_bytes = reinterpret_cast<const unsigned char*>(&header);
-    dds_output.insert(dds_output.end(), header_bytes, header_bytes + sizeof(header));
-
-    // Compress and append data
-    std::vector<unsigned char> compressed(compressed_bytes);
-    squish::CompressImage(rgba_data.data(), static_cast<int>(width), static_cast<int>(height),
-                         compressed.data(), squish_flags);
-    dds_output.insert(dds_output.end(), compressed.begin(), compressed.end());
-
-    return dds_output;
-}
-#endif
-
-#ifdef SPRAT_HAS_WEBP
-std::vector<unsigned char> encode_webp(
-    const unsigned char* rgba_data,
-    int width,
-    int height,
-    int quality
-) {
-    uint8_t* output = nullptr;
-    size_t output_size = 0;
-
-    if (quality >= 100) {
-        output_size = WebPEncodeLosslessRGBA(rgba_data, width, height,
-                                              width * 4, &output);
-    } else {
-        float q = (quality < 0) ? 100.0f : static_cast<float>(quality);
-        output_size = WebPEncodeRGBA(rgba_data, width, height,
-                                      width * 4, q, &output);
+struct StbImageDeleter {
+    void operator()(unsigned char* p) const { stbi_image_free(p); }
+};
+
+// Sprite pixels ready for the atlas: `pixels` is the unrotated destination-size
+// image, `stride` bytes per row, backed by whichever buffer below holds it.
+struct PreparedSprite {
+    sprat::core::CachedPixels cached;
+    std::unique_ptr<unsigned char, StbImageDeleter> image;
+    std::vector<unsigned char> owned;
+    const unsigned char* pixels = nullptr;
+    size_t stride = 0;
+};
+
+// Placements with the same key prepare to identical pixels: same source file,
+// crop, quantization and destination size. Rotation is applied while
+// blitting, so rotated and unrotated placements share one decode.
+std::string prepared_source_key(const Sprite& s) {
+    const int dest_w = s.rotated ? s.h : s.w;
+    const int dest_h = s.rotated ? s.w : s.h;
+    std::string key = s.path;
+    key.push_back('\0');
+    for (int v : {s.has_trim ? 1 : 0, s.src_x, s.src_y, s.trim_right, s.trim_bottom,
+                  s.colors, s.dither ? 1 : 0, dest_w, dest_h}) {
+        key += std::to_string(v);
+        key.push_back(',');
     }
-
-    std::vector<unsigned char> result;
-    if (output_size > 0 && output) {
-        result.assign(output, output + output_size);
-    }
-    WebPFree(output);
-    return result;
+    return key;
 }
-#endif
 
-#ifdef SPRAT_HAS_AVIF
-std::vector<unsigned char> encode_avif(
-    const unsigned char* rgba_data,
-    int width,
-    int height,
-    int quality
+// Copies the sprite rows that fall inside [band_y0, band_y1) into `band`, which
+// holds those atlas rows; 90° CW rotation is applied while copying.
+void blit_sprite_rows(
+    const Sprite& s,
+    const PreparedSprite& prepared,
+    unsigned char* band,
+    int atlas_width,
+    int band_y0,
+    int band_y1
 ) {
-    std::vector<unsigned char> result;
-
-    avifImage* image = avifImageCreate(width, height, 8, AVIF_PIXEL_FORMAT_YUV444);
-    if (!image) return result;
-
-    image->matrixCoefficients = AVIF_MATRIX_COEFFICIENTS_IDENTITY;
-    image->yuvRange = AVIF_RANGE_FULL;
-
-    avifRGBImage rgb;
-    avifRGBImageSetDefaults(&rgb, image);
-    rgb.format = AVIF_RGB_FORMAT_RGBA;
-    rgb.depth = 8;
-    rgb.pixels = const_cast<uint8_t*>(rgba_data);
-    rgb.rowBytes = static_cast<uint32_t>(width) * 4;
-
-    if (avifImageRGBToYUV(image, &rgb) != AVIF_RESULT_OK) {
-        avifImageDestroy(image);
-        return result;
-    }
-
-    avifEncoder* encoder = avifEncoderCreate();
-    if (!encoder) {
-        avifImageDestroy(image);
-        return result;
-    }
-
-    if (quality >= 100 || quality < 0) {
-        encoder->quality = AVIF_QUALITY_LOSSLESS;
-        encoder->qualityAlpha = AVIF_QUALITY_LOSSLESS;
-    } else {
-        encoder->quality = quality;
-        encoder->qualityAlpha = quality;
-    }
-    encoder->speed = AVIF_SPEED_DEFAULT;
-
-    avifRWData output = AVIF_DATA_EMPTY;
-    avifResult addResult = avifEncoderAddImage(encoder, image, 1, AVIF_ADD_IMAGE_FLAG_SINGLE);
-    if (addResult == AVIF_RESULT_OK) {
-        avifResult finishResult = avifEncoderFinish(encoder, &output);
-        if (finishResult == AVIF_RESULT_OK && output.size > 0) {
-            result.assign(output.data, output.data + output.size);
-        }
-    }
-
-    avifRWDataFree(&output);
-    avifEncoderDestroy(encoder);
-    avifImageDestroy(image);
-    return result;
+    sprat::core::blit_sprite_rows(prepared.pixels, prepared.stride, s.x, s.y, s.w, s.h, s.rotated,
+                                  band, atlas_width, band_y0, band_y1);
 }
-#endif
 
 } // namespace
 
@@ -553,6 +394,9 @@ void print_usage() {
               << tr("  --scale-filter FILTER  Resampling filter when source and target sizes differ:\n")
               << tr("                           nearest (default), bilinear, bicubic, mitchell\n")
               << tr("  --threads N            Number of worker threads\n")
+              << tr("  --pixel-cache          Reuse sprite pixels decoded by spratlayout --pixel-cache\n")
+              << tr("  --band-rows N          Compose and encode PNG atlases N rows at a time (requires zlib)\n")
+              << tr("  --trace FILE           Write stage timings and counters as Chrome trace JSON\n")
               << tr("  --debug                Enable detailed error reporting and debug visualization\n")
               << tr("  --protect              Protect output with basic obfuscation\n")
               << tr("  --format FORMAT        Output format: png (default), webp, or avif\n")
@@ -562,10 +406,16 @@ void print_usage() {
               << tr("  --version, -v          Show version\n");
 }
 
-int run_spratpack(int argc, char** argv) {
+namespace {
+
+// `parsed_layout` is set when sprat build hands over the layout it already
+// parsed; the tool itself reads layout text from stdin.
+int run_pack(int argc, char** argv, const Layout* parsed_layout) {
+    sprat::core::ProfileSession profile_session("spratpack");
     bool debug = false;
     bool protect = false;
     bool use_zopfli = false;
+    bool use_pixel_cache = false;
     bool draw_frame_lines = false;
     ScaleFilter scale_filter = ScaleFilter::nearest;
     int line_width = 1;
@@ -573,6 +423,7 @@ int run_spratpack(int argc, char** argv) {
     constexpr unsigned char DEFAULT_COLOR_ALPHA = 255;
     std::array<unsigned char, 4> line_color = {DEFAULT_COLOR_RED, 0, 0, DEFAULT_COLOR_ALPHA};
     unsigned int thread_limit = 0;
+    int band_rows = 0;
     std::string output_pattern;
     int requested_atlas_index = -1;
     int extrude = 0;
@@ -597,6 +448,8 @@ int run_spratpack(int argc, char** argv) {
             protect = true;
         } else if (arg == "--zopfli") {
             use_zopfli = true;
+        } else if (arg == "--pixel-cache") {
+            use_pixel_cache = true;
         } else if ((arg == "--atlas" || arg == "-a" || arg == "--output" || arg == "-o") && i + 1 < argc) {
             output_pattern = argv[++i];
         } else if (arg == "--atlas-index" && i + 1 < argc) {
@@ -669,6 +522,14 @@ int run_spratpack(int argc, char** argv) {
                 return 1;
             }
             thread_limit = static_cast<unsigned int>(parsed);
+        } else if (arg == "--band-rows" && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (!parse_int(value, band_rows) || band_rows <= 0) {
+                std::cerr << tr("Invalid band rows: ") << value << "\n";
+                return 1;
+            }
+        } else if (arg == "--trace" && i + 1 < argc) {
+            profile_session.start(argv[++i]);
         } else if (arg == "--format" && i + 1 < argc) {
             output_format = argv[++i];
             std::transform(output_format.begin(), output_format.end(), output_format.begin(),
@@ -690,6 +551,10 @@ int run_spratpack(int argc, char** argv) {
         draw_frame_lines = true;
     }
 
+    if (band_rows > 0 && !sprat::core::PngStreamWriter::available()) {
+        std::cerr << tr("Warning: --band-rows requires zlib support (not compiled in); encoding whole atlases\n");
+    }
+
     if (output_format == "webp") {
 #ifndef SPRAT_HAS_WEBP
         std::cerr << tr("Error: --format webp requires libwebp support (not compiled in)\n");
@@ -707,33 +572,18 @@ int run_spratpack(int argc, char** argv) {
         quality = 100;
     }
 
-    Layout layout;
+    // sprat build lends the layout it parsed while spratconvert reads it on
+    // another thread, so it is only read here, never copied or changed.
+    Layout stdin_layout;
     std::string parse_error;
-    if (!parse_layout(std::cin, layout, parse_error)) {
+    sprat::core::ProfileScope parse_scope("parse_layout");
+    if (parsed_layout == nullptr && !parse_layout(std::cin, stdin_layout, parse_error)) {
         std::cerr << parse_error << "\n";
         return 1;
     }
-
-    // Resolve relative sprite paths using the root directory from the layout.
-    if (layout.has_root && !layout.root.empty()) {
-        std::filesystem::path root_path(layout.root);
-        for (auto& sprite : layout.sprites) {
-            std::filesystem::path sp(sprite.path);
-            if (sp.is_relative()) {
-                sprite.path = (root_path / sp).string();
-            }
-        }
-        for (auto& alias : layout.aliases) {
-            std::filesystem::path ap(alias.first);
-            if (ap.is_relative()) {
-                alias.first = (root_path / ap).string();
-            }
-            std::filesystem::path cp(alias.second);
-            if (cp.is_relative()) {
-                alias.second = (root_path / cp).string();
-            }
-        }
-    }
+    const Layout& layout = parsed_layout != nullptr ? *parsed_layout : stdin_layout;
+    parse_scope.arg("sprites", static_cast<int64_t>(layout.sprites.size()));
+    parse_scope.stop();
 
     if (requested_atlas_index >= 0 && static_cast<size_t>(requested_atlas_index) >= layout.atlases.size()) {
         std::cerr << tr("Error: requested atlas index ") << requested_atlas_index
@@ -791,82 +641,124 @@ int run_spratpack(int argc, char** argv) {
         }
     }
 
-    // Pre-group sprites by atlas index
+    const std::filesystem::path pixel_cache_dir =
+        use_pixel_cache ? sprat::core::default_pixel_cache_dir() : std::filesystem::path();
+
+    // Pre-group sprites by atlas index, resolving relative sprite paths
+    // using the root directory from the layout.
+    const bool has_root = layout.has_root && !layout.root.empty();
+    const std::filesystem::path root_path(has_root ? layout.root : std::string());
     std::vector<std::vector<Sprite>> sprites_by_atlas(layout.atlases.size());
     for (const auto& s : layout.sprites) {
         if (s.atlas_index >= 0 && static_cast<size_t>(s.atlas_index) < layout.atlases.size()) {
-            sprites_by_atlas[static_cast<size_t>(s.atlas_index)].push_back(s);
+            Sprite& sprite = sprites_by_atlas[static_cast<size_t>(s.atlas_index)].emplace_back(s);
+            if (has_root && std::filesystem::path(sprite.path).is_relative()) {
+                sprite.path = (root_path / sprite.path).string();
+            }
         }
     }
 
+    unsigned int total_thread_count = thread_limit > 0 ? thread_limit : std::thread::hardware_concurrency();
+    if (total_thread_count == 0) total_thread_count = 1;
+#ifdef __EMSCRIPTEN__
+    total_thread_count = 1;
+#endif
+
+    std::vector<size_t> atlas_targets;
     for (size_t atlas_idx = 0; atlas_idx < layout.atlases.size(); ++atlas_idx) {
-        if (requested_atlas_index >= 0 && static_cast<size_t>(requested_atlas_index) != atlas_idx) {
-            continue;
+        if (requested_atlas_index < 0 || static_cast<size_t>(requested_atlas_index) == atlas_idx) {
+            atlas_targets.push_back(atlas_idx);
         }
+    }
+    // Several atlases are packed at once and share the thread budget; each
+    // one still splits its sprites across its share.
+    const unsigned int atlas_job_count =
+        std::min<unsigned int>(total_thread_count, static_cast<unsigned int>(std::max<size_t>(1, atlas_targets.size())));
+    const unsigned int sprite_thread_count = std::max(1u, total_thread_count / atlas_job_count);
+
+    // What one atlas hands to the in-order writer. Only TAR entries carry
+    // their encoded bytes; files and stdout were written by the atlas job.
+    struct PackedAtlas {
+        std::vector<unsigned char> data;
+        std::string extension;
+    };
 
+    auto pack_atlas = [&](size_t atlas_idx, PackedAtlas& packed) -> bool {
         const int atlas_width = layout.atlases[atlas_idx].width;
         const int atlas_height = layout.atlases[atlas_idx].height;
         const std::vector<Sprite>& atlas_sprites = sprites_by_atlas[atlas_idx];
+        sprat::core::ProfileScope atlas_scope("atlas");
+        atlas_scope.arg("atlas", static_cast<int64_t>(atlas_idx));
+        atlas_scope.arg("sprites", static_cast<int64_t>(atlas_sprites.size()));
 
         size_t pixel_count = 0;
         size_t byte_count = 0;
         if (!checked_mul_size_t(static_cast<size_t>(atlas_width), static_cast<size_t>(atlas_height), pixel_count)
             || !checked_mul_size_t(pixel_count, NUM_CHANNELS, byte_count)) {
             std::cerr << tr("Error: Atlas ") << atlas_idx << tr(" dimensions are too large for memory allocation\n");
-            return 1;
+            return false;
         }
 
-        std::vector<unsigned char> atlas_data(byte_count, 0);
-
-        auto blit_sprite = [&](const Sprite& s, std::string& error_out) -> bool {
-            int w = 0, h = 0, channels = 0;
-            unsigned char* data = stbi_load(s.path.c_str(), &w, &h, &channels, static_cast<int>(NUM_CHANNELS));
-            if (!data) {
-                // stbi_failure_reason() is global, but since we are stopping on first error, it's acceptable here.
-                error_out = "Failed to load image: " + to_quoted(s.path) + " (Reason: " + stbi_failure_reason() + ")";
-                return false;
-            }
-            // Use RAII for image data
-            struct StbImageDeleter { void operator()(unsigned char* p) const { stbi_image_free(p); } };
-            std::unique_ptr<unsigned char, StbImageDeleter> image_ptr(data);
-
-            if (s.colors > 0) {
-                auto quantize = [](unsigned char v, int levels, int x, int y, bool dither) -> unsigned char {
-                    if (levels <= 1) return 0;
-                    if (levels >= 256) return v;
-                    
-                    float val = v / 255.0f;
-                    if (dither) {
-                        static const float bayer[4][4] = {
-                            { 0.0f/16, 8.0f/16, 2.0f/16, 10.0f/16 },
-                            { 12.0f/16, 4.0f/16, 14.0f/16, 6.0f/16 },
-                            { 3.0f/16, 11.0f/16, 1.0f/16, 9.0f/16 },
-                            { 15.0f/16, 7.0f/16, 13.0f/16, 5.0f/16 }
-                        };
-                        float threshold = bayer[y % 4][x % 4];
-                        val += (threshold - 0.5f) / (levels - 1);
-                        if (val < 0.0f) val = 0.0f;
-                        if (val > 1.0f) val = 1.0f;
-                    }
-                    
-                    int level = static_cast<int>(val * (levels - 1) + 0.5f);
-                    return static_cast<unsigned char>((level * 255) / (levels - 1));
+        const unsigned int atlas_worker_count =
+            std::min<unsigned int>(sprite_thread_count, static_cast<unsigned int>(std::max<size_t>(1, atlas_sprites.size())));
+
+        auto prepare_sprite = [&](const Sprite& s, PreparedSprite& out, std::string& error_out) -> bool {
+            struct SourceRect { int x, y, w, h; };
+            auto source_rect_for = [&s](int w, int h) {
+                return SourceRect{
+                    s.has_trim ? s.src_x : 0,
+                    s.has_trim ? s.src_y : 0,
+                    s.has_trim ? (w - s.src_x - s.trim_right) : w,
+                    s.has_trim ? (h - s.src_y - s.trim_bottom) : h
                 };
+            };
+            auto rect_inside = [](const SourceRect& r, const sprat::core::PixelCacheRegion& region) {
+                return r.w > 0 && r.h > 0 && r.x >= region.x && r.y >= region.y &&
+                       r.x - region.x <= region.w - r.w && r.y - region.y <= region.h - r.h;
+            };
 
-                for (int y = 0; y < h; ++y) {
-                    for (int x = 0; x < w; ++x) {
-                        for (int c = 0; c < 3; ++c) { // R, G, B
-                            size_t off = (static_cast<size_t>(y) * static_cast<size_t>(w) + static_cast<size_t>(x)) * NUM_CHANNELS + static_cast<size_t>(c);
-                            image_ptr.get()[off] = quantize(image_ptr.get()[off], s.colors, x, y, s.dither);
-                        }
-                    }
+            // `pixels` holds the source region described by `region`: either a
+            // pixel cache entry or the whole freshly decoded image.
+            sprat::core::PixelCacheRegion region;
+            const unsigned char* pixels = nullptr;
+            sprat::core::CachedPixels& cached = out.cached;
+            std::unique_ptr<unsigned char, StbImageDeleter>& image_ptr = out.image;
+            std::vector<unsigned char>& cached_copy = out.owned;
+
+            uintmax_t source_size = 0;
+            long long source_mtime = 0;
+            const bool has_stamp = use_pixel_cache &&
+                sprat::core::read_source_stamp(s.path, source_size, source_mtime);
+            if (has_stamp && cached.open(pixel_cache_dir, s.path, source_size, source_mtime) &&
+                rect_inside(source_rect_for(cached.region().image_w, cached.region().image_h), cached.region())) {
+                region = cached.region();
+                pixels = cached.pixels();
+                sprat::core::profile_count("pixel_cache.hits");
+            } else {
+                if (use_pixel_cache) {
+                    sprat::core::profile_count("pixel_cache.misses");
                 }
+                sprat::core::ProfileScope decode_scope("decode");
+                sprat::core::profile_count("decode.images");
+                int w = 0, h = 0, channels = 0;
+                unsigned char* data = stbi_load(s.path.c_str(), &w, &h, &channels, static_cast<int>(NUM_CHANNELS));
+                if (!data) {
+                    // stbi_failure_reason() is global, but since we are stopping on first error, it's acceptable here.
+                    error_out = "Failed to load image: " + to_quoted(s.path) + " (Reason: " + stbi_failure_reason() + ")";
+                    return false;
+                }
+                image_ptr.reset(data);
+                region = sprat::core::PixelCacheRegion{w, h, 0, 0, w, h};
+                pixels = data;
             }
 
-            const int source_x = s.has_trim ? s.src_x : 0;
-            const int source_y = s.has_trim ? s.src_y : 0;
-            const int source_w = s.has_trim ? (w - s.src_x - s.trim_right) : w;
-            const int source_h = s.has_trim ? (h - s.src_y - s.trim_bottom) : h;
+            const int w = region.image_w;
+            const int h = region.image_h;
+            const SourceRect source = source_rect_for(w, h);
+            const int source_x = source.x;
+            const int source_y = source.y;
+            const int source_w = source.w;
+            const int source_h = source.h;
 
             if (source_x < 0 || source_y < 0 || source_w <= 0 || source_h <= 0 ||
                 source_x > w - source_w || source_y > h - source_h) {
@@ -874,6 +766,28 @@ int run_spratpack(int argc, char** argv) {
                 return false;
             }
 
+            const size_t region_stride = static_cast<size_t>(region.w) * NUM_CHANNELS;
+            // Keep the untouched crop for later runs before quantization edits the pixels.
+            if (has_stamp && image_ptr) {
+                const sprat::core::PixelCacheRegion crop{w, h, source_x, source_y, source_w, source_h};
+                sprat::core::store_cached_pixels(
+                    pixel_cache_dir, s.path, source_size, source_mtime, crop,
+                    pixels + (static_cast<size_t>(source_y) * region_stride + static_cast<size_t>(source_x) * NUM_CHANNELS),
+                    region_stride);
+            }
+
+            if (s.colors > 0) {
+                unsigned char* editable = image_ptr.get();
+                if (editable == nullptr) {
+                    cached_copy.assign(pixels, pixels + region_stride * static_cast<size_t>(region.h));
+                    editable = cached_copy.data();
+                    pixels = editable;
+                }
+                // Dither coordinates stay relative to the full source image.
+                sprat::core::quantize_rgb(editable, region.w, region.h, region_stride, s.colors, s.dither,
+                                          region.x, region.y);
+            }
+
             if (s.x < 0 || s.y < 0 || s.x + s.w > atlas_width || s.y + s.h > atlas_height) {
                 error_out = "Error: Sprite " + to_quoted(s.path)
                     + " placement out of atlas bounds";
@@ -885,34 +799,19 @@ int run_spratpack(int argc, char** argv) {
             const int dest_h = s.rotated ? s.w : s.h;
             const bool needs_scale = (source_w != dest_w || source_h != dest_h);
 
-            // Fast path: no rotation, no scaling
-            if (!s.rotated && !needs_scale) {
-                const size_t row_bytes = static_cast<size_t>(s.w) * NUM_CHANNELS;
-                for (int row = 0; row < s.h; ++row) {
-                    const size_t dest_pixels = static_cast<size_t>(s.y + row) * atlas_width + s.x;
-                    const size_t dest_offset = dest_pixels * NUM_CHANNELS;
-                    const size_t src_pixels = static_cast<size_t>(source_y + row) * w + source_x;
-                    const size_t src_offset = src_pixels * NUM_CHANNELS;
-                    std::memcpy(atlas_data.data() + dest_offset, image_ptr.get() + src_offset, row_bytes);
-                }
-                return true;
-            }
-
-            // Source pointer and stride within the full loaded image
-            const unsigned char* src_ptr = image_ptr.get() +
-                (static_cast<size_t>(source_y) * w + source_x) * NUM_CHANNELS;
-            const int src_stride_bytes = w * static_cast<int>(NUM_CHANNELS);
+            // Source pointer and stride within the loaded region
+            const unsigned char* src_ptr = pixels +
+                (static_cast<size_t>(source_y - region.y) * region_stride +
+                 static_cast<size_t>(source_x - region.x) * NUM_CHANNELS);
+            out.pixels = src_ptr;
+            out.stride = region_stride;
 
             // Scale if source and destination sizes differ
-            std::vector<unsigned char> scaled_buf;
-            const unsigned char* blit_ptr = src_ptr;
-            int blit_stride_bytes = src_stride_bytes;
-
             if (needs_scale) {
-                scaled_buf.resize(static_cast<size_t>(dest_w) * dest_h * NUM_CHANNELS);
+                std::vector<unsigned char> scaled_buf(static_cast<size_t>(dest_w) * dest_h * NUM_CHANNELS);
                 STBIR_RESIZE resize;
                 stbir_resize_init(&resize,
-                    src_ptr, source_w, source_h, src_stride_bytes,
+                    src_ptr, source_w, source_h, static_cast<int>(region_stride),
                     scaled_buf.data(), dest_w, dest_h, 0,
                     STBIR_RGBA, STBIR_TYPE_UINT8_SRGB);
                 stbir_set_filters(&resize,
@@ -921,64 +820,40 @@ int run_spratpack(int argc, char** argv) {
                     error_out = "Error: Failed to resize image " + to_quoted(s.path);
                     return false;
                 }
-                blit_ptr = scaled_buf.data();
-                blit_stride_bytes = dest_w * static_cast<int>(NUM_CHANNELS);
-            }
-
-            // Blit to atlas, handling 90° CW rotation if needed
-            if (!s.rotated) {
-                const size_t row_bytes = static_cast<size_t>(dest_w) * NUM_CHANNELS;
-                for (int row = 0; row < dest_h; ++row) {
-                    const size_t dest_off =
-                        (static_cast<size_t>(s.y + row) * atlas_width + s.x) * NUM_CHANNELS;
-                    const size_t src_off =
-                        static_cast<size_t>(row) * static_cast<size_t>(blit_stride_bytes);
-                    std::memcpy(atlas_data.data() + dest_off, blit_ptr + src_off, row_bytes);
-                }
-            } else {
-                // atlas(s.x+col, s.y+row) <- source(px=row, py=dest_h-1-col)
-                for (int row = 0; row < s.h; ++row) {
-                    for (int col = 0; col < s.w; ++col) {
-                        const int px = row;
-                        const int py = dest_h - 1 - col;
-                        const size_t dest_off =
-                            (static_cast<size_t>(s.y + row) * atlas_width + (s.x + col)) * NUM_CHANNELS;
-                        const size_t src_off =
-                            static_cast<size_t>(py) * static_cast<size_t>(blit_stride_bytes) +
-                            static_cast<size_t>(px) * NUM_CHANNELS;
-                        std::memcpy(atlas_data.data() + dest_off, blit_ptr + src_off, NUM_CHANNELS);
-                    }
-                }
+                // The source is no longer needed once scaled.
+                out.owned = std::move(scaled_buf);
+                out.image.reset();
+                out.cached = {};
+                out.pixels = out.owned.data();
+                out.stride = static_cast<size_t>(dest_w) * NUM_CHANNELS;
             }
             return true;
         };
 
-        unsigned int atlas_worker_count = thread_limit > 0 ? thread_limit : std::thread::hardware_concurrency();
-        if (atlas_worker_count == 0) atlas_worker_count = 1;
-        atlas_worker_count = std::min<unsigned int>(atlas_worker_count, static_cast<unsigned int>(std::max<size_t>(1, atlas_sprites.size())));
-#ifdef __EMSCRIPTEN__
-        atlas_worker_count = 1;
-#endif
-
-        const bool can_parallel = (atlas_worker_count > 1) && !sprites_have_overlap(atlas_sprites);
-        if (!can_parallel) {
-            for (const auto& s : atlas_sprites) {
-                std::string error;
-                if (!blit_sprite(s, error)) { std::cerr << error << "\n"; return 1; }
+        // Runs `job` for every index below `count`, on worker threads when
+        // `parallel` is set, and reports the first failure.
+        auto run_sprite_jobs = [&](size_t count, bool parallel,
+                                   const std::function<bool(size_t, std::string&)>& job) -> bool {
+            if (!parallel || count < 2) {
+                for (size_t idx = 0; idx < count; ++idx) {
+                    std::string error;
+                    if (!job(idx, error)) { std::cerr << error << "\n"; return false; }
+                }
+                return true;
             }
-        } else {
             std::atomic<size_t> next_idx{0};
             std::atomic<bool> failed{false};
             std::mutex err_mtx;
             std::string first_err;
             std::vector<std::thread> workers;
-            for (unsigned int i = 0; i < atlas_worker_count; ++i) {
+            const unsigned int job_workers = std::min<unsigned int>(atlas_worker_count, static_cast<unsigned int>(count));
+            for (unsigned int i = 0; i < job_workers; ++i) {
                 workers.emplace_back([&]() {
                     while (!failed.load(std::memory_order_relaxed)) {
                         size_t idx = next_idx.fetch_add(1, std::memory_order_relaxed);
-                        if (idx >= atlas_sprites.size()) break;
+                        if (idx >= count) break;
                         std::string error;
-                        if (!blit_sprite(atlas_sprites[idx], error)) {
+                        if (!job(idx, error)) {
                             std::scoped_lock lock(err_mtx);
                             if (first_err.empty()) first_err = std::move(error);
                             failed.store(true, std::memory_order_relaxed);
@@ -988,148 +863,471 @@ int run_spratpack(int argc, char** argv) {
                 });
             }
             for (auto& w : workers) w.join();
-            if (failed.load(std::memory_order_relaxed)) { std::cerr << first_err << "\n"; return 1; }
-        }
+            if (failed.load(std::memory_order_relaxed)) { std::cerr << first_err << "\n"; return false; }
+            return true;
+        };
 
         const int active_extrude = has_extrude_override ? extrude : layout.extrude;
-        if (active_extrude > 0) {
-            extrude_atlas(atlas_data, atlas_width, atlas_height, atlas_sprites, active_extrude);
-        }
-
         const int active_dilate = has_dilate_override ? dilate : 0;
-        if (active_dilate > 0) {
-            dilate_sprite_colors(atlas_data, atlas_width, atlas_height, atlas_sprites, active_dilate);
+        const char* pixel_debug = std::getenv("SPRAT_PACK_DEBUG");
+        std::string& output_extension = packed.extension;
+        output_extension = "." + output_format;
+
+        // Band streaming covers plain PNG output; passes that read or write
+        // across sprite borders still need the whole atlas in memory.
+        const bool stream_bands = band_rows > 0 && sprat::core::PngStreamWriter::available() &&
+            output_format == "png" && !has_gpu_compress && !use_zopfli &&
+            active_extrude == 0 && active_dilate == 0 && !draw_frame_lines && pixel_debug == nullptr;
+
+        std::vector<unsigned char>& output_data = packed.data;
+        // Encoded bytes go straight to the destination, except for TAR entries,
+        // whose header needs the final size.
+        std::ofstream out_file;
+        std::string out_filename;
+        if (!use_tar && !output_pattern.empty()) {
+            std::string pattern_error;
+            if (!format_index_pattern(output_pattern, static_cast<int>(atlas_idx), out_filename, pattern_error)) {
+                std::cerr << tr("Invalid output pattern: ") << pattern_error << "\n";
+                return false;
+            }
         }
+        auto write_output = [&](const unsigned char* data, size_t size) -> bool {
+            if (use_tar) {
+                output_data.insert(output_data.end(), data, data + size);
+                return true;
+            }
+            if (output_pattern.empty()) {
+#ifdef _WIN32
+                // Non-fatal: in embedded mode stdout may not be a real file handle.
+                _setmode(_fileno(stdout), _O_BINARY);
+#endif
+                std::cout.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+                return !std::cout.fail();
+            }
+            if (!out_file.is_open()) {
+                out_file.open(out_filename, std::ios::binary);
+                if (!out_file) {
+                    std::cerr << tr("Error: Failed to open output file: ") << out_filename << "\n";
+                    return false;
+                }
+            }
+            out_file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+            return static_cast<bool>(out_file);
+        };
+        // --protect prefixes a signature and XORs the payload with a repeating key.
+        const std::string protect_key = "sprat";
+        const bool apply_protect = protect && !has_gpu_compress;
+        size_t protect_offset = 0;
+        std::vector<unsigned char> protect_buf;
+        auto emit = [&](const unsigned char* data, size_t size) -> bool {
+            if (!apply_protect) {
+                return write_output(data, size);
+            }
+            if (protect_offset == 0 && protect_buf.empty()) {
+                static constexpr unsigned char signature[] = {'S', 'P', 'R', 'A', 'T', '!'};
+                if (!write_output(signature, sizeof(signature))) {
+                    return false;
+                }
+            }
+            protect_buf.resize(size);
+            for (size_t i = 0; i < size; ++i, ++protect_offset) {
+                protect_buf[i] = data[i] ^ static_cast<unsigned char>(protect_key[protect_offset % protect_key.size()]);
+            }
+            return write_output(protect_buf.data(), size);
+        };
 
-        if (draw_frame_lines) {
-            for (const auto& s : atlas_sprites) {
-                draw_sprite_outline(atlas_data, atlas_width, atlas_height, s, line_width, line_color);
+        if (stream_bands) {
+            // Sprites enter in y order, are decoded once, and stay prepared only
+            // while the current band still crosses them.
+            std::vector<size_t> order(atlas_sprites.size());
+            for (size_t i = 0; i < order.size(); ++i) {
+                order[i] = i;
             }
-        }
+            std::ranges::stable_sort(order, [&](size_t lhs, size_t rhs) {
+                return atlas_sprites[lhs].y < atlas_sprites[rhs].y;
+            });
+            std::vector<std::shared_ptr<PreparedSprite>> prepared(atlas_sprites.size());
+            // Sources still held by an active placement, reused by later ones.
+            std::unordered_map<std::string, std::weak_ptr<PreparedSprite>> live_sources;
+            std::vector<size_t> active;
+            std::vector<size_t> entering;
+            std::vector<size_t> decoding;
+            std::vector<std::string> entering_keys;
+            size_t next_sprite = 0;
+
+            const int band_height = std::min(band_rows, atlas_height);
+            std::vector<unsigned char> band(static_cast<size_t>(atlas_width) * static_cast<size_t>(band_height) * NUM_CHANNELS);
+            sprat::core::PngStreamWriter writer;
+            if (!writer.begin(atlas_width, atlas_height, emit)) {
+                std::cerr << tr("Error: Failed to encode PNG for atlas ") << atlas_idx << "\n";
+                return false;
+            }
+            for (int band_y0 = 0; band_y0 < atlas_height; band_y0 += band_height) {
+                const int band_y1 = std::min(atlas_height, band_y0 + band_height);
+                entering.clear();
+                while (next_sprite < order.size() && atlas_sprites[order[next_sprite]].y < band_y1) {
+                    entering.push_back(order[next_sprite++]);
+                }
+                // Decode each new source once; repeated placements share it.
+                decoding.clear();
+                entering_keys.resize(entering.size());
+                for (size_t e = 0; e < entering.size(); ++e) {
+                    const size_t idx = entering[e];
+                    entering_keys[e] = prepared_source_key(atlas_sprites[idx]);
+                    std::weak_ptr<PreparedSprite>& live = live_sources[entering_keys[e]];
+                    prepared[idx] = live.lock();
+                    if (!prepared[idx]) {
+                        prepared[idx] = std::make_shared<PreparedSprite>();
+                        live = prepared[idx];
+                        decoding.push_back(idx);
+                    }
+                }
+                const bool prepared_ok = run_sprite_jobs(decoding.size(), atlas_worker_count > 1,
+                    [&](size_t job, std::string& error) {
+                        const size_t idx = decoding[job];
+                        return prepare_sprite(atlas_sprites[idx], *prepared[idx], error);
+                    });
+                if (!prepared_ok) {
+                    return false;
+                }
+                // Later sprites overwrite earlier ones, as in the whole-atlas path.
+                active.insert(active.end(), entering.begin(), entering.end());
+                std::ranges::sort(active);
 
-        if (std::getenv("SPRAT_PACK_DEBUG") && atlas_width <= 16) {
-            for (int y = 0; y < atlas_height; ++y) {
-                for (int x = 0; x < atlas_width; ++x) {
-                    size_t off = (static_cast<size_t>(y) * atlas_width + x) * NUM_CHANNELS;
-                    if (atlas_data[off+3] != 0) {
-                        std::cerr << "[pixel-debug] x=" << x << " y=" << y << " RGBA=" 
-                                  << (int)atlas_data[off] << "," << (int)atlas_data[off+1] << "," 
-                                  << (int)atlas_data[off+2] << "," << (int)atlas_data[off+3] << "\n";
+                std::fill(band.begin(), band.end(), 0);
+                for (size_t idx : active) {
+                    blit_sprite_rows(atlas_sprites[idx], *prepared[idx], band.data(), atlas_width, band_y0, band_y1);
+                }
+                if (!writer.write_rows(band.data(), band_y1 - band_y0, static_cast<size_t>(atlas_width) * NUM_CHANNELS)) {
+                    std::cerr << tr("Error: Failed to encode PNG for atlas ") << atlas_idx << "\n";
+                    return false;
+                }
+                std::erase_if(active, [&](size_t idx) {
+                    const Sprite& s = atlas_sprites[idx];
+                    if (s.y + s.h > band_y1) {
+                        return false;
                     }
+                    prepared[idx].reset();
+                    return true;
+                });
+                std::erase_if(live_sources, [](const auto& entry) { return entry.second.expired(); });
+            }
+            // Sprites placed below the atlas never entered a band; report them.
+            for (; next_sprite < order.size(); ++next_sprite) {
+                PreparedSprite unused;
+                std::string error;
+                if (!prepare_sprite(atlas_sprites[order[next_sprite]], unused, error)) {
+                    std::cerr << error << "\n";
+                    return false;
                 }
             }
-        }
+            if (!writer.finish()) {
+                std::cerr << tr("Error: Failed to encode PNG for atlas ") << atlas_idx << "\n";
+                return false;
+            }
+        } else {
+            std::vector<unsigned char> atlas_data(byte_count, 0);
+            sprat::core::ProfileScope blit_scope("blit");
+            blit_scope.arg("atlas", static_cast<int64_t>(atlas_idx));
+
+            // Sources placed more than once are decoded up front and shared;
+            // each is released after its last placement.
+            std::vector<size_t> shared_slot(atlas_sprites.size(), atlas_sprites.size());
+            std::vector<size_t> shared_first;
+            {
+                std::unordered_map<std::string, size_t> first_by_key;
+                std::vector<size_t> slot_of_first(atlas_sprites.size(), atlas_sprites.size());
+                for (size_t idx = 0; idx < atlas_sprites.size(); ++idx) {
+                    const auto [it, inserted] = first_by_key.try_emplace(prepared_source_key(atlas_sprites[idx]), idx);
+                    if (inserted) {
+                        continue;
+                    }
+                    size_t& slot = slot_of_first[it->second];
+                    if (slot == atlas_sprites.size()) {
+                        slot = shared_first.size();
+                        shared_first.push_back(it->second);
+                        shared_slot[it->second] = slot;
+                    }
+                    shared_slot[idx] = slot;
+                }
+            }
+            std::vector<PreparedSprite> shared_sources(shared_first.size());
+            std::vector<std::atomic<size_t>> shared_uses(shared_first.size());
+            for (size_t idx = 0; idx < atlas_sprites.size(); ++idx) {
+                if (shared_slot[idx] < shared_first.size()) {
+                    shared_uses[shared_slot[idx]].fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            if (!run_sprite_jobs(shared_first.size(), atlas_worker_count > 1, [&](size_t slot, std::string& error) {
+                    return prepare_sprite(atlas_sprites[shared_first[slot]], shared_sources[slot], error);
+                })) {
+                return false;
+            }
+
+            // Only overlapping sprites are serialized, inside their conflict set.
+            const std::vector<std::vector<size_t>> conflict_sets = overlap_conflict_sets(atlas_sprites);
+            const bool blitted = run_sprite_jobs(conflict_sets.size(), atlas_worker_count > 1, [&](size_t set, std::string& error) {
+                for (size_t idx : conflict_sets[set]) {
+                    const size_t slot = shared_slot[idx];
+                    if (slot < shared_first.size()) {
+                        blit_sprite_rows(atlas_sprites[idx], shared_sources[slot], atlas_data.data(), atlas_width, 0, atlas_height);
+                        if (shared_uses[slot].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                            shared_sources[slot] = {};
+                        }
+                        continue;
+                    }
+                    PreparedSprite sprite_pixels;
+                    if (!prepare_sprite(atlas_sprites[idx], sprite_pixels, error)) {
+                        return false;
+                    }
+                    blit_sprite_rows(atlas_sprites[idx], sprite_pixels, atlas_data.data(), atlas_width, 0, atlas_height);
+                }
+                return true;
+            });
+            if (!blitted) {
+                return false;
+            }
 
-        std::vector<unsigned char> output_data;
-        std::string output_extension = "." + output_format;
+            if (active_extrude > 0) {
+                extrude_atlas(atlas_data, atlas_width, atlas_height, atlas_sprites, active_extrude);
+            }
 
-#ifdef SPRAT_HAS_SQUISH
-        if (has_gpu_compress) {
-            output_data = compress_to_dds(atlas_data, atlas_width, atlas_height, gpu_compress_format);
-            if (output_data.empty()) {
-                std::cerr << tr("Error: Failed to compress to DDS for atlas ") << atlas_idx << tr(" (atlas dimensions must be multiple of 4)\n");
-                return 1;
+            if (active_dilate > 0) {
+                dilate_sprite_colors(atlas_data, atlas_width, atlas_height, atlas_sprites, active_dilate);
             }
-            output_extension = ".dds";
-        } else
+
+            if (draw_frame_lines) {
+                for (const auto& s : atlas_sprites) {
+                    draw_sprite_outline(atlas_data, atlas_width, atlas_height, s, line_width, line_color);
+                }
+            }
+
+            if (pixel_debug && atlas_width <= 16) {
+                for (int y = 0; y < atlas_height; ++y) {
+                    for (int x = 0; x < atlas_width; ++x) {
+                        size_t off = (static_cast<size_t>(y) * atlas_width + x) * NUM_CHANNELS;
+                        if (atlas_data[off+3] != 0) {
+                            std::cerr << "[pixel-debug] x=" << x << " y=" << y << " RGBA=" 
+                                      << (int)atlas_data[off] << "," << (int)atlas_data[off+1] << "," 
+                                      << (int)atlas_data[off+2] << "," << (int)atlas_data[off+3] << "\n";
+                        }
+                    }
+                }
+            }
+
+            blit_scope.stop();
+
+            std::vector<unsigned char> encoded;
+            sprat::core::ProfileScope encode_scope("encode");
+            encode_scope.arg("atlas", static_cast<int64_t>(atlas_idx));
+
+#ifdef SPRAT_HAS_SQUISH
+            if (has_gpu_compress) {
+                encoded = sprat::core::compress_to_dds(atlas_data, atlas_width, atlas_height, gpu_compress_format,
+                                                       atlas_sprites, active_extrude + active_dilate, sprite_thread_count);
+                if (encoded.empty()) {
+                    std::cerr << tr("Error: Failed to compress to DDS for atlas ") << atlas_idx << tr(" (atlas dimensions must be multiple of 4)\n");
+                    return false;
+                }
+                output_extension = ".dds";
+            } else
 #endif
 #ifdef SPRAT_HAS_WEBP
-        if (output_format == "webp") {
-            output_data = encode_webp(atlas_data.data(), atlas_width, atlas_height, quality);
-            if (output_data.empty()) {
-                std::cerr << tr("Error: Failed to encode WEBP for atlas ") << atlas_idx << "\n";
-                return 1;
-            }
-        } else
+            if (output_format == "webp") {
+                encoded = sprat::core::encode_webp(atlas_data.data(), atlas_width, atlas_height, quality);
+                if (encoded.empty()) {
+                    std::cerr << tr("Error: Failed to encode WEBP for atlas ") << atlas_idx << "\n";
+                    return false;
+                }
+            } else
 #endif
 #ifdef SPRAT_HAS_AVIF
-        if (output_format == "avif") {
-            output_data = encode_avif(atlas_data.data(), atlas_width, atlas_height, quality);
-            if (output_data.empty()) {
-                std::cerr << tr("Error: Failed to encode AVIF for atlas ") << atlas_idx << "\n";
-                return 1;
-            }
-        } else
+            if (output_format == "avif") {
+                encoded = sprat::core::encode_avif(atlas_data.data(), atlas_width, atlas_height, quality);
+                if (encoded.empty()) {
+                    std::cerr << tr("Error: Failed to encode AVIF for atlas ") << atlas_idx << "\n";
+                    return false;
+                }
+            } else
 #endif
-        {
-            auto write_to_vec = [](void* context, void* data, int size) {
-                auto* vec = static_cast<std::vector<unsigned char>*>(context);
-                const auto* bytes = static_cast<const unsigned char*>(data);
-                vec->insert(vec->end(), bytes, bytes + size);
-            };
-
-            if (stbi_write_png_to_func(write_to_vec, &output_data, atlas_width, atlas_height, 4, atlas_data.data(), atlas_width * 4) == 0) {
-                std::cerr << tr("Error: Failed to encode PNG for atlas ") << atlas_idx << "\n";
-                return 1;
-            }
+            {
+                auto write_to_vec = [](void* context, void* data, int size) {
+                    auto* vec = static_cast<std::vector<unsigned char>*>(context);
+                    const auto* bytes = static_cast<const unsigned char*>(data);
+                    vec->insert(vec->end(), bytes, bytes + size);
+                };
 
-#ifdef SPRAT_HAS_ZOPFLI
-            if (use_zopfli) {
-                ZopfliPNGOptions options;
-                std::vector<unsigned char> optimized;
-                if (ZopfliPNGCompress(output_data, options, false, &optimized) == 0) {
-                    output_data = std::move(optimized);
+                // Deflate on the atlas's workers when zlib is available;
+                // --zopfli runs Zopfli on the same pieces when its deflate
+                // library was found.
+                const size_t atlas_stride = static_cast<size_t>(atlas_width) * NUM_CHANNELS;
+#ifdef SPRAT_HAS_ZOPFLI_DEFLATE
+                const bool zopfli_pieces = use_zopfli;
+#else
+                const bool zopfli_pieces = false;
+#endif
+                bool png_ok = false;
+                if (zopfli_pieces) {
+                    png_ok = sprat::core::encode_png_zopfli_parallel(atlas_data.data(), atlas_width, atlas_height,
+                                                                     atlas_stride, sprite_thread_count, encoded);
+                } else if (sprat::core::PngStreamWriter::available()) {
+                    png_ok = sprat::core::encode_png_parallel(atlas_data.data(), atlas_width, atlas_height,
+                                                              atlas_stride, sprite_thread_count, encoded);
                 } else {
-                    std::cerr << tr("Warning: Zopfli optimization failed for atlas ") << atlas_idx << "\n";
+                    png_ok = stbi_write_png_to_func(write_to_vec, &encoded, atlas_width, atlas_height, 4,
+                                                    atlas_data.data(), atlas_width * 4) != 0;
+                }
+                if (!png_ok) {
+                    std::cerr << tr("Error: Failed to encode PNG for atlas ") << atlas_idx << "\n";
+                    return false;
+                }
+
+#if defined(SPRAT_HAS_ZOPFLI) && !defined(SPRAT_HAS_ZOPFLI_DEFLATE)
+                if (use_zopfli) {
+                    std::vector<unsigned char> optimized;
+                    if (sprat::core::zopfli_optimize_png(encoded, sprite_thread_count, optimized)) {
+                        encoded = std::move(optimized);
+                    } else {
+                        std::cerr << tr("Warning: Zopfli optimization failed for atlas ") << atlas_idx << "\n";
+                    }
                 }
-            }
 #endif
-        }
+            }
+            encode_scope.arg("bytes", static_cast<int64_t>(encoded.size()));
+            encode_scope.stop();
+            sprat::core::profile_count("encode.bytes", static_cast<int64_t>(encoded.size()));
 
-        if (protect && !has_gpu_compress) {
-            const std::string key = "sprat";
-            std::vector<unsigned char> protected_data = {'S', 'P', 'R', 'A', 'T', '!'};
-            protected_data.reserve(output_data.size() + protected_data.size());
-            for (size_t i = 0; i < output_data.size(); ++i) {
-                protected_data.push_back(output_data[i] ^ static_cast<unsigned char>(key[i % key.size()]));
+            if (!emit(encoded.data(), encoded.size())) {
+                return false;
             }
-            output_data = std::move(protected_data);
         }
 
-        if (use_tar) {
-            std::string filename = "atlas_" + std::to_string(atlas_idx) + output_extension;
-            struct archive_entry* entry = archive_entry_new();
-            if (!entry) {
-                std::cerr << tr("Error: Failed to create TAR entry\n");
+        return true;
+    };
+
+    auto write_packed_atlas = [&](size_t atlas_idx, const PackedAtlas& packed) -> bool {
+        if (!use_tar) {
+            return true;
+        }
+        std::string filename = "atlas_" + std::to_string(atlas_idx) + packed.extension;
+        struct archive_entry* entry = archive_entry_new();
+        if (!entry) {
+            std::cerr << tr("Error: Failed to create TAR entry\n");
+            return false;
+        }
+        archive_entry_set_pathname(entry, filename.c_str());
+        archive_entry_set_size(entry, static_cast<la_int64_t>(packed.data.size()));
+        archive_entry_set_filetype(entry, AE_IFREG);
+        archive_entry_set_perm(entry, 0644);
+
+        if (archive_write_header(a.get(), entry) != ARCHIVE_OK) {
+            std::cerr << tr("Error: Failed to write TAR header: ") << archive_error_string(a.get()) << "\n";
+            archive_entry_free(entry);
+            return false;
+        }
+        if (archive_write_data(a.get(), packed.data.data(), packed.data.size()) < 0) {
+            std::cerr << tr("Error: Failed to write TAR data: ") << archive_error_string(a.get()) << "\n";
+            archive_entry_free(entry);
+            return false;
+        }
+        archive_entry_free(entry);
+        return true;
+    };
+
+    if (atlas_job_count <= 1) {
+        for (size_t atlas_idx : atlas_targets) {
+            PackedAtlas packed;
+            if (!pack_atlas(atlas_idx, packed)) {
                 return 1;
             }
-            archive_entry_set_pathname(entry, filename.c_str());
-            archive_entry_set_size(entry, static_cast<la_int64_t>(output_data.size()));
-            archive_entry_set_filetype(entry, AE_IFREG);
-            archive_entry_set_perm(entry, 0644);
-
-            if (archive_write_header(a.get(), entry) != ARCHIVE_OK) {
-                std::cerr << tr("Error: Failed to write TAR header: ") << archive_error_string(a.get()) << "\n";
-                archive_entry_free(entry);
+            if (!write_packed_atlas(atlas_idx, packed)) {
                 return 1;
             }
-            if (archive_write_data(a.get(), output_data.data(), output_data.size()) < 0) {
-                std::cerr << tr("Error: Failed to write TAR data: ") << archive_error_string(a.get()) << "\n";
-                archive_entry_free(entry);
-                return 1;
+        }
+        return 0;
+    }
+
+    // Bounded pipeline: jobs may run ahead of the writer by at most
+    // `max_in_flight` atlases, so TAR and file output keep atlas order
+    // without holding every encoded atlas in memory.
+    const size_t max_in_flight = static_cast<size_t>(atlas_job_count) * 2;
+    std::vector<std::unique_ptr<PackedAtlas>> finished(atlas_targets.size());
+    std::mutex pipeline_mtx;
+    std::condition_variable pipeline_cv;
+    size_t next_job = 0;
+    size_t next_write = 0;
+    bool pipeline_failed = false;
+    std::vector<std::thread> atlas_workers;
+    for (unsigned int i = 0; i < atlas_job_count; ++i) {
+        atlas_workers.emplace_back([&]() {
+            while (true) {
+                size_t job = 0;
+                {
+                    std::unique_lock lock(pipeline_mtx);
+                    pipeline_cv.wait(lock, [&]() {
+                        return pipeline_failed || next_job >= atlas_targets.size() ||
+                               next_job < next_write + max_in_flight;
+                    });
+                    if (pipeline_failed || next_job >= atlas_targets.size()) {
+                        return;
+                    }
+                    job = next_job++;
+                }
+                auto packed = std::make_unique<PackedAtlas>();
+                const bool ok = pack_atlas(atlas_targets[job], *packed);
+                {
+                    std::scoped_lock lock(pipeline_mtx);
+                    if (ok) {
+                        finished[job] = std::move(packed);
+                    } else {
+                        pipeline_failed = true;
+                    }
+                }
+                pipeline_cv.notify_all();
             }
-            archive_entry_free(entry);
-        } else if (output_pattern.empty()) {
-#ifdef _WIN32
-            // Non-fatal: in embedded mode stdout may not be a real file handle.
-            _setmode(_fileno(stdout), _O_BINARY);
-#endif
-            std::cout.write(reinterpret_cast<const char*>(output_data.data()), static_cast<std::streamsize>(output_data.size()));
-        } else {
-            std::string filename;
-            std::string pattern_error;
-            if (!format_index_pattern(output_pattern, static_cast<int>(atlas_idx), filename, pattern_error)) {
-                std::cerr << tr("Invalid output pattern: ") << pattern_error << "\n";
-                return 1;
+        });
+    }
+
+    bool write_ok = true;
+    for (size_t job = 0; job < atlas_targets.size(); ++job) {
+        std::unique_ptr<PackedAtlas> packed;
+        {
+            std::unique_lock lock(pipeline_mtx);
+            pipeline_cv.wait(lock, [&]() { return pipeline_failed || finished[job] != nullptr; });
+            if (finished[job] == nullptr) {
+                break;
             }
-            std::ofstream out_file(filename, std::ios::binary);
-            if (!out_file) {
-                std::cerr << tr("Error: Failed to open output file: ") << filename << "\n";
-                return 1;
+            packed = std::move(finished[job]);
+        }
+        write_ok = write_packed_atlas(atlas_targets[job], *packed);
+        {
+            std::scoped_lock lock(pipeline_mtx);
+            ++next_write;
+            if (!write_ok) {
+                pipeline_failed = true;
             }
-            out_file.write(reinterpret_cast<const char*>(output_data.data()), static_cast<std::streamsize>(output_data.size()));
         }
+        pipeline_cv.notify_all();
+        if (!write_ok) {
+            break;
+        }
+    }
+    for (auto& worker : atlas_workers) {
+        worker.join();
+    }
+    if (pipeline_failed || !write_ok) {
+        return 1;
     }
 
     return 0;
 }
+
+} // namespace
+
+int run_spratpack(int argc, char** argv) {
+    return run_pack(argc, argv, nullptr);
+}
+
+int run_spratpack_layout(int argc, char** argv, const sprat::core::Layout& layout) {
+    return run_pack(argc, argv, &layout);
+}
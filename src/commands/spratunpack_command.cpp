@@ -20,7 +20,10 @@ namespace fs = std::filesystem;
 #include <sstream>
 #include <thread>
 #include <iterator>
+#include <condition_variable>
+#include <mutex>
 #include "core/cli_parse.h"
+#include "core/mapped_file.h"
 
 #ifdef _WIN32
 #ifndef NOMINMAX
@@ -51,6 +54,7 @@ typedef SSIZE_T ssize_t;
 #include <archive.h>
 #include <archive_entry.h>
 #include "core/i18n.h"
+#include "core/profiler.h"
 
 namespace {
 using sprat::core::parse_non_negative_uint;
@@ -58,6 +62,20 @@ using sprat::core::tr;
 using sprat::core::to_quoted;
 
 constexpr int NUM_CHANNELS = 4;
+// stdin is read in blocks of this size when the atlas arrives through a pipe.
+constexpr size_t k_stdin_block_bytes = size_t{1} << 20;
+// Encoded frames each worker may keep waiting for the in-order writer.
+constexpr size_t k_frames_in_flight_per_thread = 4;
+
+struct StbImageDeleter {
+    void operator()(unsigned char* p) const { stbi_image_free(p); }
+};
+
+void append_to_vector(void* context, void* data, int size) {
+    auto* vec = static_cast<std::vector<unsigned char>*>(context);
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    vec->insert(vec->end(), bytes, bytes + size);
+}
 
 struct Rectangle {
     int x, y, w, h;
@@ -89,12 +107,20 @@ public:
     SpriteUnpacker(Config  config) : config_(std::move(config)) {}
 
     bool run() {
+        sprat::core::ProfileScope frames_scope("load_frames");
         if (!load_frames()) {
             return false;
         }
+        frames_scope.arg("frames", static_cast<int64_t>(frames_.size()));
+        frames_scope.stop();
+        sprat::core::ProfileScope decode_scope("decode");
         if (!load_image()) {
             return false;
         }
+        decode_scope.arg("width", width_);
+        decode_scope.arg("height", height_);
+        decode_scope.stop();
+        sprat::core::ProfileScope unpack_scope("unpack");
         if (config_.stdout_mode) {
             return unpack_to_stdout();
         }
@@ -104,29 +130,46 @@ public:
 private:
     Config config_;
     int width_{}, height_{}, channels_{};
-    std::vector<unsigned char> image_data_;
+    std::unique_ptr<unsigned char, StbImageDeleter> image_data_;
     std::vector<SpriteFrame> frames_;
 
+    static void read_stdin(std::vector<unsigned char>& out) {
+        size_t used = 0;
+        while (std::cin) {
+            out.resize(used + k_stdin_block_bytes);
+            std::cin.read(reinterpret_cast<char*>(out.data() + used), static_cast<std::streamsize>(k_stdin_block_bytes));
+            used += static_cast<size_t>(std::cin.gcount());
+        }
+        out.resize(used);
+    }
+
     bool load_image() {
-        std::vector<unsigned char> buffer;
         fs::path actual_input_path = config_.input_path;
         if (actual_input_path.empty() && !config_.detected_input_path.empty()) {
             actual_input_path = config_.detected_input_path;
         }
 
+        // Atlas files are decoded straight from a read-only mapping; only
+        // piped or obfuscated input is held in `buffer`.
+        sprat::core::MappedFile mapped;
+        std::vector<unsigned char> buffer;
+        const unsigned char* bytes = nullptr;
+        size_t size = 0;
         if (actual_input_path.empty() && config_.input_from_stdin) {
-            buffer.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+            read_stdin(buffer);
+            bytes = buffer.data();
+            size = buffer.size();
         } else if (!actual_input_path.empty()) {
-            std::ifstream in(actual_input_path, std::ios::binary);
-            if (in) {
-                buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            if (mapped.open(actual_input_path)) {
+                bytes = mapped.data();
+                size = mapped.size();
             }
         } else {
             std::cerr << tr("Error: No input atlas provided.\n");
             return false;
         }
 
-        if (buffer.empty()) {
+        if (size == 0) {
             std::cerr << tr("Error: No atlas image data received\n");
             return false;
         }
@@ -134,18 +177,19 @@ private:
         // Check for obfuscation
         const std::string prefix = "SPRAT!";
         const std::string key = "sprat";
-        if (buffer.size() >= prefix.size() && std::equal(prefix.begin(), prefix.end(), buffer.begin())) {
-            std::vector<unsigned char> deobfuscated;
-            deobfuscated.reserve(buffer.size() - prefix.size());
-            for (size_t i = prefix.size(); i < buffer.size(); ++i) {
-                deobfuscated.push_back(buffer[i] ^ static_cast<unsigned char>(key[(i - prefix.size()) % key.size()]));
+        if (size >= prefix.size() && std::equal(prefix.begin(), prefix.end(), bytes)) {
+            std::vector<unsigned char> deobfuscated(size - prefix.size());
+            for (size_t i = 0; i < deobfuscated.size(); ++i) {
+                deobfuscated[i] = bytes[prefix.size() + i] ^ static_cast<unsigned char>(key[i % key.size()]);
             }
             buffer = std::move(deobfuscated);
+            bytes = buffer.data();
+            size = buffer.size();
         }
 
         unsigned char* data = stbi_load_from_memory(
-            buffer.data(),
-            static_cast<int>(buffer.size()),
+            bytes,
+            static_cast<int>(size),
             &width_,
             &height_,
             &channels_,
@@ -156,8 +200,7 @@ private:
             return false;
         }
 
-        image_data_.assign(data, data + (static_cast<size_t>(width_) * height_ * NUM_CHANNELS));
-        stbi_image_free(data);
+        image_data_.reset(data);
         return true;
     }
 
@@ -528,6 +571,91 @@ private:
         return std::string::npos;
     }
 
+    // One frame after encoding: its PNG bytes, or why it failed.
+    struct EncodedFrame {
+        std::vector<unsigned char> png;
+        fs::path output_path;
+        std::string error;
+        bool ok = false;
+    };
+
+    // Runs `produce` for every frame on up to config_.threads workers and
+    // hands the results to `consume` on the calling thread in frame order.
+    // Workers stay at most a few frames per thread ahead of `consume`, so
+    // memory stays bounded however many frames the atlas has. Stops early
+    // once `consume` returns false.
+    template <typename Produce, typename Consume>
+    bool for_each_frame_in_order(Produce&& produce, Consume&& consume) {
+        const size_t frame_count = frames_.size();
+        const size_t worker_count = std::min<size_t>(std::max(1U, config_.threads), frame_count);
+        if (worker_count <= 1) {
+            for (const auto& frame : frames_) {
+                EncodedFrame encoded;
+                produce(frame, encoded);
+                if (!consume(frame, encoded)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        const size_t max_in_flight = worker_count * k_frames_in_flight_per_thread;
+        std::vector<std::unique_ptr<EncodedFrame>> finished(frame_count);
+        std::mutex pipeline_mtx;
+        std::condition_variable pipeline_cv;
+        size_t next_job = 0;
+        size_t next_write = 0;
+        bool stopped = false;
+        std::vector<std::thread> workers;
+        workers.reserve(worker_count);
+        for (size_t w = 0; w < worker_count; ++w) {
+            workers.emplace_back([&]() {
+                while (true) {
+                    size_t job = 0;
+                    {
+                        std::unique_lock lock(pipeline_mtx);
+                        pipeline_cv.wait(lock, [&]() {
+                            return stopped || next_job >= frame_count ||
+                                   next_job < next_write + max_in_flight;
+                        });
+                        if (stopped || next_job >= frame_count) {
+                            return;
+                        }
+                        job = next_job++;
+                    }
+                    auto encoded = std::make_unique<EncodedFrame>();
+                    produce(frames_[job], *encoded);
+                    {
+                        std::scoped_lock lock(pipeline_mtx);
+                        finished[job] = std::move(encoded);
+                    }
+                    pipeline_cv.notify_all();
+                }
+            });
+        }
+
+        bool ok = true;
+        for (size_t job = 0; job < frame_count && ok; ++job) {
+            std::unique_ptr<EncodedFrame> encoded;
+            {
+                std::unique_lock lock(pipeline_mtx);
+                pipeline_cv.wait(lock, [&]() { return finished[job] != nullptr; });
+                encoded = std::move(finished[job]);
+            }
+            ok = consume(frames_[job], *encoded);
+            {
+                std::scoped_lock lock(pipeline_mtx);
+                ++next_write;
+                stopped = !ok;
+            }
+            pipeline_cv.notify_all();
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        return ok;
+    }
+
     bool unpack_to_dir() {
         if (!fs::exists(config_.output_dir)) {
             std::error_code ec;
@@ -539,11 +667,24 @@ private:
 
         std::cout << tr("Unpacking ") << frames_.size() << tr(" frames to ") << to_quoted(config_.output_dir.string()) << tr("...\n");
 
-        for (const auto& frame : frames_) {
-            if (!save_sprite_image(frame)) {
-                std::cerr << tr("Warning: Failed to save sprite ") << to_quoted(frame.name) << "\n";
-            }
-        }
+        // Frames are encoded by the workers but written here, in frame
+        // order, so frames sharing a name overwrite each other exactly as
+        // they do with a single thread instead of racing on the same file.
+        for_each_frame_in_order(
+            [this](const SpriteFrame& frame, EncodedFrame& result) {
+                result.ok = encode_sprite_image(frame, result);
+            },
+            [this](const SpriteFrame& frame, EncodedFrame& result) {
+                if (result.ok) {
+                    result.ok = write_sprite_image(frame, result);
+                }
+                result.png = {};
+                if (!result.ok) {
+                    std::cerr << result.error;
+                    std::cerr << tr("Warning: Failed to save sprite ") << to_quoted(frame.name) << "\n";
+                }
+                return true;
+            });
 
         return true;
     }
@@ -582,12 +723,21 @@ private:
             return false;
         }
 
-        for (const auto& frame : frames_) {
-            if (!write_sprite_to_archive_entry(a, frame)) {
-                std::cerr << tr("Warning: Failed to add sprite ") << to_quoted(frame.name) << tr(" to archive\n");
-                archive_write_free(a);
-                return false;
-            }
+        // Frames are encoded in parallel; entries are appended in frame order.
+        const bool written = for_each_frame_in_order(
+            [this](const SpriteFrame& frame, EncodedFrame& result) {
+                result.ok = encode_frame(frame, result.png);
+            },
+            [&](const SpriteFrame& frame, const EncodedFrame& result) {
+                if (!result.ok || !write_sprite_to_archive_entry(a, frame, result.png)) {
+                    std::cerr << tr("Warning: Failed to add sprite ") << to_quoted(frame.name) << tr(" to archive\n");
+                    return false;
+                }
+                return true;
+            });
+        if (!written) {
+            archive_write_free(a);
+            return false;
         }
 
         if (archive_write_close(a) != ARCHIVE_OK) {
@@ -600,59 +750,66 @@ private:
         return true;
     }
 
-    std::vector<unsigned char> extract_sprite_pixels(const SpriteFrame& frame) {
+    [[nodiscard]] bool frame_in_bounds(const SpriteFrame& frame) const {
         const auto& bounds = frame.frame;
+        return bounds.w > 0 && bounds.h > 0 &&
+               bounds.x >= 0 && bounds.y >= 0 &&
+               bounds.x + bounds.w <= width_ && bounds.y + bounds.h <= height_;
+    }
 
-        // Validate frame rectangle against loaded atlas dimensions.
-        if (bounds.w <= 0 || bounds.h <= 0 ||
-            bounds.x < 0 || bounds.y < 0 ||
-            bounds.x + bounds.w > width_ || bounds.y + bounds.h > height_) {
-            return {};
-        }
-
-        const int out_w = frame.rotated ? bounds.h : bounds.w;
-        const int out_h = frame.rotated ? bounds.w : bounds.h;
+    // Copies a rotated frame out of the atlas, turned back upright.
+    [[nodiscard]] std::vector<unsigned char> extract_rotated_pixels(const SpriteFrame& frame) const {
+        const auto& bounds = frame.frame;
+        const int out_w = bounds.h;
+        const int out_h = bounds.w;
+        const unsigned char* atlas = image_data_.get();
 
         std::vector<unsigned char> sprite_data(static_cast<size_t>(out_w) * out_h * NUM_CHANNELS);
-        if (!frame.rotated) {
-            const size_t row_bytes = static_cast<size_t>(out_w) * NUM_CHANNELS;
-            for (int oy = 0; oy < out_h; oy++) {
-                const size_t dst_offset = static_cast<size_t>(oy) * out_w * NUM_CHANNELS;
-                const size_t src_offset = (static_cast<size_t>(bounds.y + oy) * width_ + bounds.x) * NUM_CHANNELS;
-                std::memcpy(&sprite_data[dst_offset], &image_data_[src_offset], row_bytes);
-            }
-        } else {
-            for (int oy = 0; oy < out_h; oy++) {
-                for (int ox = 0; ox < out_w; ox++) {
-                    const int atlas_x = bounds.x + (out_h - 1 - oy);
-                    const int atlas_y = bounds.y + ox;
-                    const size_t dst_idx = (static_cast<size_t>(oy) * out_w + ox) * NUM_CHANNELS;
-                    const size_t src_idx = (static_cast<size_t>(atlas_y) * width_ + atlas_x) * NUM_CHANNELS;
-                    std::memcpy(&sprite_data[dst_idx], &image_data_[src_idx], NUM_CHANNELS);
-                }
+        for (int oy = 0; oy < out_h; oy++) {
+            for (int ox = 0; ox < out_w; ox++) {
+                const int atlas_x = bounds.x + (out_h - 1 - oy);
+                const int atlas_y = bounds.y + ox;
+                const size_t dst_idx = (static_cast<size_t>(oy) * out_w + ox) * NUM_CHANNELS;
+                const size_t src_idx = (static_cast<size_t>(atlas_y) * width_ + atlas_x) * NUM_CHANNELS;
+                std::memcpy(&sprite_data[dst_idx], &atlas[src_idx], NUM_CHANNELS);
             }
         }
         return sprite_data;
     }
 
-    bool write_sprite_to_archive_entry(struct archive* a, const SpriteFrame& frame) {
-        const int out_w = frame.rotated ? frame.frame.h : frame.frame.w;
-        const int out_h = frame.rotated ? frame.frame.w : frame.frame.h;
-
-        std::vector<unsigned char> sprite_data = extract_sprite_pixels(frame);
-
-        // Encode as PNG in memory
-        std::vector<unsigned char> png_buffer;
-        auto write_to_vec = [](void* context, void* data, int size) {
-            auto* vec = static_cast<std::vector<unsigned char>*>(context);
-            const auto* bytes = static_cast<const unsigned char*>(data);
-            vec->insert(vec->end(), bytes, bytes + size);
-        };
-
-        if (!stbi_write_png_to_func(write_to_vec, &png_buffer, out_w, out_h, NUM_CHANNELS, sprite_data.data(), out_w * NUM_CHANNELS)) {
+    // Encodes one frame as PNG into `png`. Unrotated frames are passed to the
+    // encoder as a strided view of the atlas rows, without copying pixels.
+    // Safe to call from several threads at once.
+    bool encode_frame(const SpriteFrame& frame, std::vector<unsigned char>& png) const {
+        if (!frame_in_bounds(frame)) {
             return false;
         }
+        const auto& bounds = frame.frame;
+        const int out_w = frame.rotated ? bounds.h : bounds.w;
+        const int out_h = frame.rotated ? bounds.w : bounds.h;
+
+        std::vector<unsigned char> upright;
+        const unsigned char* pixels = nullptr;
+        int stride = 0;
+        if (frame.rotated) {
+            upright = extract_rotated_pixels(frame);
+            pixels = upright.data();
+            stride = out_w * NUM_CHANNELS;
+        } else {
+            pixels = image_data_.get() + ((static_cast<size_t>(bounds.y) * width_ + bounds.x) * NUM_CHANNELS);
+            stride = width_ * NUM_CHANNELS;
+        }
+
+        sprat::core::ProfileScope encode_scope("encode");
+        png.clear();
+        const bool ok = stbi_write_png_to_func(append_to_vector, &png, out_w, out_h, NUM_CHANNELS, pixels, stride) != 0;
+        encode_scope.arg("bytes", static_cast<int64_t>(png.size()));
+        sprat::core::profile_count("frames.encoded");
+        sprat::core::profile_count("encode.bytes", static_cast<int64_t>(png.size()));
+        return ok;
+    }
 
+    bool write_sprite_to_archive_entry(struct archive* a, const SpriteFrame& frame, const std::vector<unsigned char>& png_buffer) {
         std::string filename = frame.name;
         if (filename.find('.') == std::string::npos) {
             filename += ".png";
@@ -686,43 +843,48 @@ private:
         return true;
     }
 
-    bool save_sprite_image(const SpriteFrame& frame) {
-        const int out_w = frame.rotated ? frame.frame.h : frame.frame.w;
-        const int out_h = frame.rotated ? frame.frame.w : frame.frame.h;
-
-        std::vector<unsigned char> sprite_data = extract_sprite_pixels(frame);
-        if (sprite_data.empty()) {
-            std::cerr << tr("Error: Frame ") << to_quoted(frame.name) << tr(" references pixels outside the atlas bounds\n");
+    // Resolves where one frame goes below the output directory and encodes
+    // it. Runs on worker threads, so errors are appended to result.error
+    // instead of printed.
+    bool encode_sprite_image(const SpriteFrame& frame, EncodedFrame& result) const {
+        if (!frame_in_bounds(frame)) {
+            result.error += tr("Error: Frame ") + to_quoted(frame.name) + tr(" references pixels outside the atlas bounds\n");
             return false;
         }
 
         // Reject frame names that escape the output directory (path traversal guard).
         fs::path name_path(frame.name);
         if (name_path.is_absolute()) {
-            std::cerr << tr("Error: Frame name is an absolute path: ") << to_quoted(frame.name) << "\n";
+            result.error += tr("Error: Frame name is an absolute path: ") + to_quoted(frame.name) + "\n";
             return false;
         }
         fs::path output_path = (config_.output_dir / name_path).lexically_normal();
         fs::path rel = output_path.lexically_relative(config_.output_dir.lexically_normal());
         if (rel.empty() || rel.begin()->string() == "..") {
-            std::cerr << tr("Error: Frame name escapes output directory: ") << to_quoted(frame.name) << "\n";
+            result.error += tr("Error: Frame name escapes output directory: ") + to_quoted(frame.name) + "\n";
             return false;
         }
 
         if (output_path.extension().empty()) {
             output_path += ".png";
         }
+        result.output_path = std::move(output_path);
+        return encode_frame(frame, result.png);
+    }
 
+    // Writes a frame encoded by encode_sprite_image. Called on one thread
+    // only, in frame order.
+    static bool write_sprite_image(const SpriteFrame& frame, EncodedFrame& result) {
         std::error_code ec;
-        fs::create_directories(output_path.parent_path(), ec);
+        fs::create_directories(result.output_path.parent_path(), ec);
         if (ec) {
-            std::cerr << tr("Error: Failed to create output directory for ") << to_quoted(frame.name) << "\n";
+            result.error += tr("Error: Failed to create output directory for ") + to_quoted(frame.name) + "\n";
             return false;
         }
 
-        return stbi_write_png(output_path.string().c_str(),
-                             out_w, out_h, NUM_CHANNELS,
-                             sprite_data.data(), out_w * NUM_CHANNELS) != 0;
+        std::ofstream out(result.output_path, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(result.png.data()), static_cast<std::streamsize>(result.png.size()));
+        return static_cast<bool>(out);
     }
 };
 
@@ -736,6 +898,7 @@ void print_usage() {
               << tr("  -f, --frames PATH          Frames definition file (or '-' for stdin)\n")
               << tr("  -o, --output DIR           Output directory (if omitted, output as TAR to stdout)\n")
               << tr("  -j, --threads N            Number of threads to use (default: auto)\n")
+              << tr("  --trace FILE               Write stage timings and counters as Chrome trace JSON\n")
               << tr("  --debug                    Enable detailed error reporting\n")
               << tr("  -h, --help                 Show this help message\n")
               << tr("  -v, --version              Show version\n");
@@ -744,6 +907,7 @@ void print_usage() {
 } // namespace
 
 int run_spratunpack(int argc, char** argv) {
+    sprat::core::ProfileSession profile_session("spratunpack");
     Config config;
     config.output_dir = "";
     config.debug = (std::getenv("SPRAT_DEBUG") != nullptr);
@@ -794,6 +958,13 @@ int run_spratunpack(int argc, char** argv) {
                 std::cerr << tr("Error: Missing value for ") << arg << "\n";
                 return 1;
             }
+        } else if (arg == "--trace") {
+            if (i + 1 < argc) {
+                profile_session.start(argv[++i]);
+            } else {
+                std::cerr << tr("Error: Missing value for ") << arg << "\n";
+                return 1;
+            }
         } else if (arg.starts_with("-")) {
             std::cerr << tr("Unknown option: ") << arg << "\n";
             print_usage();
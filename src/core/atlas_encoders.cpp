@@ -0,0 +1,358 @@
+#include "atlas_encoders.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <thread>
+#include <utility>
+
+#ifdef SPRAT_HAS_SQUISH
+#include <squish.h>
+#endif
+
+#ifdef SPRAT_HAS_WEBP
+#include <webp/encode.h>
+#endif
+
+#ifdef SPRAT_HAS_AVIF
+#include <avif/avif.h>
+#endif
+
+#ifdef SPRAT_HAS_ZOPFLI
+#include <zopflipng/zopflipng_lib.h>
+#endif
+
+namespace sprat::core {
+
+#ifdef SPRAT_HAS_SQUISH
+namespace {
+
+constexpr size_t k_channels = 4;
+// Block rows handed to a compression worker at a time.
+constexpr int k_dds_block_rows_per_job = 4;
+
+// Marks the 4x4 blocks that sprite pixels can reach. `margin` covers the
+// passes that write outside the sprite rectangles (extrusion, dilation);
+// every other block is still the zeroed atlas background.
+std::vector<unsigned char> occupied_dds_blocks(
+    const std::vector<Sprite>& sprites,
+    int blocks_x,
+    int blocks_y,
+    int margin
+) {
+    std::vector<unsigned char> occupied(static_cast<size_t>(blocks_x) * static_cast<size_t>(blocks_y), 0);
+    for (const auto& s : sprites) {
+        if (s.w <= 0 || s.h <= 0) {
+            continue;
+        }
+        const int bx0 = std::max(0, (s.x - margin) / 4);
+        const int by0 = std::max(0, (s.y - margin) / 4);
+        const int bx1 = std::min(blocks_x - 1, (s.x + s.w - 1 + margin) / 4);
+        const int by1 = std::min(blocks_y - 1, (s.y + s.h - 1 + margin) / 4);
+        for (int by = by0; by <= by1; ++by) {
+            std::fill_n(occupied.begin() + static_cast<std::ptrdiff_t>(static_cast<size_t>(by) * blocks_x + bx0),
+                        std::max(0, bx1 - bx0 + 1), 1);
+        }
+    }
+    return occupied;
+}
+
+} // namespace
+
+std::vector<unsigned char> compress_to_dds(
+    const std::vector<unsigned char>& rgba_data,
+    int width,
+    int height,
+    const std::string& format,
+    const std::vector<Sprite>& sprites,
+    int margin,
+    unsigned int thread_count
+) {
+    std::vector<unsigned char> dds_output;
+
+    // Validate dimensions are multiple of 4 (DXT requirement)
+    if (width % 4 != 0 || height % 4 != 0) {
+        return dds_output;  // Return empty on error
+    }
+
+    // Determine compression flags
+    const bool dxt1 = format == "dxt1" || format == "DXT1";
+    const int squish_flags = dxt1
+        ? (squish::kDxt1 | squish::kColourClusterFit)
+        : (squish::kDxt5 | squish::kColourClusterFit);
+    const size_t block_bytes = dxt1 ? 8 : 16;
+    const int blocks_x = width / 4;
+    const int blocks_y = height / 4;
+
+    // Compute compressed size (DXT1: width*height/2, DXT5: width*height)
+    size_t compressed_bytes = static_cast<size_t>(blocks_x) * static_cast<size_t>(blocks_y) * block_bytes;
+
+    // Build minimal DDS header (128 bytes)
+    struct DdsHeader {
+        uint32_t magic;               // 0x20534444 = "DDS "
+        uint32_t size;                // Header size (124 bytes)
+        uint32_t flags;               // Surface descriptor flags
+        uint32_t height;              // Texture height
+        uint32_t width;               // Texture width
+        uint32_t pitch_or_linear;     // Pitch or linear size
+        uint32_t depth;               // Texture depth (0 for 2D)
+        uint32_t mipmap_count;        // Number of mipmaps
+        uint32_t reserved[11];        // Reserved/unused
+        // PixelFormat (32 bytes)
+        struct {
+            uint32_t size;            // PixelFormat size (32 bytes)
+            uint32_t flags;           // Flags
+            uint32_t fourcc;          // FourCC code
+            uint32_t rgb_bit_count;   // RGB bits
+            uint32_t r_mask;          // Red mask
+            uint32_t g_mask;          // Green mask
+            uint32_t b_mask;          // Blue mask
+            uint32_t a_mask;          // Alpha mask
+        } pixel_format;
+        // Caps (16 bytes)
+        uint32_t caps1;
+        uint32_t caps2;
+        uint32_t caps3;
+        uint32_t caps4;
+        uint32_t reserved2;
+    };
+    static_assert(sizeof(DdsHeader) == 128, "DDS header must be 128 bytes");
+
+    DdsHeader header = {};
+    header.magic = 0x20534444;  // "DDS "
+    header.size = 124;
+    header.flags = 0x0001 | 0x0002 | 0x0004 | 0x1000;  // CAPS | HEIGHT | WIDTH | LINEARSIZE
+    header.height = static_cast<uint32_t>(height);
+    header.width = static_cast<uint32_t>(width);
+    header.pitch_or_linear = static_cast<uint32_t>(compressed_bytes);
+    header.depth = 0;
+    header.mipmap_count = 1;
+
+    header.pixel_format.size = 32;
+    header.pixel_format.flags = 0x0004;  // FOURCC
+    header.pixel_format.fourcc = dxt1 ? 0x31545844 : 0x35545844;  // "DXT1" or "DXT5"
+
+    header.caps1 = 0x1000;  // TEXTURE
+
+    // Write header, then compress straight into the space after it
+    dds_output.resize(sizeof(header) + compressed_bytes);
+    std::memcpy(dds_output.data(), &header, sizeof(header));
+    unsigned char* compressed = dds_output.data() + sizeof(header);
+
+    const std::vector<unsigned char> occupied = occupied_dds_blocks(sprites, blocks_x, blocks_y, margin);
+    std::array<unsigned char, 16> empty_block{};
+    {
+        const std::array<unsigned char, 4 * 16> transparent{};
+        squish::Compress(transparent.data(), empty_block.data(), squish_flags);
+    }
+
+    const size_t row_stride = static_cast<size_t>(width) * k_channels;
+    auto compress_block_rows = [&](int by_begin, int by_end) {
+        std::array<unsigned char, 4 * 16> block_rgba{};
+        for (int by = by_begin; by < by_end; ++by) {
+            for (int bx = 0; bx < blocks_x; ++bx) {
+                const size_t block_index = static_cast<size_t>(by) * blocks_x + bx;
+                unsigned char* target = compressed + block_index * block_bytes;
+                if (occupied[block_index] == 0) {
+                    std::memcpy(target, empty_block.data(), block_bytes);
+                    continue;
+                }
+                const unsigned char* source = rgba_data.data() + static_cast<size_t>(by) * 4 * row_stride +
+                                              static_cast<size_t>(bx) * 4 * k_channels;
+                for (int py = 0; py < 4; ++py) {
+                    std::memcpy(block_rgba.data() + static_cast<size_t>(py) * 4 * k_channels,
+                                source + static_cast<size_t>(py) * row_stride, 4 * k_channels);
+                }
+                squish::Compress(block_rgba.data(), target, squish_flags);
+            }
+        }
+    };
+
+    const int job_count = (blocks_y + k_dds_block_rows_per_job - 1) / k_dds_block_rows_per_job;
+    const unsigned int worker_count = std::min<unsigned int>(std::max(1u, thread_count), static_cast<unsigned int>(job_count));
+    std::atomic<int> next_job{0};
+    auto run_jobs = [&]() {
+        for (int job = next_job.fetch_add(1, std::memory_order_relaxed); job < job_count;
+             job = next_job.fetch_add(1, std::memory_order_relaxed)) {
+            const int by_begin = job * k_dds_block_rows_per_job;
+            compress_block_rows(by_begin, std::min(blocks_y, by_begin + k_dds_block_rows_per_job));
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < worker_count; ++i) {
+        workers.emplace_back(run_jobs);
+    }
+    run_jobs();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    return dds_output;
+}
+#else
+std::vector<unsigned char> compress_to_dds(const std::vector<unsigned char>& /*rgba_data*/,
+                                           int /*width*/,
+                                           int /*height*/,
+                                           const std::string& /*format*/,
+                                           const std::vector<Sprite>& /*sprites*/,
+                                           int /*margin*/,
+                                           unsigned int /*thread_count*/) {
+    return {};
+}
+#endif
+
+#ifdef SPRAT_HAS_WEBP
+std::vector<unsigned char> encode_webp(
+    const unsigned char* rgba_data,
+    int width,
+    int height,
+    int quality
+) {
+    uint8_t* output = nullptr;
+    size_t output_size = 0;
+
+    if (quality >= 100) {
+        output_size = WebPEncodeLosslessRGBA(rgba_data, width, height,
+                                              width * 4, &output);
+    } else {
+        float q = (quality < 0) ? 100.0f : static_cast<float>(quality);
+        output_size = WebPEncodeRGBA(rgba_data, width, height,
+                                      width * 4, q, &output);
+    }
+
+    std::vector<unsigned char> result;
+    if (output_size > 0 && output) {
+        result.assign(output, output + output_size);
+    }
+    WebPFree(output);
+    return result;
+}
+#else
+std::vector<unsigned char> encode_webp(const unsigned char* /*rgba_data*/, int /*width*/, int /*height*/,
+                                       int /*quality*/) {
+    return {};
+}
+#endif
+
+#ifdef SPRAT_HAS_AVIF
+std::vector<unsigned char> encode_avif(
+    const unsigned char* rgba_data,
+    int width,
+    int height,
+    int quality
+) {
+    std::vector<unsigned char> result;
+
+    avifImage* image = avifImageCreate(width, height, 8, AVIF_PIXEL_FORMAT_YUV444);
+    if (!image) return result;
+
+    image->matrixCoefficients = AVIF_MATRIX_COEFFICIENTS_IDENTITY;
+    image->yuvRange = AVIF_RANGE_FULL;
+
+    avifRGBImage rgb;
+    avifRGBImageSetDefaults(&rgb, image);
+    rgb.format = AVIF_RGB_FORMAT_RGBA;
+    rgb.depth = 8;
+    rgb.pixels = const_cast<uint8_t*>(rgba_data);
+    rgb.rowBytes = static_cast<uint32_t>(width) * 4;
+
+    if (avifImageRGBToYUV(image, &rgb) != AVIF_RESULT_OK) {
+        avifImageDestroy(image);
+        return result;
+    }
+
+    avifEncoder* encoder = avifEncoderCreate();
+    if (!encoder) {
+        avifImageDestroy(image);
+        return result;
+    }
+
+    if (quality >= 100 || quality < 0) {
+        encoder->quality = AVIF_QUALITY_LOSSLESS;
+        encoder->qualityAlpha = AVIF_QUALITY_LOSSLESS;
+    } else {
+        encoder->quality = quality;
+        encoder->qualityAlpha = quality;
+    }
+    encoder->speed = AVIF_SPEED_DEFAULT;
+
+    avifRWData output = AVIF_DATA_EMPTY;
+    avifResult addResult = avifEncoderAddImage(encoder, image, 1, AVIF_ADD_IMAGE_FLAG_SINGLE);
+    if (addResult == AVIF_RESULT_OK) {
+        avifResult finishResult = avifEncoderFinish(encoder, &output);
+        if (finishResult == AVIF_RESULT_OK && output.size > 0) {
+            result.assign(output.data, output.data + output.size);
+        }
+    }
+
+    avifRWDataFree(&output);
+    avifEncoderDestroy(encoder);
+    avifImageDestroy(image);
+    return result;
+}
+#else
+std::vector<unsigned char> encode_avif(const unsigned char* /*rgba_data*/, int /*width*/, int /*height*/,
+                                       int /*quality*/) {
+    return {};
+}
+#endif
+
+#ifdef SPRAT_HAS_ZOPFLI
+// The strategies are the ones ZopfliPNGOptions::auto_filter_strategy tries.
+// Ties go to the earlier strategy, matching a single serial call.
+bool zopfli_optimize_png(const std::vector<unsigned char>& png, unsigned int workers,
+                         std::vector<unsigned char>& optimized) {
+    static constexpr ZopfliPNGFilterStrategy strategies[] = {
+        kStrategyZero, kStrategyMinSum, kStrategyEntropy, kStrategyPredefined, kStrategyBruteForce
+    };
+    constexpr size_t strategy_count = std::size(strategies);
+    if (workers <= 1) {
+        ZopfliPNGOptions options;
+        return ZopfliPNGCompress(png, options, false, &optimized) == 0;
+    }
+
+    std::vector<std::vector<unsigned char>> results(strategy_count);
+    std::vector<char> succeeded(strategy_count, 0);
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> threads;
+    const size_t thread_count = std::min<size_t>(workers, strategy_count);
+    for (size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&]() {
+            for (size_t i = next.fetch_add(1); i < strategy_count; i = next.fetch_add(1)) {
+                ZopfliPNGOptions options;
+                options.auto_filter_strategy = false;
+                options.filter_strategies = {strategies[i]};
+                // Each slot is written by exactly one job; read after join.
+                succeeded[i] = ZopfliPNGCompress(png, options, false, &results[i]) == 0 && !results[i].empty();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    size_t best = strategy_count;
+    for (size_t i = 0; i < strategy_count; ++i) {
+        if (succeeded[i] && (best == strategy_count || results[i].size() < results[best].size())) {
+            best = i;
+        }
+    }
+    if (best == strategy_count) {
+        return false;
+    }
+    optimized = std::move(results[best]);
+    return true;
+}
+#else
+bool zopfli_optimize_png(const std::vector<unsigned char>& /*png*/,
+                         unsigned int /*workers*/,
+                         std::vector<unsigned char>& /*optimized*/) {
+    return false;
+}
+#endif
+
+} // namespace sprat::core
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "layout_parser.h"
+
+#include <string>
+#include <vector>
+
+namespace sprat::core {
+
+// Whole-atlas encoders shared by spratpack and sprat_bench. Each is only
+// built in with its library (SPRAT_HAS_SQUISH, SPRAT_HAS_WEBP,
+// SPRAT_HAS_AVIF, SPRAT_HAS_ZOPFLI); without it, it returns an empty
+// result or false.
+
+// Compresses the atlas to a DXT1 or DXT5 DDS file one 4x4 block at a time,
+// the way squish::CompressImage does, but spreads block rows over
+// `thread_count` workers and copies a single precompressed block into every
+// block no sprite reaches. `margin` covers the passes that write outside
+// the sprite rectangles (extrusion, dilation). The output is identical to
+// CompressImage; it is empty when a dimension is not a multiple of 4.
+std::vector<unsigned char> compress_to_dds(const std::vector<unsigned char>& rgba_data,
+                                           int width,
+                                           int height,
+                                           const std::string& format,
+                                           const std::vector<Sprite>& sprites,
+                                           int margin,
+                                           unsigned int thread_count);
+
+// `quality` of 100 or more (or negative) is lossless.
+std::vector<unsigned char> encode_webp(const unsigned char* rgba_data, int width, int height, int quality);
+std::vector<unsigned char> encode_avif(const unsigned char* rgba_data, int width, int height, int quality);
+
+// Recompresses a whole PNG with ZopfliPNG. The filter strategies it tries
+// on its own run as separate jobs on up to `workers` threads (five at most)
+// and the smallest result is kept.
+bool zopfli_optimize_png(const std::vector<unsigned char>& png,
+                         unsigned int workers,
+                         std::vector<unsigned char>& optimized);
+
+} // namespace sprat::core
@@ -1,13 +1,15 @@
 #include "cli_parse.h"
 
+#include <array>
 #include <cerrno>
 #include <charconv>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 
 namespace sprat::core {
 
-bool parse_positive_int(const std::string& value, int& out) {
+bool parse_positive_int(std::string_view value, int& out) {
     int parsed = 0;
     const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), parsed);
     if (ec != std::errc() || ptr != value.data() + value.size()) {
@@ -20,7 +22,7 @@ bool parse_positive_int(const std::string& value, int& out) {
     return true;
 }
 
-bool parse_non_negative_int(const std::string& value, int& out) {
+bool parse_non_negative_int(std::string_view value, int& out) {
     int parsed = 0;
     const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), parsed);
     if (ec != std::errc() || ptr != value.data() + value.size()) {
@@ -33,7 +35,7 @@ bool parse_non_negative_int(const std::string& value, int& out) {
     return true;
 }
 
-bool parse_non_negative_uint(const std::string& value, unsigned int& out) {
+bool parse_non_negative_uint(std::string_view value, unsigned int& out) {
     if (value.empty() || value[0] == '-') {
         return false;
     }
@@ -46,7 +48,7 @@ bool parse_non_negative_uint(const std::string& value, unsigned int& out) {
     return true;
 }
 
-bool parse_positive_uint(const std::string& value, unsigned int& out) {
+bool parse_positive_uint(std::string_view value, unsigned int& out) {
     unsigned int parsed = 0;
     if (!parse_non_negative_uint(value, parsed) || parsed == 0) {
         return false;
@@ -55,7 +57,7 @@ bool parse_positive_uint(const std::string& value, unsigned int& out) {
     return true;
 }
 
-bool parse_int(const std::string& token, int& out) {
+bool parse_int(std::string_view token, int& out) {
     if (token.empty()) {
         return false;
     }
@@ -68,11 +70,21 @@ bool parse_int(const std::string& token, int& out) {
     return true;
 }
 
-bool parse_double(const std::string& token, double& out) {
+bool parse_double(std::string_view token, double& out) {
     if (token.empty()) {
         return false;
     }
-    const char* begin = token.c_str();
+    // strtod needs a terminated string; short tokens are copied to the stack.
+    std::array<char, 64> small{};
+    std::string large;
+    const char* begin = nullptr;
+    if (token.size() < small.size()) {
+        std::memcpy(small.data(), token.data(), token.size());
+        begin = small.data();
+    } else {
+        large.assign(token);
+        begin = large.c_str();
+    }
     char* end = nullptr;
     errno = 0;
     const double value = std::strtod(begin, &end);
@@ -86,12 +98,12 @@ bool parse_double(const std::string& token, double& out) {
     return true;
 }
 
-bool parse_pair(const std::string& token, int& a, int& b) {
-    size_t comma = token.find(',');
-    if (comma == std::string::npos || comma == 0 || comma + 1 >= token.size()) {
+bool parse_pair(std::string_view token, int& a, int& b) {
+    const size_t comma = token.find(',');
+    if (comma == std::string_view::npos || comma == 0 || comma + 1 >= token.size()) {
         return false;
     }
-    if (token.find(',', comma + 1) != std::string::npos) {
+    if (token.find(',', comma + 1) != std::string_view::npos) {
         return false;
     }
     return parse_int(token.substr(0, comma), a) && parse_int(token.substr(comma + 1), b);
@@ -0,0 +1,238 @@
+#include "directory_scan.h"
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+
+namespace sprat::core {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// One directory of a scan: the files it kept, and its subdirectories with
+// the number of kept files listed before each, so the walk order can be
+// rebuilt afterwards. `relative` is the directory's path below the root.
+struct ScannedDirectory {
+    fs::path path;
+    std::string relative;
+    std::vector<ScannedFile> files;
+    std::vector<size_t> children;
+    std::vector<size_t> child_positions;
+};
+
+struct Subdirectory {
+    fs::path path;
+    std::string relative;
+    size_t position = 0;
+};
+
+std::string join_relative(const std::string& parent, std::string_view name) {
+    if (parent.empty()) {
+        return std::string(name);
+    }
+    std::string relative;
+    relative.reserve(parent.size() + 1 + name.size());
+    relative += parent;
+    relative += static_cast<char>(fs::path::preferred_separator);
+    relative += name;
+    return relative;
+}
+
+// Lists one directory. Subdirectories go to `subdirectories`; regular files
+// accepted by `keep` are stat'ed into `out.files`, others are never stat'ed.
+bool scan_directory_entries(ScannedDirectory& out,
+                            std::vector<Subdirectory>& subdirectories,
+                            const ScanFilter& keep) {
+#ifndef _WIN32
+    DIR* dir = opendir(out.path.c_str());
+    if (dir == nullptr) {
+        return false;
+    }
+    const int dir_fd = dirfd(dir);
+    std::string relative;
+    while (const dirent* entry = readdir(dir)) {
+        const char* name = entry->d_name;
+        if (std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0) {
+            continue;
+        }
+        fs::path child = out.path / name;
+        bool is_directory = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat link_info {};
+            is_directory = fstatat(dir_fd, name, &link_info, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(link_info.st_mode);
+        }
+        if (is_directory) {
+            subdirectories.push_back({std::move(child), join_relative(out.relative, name), out.files.size()});
+            continue;
+        }
+        relative = join_relative(out.relative, name);
+        if (!keep(child, relative)) {
+            continue;
+        }
+        // One fstatat relative to the open directory replaces the separate
+        // type, size and mtime lookups by full path.
+        struct stat info {};
+        if (fstatat(dir_fd, name, &info, 0) != 0 || !S_ISREG(info.st_mode)) {
+            continue;
+        }
+        ScannedFile file{.path = std::move(child), .file_size = static_cast<uintmax_t>(info.st_size)};
+#ifdef __GLIBCXX__
+        const auto modified = std::chrono::file_clock::from_sys(
+            std::chrono::sys_time<std::chrono::nanoseconds>(
+                std::chrono::seconds(info.st_mtim.tv_sec) + std::chrono::nanoseconds(info.st_mtim.tv_nsec)));
+        file.mtime_ticks = std::chrono::duration_cast<fs::file_time_type::duration>(modified.time_since_epoch()).count();
+#else
+        std::error_code ec;
+        const fs::file_time_type modified = fs::last_write_time(file.path, ec);
+        if (ec) {
+            continue;
+        }
+        file.mtime_ticks = modified.time_since_epoch().count();
+#endif
+        out.files.push_back(std::move(file));
+    }
+    closedir(dir);
+    return true;
+#else
+    std::error_code ec;
+    fs::directory_iterator it(out.path, ec);
+    if (ec) {
+        return false;
+    }
+    for (const fs::directory_iterator end; it != end; it.increment(ec)) {
+        if (ec) {
+            return false;
+        }
+        const fs::directory_entry& entry = *it;
+        const std::string name = entry.path().filename().string();
+        std::error_code type_ec;
+        if (entry.is_directory(type_ec) && !entry.is_symlink(type_ec)) {
+            subdirectories.push_back({entry.path(), join_relative(out.relative, name), out.files.size()});
+            continue;
+        }
+        if (!entry.is_regular_file(type_ec) || !keep(entry.path(), join_relative(out.relative, name))) {
+            continue;
+        }
+        std::error_code meta_ec;
+        const uintmax_t size = entry.file_size(meta_ec);
+        if (meta_ec) {
+            continue;
+        }
+        const fs::file_time_type modified = entry.last_write_time(meta_ec);
+        if (meta_ec) {
+            continue;
+        }
+        out.files.push_back(ScannedFile{entry.path(), size, modified.time_since_epoch().count()});
+    }
+    return !ec;
+#endif
+}
+
+} // namespace
+
+bool scan_image_directory(const fs::path& root,
+                          unsigned int worker_count,
+                          const ScanFilter& keep,
+                          std::vector<ScannedFile>& out,
+                          fs::path& failed_path) {
+    std::deque<ScannedDirectory> directories(1);
+    directories.front().path = root;
+    std::vector<size_t> pending{0};
+    size_t active = 0;
+    bool failed = false;
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    auto run_worker = [&]() {
+        std::unique_lock lock(mutex);
+        while (true) {
+            cv.wait(lock, [&]() { return failed || !pending.empty() || active == 0; });
+            if (failed || pending.empty()) {
+                return;
+            }
+            ScannedDirectory* directory = &directories[pending.back()];
+            pending.pop_back();
+            ++active;
+            lock.unlock();
+
+            std::vector<Subdirectory> subdirectories;
+            const bool listed = scan_directory_entries(*directory, subdirectories, keep);
+
+            lock.lock();
+            --active;
+            if (!listed) {
+                if (!failed) {
+                    failed = true;
+                    failed_path = directory->path;
+                }
+            } else {
+                for (auto& subdirectory : subdirectories) {
+                    directory->children.push_back(directories.size());
+                    directory->child_positions.push_back(subdirectory.position);
+                    pending.push_back(directories.size());
+                    ScannedDirectory& child = directories.emplace_back();
+                    child.path = std::move(subdirectory.path);
+                    child.relative = std::move(subdirectory.relative);
+                }
+            }
+            cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < worker_count; ++i) {
+        workers.emplace_back(run_worker);
+    }
+    run_worker();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (failed) {
+        return false;
+    }
+
+    // Rebuild the pre-order walk: each directory's files, with every
+    // subdirectory's contents spliced in where it was listed.
+    size_t total = 0;
+    for (const auto& directory : directories) {
+        total += directory.files.size();
+    }
+    out.reserve(out.size() + total);
+    struct Cursor {
+        size_t directory;
+        size_t next_file;
+        size_t next_child;
+    };
+    std::vector<Cursor> stack{{0, 0, 0}};
+    while (!stack.empty()) {
+        Cursor& cursor = stack.back();
+        ScannedDirectory& directory = directories[cursor.directory];
+        const size_t files_before_child = cursor.next_child < directory.children.size()
+            ? directory.child_positions[cursor.next_child]
+            : directory.files.size();
+        while (cursor.next_file < files_before_child) {
+            out.push_back(std::move(directory.files[cursor.next_file++]));
+        }
+        if (cursor.next_child < directory.children.size()) {
+            const size_t child = directory.children[cursor.next_child++];
+            stack.push_back({child, 0, 0});
+        } else {
+            stack.pop_back();
+        }
+    }
+    return true;
+}
+
+} // namespace sprat::core
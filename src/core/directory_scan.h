@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+namespace sprat::core {
+
+struct ScannedFile {
+    std::filesystem::path path;
+    uintmax_t file_size = 0;
+    // std::filesystem::file_time_type ticks of the last write.
+    long long mtime_ticks = 0;
+};
+
+// Decides whether a regular file is kept. `relative` is the file's path
+// below the scan root, joined with the preferred separator.
+using ScanFilter = std::function<bool(const std::filesystem::path& path, std::string_view relative)>;
+
+// Walks `root` on up to `worker_count` threads, one directory per task, and
+// appends the regular files accepted by `keep` to `out` in the order
+// std::filesystem::recursive_directory_iterator would visit them. Directory
+// symlinks are not followed, and rejected files are never stat'ed. On
+// failure, `failed_path` names the unreadable directory.
+bool scan_image_directory(const std::filesystem::path& root,
+                          unsigned int worker_count,
+                          const ScanFilter& keep,
+                          std::vector<ScannedFile>& out,
+                          std::filesystem::path& failed_path);
+
+} // namespace sprat::core
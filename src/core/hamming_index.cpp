@@ -0,0 +1,195 @@
+#include "hamming_index.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+namespace sprat::core {
+
+namespace {
+
+// Past this distance the chunks get too narrow for lookups to beat a scan.
+constexpr int k_max_indexed_distance = 15;
+// Small groups are cheaper to scan than to index.
+constexpr size_t k_min_indexed_group_size = 64;
+constexpr size_t k_query_block_size = 256;
+
+using Edge = std::pair<size_t, size_t>;
+
+struct HashGroup {
+    std::vector<size_t> items;  // first item of every distinct hash, ascending
+    std::vector<uint64_t> hashes;
+    int chunk_count = 0;        // 0 = pairwise scan
+    std::vector<std::unordered_map<uint64_t, std::vector<uint32_t>>> tables;
+};
+
+uint64_t chunk_value(uint64_t hash, int chunk, int chunk_count) {
+    const int begin = chunk * 64 / chunk_count;
+    const int end = (chunk + 1) * 64 / chunk_count;
+    const int width = end - begin;
+    const uint64_t mask = width >= 64 ? ~0ULL : ((1ULL << width) - 1);
+    return (hash >> begin) & mask;
+}
+
+void index_group(HashGroup& group, int max_distance) {
+    if (max_distance > k_max_indexed_distance || group.hashes.size() < k_min_indexed_group_size) {
+        return;
+    }
+    group.chunk_count = max_distance + 1;
+    group.tables.resize(static_cast<size_t>(group.chunk_count));
+    for (uint32_t pos = 0; pos < group.hashes.size(); ++pos) {
+        for (int chunk = 0; chunk < group.chunk_count; ++chunk) {
+            group.tables[static_cast<size_t>(chunk)][chunk_value(group.hashes[pos], chunk, group.chunk_count)]
+                .push_back(pos);
+        }
+    }
+}
+
+bool within_distance(uint64_t a, uint64_t b, int max_distance) {
+    return std::popcount(a ^ b) <= max_distance;
+}
+
+void query_group(const HashGroup& group, size_t begin, size_t end, int max_distance, std::vector<Edge>& out) {
+    const size_t count = group.hashes.size();
+    if (group.chunk_count == 0) {
+        for (size_t a = begin; a < end; ++a) {
+            for (size_t b = a + 1; b < count; ++b) {
+                if (within_distance(group.hashes[a], group.hashes[b], max_distance)) {
+                    out.emplace_back(group.items[a], group.items[b]);
+                }
+            }
+        }
+        return;
+    }
+    for (size_t a = begin; a < end; ++a) {
+        const uint64_t hash = group.hashes[a];
+        for (int chunk = 0; chunk < group.chunk_count; ++chunk) {
+            const auto& table = group.tables[static_cast<size_t>(chunk)];
+            const auto it = table.find(chunk_value(hash, chunk, group.chunk_count));
+            if (it == table.end()) {
+                continue;
+            }
+            for (uint32_t b : it->second) {
+                if (b <= a) {
+                    continue;
+                }
+                const uint64_t other = group.hashes[b];
+                // Report each pair only from the first chunk on which it agrees.
+                bool seen_earlier = false;
+                for (int prev = 0; prev < chunk && !seen_earlier; ++prev) {
+                    seen_earlier = chunk_value(hash, prev, group.chunk_count) ==
+                                   chunk_value(other, prev, group.chunk_count);
+                }
+                if (!seen_earlier && within_distance(hash, other, max_distance)) {
+                    out.emplace_back(group.items[a], group.items[b]);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+std::vector<size_t> group_near_duplicate_hashes(const std::vector<uint64_t>& hashes,
+                                                const std::vector<uint64_t>& group_keys,
+                                                int max_distance,
+                                                unsigned int worker_count) {
+    const size_t n = hashes.size();
+    std::vector<size_t> parent(n);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&parent](size_t x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    };
+    auto unite = [&](size_t a, size_t b) {
+        const size_t ra = find(a);
+        const size_t rb = find(b);
+        if (ra != rb) {
+            parent[std::max(ra, rb)] = std::min(ra, rb);
+        }
+    };
+    if (max_distance < 0 || group_keys.size() != n) {
+        return parent;
+    }
+
+    // Identical hashes join directly; only distinct hashes are indexed.
+    std::vector<HashGroup> groups;
+    std::unordered_map<uint64_t, size_t> group_of_key;
+    std::unordered_map<uint64_t, std::unordered_map<uint64_t, size_t>> first_with_hash;
+    for (size_t i = 0; i < n; ++i) {
+        if (hashes[i] == 0) {
+            continue;
+        }
+        auto [group_it, new_group] = group_of_key.emplace(group_keys[i], groups.size());
+        if (new_group) {
+            groups.emplace_back();
+        }
+        auto [hash_it, new_hash] = first_with_hash[group_keys[i]].emplace(hashes[i], i);
+        if (!new_hash) {
+            unite(hash_it->second, i);
+            continue;
+        }
+        HashGroup& group = groups[group_it->second];
+        group.items.push_back(i);
+        group.hashes.push_back(hashes[i]);
+    }
+
+    if (max_distance > 0) {
+        struct QueryTask {
+            size_t group;
+            size_t begin;
+            size_t end;
+        };
+        std::vector<QueryTask> tasks;
+        for (size_t g = 0; g < groups.size(); ++g) {
+            index_group(groups[g], max_distance);
+            const size_t count = groups[g].hashes.size();
+            for (size_t begin = 0; begin + 1 < count; begin += k_query_block_size) {
+                tasks.push_back({g, begin, std::min(count, begin + k_query_block_size)});
+            }
+        }
+
+        std::vector<std::vector<Edge>> task_edges(tasks.size());
+        std::atomic<size_t> next_task{0};
+        auto run_tasks = [&]() {
+            for (size_t t = next_task.fetch_add(1); t < tasks.size(); t = next_task.fetch_add(1)) {
+                const QueryTask& task = tasks[t];
+                query_group(groups[task.group], task.begin, task.end, max_distance, task_edges[t]);
+            }
+        };
+        const unsigned int workers = std::min<size_t>(std::max(1u, worker_count), tasks.size());
+        if (workers <= 1) {
+            run_tasks();
+        } else {
+            std::vector<std::thread> threads;
+            threads.reserve(workers);
+            for (unsigned int w = 0; w < workers; ++w) {
+                threads.emplace_back(run_tasks);
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+        for (const auto& edges : task_edges) {
+            for (const auto& [a, b] : edges) {
+                unite(a, b);
+            }
+        }
+    }
+
+    // Roots are always the smallest index of their group.
+    std::vector<size_t> first(n);
+    for (size_t i = 0; i < n; ++i) {
+        first[i] = find(i);
+    }
+    return first;
+}
+
+} // namespace sprat::core
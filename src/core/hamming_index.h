@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sprat::core {
+
+// Groups 64-bit hashes whose Hamming distance is at most `max_distance`,
+// transitively, comparing only items that share the same `group_keys` value.
+// Items whose hash is 0 never join a group. Returns, for every item, the
+// index of the first item of its group (the item itself when it has none).
+//
+// Equivalent to a pairwise scan plus union-find, but finds candidate pairs
+// through multi-index hashing: with max_distance + 1 chunks, two hashes within
+// the distance agree exactly on at least one chunk.
+std::vector<size_t> group_near_duplicate_hashes(const std::vector<uint64_t>& hashes,
+                                                const std::vector<uint64_t>& group_keys,
+                                                int max_distance,
+                                                unsigned int worker_count);
+
+} // namespace sprat::core
@@ -0,0 +1,53 @@
+#include "image_probe.h"
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace sprat::core {
+
+namespace {
+
+constexpr std::array<unsigned char, 8> k_png_signature = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+// Signature, IHDR length and type, then width and height.
+constexpr size_t k_png_probe_size = 24;
+// Same limit stb_image applies, so probing never accepts what decoding rejects.
+constexpr uint32_t k_max_probe_dimension = 1u << 24;
+
+uint32_t read_be32(const unsigned char* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+} // namespace
+
+bool probe_image_dimensions(const std::filesystem::path& path, int& width, int& height) {
+#ifdef _WIN32
+    FILE* file = _wfopen(path.c_str(), L"rb");
+#else
+    FILE* file = std::fopen(path.c_str(), "rb");
+#endif
+    if (file == nullptr) {
+        return false;
+    }
+    std::array<unsigned char, k_png_probe_size> header{};
+    const size_t read = std::fread(header.data(), 1, header.size(), file);
+    std::fclose(file);
+    if (read != header.size() ||
+        std::memcmp(header.data(), k_png_signature.data(), k_png_signature.size()) != 0 ||
+        read_be32(header.data() + 8) != 13 ||
+        std::memcmp(header.data() + 12, "IHDR", 4) != 0) {
+        return false;
+    }
+    const uint32_t w = read_be32(header.data() + 16);
+    const uint32_t h = read_be32(header.data() + 20);
+    if (w == 0 || h == 0 || w > k_max_probe_dimension || h > k_max_probe_dimension) {
+        return false;
+    }
+    width = static_cast<int>(w);
+    height = static_cast<int>(h);
+    return true;
+}
+
+} // namespace sprat::core
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <filesystem>
+
+namespace sprat::core {
+
+// Reads image dimensions from the file header without decoding pixels.
+// Handles PNG directly (signature + IHDR); returns false for other formats
+// and for malformed headers so callers can fall back to stbi_info.
+bool probe_image_dimensions(const std::filesystem::path& path, int& width, int& height);
+
+} // namespace sprat::core
@@ -5,22 +5,58 @@
 #include <cctype>
 #include <cmath>
 #include <iostream>
-#include <sstream>
+#include <iterator>
 #include <string_view>
 #include <unordered_set>
 
-static bool parse_slice(const std::string& val, int& left, int& top, int& right, int& bottom,
+static bool is_space(char c) {
+    return std::isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+// Splits off the next whitespace-separated token, as `std::istream >>` does.
+// Returns an empty view once the input is exhausted.
+static std::string_view next_token(std::string_view line, size_t& pos) {
+    while (pos < line.size() && is_space(line[pos])) {
+        ++pos;
+    }
+    const size_t start = pos;
+    while (pos < line.size() && !is_space(line[pos])) {
+        ++pos;
+    }
+    return line.substr(start, pos - start);
+}
+
+static void skip_space(std::string_view line, size_t& pos) {
+    while (pos < line.size() && is_space(line[pos])) {
+        ++pos;
+    }
+}
+
+// Slice fill modes are a closed set; assigning one of these literals keeps
+// every Sprite::slice_h/slice_v within the small-string buffer.
+static bool assign_fill_mode(std::string_view mode, std::string& out) {
+    constexpr std::array<std::string_view, 3> k_modes = {"stretch", "repeat", "mirror"};
+    for (const auto& known : k_modes) {
+        if (mode == known) {
+            out.assign(known);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_slice(std::string_view val, int& left, int& top, int& right, int& bottom,
                         std::string& h_mode, std::string& v_mode) {
     // Expect "L,T,R,B" or "L,T,R,B,H_MODE,V_MODE"
     size_t p1 = val.find(',');
-    if (p1 == std::string::npos) return false;
+    if (p1 == std::string_view::npos) return false;
     size_t p2 = val.find(',', p1 + 1);
-    if (p2 == std::string::npos) return false;
+    if (p2 == std::string_view::npos) return false;
     size_t p3 = val.find(',', p2 + 1);
-    if (p3 == std::string::npos) return false;
+    if (p3 == std::string_view::npos) return false;
 
     size_t p4 = val.find(',', p3 + 1);
-    if (p4 == std::string::npos) {
+    if (p4 == std::string_view::npos) {
         // 4 values only
         if (!sprat::core::parse_non_negative_int(val.substr(0, p1), left)
             || !sprat::core::parse_non_negative_int(val.substr(p1 + 1, p2 - p1 - 1), top)
@@ -34,9 +70,9 @@ static bool parse_slice(const std::string& val, int& left, int& top, int& right,
     }
 
     size_t p5 = val.find(',', p4 + 1);
-    if (p5 == std::string::npos) return false;
+    if (p5 == std::string_view::npos) return false;
     // No more commas after p5
-    if (val.find(',', p5 + 1) != std::string::npos) return false;
+    if (val.find(',', p5 + 1) != std::string_view::npos) return false;
 
     if (!sprat::core::parse_non_negative_int(val.substr(0, p1), left)
         || !sprat::core::parse_non_negative_int(val.substr(p1 + 1, p2 - p1 - 1), top)
@@ -45,20 +81,15 @@ static bool parse_slice(const std::string& val, int& left, int& top, int& right,
         return false;
     }
 
-    h_mode = val.substr(p4 + 1, p5 - p4 - 1);
-    v_mode = val.substr(p5 + 1);
-
-    if (h_mode != "stretch" && h_mode != "repeat" && h_mode != "mirror") return false;
-    if (v_mode != "stretch" && v_mode != "repeat" && v_mode != "mirror") return false;
-
-    return true;
+    return assign_fill_mode(val.substr(p4 + 1, p5 - p4 - 1), h_mode)
+        && assign_fill_mode(val.substr(p5 + 1), v_mode);
 }
 
 // Returns true for line prefixes that appear in the combined raw-layout format
 // produced by spratconvert but carry no meaning for the basic layout parser.
 // Adding a new prefix here is the only change needed if the format gains a
 // new ignored token type.
-static bool is_combined_format_passthrough(const std::string& line) {
+static bool is_combined_format_passthrough(std::string_view line) {
     constexpr std::array<std::string_view, 5> k_prefixes = {
         "path", "- marker", "- frame", "animation", "fps"
     };
@@ -72,7 +103,7 @@ static bool is_combined_format_passthrough(const std::string& line) {
 
 namespace sprat::core {
 
-bool parse_sprite_line(const std::string& line, Sprite& out, std::string& error) {
+bool parse_sprite_line(std::string_view line, Sprite& out, std::string& error) {
     constexpr std::string_view prefix = "sprite";
     if (!line.starts_with(prefix)) {
         error = "line does not start with sprite";
@@ -80,63 +111,60 @@ bool parse_sprite_line(const std::string& line, Sprite& out, std::string& error)
     }
 
     size_t pos = prefix.size();
-    while (pos < line.size() && std::isspace(static_cast<unsigned char>(line[pos])) != 0) {
-        ++pos;
-    }
+    skip_space(line, pos);
 
-    std::string path;
+    Sprite parsed;
     if (pos >= line.size() || line[pos] != '"') {
         error = "sprite path must be quoted";
         return false;
     }
 
-    if (!parse_quoted(line, pos, path, error)) {
+    if (!parse_quoted(line, pos, parsed.path, error)) {
         return false;
     }
 
-    while (pos < line.size() && std::isspace(static_cast<unsigned char>(line[pos])) != 0) {
-        ++pos;
-    }
-
-    Sprite parsed;
-    parsed.path = path;
-    std::vector<std::string> tokens;
-    std::istringstream tail(line.substr(pos));
-    std::string token;
-    while (tail >> token) {
+    // Only the first six numeric tokens are ever read; the count of the rest
+    // is all the field-count checks below need.
+    constexpr size_t k_max_numeric_tokens = 6;
+    std::array<std::string_view, k_max_numeric_tokens> tokens;
+    size_t token_count = 0;
+    for (std::string_view token = next_token(line, pos); !token.empty(); token = next_token(line, pos)) {
         if (token == "rotated") {
             parsed.rotated = true;
         } else if (token == "dither") {
             parsed.dither = true;
         } else if (token.starts_with("colors=")) {
-            std::string val = token.substr(7);
+            const std::string_view val = token.substr(7);
             if (!parse_int(val, parsed.colors) || (parsed.colors != 0 && (parsed.colors < 2 || parsed.colors > 256))) {
-                error = "invalid colors value (must be 0 or 2-256): " + val;
+                error = "invalid colors value (must be 0 or 2-256): " + std::string(val);
                 return false;
             }
         } else if (token.starts_with("slice=")) {
-            std::string val = token.substr(6);
+            const std::string_view val = token.substr(6);
             if (!parse_slice(val, parsed.slice_left, parsed.slice_top,
                              parsed.slice_right, parsed.slice_bottom,
                              parsed.slice_h, parsed.slice_v)) {
-                error = "invalid slice value (expected L,T,R,B[,H_MODE,V_MODE] with non-negative integers and optional stretch/repeat/mirror modes): " + val;
+                error = "invalid slice value (expected L,T,R,B[,H_MODE,V_MODE] with non-negative integers and optional stretch/repeat/mirror modes): " + std::string(val);
                 return false;
             }
             parsed.has_slice = true;
         } else {
-            tokens.push_back(token);
+            if (token_count < k_max_numeric_tokens) {
+                tokens[token_count] = token;
+            }
+            ++token_count;
         }
     }
 
-    if (tokens.empty()) {
+    if (token_count == 0) {
         error = "sprite line is missing numeric fields";
         return false;
     }
 
-    if (tokens[0].find(',') != std::string::npos) {
+    if (tokens[0].find(',') != std::string_view::npos) {
         constexpr size_t MODERN_SPRITE_TOKENS_MIN = 2;
         constexpr size_t MODERN_SPRITE_TOKENS_MAX = 4;
-        if (tokens.size() != MODERN_SPRITE_TOKENS_MIN && tokens.size() != MODERN_SPRITE_TOKENS_MAX) {
+        if (token_count != MODERN_SPRITE_TOKENS_MIN && token_count != MODERN_SPRITE_TOKENS_MAX) {
             error = "sprite line must contain position/size and optional trim offsets";
             return false;
         }
@@ -154,7 +182,7 @@ bool parse_sprite_line(const std::string& line, Sprite& out, std::string& error)
             return false;
         }
 
-        if (tokens.size() == MODERN_SPRITE_TOKENS_MAX) {
+        if (token_count == MODERN_SPRITE_TOKENS_MAX) {
             if (!parse_pair(tokens[2], parsed.src_x, parsed.src_y)
                 || !parse_pair(tokens[3], parsed.trim_right, parsed.trim_bottom)) {
                 error = "invalid trim offset pair";
@@ -165,7 +193,7 @@ bool parse_sprite_line(const std::string& line, Sprite& out, std::string& error)
     } else {
         constexpr size_t LEGACY_SPRITE_TOKENS_MIN = 4;
         constexpr size_t LEGACY_SPRITE_TOKENS_MAX = 6;
-        if (tokens.size() != LEGACY_SPRITE_TOKENS_MIN && tokens.size() != LEGACY_SPRITE_TOKENS_MAX) {
+        if (token_count != LEGACY_SPRITE_TOKENS_MIN && token_count != LEGACY_SPRITE_TOKENS_MAX) {
             error = "legacy sprite line has invalid field count";
             return false;
         }
@@ -184,7 +212,7 @@ bool parse_sprite_line(const std::string& line, Sprite& out, std::string& error)
             error = "sprite dimensions must not be negative";
             return false;
         }
-        if (tokens.size() == LEGACY_SPRITE_TOKENS_MAX) {
+        if (token_count == LEGACY_SPRITE_TOKENS_MAX) {
             if (!parse_int(tokens[4], parsed.src_x) || !parse_int(tokens[5], parsed.src_y)) {
                 error = "legacy sprite line has invalid crop offsets";
                 return false;
@@ -193,17 +221,15 @@ bool parse_sprite_line(const std::string& line, Sprite& out, std::string& error)
         }
     }
 
-    out = parsed;
+    out = std::move(parsed);
     return true;
 }
 
-bool parse_atlas_line(const std::string& line, int& width, int& height) {
-    std::istringstream iss(line);
-    std::string tag;
-    std::string size_token;
-    std::string extra;
-
-    if (!(iss >> tag >> size_token)) {
+bool parse_atlas_line(std::string_view line, int& width, int& height) {
+    size_t pos = 0;
+    const std::string_view tag = next_token(line, pos);
+    const std::string_view size_token = next_token(line, pos);
+    if (size_token.empty()) {
         return false;
     }
     if (tag != "atlas") {
@@ -211,24 +237,30 @@ bool parse_atlas_line(const std::string& line, int& width, int& height) {
     }
     if (!parse_pair(size_token, width, height)) {
         // Backward compatibility: atlas <w> <h>
-        if (!parse_int(size_token, width) || !(iss >> height)) {
+        if (!parse_int(size_token, width)) {
+            return false;
+        }
+        std::string_view height_token = next_token(line, pos);
+        // `>> int` accepts an explicit plus sign; from_chars does not.
+        if (height_token.starts_with('+') && height_token.size() > 1 && height_token[1] != '-') {
+            height_token.remove_prefix(1);
+        }
+        if (!parse_int(height_token, height)) {
             return false;
         }
     }
-    if (iss >> extra) {
+    if (!next_token(line, pos).empty()) {
         return false;
     }
 
     return true;
 }
 
-bool parse_scale_line(const std::string& line, double& scale) {
-    std::istringstream iss(line);
-    std::string tag;
-    std::string value_token;
-    std::string extra;
-
-    if (!(iss >> tag >> value_token)) {
+bool parse_scale_line(std::string_view line, double& scale) {
+    size_t pos = 0;
+    const std::string_view tag = next_token(line, pos);
+    const std::string_view value_token = next_token(line, pos);
+    if (value_token.empty()) {
         return false;
     }
     if (tag != "scale") {
@@ -237,19 +269,17 @@ bool parse_scale_line(const std::string& line, double& scale) {
     if (!parse_double(value_token, scale) || scale <= 0.0) {
         return false;
     }
-    if (iss >> extra) {
+    if (!next_token(line, pos).empty()) {
         return false;
     }
     return true;
 }
 
-bool parse_extrude_line(const std::string& line, int& extrude) {
-    std::istringstream iss(line);
-    std::string tag;
-    std::string value_token;
-    std::string extra;
-
-    if (!(iss >> tag >> value_token)) {
+bool parse_extrude_line(std::string_view line, int& extrude) {
+    size_t pos = 0;
+    const std::string_view tag = next_token(line, pos);
+    const std::string_view value_token = next_token(line, pos);
+    if (value_token.empty()) {
         return false;
     }
     if (tag != "extrude") {
@@ -258,19 +288,17 @@ bool parse_extrude_line(const std::string& line, int& extrude) {
     if (!parse_int(value_token, extrude) || extrude < 0) {
         return false;
     }
-    if (iss >> extra) {
+    if (!next_token(line, pos).empty()) {
         return false;
     }
     return true;
 }
 
-bool parse_multipack_line(const std::string& line, bool& multipack) {
-    std::istringstream iss(line);
-    std::string tag;
-    std::string value_token;
-    std::string extra;
-
-    if (!(iss >> tag >> value_token)) {
+bool parse_multipack_line(std::string_view line, bool& multipack) {
+    size_t pos = 0;
+    const std::string_view tag = next_token(line, pos);
+    const std::string_view value_token = next_token(line, pos);
+    if (value_token.empty()) {
         return false;
     }
     if (tag != "multipack") {
@@ -283,13 +311,13 @@ bool parse_multipack_line(const std::string& line, bool& multipack) {
     } else {
         return false;
     }
-    if (iss >> extra) {
+    if (!next_token(line, pos).empty()) {
         return false;
     }
     return true;
 }
 
-bool parse_alias_line(const std::string& line, std::string& alias_path, std::string& canonical_path, std::string& error) {
+bool parse_alias_line(std::string_view line, std::string& alias_path, std::string& canonical_path, std::string& error) {
     constexpr std::string_view prefix = "alias";
     if (!line.starts_with(prefix)) {
         error = "line does not start with alias";
@@ -297,9 +325,7 @@ bool parse_alias_line(const std::string& line, std::string& alias_path, std::str
     }
 
     size_t pos = prefix.size();
-    while (pos < line.size() && std::isspace(static_cast<unsigned char>(line[pos])) != 0) {
-        ++pos;
-    }
+    skip_space(line, pos);
 
     if (pos >= line.size() || line[pos] != '"') {
         error = "alias path must be quoted";
@@ -310,9 +336,7 @@ bool parse_alias_line(const std::string& line, std::string& alias_path, std::str
         return false;
     }
 
-    while (pos < line.size() && std::isspace(static_cast<unsigned char>(line[pos])) != 0) {
-        ++pos;
-    }
+    skip_space(line, pos);
 
     if (pos >= line.size() || line[pos] != '"') {
         error = "canonical path must be quoted";
@@ -323,9 +347,7 @@ bool parse_alias_line(const std::string& line, std::string& alias_path, std::str
         return false;
     }
 
-    while (pos < line.size() && std::isspace(static_cast<unsigned char>(line[pos])) != 0) {
-        ++pos;
-    }
+    skip_space(line, pos);
 
     if (pos < line.size()) {
         error = "extra content after canonical path";
@@ -336,11 +358,37 @@ bool parse_alias_line(const std::string& line, std::string& alias_path, std::str
 }
 
 bool parse_layout(std::istream& in, Layout& out, std::string& error) {
+    const std::string text{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    return parse_layout(std::string_view(text), out, error);
+}
+
+bool parse_layout(std::string_view text, Layout& out, std::string& error) {
     Layout parsed;
-    std::string line;
-    std::unordered_set<std::string> seen_sprite_paths;
 
-    while (std::getline(in, line)) {
+    // Sprites are reserved up front so their paths never move; the duplicate
+    // check can then hold views of them instead of copies. Those views stay
+    // valid only because this count is an upper bound on the sprites pushed
+    // below: every sprite comes from a line starting with "sprite", so the
+    // vector never reallocates. Keep the two conditions in sync.
+    size_t sprite_lines = text.starts_with("sprite") ? 1 : 0;
+    for (size_t nl = text.find('\n'); nl != std::string_view::npos; nl = text.find('\n', nl + 1)) {
+        if (text.substr(nl + 1).starts_with("sprite")) {
+            ++sprite_lines;
+        }
+    }
+    parsed.sprites.reserve(sprite_lines);
+    std::unordered_set<std::string_view> seen_sprite_paths;
+    seen_sprite_paths.reserve(sprite_lines);
+
+    size_t line_start = 0;
+    while (line_start < text.size()) {
+        size_t line_end = text.find('\n', line_start);
+        if (line_end == std::string_view::npos) {
+            line_end = text.size();
+        }
+        const std::string_view line = text.substr(line_start, line_end - line_start);
+        line_start = line_end + 1;
+
         if (line.empty()) {
             continue;
         }
@@ -348,11 +396,11 @@ bool parse_layout(std::istream& in, Layout& out, std::string& error) {
         if (line.starts_with("atlas")) {
             int w = 0, h = 0;
             if (!parse_atlas_line(line, w, h)) {
-                error = "Invalid atlas line: " + line;
+                error = "Invalid atlas line: " + std::string(line);
                 return false;
             }
             if (w <= 0 || h <= 0) {
-                error = "Atlas dimensions must be positive: " + line;
+                error = "Atlas dimensions must be positive: " + std::string(line);
                 return false;
             }
             parsed.atlases.push_back({w, h});
@@ -365,13 +413,11 @@ bool parse_layout(std::istream& in, Layout& out, std::string& error) {
             while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t')) {
                 ++pos;
             }
-            std::string root_path;
             std::string root_error;
-            if (!parse_quoted(line, pos, root_path, root_error)) {
+            if (!parse_quoted(line, pos, parsed.root, root_error)) {
                 error = "Invalid root line: " + root_error;
                 return false;
             }
-            parsed.root = root_path;
             parsed.has_root = true;
         } else if (line.starts_with("scale")) {
             if (parsed.has_scale) {
@@ -379,7 +425,7 @@ bool parse_layout(std::istream& in, Layout& out, std::string& error) {
                 return false;
             }
             if (!parse_scale_line(line, parsed.scale)) {
-                error = "Invalid scale line: " + line;
+                error = "Invalid scale line: " + std::string(line);
                 return false;
             }
             parsed.has_scale = true;
@@ -389,7 +435,7 @@ bool parse_layout(std::istream& in, Layout& out, std::string& error) {
                 return false;
             }
             if (!parse_extrude_line(line, parsed.extrude)) {
-                error = "Invalid extrude line: " + line;
+                error = "Invalid extrude line: " + std::string(line);
                 return false;
             }
             parsed.has_extrude = true;
@@ -399,12 +445,12 @@ bool parse_layout(std::istream& in, Layout& out, std::string& error) {
                 return false;
             }
             if (!parse_multipack_line(line, parsed.multipack)) {
-                error = "Invalid multipack line: " + line;
+                error = "Invalid multipack line: " + std::string(line);
                 return false;
             }
             parsed.has_multipack = true;
         } else if (line.starts_with("sprite")) {
-            Sprite s;
+            Sprite& s = parsed.sprites.emplace_back();
             std::string sprite_error;
             if (!parse_sprite_line(line, s, sprite_error)) {
                 error = "Invalid sprite line: " + sprite_error;
@@ -427,27 +473,23 @@ bool parse_layout(std::istream& in, Layout& out, std::string& error) {
             if (!parsed.multipack && !seen_sprite_paths.insert(s.path).second) {
                 std::cerr << "Warning: duplicate sprite path: " << s.path << "\n";
             }
-            parsed.sprites.push_back(s);
         } else if (line.starts_with("alias")) {
             std::string alias_path, canonical_path;
             if (!parse_alias_line(line, alias_path, canonical_path, error)) {
                 error = "Invalid alias line: " + error;
                 return false;
             }
-            parsed.aliases.push_back({alias_path, canonical_path});
+            parsed.aliases.push_back({std::move(alias_path), std::move(canonical_path)});
         } else if (is_combined_format_passthrough(line)) {
             // These lines are valid in the combined raw layout format but carry no
             // meaning for the basic layout parser. See is_combined_format_passthrough.
             continue;
         } else {
             // If the line is just whitespace, skip it
-            std::string trimmed = line;
-            trimmed.erase(0, trimmed.find_first_not_of(" \t\r\n"));
-            trimmed.erase(trimmed.find_last_not_of(" \t\r\n") + 1);
-            if (trimmed.empty()) {
+            if (line.find_first_not_of(" \t\r\n") == std::string_view::npos) {
                 continue;
             }
-            error = "Unknown line: " + line;
+            error = "Unknown line: " + std::string(line);
             return false;
         }
     }
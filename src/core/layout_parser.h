@@ -65,12 +65,17 @@ struct Layout {
     std::vector<std::pair<std::string, std::string>> aliases;  // (alias_path, canonical_path) pairs
 };
 
-bool parse_sprite_line(const std::string& line, Sprite& out, std::string& error);
-bool parse_atlas_line(const std::string& line, int& width, int& height);
-bool parse_scale_line(const std::string& line, double& scale);
-bool parse_extrude_line(const std::string& line, int& extrude);
-bool parse_multipack_line(const std::string& line, bool& multipack);
-bool parse_alias_line(const std::string& line, std::string& alias_path, std::string& canonical_path, std::string& error);
+bool parse_sprite_line(std::string_view line, Sprite& out, std::string& error);
+bool parse_atlas_line(std::string_view line, int& width, int& height);
+bool parse_scale_line(std::string_view line, double& scale);
+bool parse_extrude_line(std::string_view line, int& extrude);
+bool parse_multipack_line(std::string_view line, bool& multipack);
+bool parse_alias_line(std::string_view line, std::string& alias_path, std::string& canonical_path, std::string& error);
+
+// Parses a whole layout held in memory. Lines are tokenized in place, so the
+// only strings allocated are the ones stored in the resulting Layout.
+bool parse_layout(std::string_view text, Layout& out, std::string& error);
+// Reads the stream to its end and parses it as above.
 bool parse_layout(std::istream& in, Layout& out, std::string& error);
 
 } // namespace sprat::core
@@ -0,0 +1,149 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <fstream>
+#include <limits>
+#include <utility>
+
+namespace sprat::core {
+
+namespace {
+
+bool map_whole_file(const std::filesystem::path& path, const unsigned char*& data, size_t& size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER file_size{};
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0 ||
+        static_cast<unsigned long long>(file_size.QuadPart) > std::numeric_limits<size_t>::max()) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    // The view keeps the mapping object alive.
+    CloseHandle(mapping);
+    if (view == nullptr) {
+        return false;
+    }
+    data = static_cast<const unsigned char*>(view);
+    size = static_cast<size_t>(file_size.QuadPart);
+    return true;
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 ||
+        static_cast<unsigned long long>(st.st_size) > std::numeric_limits<size_t>::max()) {
+        ::close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    data = static_cast<const unsigned char*>(view);
+    size = static_cast<size_t>(st.st_size);
+    return true;
+#endif
+}
+
+void unmap_whole_file(const unsigned char* data, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap(const_cast<unsigned char*>(data), size);
+#endif
+}
+
+} // namespace
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        open_ = std::exchange(other.open_, false);
+        mapped_ = std::exchange(other.mapped_, false);
+        buffer_ = std::move(other.buffer_);
+        if (!mapped_ && !buffer_.empty()) {
+            data_ = buffer_.data();
+        }
+        other.buffer_.clear();
+    }
+    return *this;
+}
+
+bool MappedFile::open(const std::filesystem::path& path) {
+    close();
+    if (map_whole_file(path, data_, size_)) {
+        mapped_ = true;
+        open_ = true;
+        return true;
+    }
+
+    // Empty files cannot be mapped, and some filesystems refuse mappings.
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        return false;
+    }
+    const std::streamoff length = in.tellg();
+    if (length < 0) {
+        return false;
+    }
+    buffer_.resize(static_cast<size_t>(length));
+    in.seekg(0);
+    if (!buffer_.empty() &&
+        !in.read(reinterpret_cast<char*>(buffer_.data()), static_cast<std::streamsize>(buffer_.size()))) {
+        buffer_.clear();
+        return false;
+    }
+    data_ = buffer_.empty() ? nullptr : buffer_.data();
+    size_ = buffer_.size();
+    open_ = true;
+    return true;
+}
+
+void MappedFile::close() {
+    if (mapped_ && data_ != nullptr) {
+        unmap_whole_file(data_, size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    open_ = false;
+    mapped_ = false;
+    buffer_.clear();
+}
+
+} // namespace sprat::core
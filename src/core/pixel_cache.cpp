@@ -0,0 +1,328 @@
+#include "pixel_cache.h"
+#include "fnv1a.h"
+#include "pixel_kernels.h"
+#include "temp_dir.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+
+namespace sprat::core {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr std::array<char, 8> k_pixel_cache_magic = {'S', 'P', 'R', 'A', 'T', 'P', 'I', 'X'};
+constexpr uint32_t k_pixel_cache_format_version = 2;
+constexpr uint32_t k_pixel_cache_byte_order_mark = 0x01020304u;
+constexpr int k_max_region_dimension = 100000;
+
+// File layout: header, region.h rows of region.w RGBA pixels, source path.
+// Entries are renamed into place only once complete, so open() checks the
+// header, size and path; the checksum over the pixels is compared as well
+// in debug builds or when SPRAT_PIXEL_CACHE_VERIFY is set, since hashing
+// reads every mapped page on each hit.
+struct PixelCacheHeader {
+    std::array<char, 8> magic{};
+    uint32_t version = 0;
+    uint32_t byte_order = 0;
+    uint64_t file_size = 0;
+    int64_t mtime_ticks = 0;
+    int32_t image_w = 0;
+    int32_t image_h = 0;
+    int32_t x = 0;
+    int32_t y = 0;
+    int32_t w = 0;
+    int32_t h = 0;
+    uint32_t path_size = 0;
+    uint32_t reserved = 0;
+    uint64_t pixel_checksum = 0;
+};
+
+static_assert(sizeof(PixelCacheHeader) == 72);
+
+struct MemoryEntry {
+    uintmax_t file_size = 0;
+    long long mtime_ticks = 0;
+    PixelCacheRegion region;
+    std::shared_ptr<const std::vector<unsigned char>> pixels;
+};
+
+// Entries stay shared while a CachedPixels still reads them, even if the
+// store is replaced or cleared meanwhile. `bytes` counts the stored pixels
+// against `budget`.
+struct MemoryStore {
+    std::mutex mutex;
+    bool enabled = false;
+    size_t budget = 0;
+    size_t bytes = 0;
+    std::unordered_map<std::string, MemoryEntry> entries;
+};
+
+MemoryStore& memory_store() {
+    static MemoryStore store;
+    return store;
+}
+
+std::string source_key(const fs::path& source) {
+    std::error_code ec;
+    const fs::path absolute = fs::absolute(source, ec);
+    return (!ec ? absolute.lexically_normal() : source).string();
+}
+
+fs::path entry_path(const fs::path& cache_dir, const std::string& key) {
+    const uint64_t hash = fnv1a_hash(reinterpret_cast<const unsigned char*>(key.data()), key.size());
+    std::array<char, 32> name{};
+    std::snprintf(name.data(), name.size(), "%016llx.rgba", static_cast<unsigned long long>(hash));
+    return cache_dir / name.data();
+}
+
+bool verify_pixels_on_open() {
+#ifndef NDEBUG
+    return true;
+#else
+    static const bool verify = std::getenv("SPRAT_PIXEL_CACHE_VERIFY") != nullptr;
+    return verify;
+#endif
+}
+
+bool region_is_valid(const PixelCacheRegion& region) {
+    return region.image_w > 0 && region.image_h > 0 &&
+           region.image_w <= k_max_region_dimension && region.image_h <= k_max_region_dimension &&
+           region.w > 0 && region.h > 0 && region.x >= 0 && region.y >= 0 &&
+           region.x <= region.image_w - region.w && region.y <= region.image_h - region.h;
+}
+
+} // namespace
+
+fs::path default_pixel_cache_dir() {
+    return default_temp_dir() / "sprat" / "pixels";
+}
+
+void set_pixel_cache_in_memory(bool enabled, size_t budget_bytes) {
+    MemoryStore& store = memory_store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    store.enabled = enabled;
+    store.budget = budget_bytes;
+    if (!enabled) {
+        store.entries.clear();
+        store.bytes = 0;
+    }
+}
+
+bool read_source_stamp(const fs::path& source, uintmax_t& file_size, long long& mtime_ticks) {
+    std::error_code ec;
+    const uintmax_t size = fs::file_size(source, ec);
+    if (ec) {
+        return false;
+    }
+    const fs::file_time_type mtime = fs::last_write_time(source, ec);
+    if (ec) {
+        return false;
+    }
+    file_size = size;
+    mtime_ticks = mtime.time_since_epoch().count();
+    return true;
+}
+
+bool store_cached_pixels(const fs::path& cache_dir,
+                         const fs::path& source,
+                         uintmax_t file_size,
+                         long long mtime_ticks,
+                         const PixelCacheRegion& region,
+                         const unsigned char* region_rgba,
+                         size_t stride_bytes) {
+    const size_t row_bytes = static_cast<size_t>(region.w) * 4;
+    if (region_rgba == nullptr || !region_is_valid(region) || stride_bytes < row_bytes) {
+        return false;
+    }
+    const std::string key = source_key(source);
+    if (key.size() > std::numeric_limits<uint32_t>::max()) {
+        return false;
+    }
+
+    // Pixels are reserved against the memory budget before they are copied;
+    // an entry that does not fit is written to the cache directory instead.
+    MemoryStore& store = memory_store();
+    const size_t pixel_bytes = row_bytes * static_cast<size_t>(region.h);
+    bool in_memory = false;
+    {
+        std::lock_guard<std::mutex> lock(store.mutex);
+        if (store.enabled && pixel_bytes <= store.budget - std::min(store.bytes, store.budget)) {
+            in_memory = true;
+            store.bytes += pixel_bytes;
+        }
+    }
+    if (in_memory) {
+        auto pixels = std::make_shared<std::vector<unsigned char>>(pixel_bytes);
+        for (int row = 0; row < region.h; ++row) {
+            std::memcpy(pixels->data() + static_cast<size_t>(row) * row_bytes,
+                        region_rgba + static_cast<size_t>(row) * stride_bytes, row_bytes);
+        }
+        std::lock_guard<std::mutex> lock(store.mutex);
+        MemoryEntry& entry = store.entries[key];
+        if (entry.pixels != nullptr) {
+            store.bytes -= entry.pixels->size();
+        }
+        entry = MemoryEntry{file_size, mtime_ticks, region, std::move(pixels)};
+        return true;
+    }
+
+    std::error_code ec;
+    fs::create_directories(cache_dir, ec);
+    if (ec) {
+        return false;
+    }
+
+    PixelCacheHeader header;
+    header.magic = k_pixel_cache_magic;
+    header.version = k_pixel_cache_format_version;
+    header.byte_order = k_pixel_cache_byte_order_mark;
+    header.file_size = static_cast<uint64_t>(file_size);
+    header.mtime_ticks = mtime_ticks;
+    header.image_w = region.image_w;
+    header.image_h = region.image_h;
+    header.x = region.x;
+    header.y = region.y;
+    header.w = region.w;
+    header.h = region.h;
+    header.path_size = static_cast<uint32_t>(key.size());
+    header.pixel_checksum = hash_rgba_region(region_rgba, region.w, region.h, stride_bytes);
+
+    // Concurrent tools may store the same source; each writes its own
+    // temporary file and the last rename wins with a complete entry.
+    const fs::path path = entry_path(cache_dir, key);
+    const fs::path tmp = unique_temp_path(path);
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (int row = 0; row < region.h; ++row) {
+            out.write(reinterpret_cast<const char*>(region_rgba + static_cast<size_t>(row) * stride_bytes),
+                      static_cast<std::streamsize>(row_bytes));
+        }
+        out.write(key.data(), static_cast<std::streamsize>(key.size()));
+        out.close();
+        if (!out) {
+            fs::remove(tmp, ec);
+            return false;
+        }
+    }
+
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        fs::remove(path, ec);
+        ec.clear();
+        fs::rename(tmp, path, ec);
+        if (ec) {
+            fs::remove(tmp, ec);
+            return false;
+        }
+    }
+    return true;
+}
+
+void prune_pixel_cache(const fs::path& cache_dir, long long max_age_seconds) {
+    std::error_code ec;
+    fs::directory_iterator it(cache_dir, ec);
+    if (ec) {
+        return;
+    }
+    const auto now = fs::file_time_type::clock::now();
+    const auto max_age = std::chrono::seconds(max_age_seconds);
+    for (const fs::directory_entry& entry : it) {
+        const fs::path& path = entry.path();
+        const std::string ext = path.extension().string();
+        if (ext != ".rgba" && ext != ".tmp") {
+            continue;
+        }
+        const fs::file_time_type mtime = fs::last_write_time(path, ec);
+        if (ec) {
+            ec.clear();
+            continue;
+        }
+        if (now - mtime > max_age) {
+            fs::remove(path, ec);
+            ec.clear();
+        }
+    }
+}
+
+bool CachedPixels::open(const fs::path& cache_dir,
+                        const fs::path& source,
+                        uintmax_t file_size,
+                        long long mtime_ticks) {
+    file_.close();
+    memory_.reset();
+    pixels_ = nullptr;
+    region_ = PixelCacheRegion{};
+
+    const std::string key = source_key(source);
+    MemoryStore& store = memory_store();
+    {
+        std::lock_guard<std::mutex> lock(store.mutex);
+        // Entries over the memory budget were written to the cache
+        // directory, so a miss here still looks there.
+        const auto it = store.enabled ? store.entries.find(key) : store.entries.end();
+        if (it != store.entries.end()) {
+            if (it->second.file_size != file_size || it->second.mtime_ticks != mtime_ticks) {
+                return false;
+            }
+            memory_ = it->second.pixels;
+            region_ = it->second.region;
+            pixels_ = memory_->data();
+            return true;
+        }
+    }
+    if (!file_.open(entry_path(cache_dir, key)) || file_.size() < sizeof(PixelCacheHeader)) {
+        file_.close();
+        return false;
+    }
+    PixelCacheHeader header;
+    std::memcpy(&header, file_.data(), sizeof(header));
+
+    PixelCacheRegion region;
+    region.image_w = header.image_w;
+    region.image_h = header.image_h;
+    region.x = header.x;
+    region.y = header.y;
+    region.w = header.w;
+    region.h = header.h;
+    const size_t pixel_bytes = region_is_valid(region)
+        ? static_cast<size_t>(region.w) * static_cast<size_t>(region.h) * 4
+        : 0;
+    const bool valid = header.magic == k_pixel_cache_magic &&
+                       header.version == k_pixel_cache_format_version &&
+                       header.byte_order == k_pixel_cache_byte_order_mark &&
+                       header.file_size == static_cast<uint64_t>(file_size) &&
+                       header.mtime_ticks == mtime_ticks &&
+                       pixel_bytes > 0 &&
+                       header.path_size == key.size() &&
+                       file_.size() == sizeof(PixelCacheHeader) + pixel_bytes + key.size() &&
+                       std::memcmp(file_.data() + sizeof(PixelCacheHeader) + pixel_bytes,
+                                   key.data(), key.size()) == 0 &&
+                       (!verify_pixels_on_open() ||
+                        hash_rgba_region(file_.data() + sizeof(PixelCacheHeader), region.w, region.h,
+                                         static_cast<size_t>(region.w) * 4) == header.pixel_checksum);
+    if (!valid) {
+        file_.close();
+        return false;
+    }
+    region_ = region;
+    pixels_ = file_.data() + sizeof(PixelCacheHeader);
+    return true;
+}
+
+} // namespace sprat::core
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace sprat::core {
+
+// Decoded RGBA pixels of one source image, stored so spratpack can blit
+// sprites that spratlayout (or an earlier spratpack run) already decoded.
+// Entries are keyed by the absolute source path and are only used while the
+// source file size and modification time still match.
+struct PixelCacheRegion {
+    int image_w = 0; // full source image size
+    int image_h = 0;
+    int x = 0;       // stored region inside the source image
+    int y = 0;
+    int w = 0;
+    int h = 0;
+};
+
+std::filesystem::path default_pixel_cache_dir();
+
+constexpr size_t k_pixel_cache_memory_budget = size_t{1} << 30;
+
+// Keeps entries in process memory instead of the cache directory, for tools
+// run in one process (sprat build). Entries that would take the memory tier
+// past `budget_bytes` go to the cache directory instead. Disabling it drops
+// the stored pixels.
+void set_pixel_cache_in_memory(bool enabled, size_t budget_bytes = k_pixel_cache_memory_budget);
+
+bool read_source_stamp(const std::filesystem::path& source,
+                       uintmax_t& file_size,
+                       long long& mtime_ticks);
+
+bool store_cached_pixels(const std::filesystem::path& cache_dir,
+                         const std::filesystem::path& source,
+                         uintmax_t file_size,
+                         long long mtime_ticks,
+                         const PixelCacheRegion& region,
+                         const unsigned char* region_rgba,
+                         size_t stride_bytes);
+
+// Removes cache entries not written during the last `max_age_seconds`.
+void prune_pixel_cache(const std::filesystem::path& cache_dir, long long max_age_seconds);
+
+class CachedPixels {
+public:
+    bool open(const std::filesystem::path& cache_dir,
+              const std::filesystem::path& source,
+              uintmax_t file_size,
+              long long mtime_ticks);
+
+    const PixelCacheRegion& region() const { return region_; }
+    // Tightly packed rows of region().w RGBA pixels.
+    const unsigned char* pixels() const { return pixels_; }
+
+private:
+    MappedFile file_;
+    std::shared_ptr<const std::vector<unsigned char>> memory_;
+    PixelCacheRegion region_;
+    const unsigned char* pixels_ = nullptr;
+};
+
+} // namespace sprat::core
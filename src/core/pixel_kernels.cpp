@@ -0,0 +1,795 @@
+#include "pixel_kernels.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SPRAT_PIXEL_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#elif (defined(__aarch64__) || defined(_M_ARM64)) && !defined(__ARM_BIG_ENDIAN)
+#define SPRAT_PIXEL_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(SPRAT_PIXEL_KERNELS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SPRAT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SPRAT_TARGET_AVX2
+#endif
+
+namespace sprat::core {
+
+namespace {
+
+// RGBA pixels read as little-endian 32-bit words keep alpha in the top byte.
+constexpr uint32_t k_alpha_mask = 0xFF000000u;
+
+int first_opaque_scalar(const unsigned char* rgba, int begin, int count) {
+    for (int i = begin; i < count; ++i) {
+        if (rgba[static_cast<size_t>(i) * 4 + 3] != 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int last_opaque_scalar(const unsigned char* rgba, int end) {
+    for (int i = end - 1; i >= 0; --i) {
+        if (rgba[static_cast<size_t>(i) * 4 + 3] != 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#ifdef SPRAT_PIXEL_KERNELS_X86
+// Bit i is set when pixel i of the 4-pixel block has non-zero alpha.
+inline unsigned opaque_mask_sse2(const unsigned char* rgba) {
+    const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba));
+    const __m128i alpha = _mm_and_si128(pixels, _mm_set1_epi32(static_cast<int>(k_alpha_mask)));
+    const __m128i transparent = _mm_cmpeq_epi32(alpha, _mm_setzero_si128());
+    return ~static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(transparent))) & 0xFu;
+}
+
+int first_opaque_sse2(const unsigned char* rgba, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const unsigned mask = opaque_mask_sse2(rgba + static_cast<size_t>(i) * 4);
+        if (mask != 0) {
+            return i + std::countr_zero(mask);
+        }
+    }
+    return first_opaque_scalar(rgba, i, count);
+}
+
+int last_opaque_sse2(const unsigned char* rgba, int count) {
+    int i = count;
+    for (; i >= 4; i -= 4) {
+        const unsigned mask = opaque_mask_sse2(rgba + static_cast<size_t>(i - 4) * 4);
+        if (mask != 0) {
+            return i - 4 + std::bit_width(mask) - 1;
+        }
+    }
+    return last_opaque_scalar(rgba, i);
+}
+
+SPRAT_TARGET_AVX2 inline unsigned opaque_mask_avx2(const unsigned char* rgba) {
+    const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rgba));
+    const __m256i alpha = _mm256_and_si256(pixels, _mm256_set1_epi32(static_cast<int>(k_alpha_mask)));
+    const __m256i transparent = _mm256_cmpeq_epi32(alpha, _mm256_setzero_si256());
+    return ~static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(transparent))) & 0xFFu;
+}
+
+SPRAT_TARGET_AVX2 int first_opaque_avx2(const unsigned char* rgba, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const unsigned mask = opaque_mask_avx2(rgba + static_cast<size_t>(i) * 4);
+        if (mask != 0) {
+            return i + std::countr_zero(mask);
+        }
+    }
+    return first_opaque_scalar(rgba, i, count);
+}
+
+SPRAT_TARGET_AVX2 int last_opaque_avx2(const unsigned char* rgba, int count) {
+    int i = count;
+    for (; i >= 8; i -= 8) {
+        const unsigned mask = opaque_mask_avx2(rgba + static_cast<size_t>(i - 8) * 4);
+        if (mask != 0) {
+            return i - 8 + std::bit_width(mask) - 1;
+        }
+    }
+    return last_opaque_scalar(rgba, i);
+}
+
+bool cpu_supports_avx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4] = {};
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    if (!os_saves_ymm) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+#ifdef SPRAT_PIXEL_KERNELS_NEON
+// Bit i is set when pixel i of the 4-pixel block has non-zero alpha.
+inline unsigned opaque_mask_neon(const unsigned char* rgba) {
+    const uint32x4_t pixels = vreinterpretq_u32_u8(vld1q_u8(rgba));
+    const uint32x4_t opaque = vtstq_u32(pixels, vdupq_n_u32(k_alpha_mask));
+    const uint32x4_t bits = {1u, 2u, 4u, 8u};
+    return vaddvq_u32(vandq_u32(opaque, bits));
+}
+
+int first_opaque_neon(const unsigned char* rgba, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const unsigned mask = opaque_mask_neon(rgba + static_cast<size_t>(i) * 4);
+        if (mask != 0) {
+            return i + std::countr_zero(mask);
+        }
+    }
+    return first_opaque_scalar(rgba, i, count);
+}
+
+int last_opaque_neon(const unsigned char* rgba, int count) {
+    int i = count;
+    for (; i >= 4; i -= 4) {
+        const unsigned mask = opaque_mask_neon(rgba + static_cast<size_t>(i - 4) * 4);
+        if (mask != 0) {
+            return i - 4 + std::bit_width(mask) - 1;
+        }
+    }
+    return last_opaque_scalar(rgba, i);
+}
+#endif
+
+PixelKernelIsa detect_pixel_kernel_isa() {
+#if defined(SPRAT_PIXEL_KERNELS_X86)
+    return cpu_supports_avx2() ? PixelKernelIsa::avx2 : PixelKernelIsa::sse2;
+#elif defined(SPRAT_PIXEL_KERNELS_NEON)
+    return PixelKernelIsa::neon;
+#else
+    return PixelKernelIsa::scalar;
+#endif
+}
+
+constexpr uint64_t k_xxh_prime1 = 11400714785074694791ULL;
+constexpr uint64_t k_xxh_prime2 = 14029467366897019727ULL;
+constexpr uint64_t k_xxh_prime3 = 1609587929392839161ULL;
+constexpr uint64_t k_xxh_prime4 = 9650029242287828579ULL;
+constexpr uint64_t k_xxh_prime5 = 2870177450012600261ULL;
+
+inline uint64_t read_le64(const unsigned char* p) {
+    if constexpr (std::endian::native == std::endian::little) {
+        uint64_t value = 0;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    } else {
+        uint64_t value = 0;
+        for (int i = 7; i >= 0; --i) {
+            value = (value << 8) | p[i];
+        }
+        return value;
+    }
+}
+
+inline uint32_t read_le32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline uint64_t xxh_round(uint64_t acc, uint64_t input) {
+    acc += input * k_xxh_prime2;
+    acc = std::rotl(acc, 31);
+    return acc * k_xxh_prime1;
+}
+
+inline uint64_t xxh_merge(uint64_t acc, uint64_t value) {
+    acc ^= xxh_round(0, value);
+    return acc * k_xxh_prime1 + k_xxh_prime4;
+}
+
+} // namespace
+
+const char* pixel_kernel_isa_name(PixelKernelIsa isa) {
+    switch (isa) {
+        case PixelKernelIsa::sse2: return "sse2";
+        case PixelKernelIsa::avx2: return "avx2";
+        case PixelKernelIsa::neon: return "neon";
+        case PixelKernelIsa::scalar: break;
+    }
+    return "scalar";
+}
+
+bool pixel_kernel_isa_supported(PixelKernelIsa isa) {
+    switch (isa) {
+        case PixelKernelIsa::scalar:
+            return true;
+#if defined(SPRAT_PIXEL_KERNELS_X86)
+        case PixelKernelIsa::sse2:
+            return true;
+        case PixelKernelIsa::avx2:
+            return cpu_supports_avx2();
+#elif defined(SPRAT_PIXEL_KERNELS_NEON)
+        case PixelKernelIsa::neon:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+PixelKernelIsa active_pixel_kernel_isa() {
+    static const PixelKernelIsa isa = detect_pixel_kernel_isa();
+    return isa;
+}
+
+int find_first_opaque_pixel(const unsigned char* rgba, int count, PixelKernelIsa isa) {
+    switch (isa) {
+#if defined(SPRAT_PIXEL_KERNELS_X86)
+        case PixelKernelIsa::sse2: return first_opaque_sse2(rgba, count);
+        case PixelKernelIsa::avx2: return first_opaque_avx2(rgba, count);
+#elif defined(SPRAT_PIXEL_KERNELS_NEON)
+        case PixelKernelIsa::neon: return first_opaque_neon(rgba, count);
+#endif
+        default: return first_opaque_scalar(rgba, 0, count);
+    }
+}
+
+int find_last_opaque_pixel(const unsigned char* rgba, int count, PixelKernelIsa isa) {
+    switch (isa) {
+#if defined(SPRAT_PIXEL_KERNELS_X86)
+        case PixelKernelIsa::sse2: return last_opaque_sse2(rgba, count);
+        case PixelKernelIsa::avx2: return last_opaque_avx2(rgba, count);
+#elif defined(SPRAT_PIXEL_KERNELS_NEON)
+        case PixelKernelIsa::neon: return last_opaque_neon(rgba, count);
+#endif
+        default: return last_opaque_scalar(rgba, count);
+    }
+}
+
+bool find_opaque_bounds(const unsigned char* rgba,
+                        int w,
+                        int h,
+                        size_t stride_bytes,
+                        int& min_x,
+                        int& min_y,
+                        int& max_x,
+                        int& max_y,
+                        PixelKernelIsa isa) {
+    min_x = 0;
+    min_y = 0;
+    max_x = -1;
+    max_y = -1;
+    if (rgba == nullptr || w <= 0 || h <= 0) {
+        return false;
+    }
+    auto row = [&](int y) { return rgba + static_cast<size_t>(y) * stride_bytes; };
+
+    int top = 0;
+    int left = -1;
+    for (; top < h; ++top) {
+        left = find_first_opaque_pixel(row(top), w, isa);
+        if (left >= 0) {
+            break;
+        }
+    }
+    if (left < 0) {
+        return false;
+    }
+    int bottom = h - 1;
+    int right = -1;
+    for (; bottom >= top; --bottom) {
+        right = find_last_opaque_pixel(row(bottom), w, isa);
+        if (right >= 0) {
+            break;
+        }
+    }
+    right = std::max(right, find_last_opaque_pixel(row(top), w, isa));
+    if (bottom > top) {
+        left = std::min(left, find_first_opaque_pixel(row(bottom), w, isa));
+    }
+
+    // Rows between the first and last opaque rows only need the pixels
+    // outside the columns already known to be inside the bounds.
+    for (int y = top + 1; y < bottom && (left > 0 || right < w - 1); ++y) {
+        const unsigned char* r = row(y);
+        if (left > 0) {
+            const int first = find_first_opaque_pixel(r, left, isa);
+            if (first >= 0) {
+                left = first;
+            }
+        }
+        if (right < w - 1) {
+            const int last = find_last_opaque_pixel(r + static_cast<size_t>(right + 1) * 4, w - right - 1, isa);
+            if (last >= 0) {
+                right += 1 + last;
+            }
+        }
+    }
+
+    min_x = left;
+    min_y = top;
+    max_x = right;
+    max_y = bottom;
+    return true;
+}
+
+Xxh64::Xxh64()
+    : v1_(k_xxh_prime1 + k_xxh_prime2),
+      v2_(k_xxh_prime2),
+      v3_(0),
+      v4_(0 - k_xxh_prime1) {}
+
+void Xxh64::update(const unsigned char* data, size_t len) {
+    total_len_ += len;
+    if (buffer_len_ + len < sizeof(buffer_)) {
+        if (len > 0) {
+            std::memcpy(buffer_ + buffer_len_, data, len);
+        }
+        buffer_len_ += len;
+        return;
+    }
+    if (buffer_len_ > 0) {
+        const size_t fill = sizeof(buffer_) - buffer_len_;
+        std::memcpy(buffer_ + buffer_len_, data, fill);
+        v1_ = xxh_round(v1_, read_le64(buffer_));
+        v2_ = xxh_round(v2_, read_le64(buffer_ + 8));
+        v3_ = xxh_round(v3_, read_le64(buffer_ + 16));
+        v4_ = xxh_round(v4_, read_le64(buffer_ + 24));
+        data += fill;
+        len -= fill;
+        buffer_len_ = 0;
+    }
+    // Four independent lanes keep several multiplies in flight per cycle.
+    while (len >= 32) {
+        v1_ = xxh_round(v1_, read_le64(data));
+        v2_ = xxh_round(v2_, read_le64(data + 8));
+        v3_ = xxh_round(v3_, read_le64(data + 16));
+        v4_ = xxh_round(v4_, read_le64(data + 24));
+        data += 32;
+        len -= 32;
+    }
+    if (len > 0) {
+        std::memcpy(buffer_, data, len);
+        buffer_len_ = len;
+    }
+}
+
+uint64_t Xxh64::digest() const {
+    uint64_t h = 0;
+    if (total_len_ >= 32) {
+        h = std::rotl(v1_, 1) + std::rotl(v2_, 7) + std::rotl(v3_, 12) + std::rotl(v4_, 18);
+        h = xxh_merge(h, v1_);
+        h = xxh_merge(h, v2_);
+        h = xxh_merge(h, v3_);
+        h = xxh_merge(h, v4_);
+    } else {
+        h = k_xxh_prime5;
+    }
+    h += total_len_;
+
+    const unsigned char* p = buffer_;
+    size_t remaining = buffer_len_;
+    while (remaining >= 8) {
+        h ^= xxh_round(0, read_le64(p));
+        h = std::rotl(h, 27) * k_xxh_prime1 + k_xxh_prime4;
+        p += 8;
+        remaining -= 8;
+    }
+    if (remaining >= 4) {
+        h ^= static_cast<uint64_t>(read_le32(p)) * k_xxh_prime1;
+        h = std::rotl(h, 23) * k_xxh_prime2 + k_xxh_prime3;
+        p += 4;
+        remaining -= 4;
+    }
+    while (remaining > 0) {
+        h ^= static_cast<uint64_t>(*p) * k_xxh_prime5;
+        h = std::rotl(h, 11) * k_xxh_prime1;
+        ++p;
+        --remaining;
+    }
+
+    h ^= h >> 33;
+    h *= k_xxh_prime2;
+    h ^= h >> 29;
+    h *= k_xxh_prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t hash_rgba_region(const unsigned char* rgba, int w, int h, size_t stride_bytes) {
+    Xxh64 hasher;
+    if (rgba == nullptr || w <= 0 || h <= 0) {
+        return hasher.digest();
+    }
+    const size_t row_bytes = static_cast<size_t>(w) * 4;
+    if (stride_bytes == row_bytes) {
+        hasher.update(rgba, row_bytes * static_cast<size_t>(h));
+        return hasher.digest();
+    }
+    for (int y = 0; y < h; ++y) {
+        hasher.update(rgba + static_cast<size_t>(y) * stride_bytes, row_bytes);
+    }
+    return hasher.digest();
+}
+
+uint64_t compute_dhash(const unsigned char* rgba, int w, int h, size_t stride_bytes) {
+    if (rgba == nullptr || w <= 0 || h <= 0) {
+        return 0;
+    }
+    // Sample a 9x8 grid (9 cols, 8 rows)
+    double grid[8][9];
+    for (int row = 0; row < 8; ++row) {
+        for (int col = 0; col < 9; ++col) {
+            int px = (col * (w - 1)) / 8;
+            int py = (row * (h - 1)) / 7;
+            if (px < 0) px = 0;
+            if (px >= w) px = w - 1;
+            if (py < 0) py = 0;
+            if (py >= h) py = h - 1;
+            const unsigned char* p = rgba + static_cast<size_t>(py) * stride_bytes + static_cast<size_t>(px) * 4;
+            double a = p[3] / 255.0;
+            grid[row][col] = (0.299 * p[0] + 0.587 * p[1] + 0.114 * p[2]) * a;
+        }
+    }
+    uint64_t hash = 0;
+    int bit = 0;
+    for (int row = 0; row < 8; ++row) {
+        for (int col = 0; col < 8; ++col) {
+            if (grid[row][col] < grid[row][col + 1]) {
+                hash |= (uint64_t(1) << bit);
+            }
+            ++bit;
+        }
+    }
+    return hash;
+}
+
+namespace {
+
+// Pixels are moved as 32-bit words; memcpy keeps the access alias-safe and
+// compiles to a single load or store.
+inline uint32_t load_pixel(const unsigned char* p) {
+    uint32_t v = 0;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline void store_pixel(unsigned char* p, uint32_t v) {
+    std::memcpy(p, &v, sizeof(v));
+}
+
+// Rotated blits walk the source down its columns. Tiles keep the source rows
+// of one tile in L1 while every destination row of the tile is written.
+constexpr int k_rotate_tile_rows = 16;
+constexpr int k_rotate_tile_cols = 64;
+
+inline void rotate_cw_pixel(const unsigned char* src, size_t src_stride, int width,
+                            int r, int col, unsigned char* dest_row) {
+    const size_t py = static_cast<size_t>(width - 1 - col);
+    store_pixel(dest_row + static_cast<size_t>(col) * 4, load_pixel(src + py * src_stride + static_cast<size_t>(r) * 4));
+}
+
+// Calls `block(r0, c0)` for every full 4x4 block of the region in tile order
+// and `pixel(r, col)` for the pixels left over at the right and bottom edges.
+template <typename Block, typename Pixel>
+void for_each_rotate_block(int width, int row_begin, int row_end, Block&& block, Pixel&& pixel) {
+    const int full_rows_end = row_begin + (row_end - row_begin) / 4 * 4;
+    const int full_cols_end = width / 4 * 4;
+    for (int tile_r = row_begin; tile_r < full_rows_end; tile_r += k_rotate_tile_rows) {
+        const int tile_r_end = std::min(full_rows_end, tile_r + k_rotate_tile_rows);
+        for (int tile_c = 0; tile_c < full_cols_end; tile_c += k_rotate_tile_cols) {
+            const int tile_c_end = std::min(full_cols_end, tile_c + k_rotate_tile_cols);
+            for (int r0 = tile_r; r0 < tile_r_end; r0 += 4) {
+                for (int c0 = tile_c; c0 < tile_c_end; c0 += 4) {
+                    block(r0, c0);
+                }
+            }
+        }
+        for (int r = tile_r; r < tile_r_end; ++r) {
+            for (int col = full_cols_end; col < width; ++col) {
+                pixel(r, col);
+            }
+        }
+    }
+    for (int r = full_rows_end; r < row_end; ++r) {
+        for (int col = 0; col < width; ++col) {
+            pixel(r, col);
+        }
+    }
+}
+
+void blit_rotated_cw_scalar(const unsigned char* src, size_t src_stride, int width, int row_begin, int row_end,
+                            unsigned char* dest, size_t dest_stride) {
+    auto dest_row = [&](int r) { return dest + static_cast<size_t>(r - row_begin) * dest_stride; };
+    auto pixel = [&](int r, int col) { rotate_cw_pixel(src, src_stride, width, r, col, dest_row(r)); };
+    for_each_rotate_block(width, row_begin, row_end, [&](int r0, int c0) {
+        for (int j = 0; j < 4; ++j) {
+            for (int k = 0; k < 4; ++k) {
+                pixel(r0 + j, c0 + k);
+            }
+        }
+    }, pixel);
+}
+
+#ifdef SPRAT_PIXEL_KERNELS_X86
+// Block rows k hold source row (width - 1 - c0 - k) at columns r0..r0+3, so
+// the transposed rows j are destination row r0 + j at columns c0..c0+3.
+void blit_rotated_cw_sse2(const unsigned char* src, size_t src_stride, int width, int row_begin, int row_end,
+                          unsigned char* dest, size_t dest_stride) {
+    auto dest_row = [&](int r) { return dest + static_cast<size_t>(r - row_begin) * dest_stride; };
+    auto source = [&](int c, int r) {
+        return src + static_cast<size_t>(width - 1 - c) * src_stride + static_cast<size_t>(r) * 4;
+    };
+    for_each_rotate_block(width, row_begin, row_end, [&](int r0, int c0) {
+        const __m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source(c0, r0)));
+        const __m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source(c0 + 1, r0)));
+        const __m128i s2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source(c0 + 2, r0)));
+        const __m128i s3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source(c0 + 3, r0)));
+        const __m128i t0 = _mm_unpacklo_epi32(s0, s1);
+        const __m128i t1 = _mm_unpacklo_epi32(s2, s3);
+        const __m128i t2 = _mm_unpackhi_epi32(s0, s1);
+        const __m128i t3 = _mm_unpackhi_epi32(s2, s3);
+        const size_t offset = static_cast<size_t>(c0) * 4;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest_row(r0) + offset), _mm_unpacklo_epi64(t0, t1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest_row(r0 + 1) + offset), _mm_unpackhi_epi64(t0, t1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest_row(r0 + 2) + offset), _mm_unpacklo_epi64(t2, t3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest_row(r0 + 3) + offset), _mm_unpackhi_epi64(t2, t3));
+    }, [&](int r, int col) { rotate_cw_pixel(src, src_stride, width, r, col, dest_row(r)); });
+}
+
+// Lanes whose pixel is transparent in `center` and opaque in `neighbor`.
+inline __m128i fill_mask_sse2(__m128i center, __m128i neighbor) {
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(k_alpha_mask));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i center_clear = _mm_cmpeq_epi32(_mm_and_si128(center, alpha), zero);
+    const __m128i neighbor_clear = _mm_cmpeq_epi32(_mm_and_si128(neighbor, alpha), zero);
+    return _mm_andnot_si128(neighbor_clear, center_clear);
+}
+#endif
+
+#ifdef SPRAT_PIXEL_KERNELS_NEON
+void blit_rotated_cw_neon(const unsigned char* src, size_t src_stride, int width, int row_begin, int row_end,
+                          unsigned char* dest, size_t dest_stride) {
+    auto dest_row = [&](int r) { return dest + static_cast<size_t>(r - row_begin) * dest_stride; };
+    auto load = [&](int c, int r) {
+        return vreinterpretq_u32_u8(
+            vld1q_u8(src + static_cast<size_t>(width - 1 - c) * src_stride + static_cast<size_t>(r) * 4));
+    };
+    auto store = [](unsigned char* p, uint32x4_t v) { vst1q_u8(p, vreinterpretq_u8_u32(v)); };
+    for_each_rotate_block(width, row_begin, row_end, [&](int r0, int c0) {
+        const uint32x4x2_t t01 = vtrnq_u32(load(c0, r0), load(c0 + 1, r0));
+        const uint32x4x2_t t23 = vtrnq_u32(load(c0 + 2, r0), load(c0 + 3, r0));
+        const size_t offset = static_cast<size_t>(c0) * 4;
+        store(dest_row(r0) + offset, vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0])));
+        store(dest_row(r0 + 1) + offset, vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1])));
+        store(dest_row(r0 + 2) + offset, vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0])));
+        store(dest_row(r0 + 3) + offset, vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1])));
+    }, [&](int r, int col) { rotate_cw_pixel(src, src_stride, width, r, col, dest_row(r)); });
+}
+#endif
+
+// One pixel of a dilate step: a transparent pixel takes the RGB of its first
+// opaque neighbour, in left, right, up, down order.
+inline void dilate_pixel(const unsigned char* read, unsigned char* write_row, int width, int height,
+                         size_t stride, int y, int x) {
+    const unsigned char* here = read + static_cast<size_t>(y) * stride + static_cast<size_t>(x) * 4;
+    if (here[3] != 0) {
+        return;
+    }
+    const unsigned char* neighbors[4] = {
+        x > 0 ? here - 4 : nullptr,
+        x + 1 < width ? here + 4 : nullptr,
+        y > 0 ? here - stride : nullptr,
+        y + 1 < height ? here + stride : nullptr,
+    };
+    for (const unsigned char* n : neighbors) {
+        if (n != nullptr && n[3] != 0) {
+            unsigned char* out = write_row + static_cast<size_t>(x) * 4;
+            out[0] = n[0];
+            out[1] = n[1];
+            out[2] = n[2];
+            return;
+        }
+    }
+}
+
+} // namespace
+
+void blit_rotated_cw(const unsigned char* src, size_t src_stride, int width, int row_begin, int row_end,
+                     unsigned char* dest, size_t dest_stride, PixelKernelIsa isa) {
+    if (src == nullptr || dest == nullptr || width <= 0 || row_end <= row_begin) {
+        return;
+    }
+    switch (isa) {
+#if defined(SPRAT_PIXEL_KERNELS_X86)
+        case PixelKernelIsa::sse2:
+        case PixelKernelIsa::avx2:
+            blit_rotated_cw_sse2(src, src_stride, width, row_begin, row_end, dest, dest_stride);
+            return;
+#elif defined(SPRAT_PIXEL_KERNELS_NEON)
+        case PixelKernelIsa::neon:
+            blit_rotated_cw_neon(src, src_stride, width, row_begin, row_end, dest, dest_stride);
+            return;
+#endif
+        default:
+            blit_rotated_cw_scalar(src, src_stride, width, row_begin, row_end, dest, dest_stride);
+            return;
+    }
+}
+
+void blit_sprite_rows(const unsigned char* src, size_t src_stride, int x, int y, int w, int h, bool rotated,
+                      unsigned char* band, int atlas_width, int band_y0, int band_y1) {
+    const int row_begin = std::max(y, band_y0);
+    const int row_end = std::min(y + h, band_y1);
+    if (src == nullptr || band == nullptr || row_begin >= row_end) {
+        return;
+    }
+    const size_t atlas_stride = static_cast<size_t>(atlas_width) * 4;
+    unsigned char* dest = band + static_cast<size_t>(row_begin - band_y0) * atlas_stride + static_cast<size_t>(x) * 4;
+    if (rotated) {
+        // atlas(x+col, y+r) <- source(px=r, py=src_h-1-col), with src_h == w
+        blit_rotated_cw(src, src_stride, w, row_begin - y, row_end - y, dest, atlas_stride);
+        return;
+    }
+    const size_t row_bytes = static_cast<size_t>(w) * 4;
+    for (int row = row_begin; row < row_end; ++row, dest += atlas_stride) {
+        std::memcpy(dest, src + static_cast<size_t>(row - y) * src_stride, row_bytes);
+    }
+}
+
+void extrude_rect(unsigned char* rgba, int width, int height, size_t stride,
+                  int x, int y, int w, int h, int extrude) {
+    if (rgba == nullptr || extrude <= 0 || w <= 0 || h <= 0 ||
+        x < 0 || y < 0 || x > width - w || y > height - h) {
+        return;
+    }
+    auto row = [&](int ry) { return rgba + static_cast<size_t>(ry) * stride; };
+    const int left = std::max(0, x - extrude);
+    const int right = std::min(width, x + w + extrude);
+    const int right_edge = x + w - 1;
+
+    // Sides first: each sprite row is widened by its edge pixels. The widened
+    // first and last rows then hold the top and bottom rows with their corners.
+    for (int ry = y; ry < y + h; ++ry) {
+        unsigned char* r = row(ry);
+        const uint32_t left_pixel = load_pixel(r + static_cast<size_t>(x) * 4);
+        for (int px = left; px < x; ++px) {
+            store_pixel(r + static_cast<size_t>(px) * 4, left_pixel);
+        }
+        const uint32_t right_pixel = load_pixel(r + static_cast<size_t>(right_edge) * 4);
+        for (int px = right_edge + 1; px < right; ++px) {
+            store_pixel(r + static_cast<size_t>(px) * 4, right_pixel);
+        }
+    }
+    const size_t offset = static_cast<size_t>(left) * 4;
+    const size_t bytes = static_cast<size_t>(right - left) * 4;
+    for (int ry = std::max(0, y - extrude); ry < y; ++ry) {
+        std::memcpy(row(ry) + offset, row(y) + offset, bytes);
+    }
+    const int bottom = y + h - 1;
+    for (int ry = bottom + 1; ry < std::min(height, bottom + 1 + extrude); ++ry) {
+        std::memcpy(row(ry) + offset, row(bottom) + offset, bytes);
+    }
+}
+
+void dilate_row(const unsigned char* read, unsigned char* write, int width, int height, size_t stride,
+                int y, int x0, int x1, PixelKernelIsa isa) {
+    if (read == nullptr || write == nullptr || y < 0 || y >= height) {
+        return;
+    }
+    x0 = std::max(0, x0);
+    x1 = std::min(width - 1, x1);
+    unsigned char* write_row = write + static_cast<size_t>(y) * stride;
+    int x = x0;
+#if defined(SPRAT_PIXEL_KERNELS_X86)
+    if (isa == PixelKernelIsa::sse2 || isa == PixelKernelIsa::avx2) {
+        // Interior blocks have all four neighbours inside the image.
+        if (x == 0) {
+            dilate_pixel(read, write_row, width, height, stride, y, x);
+            ++x;
+        }
+        if (y > 0 && y + 1 < height) {
+            const unsigned char* read_row = read + static_cast<size_t>(y) * stride;
+            for (; x + 4 <= x1 + 1 && x + 4 < width; x += 4) {
+                const unsigned char* here = read_row + static_cast<size_t>(x) * 4;
+                const __m128i center = _mm_loadu_si128(reinterpret_cast<const __m128i*>(here));
+                const __m128i alpha = _mm_set1_epi32(static_cast<int>(k_alpha_mask));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(center, alpha), _mm_setzero_si128())) == 0) {
+                    continue; // no transparent pixel in the block
+                }
+                __m128i* out_ptr = reinterpret_cast<__m128i*>(write_row + static_cast<size_t>(x) * 4);
+                __m128i out = _mm_loadu_si128(out_ptr);
+                const __m128i neighbors[4] = {
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(here - 4)),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(here + 4)),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(here - stride)),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(here + stride)),
+                };
+                // Lowest priority first, so the left neighbour wins.
+                for (int n = 3; n >= 0; --n) {
+                    const __m128i mask = fill_mask_sse2(center, neighbors[n]);
+                    const __m128i fill = _mm_or_si128(_mm_andnot_si128(alpha, neighbors[n]), _mm_and_si128(out, alpha));
+                    out = _mm_or_si128(_mm_and_si128(mask, fill), _mm_andnot_si128(mask, out));
+                }
+                _mm_storeu_si128(out_ptr, out);
+            }
+        }
+    }
+#else
+    (void)isa;
+#endif
+    for (; x <= x1; ++x) {
+        dilate_pixel(read, write_row, width, height, stride, y, x);
+    }
+}
+
+unsigned char quantize_channel(unsigned char v, int levels, int x, int y, bool dither) {
+    if (levels <= 1) return 0;
+    if (levels >= 256) return v;
+
+    float val = v / 255.0f;
+    if (dither) {
+        static const float bayer[4][4] = {
+            { 0.0f/16, 8.0f/16, 2.0f/16, 10.0f/16 },
+            { 12.0f/16, 4.0f/16, 14.0f/16, 6.0f/16 },
+            { 3.0f/16, 11.0f/16, 1.0f/16, 9.0f/16 },
+            { 15.0f/16, 7.0f/16, 13.0f/16, 5.0f/16 }
+        };
+        float threshold = bayer[y % 4][x % 4];
+        val += (threshold - 0.5f) / (levels - 1);
+        if (val < 0.0f) val = 0.0f;
+        if (val > 1.0f) val = 1.0f;
+    }
+
+    int level = static_cast<int>(val * (levels - 1) + 0.5f);
+    return static_cast<unsigned char>((level * 255) / (levels - 1));
+}
+
+void quantize_rgb(unsigned char* rgba, int w, int h, size_t stride, int levels, bool dither,
+                  int origin_x, int origin_y) {
+    if (rgba == nullptr || w <= 0 || h <= 0) {
+        return;
+    }
+    // One table per Bayer cell (a single one without dithering), built with
+    // quantize_channel itself so the results match it exactly.
+    const int cells = dither ? 16 : 1;
+    std::vector<std::array<unsigned char, 256>> tables(static_cast<size_t>(cells));
+    for (int cell = 0; cell < cells; ++cell) {
+        for (int v = 0; v < 256; ++v) {
+            tables[static_cast<size_t>(cell)][static_cast<size_t>(v)] =
+                quantize_channel(static_cast<unsigned char>(v), levels, cell % 4, cell / 4, dither);
+        }
+    }
+    for (int y = 0; y < h; ++y) {
+        unsigned char* row = rgba + static_cast<size_t>(y) * stride;
+        const int cell_row = dither ? ((origin_y + y) % 4) * 4 : 0;
+        for (int x = 0; x < w; ++x) {
+            const auto& table = tables[static_cast<size_t>(dither ? cell_row + (origin_x + x) % 4 : 0)];
+            unsigned char* p = row + static_cast<size_t>(x) * 4;
+            p[0] = table[p[0]];
+            p[1] = table[p[1]];
+            p[2] = table[p[2]];
+        }
+    }
+}
+
+} // namespace sprat::core
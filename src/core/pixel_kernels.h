@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sprat::core {
+
+// Instruction sets the RGBA scanning kernels can run on. The active one is
+// picked once at runtime; the others stay callable for tests and benchmarks.
+enum class PixelKernelIsa : std::uint8_t {
+    scalar,
+    sse2,
+    avx2,
+    neon
+};
+
+const char* pixel_kernel_isa_name(PixelKernelIsa isa);
+bool pixel_kernel_isa_supported(PixelKernelIsa isa);
+PixelKernelIsa active_pixel_kernel_isa();
+
+// Index of the first/last pixel with non-zero alpha among `count` RGBA
+// pixels, or -1 when all of them are transparent.
+int find_first_opaque_pixel(const unsigned char* rgba, int count, PixelKernelIsa isa);
+int find_last_opaque_pixel(const unsigned char* rgba, int count, PixelKernelIsa isa);
+
+// Bounding box of the pixels with non-zero alpha. Returns false when the
+// image is fully transparent.
+bool find_opaque_bounds(const unsigned char* rgba,
+                        int w,
+                        int h,
+                        size_t stride_bytes,
+                        int& min_x,
+                        int& min_y,
+                        int& max_x,
+                        int& max_y,
+                        PixelKernelIsa isa = active_pixel_kernel_isa());
+
+// Copies rows [row_begin, row_end) of a sprite placed with a 90° clockwise
+// rotation: destination pixel `col` of row `r` is source pixel (r, width - 1 -
+// col), where `width` is the placed width. `dest` points at row `row_begin`.
+// Works in cache-sized tiles of 4x4 transposes.
+void blit_rotated_cw(const unsigned char* src,
+                     size_t src_stride,
+                     int width,
+                     int row_begin,
+                     int row_end,
+                     unsigned char* dest,
+                     size_t dest_stride,
+                     PixelKernelIsa isa = active_pixel_kernel_isa());
+
+// Copies the rows of a w x h sprite placed at (x, y) that fall inside atlas
+// rows [band_y0, band_y1) into `band`, which holds those rows of an
+// `atlas_width`-wide RGBA atlas. `src` is the unrotated image; when `rotated`
+// is set it is turned 90° clockwise while copying and w is the placed width.
+void blit_sprite_rows(const unsigned char* src,
+                      size_t src_stride,
+                      int x,
+                      int y,
+                      int w,
+                      int h,
+                      bool rotated,
+                      unsigned char* band,
+                      int atlas_width,
+                      int band_y0,
+                      int band_y1);
+
+// Repeats the edge pixels of the w x h rectangle at (x, y) `extrude` pixels
+// outward, corners included, clipped to the image. The rectangle itself must
+// lie inside the image.
+void extrude_rect(unsigned char* rgba, int width, int height, size_t stride,
+                  int x, int y, int w, int h, int extrude);
+
+// One dilate step over pixels [x0, x1] of row `y`: every pixel transparent in
+// `read` takes the RGB of its first opaque 4-neighbour (left, right, up, down)
+// in `read`, written into `write`. Both buffers are width x height.
+void dilate_row(const unsigned char* read,
+                unsigned char* write,
+                int width,
+                int height,
+                size_t stride,
+                int y,
+                int x0,
+                int x1,
+                PixelKernelIsa isa = active_pixel_kernel_isa());
+
+// Reduces a channel to `levels` values, with 4x4 Bayer dithering at (x, y).
+unsigned char quantize_channel(unsigned char v, int levels, int x, int y, bool dither);
+
+// quantize_channel over the RGB of a w x h region through per-level lookup
+// tables. `origin_x`/`origin_y` position the region in the dither pattern.
+void quantize_rgb(unsigned char* rgba, int w, int h, size_t stride, int levels, bool dither,
+                  int origin_x, int origin_y);
+
+// XXH64 (seed 0) of the concatenated rows of a w x h RGBA region.
+uint64_t hash_rgba_region(const unsigned char* rgba, int w, int h, size_t stride_bytes);
+
+// 64-bit dHash of a w x h RGBA region: a 9x8 grid of alpha-premultiplied luma
+// is sampled nearest-neighbour, and each bit is set when a cell is darker
+// than its right neighbour. Returns 0 for an empty region.
+uint64_t compute_dhash(const unsigned char* rgba, int w, int h, size_t stride_bytes);
+
+// Streaming XXH64 with seed 0.
+class Xxh64 {
+public:
+    Xxh64();
+    void update(const unsigned char* data, size_t len);
+    uint64_t digest() const;
+
+private:
+    uint64_t v1_;
+    uint64_t v2_;
+    uint64_t v3_;
+    uint64_t v4_;
+    uint64_t total_len_ = 0;
+    unsigned char buffer_[32] = {};
+    size_t buffer_len_ = 0;
+};
+
+} // namespace sprat::core
@@ -0,0 +1,464 @@
+#include "png_stream_writer.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef SPRAT_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef SPRAT_HAS_ZOPFLI_DEFLATE
+#include <zopfli/deflate.h>
+#endif
+
+namespace sprat::core {
+
+#ifdef SPRAT_HAS_ZLIB
+
+namespace {
+
+constexpr size_t k_idat_chunk_size = 1 << 16;
+// Uncompressed bytes per independently deflated piece of a parallel encode.
+constexpr size_t k_parallel_chunk_bytes = 1 << 20;
+constexpr size_t k_deflate_window = 1 << 15;
+constexpr std::array<unsigned char, 8> k_png_signature = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+void put_be32(unsigned char* p, uint32_t v) {
+    p[0] = static_cast<unsigned char>(v >> 24);
+    p[1] = static_cast<unsigned char>(v >> 16);
+    p[2] = static_cast<unsigned char>(v >> 8);
+    p[3] = static_cast<unsigned char>(v);
+}
+
+unsigned char paeth(int a, int b, int c) {
+    const int p = a + b - c;
+    const int pa = std::abs(p - a);
+    const int pb = std::abs(p - b);
+    const int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) {
+        return static_cast<unsigned char>(a);
+    }
+    return static_cast<unsigned char>(pb <= pc ? b : c);
+}
+
+// Same heuristic as stb_image_write: keep the filter whose output has the
+// smallest sum of absolute signed bytes. Each candidate holds the filter type
+// byte followed by the filtered row.
+size_t select_row_filter(const unsigned char* row, const unsigned char* up, int width,
+                         std::array<std::vector<unsigned char>, 5>& candidates) {
+    const size_t bytes = static_cast<size_t>(width) * 4;
+    size_t best = 0;
+    long long best_score = -1;
+    for (size_t f = 0; f < candidates.size(); ++f) {
+        std::vector<unsigned char>& out = candidates[f];
+        out[0] = static_cast<unsigned char>(f);
+        long long score = 0;
+        for (size_t i = 0; i < bytes; ++i) {
+            const int a = i >= 4 ? row[i - 4] : 0;
+            const int b = up[i];
+            const int c = i >= 4 ? up[i - 4] : 0;
+            int predicted = 0;
+            switch (f) {
+                case 1: predicted = a; break;
+                case 2: predicted = b; break;
+                case 3: predicted = (a + b) >> 1; break;
+                case 4: predicted = paeth(a, b, c); break;
+                default: break;
+            }
+            const auto v = static_cast<unsigned char>(row[i] - predicted);
+            out[i + 1] = v;
+            score += std::abs(static_cast<int>(static_cast<signed char>(v)));
+        }
+        if (best_score < 0 || score < best_score) {
+            best_score = score;
+            best = f;
+        }
+    }
+    return best;
+}
+
+// Fills the length/type header and the CRC trailer that frame a chunk.
+void frame_chunk(const char* type, const unsigned char* data, size_t size,
+                 unsigned char (&header)[8], unsigned char (&trailer)[4]) {
+    put_be32(header, static_cast<uint32_t>(size));
+    std::memcpy(header + 4, type, 4);
+    uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(type), 4);
+    if (size > 0) {
+        crc = crc32(crc, data, static_cast<uInt>(size));
+    }
+    put_be32(trailer, static_cast<uint32_t>(crc));
+}
+
+void append_chunk(std::vector<unsigned char>& out, const char* type, const unsigned char* data, size_t size) {
+    unsigned char header[8];
+    unsigned char trailer[4];
+    frame_chunk(type, data, size, header, trailer);
+    out.insert(out.end(), header, header + sizeof(header));
+    if (size > 0) {
+        out.insert(out.end(), data, data + size);
+    }
+    out.insert(out.end(), trailer, trailer + sizeof(trailer));
+}
+
+void append_ihdr(std::vector<unsigned char>& out, int width, int height) {
+    unsigned char ihdr[13];
+    put_be32(ihdr, static_cast<uint32_t>(width));
+    put_be32(ihdr + 4, static_cast<uint32_t>(height));
+    ihdr[8] = 8;  // bit depth
+    ihdr[9] = 6;  // RGBA
+    ihdr[10] = 0; // deflate
+    ihdr[11] = 0; // adaptive filtering
+    ihdr[12] = 0; // no interlace
+    append_chunk(out, "IHDR", ihdr, sizeof(ihdr));
+}
+
+// Runs `job(index)` for every index below `count` on up to `workers` threads.
+template <typename Job>
+void run_indexed_jobs(size_t count, unsigned int workers, Job&& job) {
+    const size_t thread_count = std::min<size_t>(std::max(1u, workers), count);
+    if (thread_count <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            job(i);
+        }
+        return;
+    }
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count);
+    for (size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&]() {
+            for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < count;
+                 i = next.fetch_add(1, std::memory_order_relaxed)) {
+                job(i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+} // namespace
+
+struct PngStreamWriter::State {
+    Sink sink;
+    z_stream zs{};
+    bool zs_ready = false;
+    int width = 0;
+    int height = 0;
+    int rows_written = 0;
+    std::vector<unsigned char> previous_row;
+    // Filter type byte plus the filtered row, one candidate per PNG filter.
+    std::array<std::vector<unsigned char>, 5> candidates;
+    std::vector<unsigned char> idat;
+
+    ~State() {
+        if (zs_ready) {
+            deflateEnd(&zs);
+        }
+    }
+
+    bool write_chunk(const char* type, const unsigned char* data, size_t size) {
+        unsigned char header[8];
+        unsigned char trailer[4];
+        frame_chunk(type, data, size, header, trailer);
+        return sink(header, sizeof(header)) && (size == 0 || sink(data, size)) && sink(trailer, sizeof(trailer));
+    }
+
+    // Runs deflate over the pending input, emitting an IDAT chunk per full buffer.
+    bool pump(int flush) {
+        while (true) {
+            zs.next_out = idat.data();
+            zs.avail_out = static_cast<uInt>(idat.size());
+            const int r = deflate(&zs, flush);
+            if (r == Z_STREAM_ERROR) {
+                return false;
+            }
+            const size_t produced = idat.size() - zs.avail_out;
+            if (produced > 0 && !write_chunk("IDAT", idat.data(), produced)) {
+                return false;
+            }
+            if (flush == Z_FINISH ? r == Z_STREAM_END : (zs.avail_in == 0 && zs.avail_out != 0)) {
+                return true;
+            }
+        }
+    }
+
+    const std::vector<unsigned char>& filter_row(const unsigned char* row) {
+        return candidates[select_row_filter(row, previous_row.data(), width, candidates)];
+    }
+};
+
+bool PngStreamWriter::available() {
+    return true;
+}
+
+PngStreamWriter::PngStreamWriter() = default;
+PngStreamWriter::~PngStreamWriter() = default;
+
+bool PngStreamWriter::begin(int width, int height, Sink sink) {
+    state_.reset();
+    if (width <= 0 || height <= 0 || !sink) {
+        return false;
+    }
+    auto state = std::make_unique<State>();
+    state->sink = std::move(sink);
+    state->width = width;
+    state->height = height;
+    const size_t row_bytes = static_cast<size_t>(width) * 4;
+    state->previous_row.assign(row_bytes, 0);
+    for (auto& candidate : state->candidates) {
+        candidate.resize(row_bytes + 1);
+    }
+    state->idat.resize(k_idat_chunk_size);
+    if (deflateInit(&state->zs, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        return false;
+    }
+    state->zs_ready = true;
+
+    std::vector<unsigned char> head(k_png_signature.begin(), k_png_signature.end());
+    append_ihdr(head, width, height);
+    if (!state->sink(head.data(), head.size())) {
+        return false;
+    }
+    state_ = std::move(state);
+    return true;
+}
+
+bool PngStreamWriter::write_rows(const unsigned char* rgba, int row_count, size_t stride) {
+    if (!state_ || row_count < 0 || row_count > state_->height - state_->rows_written) {
+        return false;
+    }
+    const size_t row_bytes = static_cast<size_t>(state_->width) * 4;
+    for (int r = 0; r < row_count; ++r) {
+        const unsigned char* row = rgba + static_cast<size_t>(r) * stride;
+        const std::vector<unsigned char>& filtered = state_->filter_row(row);
+        state_->zs.next_in = const_cast<Bytef*>(filtered.data());
+        state_->zs.avail_in = static_cast<uInt>(filtered.size());
+        if (!state_->pump(Z_NO_FLUSH)) {
+            return false;
+        }
+        std::memcpy(state_->previous_row.data(), row, row_bytes);
+    }
+    state_->rows_written += row_count;
+    return true;
+}
+
+bool PngStreamWriter::finish() {
+    if (!state_ || state_->rows_written != state_->height) {
+        return false;
+    }
+    state_->zs.next_in = nullptr;
+    state_->zs.avail_in = 0;
+    const bool ok = state_->pump(Z_FINISH) && state_->write_chunk("IEND", nullptr, 0);
+    state_.reset();
+    return ok;
+}
+
+
+namespace {
+
+// Deflates `size` bytes at `data` into `piece` as raw deflate, primed with
+// the `dictionary` bytes before `data`. Pieces other than the last must end
+// byte-aligned on a non-final block so they can be concatenated.
+using PieceDeflater = std::function<bool(const unsigned char* data, size_t dictionary, size_t size, bool last,
+                                         std::vector<unsigned char>& piece)>;
+
+// Filters the rows, deflates fixed k_parallel_chunk_bytes pieces of the
+// filtered stream with `deflate_piece` on up to `workers` threads and wraps
+// them in one zlib stream and a PNG.
+bool encode_png_pieces(const unsigned char* rgba, int width, int height, size_t stride,
+                       unsigned int workers, unsigned char zlib_flags, const PieceDeflater& deflate_piece,
+                       std::vector<unsigned char>& out) {
+    out.clear();
+    if (rgba == nullptr || width <= 0 || height <= 0) {
+        return false;
+    }
+    const size_t row_bytes = static_cast<size_t>(width) * 4;
+    const size_t filtered_row_bytes = row_bytes + 1;
+    const size_t rows = static_cast<size_t>(height);
+
+    // Filtering only looks at the unfiltered row above, so rows filter independently.
+    std::vector<unsigned char> filtered(filtered_row_bytes * rows);
+    const size_t filter_batch = std::max<size_t>(1, k_parallel_chunk_bytes / filtered_row_bytes);
+    const size_t filter_jobs = (rows + filter_batch - 1) / filter_batch;
+    const std::vector<unsigned char> zero_row(row_bytes, 0);
+    run_indexed_jobs(filter_jobs, workers, [&](size_t job) {
+        std::array<std::vector<unsigned char>, 5> candidates;
+        for (auto& candidate : candidates) {
+            candidate.resize(filtered_row_bytes);
+        }
+        const size_t end = std::min(rows, (job + 1) * filter_batch);
+        for (size_t y = job * filter_batch; y < end; ++y) {
+            const unsigned char* row = rgba + y * stride;
+            const unsigned char* up = y > 0 ? rgba + (y - 1) * stride : zero_row.data();
+            const size_t best = select_row_filter(row, up, width, candidates);
+            std::memcpy(filtered.data() + y * filtered_row_bytes, candidates[best].data(), filtered_row_bytes);
+        }
+    });
+
+    // Chunk boundaries depend only on the image size, so the stream is the
+    // same for every worker count. Each chunk is primed with the 32 KiB
+    // before it, and the adler32 of the pieces is combined afterwards.
+    const size_t total = filtered.size();
+    const size_t chunk_count = (total + k_parallel_chunk_bytes - 1) / k_parallel_chunk_bytes;
+    std::vector<std::vector<unsigned char>> pieces(chunk_count);
+    std::vector<uLong> checksums(chunk_count, 0);
+    std::atomic<bool> failed{false};
+    run_indexed_jobs(chunk_count, workers, [&](size_t chunk) {
+        if (failed.load(std::memory_order_relaxed)) {
+            return;
+        }
+        const size_t begin = chunk * k_parallel_chunk_bytes;
+        const size_t size = std::min(k_parallel_chunk_bytes, total - begin);
+        checksums[chunk] = adler32(adler32(0L, Z_NULL, 0), filtered.data() + begin, static_cast<uInt>(size));
+        if (!deflate_piece(filtered.data() + begin, std::min(k_deflate_window, begin), size,
+                           chunk + 1 == chunk_count, pieces[chunk])) {
+            failed.store(true, std::memory_order_relaxed);
+        }
+    });
+    if (failed.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    std::vector<unsigned char> stream = {0x78, zlib_flags};
+    uLong checksum = adler32(0L, Z_NULL, 0);
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+        stream.insert(stream.end(), pieces[chunk].begin(), pieces[chunk].end());
+        const size_t size = std::min(k_parallel_chunk_bytes, total - chunk * k_parallel_chunk_bytes);
+        checksum = adler32_combine(checksum, checksums[chunk], static_cast<z_off_t>(size));
+        pieces[chunk] = {};
+    }
+    unsigned char trailer[4];
+    put_be32(trailer, static_cast<uint32_t>(checksum));
+    stream.insert(stream.end(), trailer, trailer + sizeof(trailer));
+
+    out.assign(k_png_signature.begin(), k_png_signature.end());
+    append_ihdr(out, width, height);
+    for (size_t offset = 0; offset < stream.size(); offset += k_idat_chunk_size) {
+        append_chunk(out, "IDAT", stream.data() + offset, std::min(k_idat_chunk_size, stream.size() - offset));
+    }
+    append_chunk(out, "IEND", nullptr, 0);
+    return true;
+}
+
+} // namespace
+
+bool encode_png_parallel(const unsigned char* rgba, int width, int height, size_t stride,
+                         unsigned int workers, std::vector<unsigned char>& out) {
+    // A sync flush ends each piece on an empty stored block, which keeps the
+    // raw deflate pieces byte-aligned and safe to concatenate.
+    auto deflate_piece = [](const unsigned char* data, size_t dictionary, size_t size, bool last,
+                            std::vector<unsigned char>& piece) {
+        z_stream zs{};
+        if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return false;
+        }
+        if (dictionary > 0) {
+            deflateSetDictionary(&zs, data - dictionary, static_cast<uInt>(dictionary));
+        }
+        piece.resize(deflateBound(&zs, static_cast<uLong>(size)) + 16);
+        zs.next_in = const_cast<Bytef*>(data);
+        zs.avail_in = static_cast<uInt>(size);
+        zs.next_out = piece.data();
+        zs.avail_out = static_cast<uInt>(piece.size());
+        const int r = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+        const bool ok = last ? r == Z_STREAM_END : (r == Z_OK && zs.avail_in == 0);
+        piece.resize(piece.size() - zs.avail_out);
+        deflateEnd(&zs);
+        return ok;
+    };
+    return encode_png_pieces(rgba, width, height, stride, workers, 0x9C, deflate_piece, out);
+}
+
+#ifdef SPRAT_HAS_ZOPFLI_DEFLATE
+bool encode_png_zopfli_parallel(const unsigned char* rgba, int width, int height, size_t stride,
+                                unsigned int workers, std::vector<unsigned char>& out) {
+    // ZopfliDeflatePart matches against the input before `instart`, so
+    // passing the dictionary as leading input primes the piece the way
+    // deflateSetDictionary does for zlib. Zopfli writes a bit stream, so
+    // non-final pieces get the same empty stored block a zlib sync flush
+    // emits to end byte-aligned.
+    auto deflate_piece = [](const unsigned char* data, size_t dictionary, size_t size, bool last,
+                            std::vector<unsigned char>& piece) {
+        ZopfliOptions options;
+        ZopfliInitOptions(&options);
+        unsigned char bit_pointer = 0;
+        unsigned char* compressed = nullptr;
+        size_t compressed_size = 0;
+        ZopfliDeflatePart(&options, 2, last ? 1 : 0, data - dictionary, dictionary, dictionary + size,
+                          &bit_pointer, &compressed, &compressed_size);
+        if (compressed == nullptr) {
+            return false;
+        }
+        piece.assign(compressed, compressed + compressed_size);
+        std::free(compressed);
+        if (!last) {
+            // BFINAL = 0 and BTYPE = 00 are three zero bits; the rest of
+            // their byte is padding, then LEN = 0 and NLEN = 0xFFFF.
+            for (int bit = 0; bit < 3; ++bit) {
+                if (bit_pointer == 0) {
+                    piece.push_back(0);
+                }
+                bit_pointer = static_cast<unsigned char>((bit_pointer + 1) & 7);
+            }
+            piece.insert(piece.end(), {0x00, 0x00, 0xFF, 0xFF});
+        }
+        return true;
+    };
+    return encode_png_pieces(rgba, width, height, stride, workers, 0xDA, deflate_piece, out);
+}
+#else
+bool encode_png_zopfli_parallel(const unsigned char* /*rgba*/, int /*width*/, int /*height*/, size_t /*stride*/,
+                                unsigned int /*workers*/, std::vector<unsigned char>& out) {
+    out.clear();
+    return false;
+}
+#endif
+
+#else
+
+struct PngStreamWriter::State {};
+
+bool PngStreamWriter::available() {
+    return false;
+}
+
+PngStreamWriter::PngStreamWriter() = default;
+PngStreamWriter::~PngStreamWriter() = default;
+
+bool PngStreamWriter::begin(int /*width*/, int /*height*/, Sink /*sink*/) {
+    return false;
+}
+
+bool PngStreamWriter::write_rows(const unsigned char* /*rgba*/, int /*row_count*/, size_t /*stride*/) {
+    return false;
+}
+
+bool PngStreamWriter::finish() {
+    return false;
+}
+
+bool encode_png_parallel(const unsigned char* /*rgba*/, int /*width*/, int /*height*/, size_t /*stride*/,
+                         unsigned int /*workers*/, std::vector<unsigned char>& out) {
+    out.clear();
+    return false;
+}
+
+bool encode_png_zopfli_parallel(const unsigned char* /*rgba*/, int /*width*/, int /*height*/, size_t /*stride*/,
+                                unsigned int /*workers*/, std::vector<unsigned char>& out) {
+    out.clear();
+    return false;
+}
+
+#endif
+
+} // namespace sprat::core
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace sprat::core {
+
+// Incremental RGBA PNG encoder. Rows are fed top to bottom in any number of
+// batches and compressed bytes leave through the sink as soon as zlib emits
+// them, so callers never hold the whole image or the whole encoded file.
+// Requires zlib (SPRAT_HAS_ZLIB); available() reports whether it was built in.
+class PngStreamWriter {
+public:
+    using Sink = std::function<bool(const unsigned char* data, size_t size)>;
+
+    static bool available();
+
+    PngStreamWriter();
+    ~PngStreamWriter();
+    PngStreamWriter(const PngStreamWriter&) = delete;
+    PngStreamWriter& operator=(const PngStreamWriter&) = delete;
+
+    bool begin(int width, int height, Sink sink);
+    // Encodes `row_count` rows of width * 4 bytes, `stride` bytes apart.
+    bool write_rows(const unsigned char* rgba, int row_count, size_t stride);
+    // Flushes the last IDAT chunk and writes IEND once every row was written.
+    bool finish();
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+};
+
+// Encodes a whole RGBA image into `out` as a standard PNG. Rows are filtered
+// and deflated in fixed 1 MiB pieces on up to `workers` threads; each piece
+// is primed with the previous 32 KiB as its dictionary (pigz-style), so the
+// ratio stays close to a single stream and the bytes do not depend on
+// `workers`. Returns false without zlib.
+bool encode_png_parallel(const unsigned char* rgba, int width, int height, size_t stride,
+                         unsigned int workers, std::vector<unsigned char>& out);
+
+// Same pieces as encode_png_parallel, each deflated by Zopfli with the
+// previous 32 KiB as its history, for a smaller PNG at Zopfli's cost spread
+// over `workers`. Rows use the same filters as encode_png_parallel rather
+// than ZopfliPNG's filter search. Returns false unless built with zlib and
+// the Zopfli deflate library (SPRAT_HAS_ZOPFLI_DEFLATE).
+bool encode_png_zopfli_parallel(const unsigned char* rgba, int width, int height, size_t stride,
+                                unsigned int workers, std::vector<unsigned char>& out);
+
+} // namespace sprat::core
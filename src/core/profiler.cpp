@@ -0,0 +1,295 @@
+#include "profiler.h"
+
+#include "i18n.h"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace sprat::core {
+
+namespace {
+
+struct ProfileEvent {
+    const char* name = nullptr;
+    int64_t start_us = 0;
+    int64_t duration_us = 0;
+    int arg_count = 0;
+    const char* arg_keys[k_max_profile_args] = {};
+    int64_t arg_values[k_max_profile_args] = {};
+};
+
+enum class CounterKind : uint8_t { sum, peak };
+
+struct ProfileCounter {
+    const char* name = nullptr;
+    CounterKind kind = CounterKind::sum;
+    int64_t value = 0;
+};
+
+// Each thread appends to its own buffer without locking. Buffers stay in the
+// registry after their thread exits, so the session still writes what worker
+// threads recorded; a later thread then takes over the free buffer (and its
+// trace lane) instead of growing the registry, and the session drops the
+// free ones once written.
+struct ThreadBuffer {
+    int tid = 0;
+    bool in_use = false;
+    std::vector<ProfileEvent> events;
+    std::vector<ProfileCounter> counters;
+};
+
+std::atomic<bool> g_enabled{false};
+std::chrono::steady_clock::time_point g_origin;
+std::mutex g_registry_mutex;
+std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+int g_next_tid = 1;
+thread_local ThreadBuffer* t_buffer = nullptr;
+
+// Hands the calling thread's buffer back to the registry when it exits.
+struct BufferRelease {
+    ~BufferRelease() {
+        std::lock_guard<std::mutex> lock(g_registry_mutex);
+        t_buffer->in_use = false;
+    }
+};
+
+ThreadBuffer& thread_buffer() {
+    if (t_buffer == nullptr) {
+        {
+            std::lock_guard<std::mutex> lock(g_registry_mutex);
+            auto free_buffer = std::ranges::find_if(g_buffers, [](const auto& buffer) { return !buffer->in_use; });
+            if (free_buffer == g_buffers.end()) {
+                g_buffers.push_back(std::make_unique<ThreadBuffer>());
+                g_buffers.back()->tid = g_next_tid++;
+                free_buffer = std::prev(g_buffers.end());
+            }
+            (*free_buffer)->in_use = true;
+            t_buffer = free_buffer->get();
+        }
+        thread_local BufferRelease release;
+    }
+    return *t_buffer;
+}
+
+int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - g_origin).count();
+}
+
+void update_counter(const char* name, CounterKind kind, int64_t value) {
+    // Few distinct counters per thread, so a linear scan beats hashing.
+    std::vector<ProfileCounter>& counters = thread_buffer().counters;
+    for (ProfileCounter& counter : counters) {
+        if (counter.name == name) {
+            counter.value = kind == CounterKind::sum ? counter.value + value : std::max(counter.value, value);
+            return;
+        }
+    }
+    counters.push_back({name, kind, value});
+}
+
+std::string json_string(const char* text) {
+    std::string out = "\"";
+    for (const char* p = text; *p != '\0'; ++p) {
+        if (*p == '"' || *p == '\\') {
+            out += '\\';
+        }
+        out += *p;
+    }
+    out += '"';
+    return out;
+}
+
+bool write_profile(const std::string& path, const char* tool) {
+    struct ScopeTotal {
+        int64_t count = 0;
+        int64_t total_us = 0;
+        int64_t max_us = 0;
+    };
+    struct CounterTotal {
+        CounterKind kind = CounterKind::sum;
+        int64_t value = 0;
+    };
+    std::map<std::string, ScopeTotal> scopes;
+    std::map<std::string, CounterTotal> counters;
+    const int64_t end_us = now_us();
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        return false;
+    }
+    out << "{\"traceEvents\":[\n"
+        << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":"
+        << json_string(tool) << "}}";
+    std::lock_guard<std::mutex> lock(g_registry_mutex);
+    for (const auto& buffer : g_buffers) {
+        for (const ProfileEvent& event : buffer->events) {
+            out << ",\n{\"name\":" << json_string(event.name) << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"ts\":" << event.start_us << ",\"dur\":" << event.duration_us;
+            if (event.arg_count > 0) {
+                out << ",\"args\":{";
+                for (int i = 0; i < event.arg_count; ++i) {
+                    out << (i == 0 ? "" : ",") << json_string(event.arg_keys[i]) << ":" << event.arg_values[i];
+                }
+                out << "}";
+            }
+            out << "}";
+            ScopeTotal& total = scopes[event.name];
+            ++total.count;
+            total.total_us += event.duration_us;
+            total.max_us = std::max(total.max_us, event.duration_us);
+        }
+        for (const ProfileCounter& counter : buffer->counters) {
+            CounterTotal& total = counters[counter.name];
+            total.kind = counter.kind;
+            total.value = counter.kind == CounterKind::sum ? total.value + counter.value
+                                                           : std::max(total.value, counter.value);
+        }
+    }
+    for (const auto& [name, total] : counters) {
+        out << ",\n{\"name\":" << json_string(name.c_str()) << ",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":"
+            << end_us << ",\"args\":{\"value\":" << total.value << "}}";
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\",\n\"tool\":" << json_string(tool)
+        << ",\n\"wall_ms\":" << static_cast<double>(end_us) / 1000.0 << ",\n\"scopes\":{";
+    bool first = true;
+    for (const auto& [name, total] : scopes) {
+        out << (first ? "\n" : ",\n") << json_string(name.c_str()) << ":{\"count\":" << total.count
+            << ",\"total_ms\":" << static_cast<double>(total.total_us) / 1000.0
+            << ",\"max_ms\":" << static_cast<double>(total.max_us) / 1000.0 << "}";
+        first = false;
+    }
+    out << "},\n\"counters\":{";
+    first = true;
+    for (const auto& [name, total] : counters) {
+        out << (first ? "\n" : ",\n") << json_string(name.c_str()) << ":" << total.value;
+        first = false;
+    }
+    out << "}}\n";
+    return static_cast<bool>(out);
+}
+
+} // namespace
+
+bool profiling_enabled() {
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+void profile_count(const char* name, int64_t delta) {
+    if (profiling_enabled()) {
+        update_counter(name, CounterKind::sum, delta);
+    }
+}
+
+void profile_peak(const char* name, int64_t value) {
+    if (profiling_enabled()) {
+        update_counter(name, CounterKind::peak, value);
+    }
+}
+
+ProfileScope::ProfileScope(const char* name) : name_(name) {
+    if (profiling_enabled()) {
+        start_us_ = now_us();
+    }
+}
+
+ProfileScope::~ProfileScope() {
+    stop();
+}
+
+void ProfileScope::stop() {
+    if (start_us_ < 0 || !profiling_enabled()) {
+        start_us_ = -1;
+        return;
+    }
+    ProfileEvent event;
+    event.name = name_;
+    event.start_us = start_us_;
+    event.duration_us = now_us() - start_us_;
+    event.arg_count = arg_count_;
+    for (int i = 0; i < arg_count_; ++i) {
+        event.arg_keys[i] = arg_keys_[i];
+        event.arg_values[i] = arg_values_[i];
+    }
+    thread_buffer().events.push_back(event);
+    start_us_ = -1;
+}
+
+void ProfileScope::arg(const char* key, int64_t value) {
+    if (start_us_ >= 0 && arg_count_ < k_max_profile_args) {
+        arg_keys_[arg_count_] = key;
+        arg_values_[arg_count_] = value;
+        ++arg_count_;
+    }
+}
+
+ProfileSession::ProfileSession(const char* tool) : tool_(tool) {
+    const char* trace = std::getenv("SPRAT_TRACE");
+    if (trace == nullptr || *trace == '\0') {
+        return;
+    }
+    std::error_code ec;
+    const std::filesystem::path trace_path(trace);
+    if (std::filesystem::is_directory(trace_path, ec)) {
+        start((trace_path / (std::string(tool) + ".json")).string());
+        return;
+    }
+    // Every tool in a pipeline sees the same variable, so each one writes
+    // <stem>.<tool>.<pid><ext> next to the named file instead of replacing it.
+#ifdef _WIN32
+    const long long pid = _getpid();
+#else
+    const long long pid = getpid();
+#endif
+    std::filesystem::path path = trace_path;
+    path.replace_filename(trace_path.stem().string() + "." + tool + "." + std::to_string(pid) +
+                          trace_path.extension().string());
+    start(path.string());
+}
+
+ProfileSession::~ProfileSession() {
+    if (!owner_) {
+        return;
+    }
+    if (!write_profile(path_, tool_)) {
+        std::cerr << tr("Failed to write profile: ") << path_ << "\n";
+    }
+    g_enabled.store(false, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(g_registry_mutex);
+    std::erase_if(g_buffers, [](const auto& buffer) { return !buffer->in_use; });
+    for (const auto& buffer : g_buffers) {
+        buffer->events.clear();
+        buffer->counters.clear();
+    }
+}
+
+void ProfileSession::start(const std::string& path) {
+    path_ = path;
+    // A tool run nested in another one (embedded use) records into the
+    // outer session instead of starting its own.
+    if (owner_ || profiling_enabled()) {
+        return;
+    }
+    owner_ = true;
+    g_origin = std::chrono::steady_clock::now();
+    g_enabled.store(true, std::memory_order_relaxed);
+}
+
+} // namespace sprat::core
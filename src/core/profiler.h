@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace sprat::core {
+
+// Low-overhead instrumentation shared by the tools. Nothing is recorded until
+// a ProfileSession starts recording; until then every hook below costs one
+// relaxed atomic load. Names must be string literals (they are kept by
+// pointer).
+
+constexpr int k_max_profile_args = 2;
+
+bool profiling_enabled();
+
+// Adds `delta` to a summed counter.
+void profile_count(const char* name, int64_t delta = 1);
+// Raises a peak counter to `value` if it is higher.
+void profile_peak(const char* name, int64_t value);
+
+// Times the enclosing block as one trace event on the calling thread.
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name);
+    ~ProfileScope();
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    // Attaches a value shown with the event (at most k_max_profile_args).
+    void arg(const char* key, int64_t value);
+    // Ends the event before the scope does; later calls do nothing.
+    void stop();
+
+private:
+    const char* name_;
+    int64_t start_us_ = -1;
+    int arg_count_ = 0;
+    const char* arg_keys_[k_max_profile_args] = {};
+    int64_t arg_values_[k_max_profile_args] = {};
+};
+
+// One profiled tool run. Recording starts when the run asks for it with
+// --trace FILE, or when SPRAT_TRACE is set: to a directory that receives
+// <tool>.json, or to a file path, which becomes <stem>.<tool>.<pid><ext> so
+// the tools of one pipeline do not overwrite each other. The profile is
+// written when the session ends, on every return path. The file is Chrome
+// trace format (load it in chrome://tracing or Perfetto) and also carries
+// per-scope totals and the counters under "scopes" and "counters".
+class ProfileSession {
+public:
+    explicit ProfileSession(const char* tool);
+    ~ProfileSession();
+    ProfileSession(const ProfileSession&) = delete;
+    ProfileSession& operator=(const ProfileSession&) = delete;
+
+    void start(const std::string& path);
+
+private:
+    const char* tool_;
+    std::string path_;
+    bool owner_ = false;
+};
+
+} // namespace sprat::core
@@ -0,0 +1,69 @@
+#include "temp_dir.h"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <system_error>
+
+namespace sprat::core {
+
+namespace fs = std::filesystem;
+
+fs::path default_temp_dir() {
+    std::error_code ec;
+    fs::path path = fs::temp_directory_path(ec);
+    if (!ec && !path.empty()) {
+        return path;
+    }
+
+    const char* tmp = std::getenv("TMP");
+    if (tmp != nullptr && *tmp != '\0') {
+        return fs::path(tmp);
+    }
+    const char* temp = std::getenv("TEMP");
+    if (temp != nullptr && *temp != '\0') {
+        return fs::path(temp);
+    }
+    const char* tmpdir = std::getenv("TMPDIR");
+    if (tmpdir != nullptr && *tmpdir != '\0') {
+        return fs::path(tmpdir);
+    }
+
+#ifdef _WIN32
+    return fs::path(".");
+#else
+    return fs::path("/tmp");
+#endif
+}
+
+fs::path unique_temp_path(const fs::path& path) {
+#ifdef _WIN32
+    const long long pid = _getpid();
+#else
+    const long long pid = getpid();
+#endif
+    // The counter keeps names unique within a process even if random_device
+    // is deterministic on the platform.
+    static std::atomic<unsigned long long> counter{0};
+    static const unsigned long long seed = [] {
+        std::random_device device;
+        return (static_cast<unsigned long long>(device()) << 32) ^ device();
+    }();
+    const unsigned long long token = seed + counter.fetch_add(1) * 0x9E3779B97F4A7C15ULL;
+
+    std::array<char, 64> suffix{};
+    std::snprintf(suffix.data(), suffix.size(), ".%lld.%016llx.tmp", pid, token);
+    fs::path tmp = path;
+    tmp += suffix.data();
+    return tmp;
+}
+
+} // namespace sprat::core
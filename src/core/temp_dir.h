@@ -0,0 +1,15 @@
+#pragma once
+
+#include <filesystem>
+
+namespace sprat::core {
+
+// System temporary directory, falling back to TMP/TEMP/TMPDIR and then to
+// /tmp (or "." on Windows) when std::filesystem cannot report one.
+std::filesystem::path default_temp_dir();
+
+// Sibling of `path` ending in ".tmp" whose name includes the process id and a
+// random token, so concurrent writers never share a temporary file.
+std::filesystem::path unique_temp_path(const std::filesystem::path& path);
+
+} // namespace sprat::core
@@ -0,0 +1,121 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+if [ "${SPRAT_TEST_DEBUG:-0}" = "1" ]; then
+    set -x
+fi
+
+if [ "$#" -ne 1 ]; then
+    echo "Usage: archive_input_test.sh <spratlayout-bin>" >&2
+    exit 1
+fi
+
+spratlayout_bin="$1"
+
+tmp_dir="$(mktemp -d)"
+if [ "${SPRAT_TEST_DEBUG:-0}" = "1" ]; then
+    echo "archive_input_test tmp_dir: $tmp_dir" >&2
+else
+    trap 'rm -rf "$tmp_dir"' EXIT
+fi
+
+# Path conversion for Windows
+if [[ "$(uname)" == MINGW* || "$(uname)" == MSYS* ]]; then
+    tmp_dir_win="$(cygpath -m "$tmp_dir")"
+    fix_path() {
+        echo "${1/$tmp_dir/$tmp_dir_win}"
+    }
+else
+    fix_path() {
+        echo "$1"
+    }
+fi
+
+frames_dir="$tmp_dir/frames"
+mkdir -p "$frames_dir"
+
+# Keep layout caches and spilled archive members inside the test directory
+cache_dir="$tmp_dir/cache"
+mkdir -p "$cache_dir"
+export TMPDIR="$cache_dir"
+export TMP="$(fix_path "$cache_dir")"
+export TEMP="$(fix_path "$cache_dir")"
+
+decode_png() {
+    if base64 --version 2>&1 | grep -q "GNU"; then
+        base64 -d "$1" > "$2"
+    else
+        base64 -D -i "$1" -o "$2"
+    fi
+}
+
+# 2x2 opaque red and blue PNGs
+cat > "$tmp_dir/red.b64" <<'EOF_PNG'
+iVBORw0KGgoAAAANSUhEUgAAAAIAAAACCAYAAABytg0kAAAAEUlEQVR4nGP4z8DwH4QZYAwAR8oH+WdZbrcAAAAASUVORK5CYII=
+EOF_PNG
+cat > "$tmp_dir/blue.b64" <<'EOF_PNG'
+iVBORw0KGgoAAAANSUhEUgAAAAIAAAACCAYAAABytg0kAAAAEElEQVR4nGNgYPj/H4KhDAA/0gf5tBJPzQAAAABJRU5ErkJggg==
+EOF_PNG
+decode_png "$tmp_dir/red.b64" "$frames_dir/a.png"
+decode_png "$tmp_dir/blue.b64" "$frames_dir/b.png"
+echo "not an image" > "$frames_dir/notes.txt"
+
+archive="$tmp_dir/frames.tar"
+tar -cf "$archive" -C "$tmp_dir" frames
+archive_arg="$(fix_path "$archive")"
+
+sprite_lines() {
+    grep '^sprite ' "$1" | tr -d '\r'
+}
+
+# --- Test 1: In-memory and spilled archive members give the same layout ---
+in_memory="$tmp_dir/in_memory.txt"
+spilled="$tmp_dir/spilled.txt"
+"$spratlayout_bin" "$archive_arg" --sort name > "$in_memory"
+"$spratlayout_bin" "$archive_arg" --sort name --archive-memory 0 > "$spilled"
+if [ "$(sprite_lines "$in_memory" | wc -l | tr -d ' ')" -ne 2 ]; then
+    echo "Test 1 FAIL: expected the two archived images in the layout" >&2
+    exit 1
+fi
+if ! diff -u <(sprite_lines "$in_memory") <(sprite_lines "$spilled") > /dev/null; then
+    echo "Test 1 FAIL: spilling archive members changed the layout" >&2
+    exit 1
+fi
+
+# --- Test 2: Spilled members are removed, cache hits included ---
+"$spratlayout_bin" "$archive_arg" --sort name --archive-memory 0 > /dev/null
+if ls -d "$cache_dir"/spratlayout_extract_* > /dev/null 2>&1; then
+    echo "Test 2 FAIL: spilled archive members were left behind" >&2
+    exit 1
+fi
+
+# --- Test 3: Invalid budgets are rejected ---
+if "$spratlayout_bin" "$archive_arg" --archive-memory -1 > /dev/null 2>&1; then
+    echo "Test 3 FAIL: negative --archive-memory should fail" >&2
+    exit 1
+fi
+
+# --- Test 4: A repeated member name keeps only the last copy ---
+# The archive holds frames/a.png twice: first the 2x2 red image, then 1x1.
+cat > "$tmp_dir/pixel.b64" <<'EOF_PNG'
+iVBORw0KGgoAAAANSUhEUgAAAAEAAAABCAQAAAC1HAwCAAAAC0lEQVR42mP8/x8AAwMCAO7ZxaoAAAAASUVORK5CYII=
+EOF_PNG
+mkdir -p "$tmp_dir/dup/frames"
+decode_png "$tmp_dir/pixel.b64" "$tmp_dir/dup/frames/a.png"
+dup_archive="$tmp_dir/dup.tar"
+tar -cf "$dup_archive" -C "$tmp_dir" frames/a.png frames/b.png
+tar -rf "$dup_archive" -C "$tmp_dir/dup" frames/a.png
+for budget in 256 0; do
+    dup_layout="$tmp_dir/dup_$budget.txt"
+    "$spratlayout_bin" "$(fix_path "$dup_archive")" --sort name --archive-memory "$budget" > "$dup_layout"
+    if [ "$(sprite_lines "$dup_layout" | wc -l | tr -d ' ')" -ne 2 ]; then
+        echo "Test 4 FAIL: duplicate archive members should produce one sprite (--archive-memory $budget)" >&2
+        exit 1
+    fi
+    if ! sprite_lines "$dup_layout" | grep 'a\.png"' | grep -q ' 1,1'; then
+        echo "Test 4 FAIL: the last copy of a duplicate member should win (--archive-memory $budget)" >&2
+        exit 1
+    fi
+done
+
+echo "All archive input tests passed."
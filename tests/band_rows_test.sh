@@ -0,0 +1,110 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+if [ "${SPRAT_TEST_DEBUG:-0}" = "1" ]; then
+    set -x
+fi
+
+if [ "$#" -ne 3 ]; then
+    echo "Usage: band_rows_test.sh <spratlayout-bin> <spratpack-bin> <spratunpack-bin>" >&2
+    exit 1
+fi
+
+spratlayout_bin="$1"
+spratpack_bin="$2"
+spratunpack_bin="$3"
+
+tmp_dir="$(mktemp -d)"
+if [ "${SPRAT_TEST_DEBUG:-0}" = "1" ]; then
+    echo "band_rows_test tmp_dir: $tmp_dir" >&2
+else
+    trap 'rm -rf "$tmp_dir"' EXIT
+fi
+
+# Path conversion for Windows
+if [[ "$(uname)" == MINGW* || "$(uname)" == MSYS* ]]; then
+    tmp_dir_win="$(cygpath -m "$tmp_dir")"
+    fix_path() {
+        echo "${1/$tmp_dir/$tmp_dir_win}"
+    }
+else
+    fix_path() {
+        echo "$1"
+    }
+fi
+
+frames_dir="$tmp_dir/frames"
+mkdir -p "$frames_dir"
+
+# Keep layout caches inside the test directory
+cache_dir="$tmp_dir/cache"
+mkdir -p "$cache_dir"
+export TMPDIR="$cache_dir"
+export TMP="$(fix_path "$cache_dir")"
+export TEMP="$(fix_path "$cache_dir")"
+
+decode_png() {
+    if base64 --version 2>&1 | grep -q "GNU"; then
+        base64 -d "$1" > "$2"
+    else
+        base64 -D -i "$1" -o "$2"
+    fi
+}
+
+# 2x2 opaque red and blue PNGs
+cat > "$tmp_dir/red.b64" <<'EOF_PNG'
+iVBORw0KGgoAAAANSUhEUgAAAAIAAAACCAYAAABytg0kAAAAEUlEQVR4nGP4z8DwH4QZYAwAR8oH+WdZbrcAAAAASUVORK5CYII=
+EOF_PNG
+cat > "$tmp_dir/blue.b64" <<'EOF_PNG'
+iVBORw0KGgoAAAANSUhEUgAAAAIAAAACCAYAAABytg0kAAAAEElEQVR4nGNgYPj/H4KhDAA/0gf5tBJPzQAAAABJRU5ErkJggg==
+EOF_PNG
+decode_png "$tmp_dir/red.b64" "$frames_dir/a.png"
+decode_png "$tmp_dir/blue.b64" "$frames_dir/b.png"
+
+cp "$frames_dir/a.png" "$frames_dir/c.png"
+
+frames_arg="$(fix_path "$frames_dir")"
+
+# Re-encodes the whole atlas $1 through spratunpack into $2 so atlases written
+# by different PNG encoders can be compared pixel by pixel.
+normalize_atlas() {
+    local atlas="$1"
+    local out="$2"
+    local size
+    size="$(grep '^atlas ' "$layout" | head -n 1 | awk '{print $2}' | tr -d '\r')"
+    printf 'sprite 0,0 %s\n' "$size" > "$tmp_dir/whole.spratframes"
+    mkdir -p "$out"
+    "$spratunpack_bin" "$atlas" -f "$tmp_dir/whole.spratframes" > "$out.tar"
+    tar -xf "$out.tar" -C "$out"
+}
+
+# --- Test 1: Band-streamed atlases match whole-atlas encoding ---
+layout="$tmp_dir/layout.txt"
+"$spratlayout_bin" "$frames_arg" --mode compact --rotate > "$layout"
+"$spratpack_bin" < "$layout" > "$tmp_dir/whole.png"
+"$spratpack_bin" --band-rows 1 < "$layout" > "$tmp_dir/band1.png"
+"$spratpack_bin" --band-rows 3 --threads 2 < "$layout" > "$tmp_dir/band3.png"
+normalize_atlas "$tmp_dir/whole.png" "$tmp_dir/whole"
+for band in band1 band3; do
+    normalize_atlas "$tmp_dir/$band.png" "$tmp_dir/$band"
+    if ! cmp -s "$tmp_dir/whole/sprite_0.png" "$tmp_dir/$band/sprite_0.png"; then
+        echo "Test 1 FAIL: $band atlas pixels differ from whole-atlas output" >&2
+        exit 1
+    fi
+done
+
+# --- Test 2: Band streaming also writes pattern outputs ---
+"$spratpack_bin" --band-rows 2 -a "$(fix_path "$tmp_dir/pattern_%d.png")" < "$layout"
+normalize_atlas "$tmp_dir/pattern_0.png" "$tmp_dir/pattern"
+if ! cmp -s "$tmp_dir/whole/sprite_0.png" "$tmp_dir/pattern/sprite_0.png"; then
+    echo "Test 2 FAIL: band-streamed pattern output differs" >&2
+    exit 1
+fi
+
+# --- Test 3: Invalid band heights are rejected ---
+if "$spratpack_bin" --band-rows 0 < "$layout" > /dev/null 2>&1; then
+    echo "Test 3 FAIL: --band-rows 0 should fail" >&2
+    exit 1
+fi
+
+echo "All band rows tests passed."
@@ -476,4 +476,101 @@ single_out="$tmp_dir/single_out"
 test -f "$single_out/json.json"
 grep -q '"stem":"json"' "$single_out/json.json"
 
+# Comma-separated transforms render in one run; each keeps its own stem
+multi_out="$tmp_dir/multi_out"
+"$convert_bin" --transform "tstsuite.txt,tstsuite.json" --output-dir "$(fix_path "$multi_out")" < "$layout_file"
+grep -q 'stem=txt' "$multi_out/txt.txt"
+grep -q '"stem":"json"' "$multi_out/json.json"
+cmp -s "$multi_out/txt.txt" "$group_out/txt.txt"
+cmp -s "$multi_out/json.json" "$group_out/json.json"
+
+# Without --output-dir the results are written to stdout in request order
+multi_stdout="$tmp_dir/multi_stdout.txt"
+"$convert_bin" --transform "tstsuite.txt,tstsuite.json" < "$layout_file" > "$multi_stdout"
+head -n 1 "$multi_stdout" | grep -q '^stem=$'
+tail -n 1 "$multi_stdout" | grep -q '"stem":""'
+
+# Empty arrays follow std.manifestJsonEx: the brackets sit on their own lines
+# with a blank line between them. A sprite without markers and an animation
+# without frames pin that layout for the native json emitter.
+empty_layout="$tmp_dir/layout.empty_arrays.txt"
+cat > "$empty_layout" <<'LAYOUTE'
+atlas 8,8
+scale 1
+sprite "./frames/a.png" 0,0 8,8
+LAYOUTE
+empty_animations="$tmp_dir/animations.empty.txt"
+printf 'animation "empty"\n' > "$empty_animations"
+cat > "$tmp_dir/expected.empty_arrays.json" <<'EXPECTED'
+{
+  "animations": [
+    {
+      "fps": 8,
+      "name": "empty",
+      "sprite_indexes": [
+
+      ],
+      "sprite_names": [
+
+      ]
+    }
+  ],
+  "atlases": [
+    {
+      "height": 8,
+      "path": "",
+      "width": 8
+    }
+  ],
+  "extrude": 0,
+  "multipack": false,
+  "scale": 1,
+  "sprites": [
+    {
+      "atlas_index": 0,
+      "markers": [
+
+      ],
+      "name": "a",
+      "path": "./frames/a.png",
+      "pivot": {
+        "x": 0,
+        "y": 0
+      },
+      "rect": {
+        "h": 8,
+        "w": 8,
+        "x": 0,
+        "y": 0
+      },
+      "rotation": 0,
+      "trim": {
+        "bottom": 0,
+        "left": 0,
+        "right": 0,
+        "top": 0
+      }
+    }
+  ]
+}
+EXPECTED
+"$convert_bin" --transform json --animations "$(fix_path "$empty_animations")" < "$empty_layout" > "$tmp_dir/native.empty_arrays.json"
+diff -u "$tmp_dir/expected.empty_arrays.json" "$tmp_dir/native.empty_arrays.json"
+
+# Built-in names are served by native emitters; the .jsonnet files they mirror
+# must give the same bytes when run by path.
+for fmt in json csv css xml phaser-hash; do
+  "$convert_bin" --transform "$fmt" --markers "$(fix_path "$markers_file")" --animations "$(fix_path "$animations_alias_file")" < "$layout_file" > "$tmp_dir/native.$fmt"
+  "$convert_bin" --transform "$transforms_dir/$fmt.jsonnet" --markers "$(fix_path "$markers_file")" --animations "$(fix_path "$animations_alias_file")" < "$layout_file" > "$tmp_dir/jsonnet.$fmt"
+  cmp "$tmp_dir/native.$fmt" "$tmp_dir/jsonnet.$fmt"
+done
+for fmt in json csv css xml phaser-hash; do
+  "$convert_bin" --transform "$fmt" --atlas 'atlas_%d.png' < "$multipack_layout" > "$tmp_dir/native.mp.$fmt"
+  "$convert_bin" --transform "$transforms_dir/$fmt.jsonnet" --atlas 'atlas_%d.png' < "$multipack_layout" > "$tmp_dir/jsonnet.mp.$fmt"
+  cmp "$tmp_dir/native.mp.$fmt" "$tmp_dir/jsonnet.mp.$fmt"
+  "$convert_bin" --transform "$fmt" < "$layout_quotes_file" > "$tmp_dir/native.q.$fmt"
+  "$convert_bin" --transform "$transforms_dir/$fmt.jsonnet" < "$layout_quotes_file" > "$tmp_dir/jsonnet.q.$fmt"
+  cmp "$tmp_dir/native.q.$fmt" "$tmp_dir/jsonnet.q.$fmt"
+done
+
 echo "convert_test.sh: ok"
@@ -1,7 +1,26 @@
 #include "../src/core/cli_parse.h"
+#include "../src/core/directory_scan.h"
 #include "../src/core/output_pattern.h"
+#include "../src/core/mapped_file.h"
+#include "../src/core/image_probe.h"
+#include "../src/core/pixel_kernels.h"
+#include "../src/core/hamming_index.h"
+#include "../src/core/png_stream_writer.h"
+#include "../src/core/pixel_cache.h"
+#include "../src/core/profiler.h"
+#include <stb_image.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <iostream>
+#include <iterator>
+#include <numeric>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <cassert>
 #include <vector>
 
@@ -48,6 +67,13 @@ void test_parse_double() {
     assert(sprat::core::parse_double("10", out));
     assert(out == 10.0);
     assert(!sprat::core::parse_double("abc", out));
+    // Views need not be terminated; only the viewed characters are parsed.
+    const std::string_view scale_line = "0.25 trailing";
+    assert(sprat::core::parse_double(scale_line.substr(0, 4), out));
+    assert(out == 0.25);
+    const std::string long_token = "1." + std::string(80, '5');
+    assert(sprat::core::parse_double(long_token, out));
+    assert(out > 1.5 && out < 1.6);
     std::cout << "test_parse_double passed" << std::endl;
 }
 
@@ -61,6 +87,9 @@ void test_parse_pair() {
     assert(!sprat::core::parse_pair("10,", a, b));
     assert(!sprat::core::parse_pair(",20", a, b));
     assert(!sprat::core::parse_pair("10,20,30", a, b));
+    const std::string_view sprite_line = "3,4 5,6";
+    assert(sprat::core::parse_pair(sprite_line.substr(0, 3), a, b));
+    assert(a == 3 && b == 4);
     std::cout << "test_parse_pair passed" << std::endl;
 }
 
@@ -166,6 +195,616 @@ void test_compare_natural() {
     std::cout << "test_compare_natural passed" << std::endl;
 }
 
+void test_mapped_file() {
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path() / "sprat_core_test_mapped_file.bin";
+    const std::string payload("map\0me", 6);
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+    }
+
+    sprat::core::MappedFile file;
+    assert(file.open(path));
+    assert(file.size() == payload.size());
+    assert(std::memcmp(file.data(), payload.data(), payload.size()) == 0);
+
+    sprat::core::MappedFile moved(std::move(file));
+    assert(!file.is_open());
+    assert(moved.is_open() && moved.size() == payload.size());
+    assert(std::memcmp(moved.data(), payload.data(), payload.size()) == 0);
+    moved.close();
+
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    }
+    assert(moved.open(path));
+    assert(moved.size() == 0);
+    moved.close();
+
+    std::filesystem::remove(path);
+    assert(!moved.open(path));
+    std::cout << "test_mapped_file passed" << std::endl;
+}
+
+void test_probe_image_dimensions() {
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path() / "sprat_core_test_probe.png";
+    // PNG signature followed by an IHDR chunk for a 300x2 image.
+    const unsigned char png_header[] = {
+        0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n',
+        0x00, 0x00, 0x00, 0x0D, 'I', 'H', 'D', 'R',
+        0x00, 0x00, 0x01, 0x2C, 0x00, 0x00, 0x00, 0x02,
+        0x08, 0x06, 0x00, 0x00, 0x00
+    };
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(png_header), sizeof(png_header));
+    }
+    int w = 0;
+    int h = 0;
+    assert(sprat::core::probe_image_dimensions(path, w, h));
+    assert(w == 300 && h == 2);
+
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "BM not a png";
+    }
+    assert(!sprat::core::probe_image_dimensions(path, w, h));
+
+    std::filesystem::remove(path);
+    assert(!sprat::core::probe_image_dimensions(path, w, h));
+    std::cout << "test_probe_image_dimensions passed" << std::endl;
+}
+
+void test_atlas_kernels() {
+    using sprat::core::PixelKernelIsa;
+    const PixelKernelIsa isas[] = {
+        PixelKernelIsa::scalar, PixelKernelIsa::sse2, PixelKernelIsa::avx2, PixelKernelIsa::neon
+    };
+    unsigned int seed = 777;
+    auto next = [&seed]() {
+        seed = seed * 1103515245u + 12345u;
+        return (seed >> 16) & 0x7FFFu;
+    };
+    auto random_image = [&](int w, int h) {
+        std::vector<unsigned char> rgba(static_cast<size_t>(w) * static_cast<size_t>(h) * 4);
+        for (size_t i = 0; i < rgba.size(); ++i) {
+            rgba[i] = static_cast<unsigned char>(next());
+        }
+        // Plenty of fully transparent pixels for dilation to fill.
+        for (size_t i = 3; i < rgba.size(); i += 4) {
+            if (next() % 3 == 0) {
+                rgba[i] = 0;
+            }
+        }
+        return rgba;
+    };
+
+    for (int iteration = 0; iteration < 60; ++iteration) {
+        // Rotated rows: destination pixel (r, col) is source pixel (r, w - 1 - col).
+        const int w = 1 + static_cast<int>(next() % 45);
+        const int h = 1 + static_cast<int>(next() % 29);
+        const std::vector<unsigned char> src = random_image(h, w);
+        const size_t src_stride = static_cast<size_t>(h) * 4;
+        const int row_begin = static_cast<int>(next() % static_cast<unsigned>(h));
+        std::vector<unsigned char> expected(static_cast<size_t>(w) * static_cast<size_t>(h) * 4, 0);
+        for (int r = row_begin; r < h; ++r) {
+            for (int col = 0; col < w; ++col) {
+                std::memcpy(&expected[(static_cast<size_t>(r - row_begin) * static_cast<size_t>(w) + static_cast<size_t>(col)) * 4],
+                            &src[static_cast<size_t>(w - 1 - col) * src_stride + static_cast<size_t>(r) * 4], 4);
+            }
+        }
+        for (PixelKernelIsa isa : isas) {
+            if (!sprat::core::pixel_kernel_isa_supported(isa)) {
+                continue;
+            }
+            std::vector<unsigned char> dest(expected.size(), 0);
+            sprat::core::blit_rotated_cw(src.data(), src_stride, w, row_begin, h, dest.data(),
+                                         static_cast<size_t>(w) * 4, isa);
+            assert(dest == expected);
+        }
+
+        // Sprite blits clip to the band and land at (2, 1) in a wider atlas.
+        const int atlas_w = std::max(w, h) + 3;
+        const int band_y0 = 1 + row_begin;
+        const int band_y1 = band_y0 + 1 + static_cast<int>(next() % static_cast<unsigned>(h));
+        for (const bool rotated : {false, true}) {
+            const int sprite_w = rotated ? w : h;
+            const int sprite_h = rotated ? h : w;
+            std::vector<unsigned char> band(static_cast<size_t>(atlas_w) * static_cast<size_t>(band_y1 - band_y0) * 4, 0);
+            sprat::core::blit_sprite_rows(src.data(), src_stride, 2, 1, sprite_w, sprite_h, rotated,
+                                          band.data(), atlas_w, band_y0, band_y1);
+            for (int y = band_y0; y < band_y1; ++y) {
+                for (int x = 0; x < atlas_w; ++x) {
+                    const unsigned char* got = &band[(static_cast<size_t>(y - band_y0) * static_cast<size_t>(atlas_w) + static_cast<size_t>(x)) * 4];
+                    const int r = y - 1;
+                    const int col = x - 2;
+                    if (r >= sprite_h || col < 0 || col >= sprite_w) {
+                        assert(got[0] == 0 && got[1] == 0 && got[2] == 0 && got[3] == 0);
+                        continue;
+                    }
+                    const size_t src_offset = rotated
+                        ? static_cast<size_t>(w - 1 - col) * src_stride + static_cast<size_t>(r) * 4
+                        : static_cast<size_t>(r) * src_stride + static_cast<size_t>(col) * 4;
+                    assert(std::memcmp(got, &src[src_offset], 4) == 0);
+                }
+            }
+        }
+
+        // Dilation: every instruction set matches the per-pixel rule.
+        const std::vector<unsigned char> read = random_image(w, h);
+        const size_t stride = static_cast<size_t>(w) * 4;
+        std::vector<unsigned char> dilated = read;
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                const unsigned char* here = &read[static_cast<size_t>(y) * stride + static_cast<size_t>(x) * 4];
+                if (here[3] != 0) {
+                    continue;
+                }
+                const int nx[] = {x - 1, x + 1, x, x};
+                const int ny[] = {y, y, y - 1, y + 1};
+                for (int n = 0; n < 4; ++n) {
+                    if (nx[n] < 0 || ny[n] < 0 || nx[n] >= w || ny[n] >= h) {
+                        continue;
+                    }
+                    const unsigned char* p = &read[static_cast<size_t>(ny[n]) * stride + static_cast<size_t>(nx[n]) * 4];
+                    if (p[3] != 0) {
+                        std::memcpy(&dilated[static_cast<size_t>(y) * stride + static_cast<size_t>(x) * 4], p, 3);
+                        break;
+                    }
+                }
+            }
+        }
+        for (PixelKernelIsa isa : isas) {
+            if (!sprat::core::pixel_kernel_isa_supported(isa)) {
+                continue;
+            }
+            std::vector<unsigned char> out = read;
+            for (int y = 0; y < h; ++y) {
+                sprat::core::dilate_row(read.data(), out.data(), w, h, stride, y, 0, w - 1, isa);
+            }
+            assert(out == dilated);
+        }
+    }
+
+    // Extrusion repeats edges and corners outward, clipped to the image.
+    std::vector<unsigned char> atlas(6 * 5 * 4, 0);
+    auto pixel_at = [&atlas](int x, int y) { return &atlas[(static_cast<size_t>(y) * 6 + static_cast<size_t>(x)) * 4]; };
+    for (int y = 1; y < 3; ++y) {
+        for (int x = 0; x < 3; ++x) {
+            pixel_at(x, y)[0] = static_cast<unsigned char>(10 * y + x);
+            pixel_at(x, y)[3] = 255;
+        }
+    }
+    sprat::core::extrude_rect(atlas.data(), 6, 5, 6 * 4, 0, 1, 3, 2, 2);
+    assert(pixel_at(0, 0)[0] == 10 && pixel_at(2, 0)[0] == 12);
+    assert(pixel_at(3, 1)[0] == 12 && pixel_at(4, 1)[0] == 12 && pixel_at(5, 1)[3] == 0);
+    assert(pixel_at(4, 0)[0] == 12 && pixel_at(4, 4)[0] == 22 && pixel_at(1, 4)[0] == 21);
+    assert(pixel_at(5, 4)[3] == 0);
+
+    // Table-driven quantization matches the per-channel rule, dither included.
+    for (int levels : {2, 5, 16}) {
+        for (bool dither : {false, true}) {
+            std::vector<unsigned char> image = random_image(9, 7);
+            std::vector<unsigned char> expected_image = image;
+            for (int y = 0; y < 7; ++y) {
+                for (int x = 0; x < 9; ++x) {
+                    for (int c = 0; c < 3; ++c) {
+                        unsigned char& v = expected_image[(static_cast<size_t>(y) * 9 + static_cast<size_t>(x)) * 4 + static_cast<size_t>(c)];
+                        v = sprat::core::quantize_channel(v, levels, 3 + x, 2 + y, dither);
+                    }
+                }
+            }
+            sprat::core::quantize_rgb(image.data(), 9, 7, 9 * 4, levels, dither, 3, 2);
+            assert(image == expected_image);
+        }
+    }
+    std::cout << "test_atlas_kernels passed" << std::endl;
+}
+
+void test_xxh64() {
+    const unsigned char abc[] = {'a', 'b', 'c'};
+    assert(sprat::core::Xxh64().digest() == 0xEF46DB3751D8E999ULL);
+    sprat::core::Xxh64 small;
+    small.update(abc, sizeof(abc));
+    assert(small.digest() == 0x44BC2CF5AD770999ULL);
+    const std::string sentence = "Nobody inspects the spammish repetition";
+    sprat::core::Xxh64 large;
+    large.update(reinterpret_cast<const unsigned char*>(sentence.data()), sentence.size());
+    assert(large.digest() == 0xFBCEA83C8A378BF1ULL);
+
+    // Streaming in uneven pieces matches hashing in one call.
+    std::vector<unsigned char> data(1000);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<unsigned char>((i * 131) ^ (i >> 3));
+    }
+    sprat::core::Xxh64 whole;
+    whole.update(data.data(), data.size());
+    sprat::core::Xxh64 pieces;
+    size_t offset = 0;
+    for (size_t piece = 1; offset < data.size(); piece = piece * 3 % 41 + 1) {
+        const size_t len = std::min(piece, data.size() - offset);
+        pieces.update(data.data() + offset, len);
+        offset += len;
+    }
+    assert(whole.digest() == pieces.digest());
+
+    // A region hashes like its rows laid out back to back.
+    const int w = 5;
+    const int h = 7;
+    const size_t stride = 9 * 4;
+    std::vector<unsigned char> packed;
+    for (int y = 0; y < h; ++y) {
+        packed.insert(packed.end(), data.begin() + static_cast<long>(y * stride),
+                      data.begin() + static_cast<long>(y * stride + w * 4));
+    }
+    assert(sprat::core::hash_rgba_region(data.data(), w, h, stride) ==
+           sprat::core::hash_rgba_region(packed.data(), w, h, static_cast<size_t>(w) * 4));
+    std::cout << "test_xxh64 passed" << std::endl;
+}
+
+void test_find_opaque_bounds() {
+    using sprat::core::PixelKernelIsa;
+    const PixelKernelIsa isas[] = {
+        PixelKernelIsa::scalar, PixelKernelIsa::sse2, PixelKernelIsa::avx2, PixelKernelIsa::neon
+    };
+    unsigned int seed = 12345;
+    auto next = [&seed]() {
+        seed = seed * 1103515245u + 12345u;
+        return (seed >> 16) & 0x7FFFu;
+    };
+    for (int iteration = 0; iteration < 200; ++iteration) {
+        const int w = 1 + static_cast<int>(next() % 37);
+        const int h = 1 + static_cast<int>(next() % 23);
+        std::vector<unsigned char> rgba(static_cast<size_t>(w) * static_cast<size_t>(h) * 4, 0);
+        const int opaque = static_cast<int>(next() % 4);
+        for (int i = 0; i < opaque; ++i) {
+            const size_t px = next() % (static_cast<size_t>(w) * static_cast<size_t>(h));
+            rgba[px * 4 + 3] = static_cast<unsigned char>(1 + next() % 255);
+        }
+        // Color without alpha never counts as opaque.
+        rgba[0] = 255;
+
+        int ex_min_x = w;
+        int ex_min_y = h;
+        int ex_max_x = -1;
+        int ex_max_y = -1;
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                if (rgba[(static_cast<size_t>(y) * static_cast<size_t>(w) + static_cast<size_t>(x)) * 4 + 3] != 0) {
+                    ex_min_x = std::min(ex_min_x, x);
+                    ex_min_y = std::min(ex_min_y, y);
+                    ex_max_x = std::max(ex_max_x, x);
+                    ex_max_y = std::max(ex_max_y, y);
+                }
+            }
+        }
+        for (PixelKernelIsa isa : isas) {
+            if (!sprat::core::pixel_kernel_isa_supported(isa)) {
+                continue;
+            }
+            int min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+            const bool found = sprat::core::find_opaque_bounds(
+                rgba.data(), w, h, static_cast<size_t>(w) * 4, min_x, min_y, max_x, max_y, isa);
+            assert(found == (ex_max_x >= 0));
+            if (found) {
+                assert(min_x == ex_min_x && min_y == ex_min_y);
+                assert(max_x == ex_max_x && max_y == ex_max_y);
+            }
+        }
+    }
+    std::cout << "test_find_opaque_bounds passed" << std::endl;
+}
+
+void test_group_near_duplicate_hashes() {
+    unsigned long long seed = 0x9E3779B97F4A7C15ULL;
+    auto next = [&seed]() {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        return static_cast<uint64_t>(seed);
+    };
+    // Clusters of nearby hashes, spread over two size groups, with a few
+    // exact repeats and unhashed (zero) entries.
+    const size_t count = 600;
+    std::vector<uint64_t> hashes(count);
+    std::vector<uint64_t> keys(count);
+    std::vector<uint64_t> centers(40);
+    for (auto& center : centers) {
+        center = next();
+    }
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t hash = centers[next() % centers.size()];
+        const int flips = static_cast<int>(next() % 9);
+        for (int f = 0; f < flips; ++f) {
+            hash ^= 1ULL << (next() % 64);
+        }
+        const uint64_t pick = next() % 20;
+        if (pick == 0) {
+            hash = 0;
+        } else if (pick == 1 && i > 0) {
+            hash = hashes[i - 1];
+        }
+        hashes[i] = hash;
+        keys[i] = next() % 2;
+    }
+
+    for (int max_distance : {0, 1, 5, 12, 20}) {
+        std::vector<size_t> parent(count);
+        std::iota(parent.begin(), parent.end(), 0);
+        auto find = [&parent](size_t x) {
+            while (parent[x] != x) {
+                x = parent[x] = parent[parent[x]];
+            }
+            return x;
+        };
+        for (size_t i = 0; i < count; ++i) {
+            for (size_t j = i + 1; j < count; ++j) {
+                if (hashes[i] != 0 && hashes[j] != 0 && keys[i] == keys[j] &&
+                    std::popcount(hashes[i] ^ hashes[j]) <= max_distance) {
+                    const size_t ri = find(i);
+                    const size_t rj = find(j);
+                    parent[std::max(ri, rj)] = std::min(ri, rj);
+                }
+            }
+        }
+        for (unsigned int workers : {1u, 4u}) {
+            const std::vector<size_t> first =
+                sprat::core::group_near_duplicate_hashes(hashes, keys, max_distance, workers);
+            assert(first.size() == count);
+            for (size_t i = 0; i < count; ++i) {
+                assert(first[i] == find(i));
+            }
+        }
+    }
+    std::cout << "test_group_near_duplicate_hashes passed" << std::endl;
+}
+
+void test_png_stream_writer() {
+    sprat::core::PngStreamWriter writer;
+    std::vector<unsigned char> png;
+    auto sink = [&png](const unsigned char* data, size_t size) {
+        png.insert(png.end(), data, data + size);
+        return true;
+    };
+    if (!sprat::core::PngStreamWriter::available()) {
+        assert(!writer.begin(2, 3, sink));
+        std::cout << "test_png_stream_writer skipped (no zlib)" << std::endl;
+        return;
+    }
+    assert(!writer.begin(0, 3, sink));
+
+    // Finishing before every row arrived fails.
+    const std::vector<unsigned char> rows(2 * 3 * 4, 0x7F);
+    assert(writer.begin(2, 3, sink));
+    assert(writer.write_rows(rows.data(), 1, 8));
+    assert(!writer.finish());
+
+    png.clear();
+    assert(writer.begin(2, 3, sink));
+    assert(writer.write_rows(rows.data(), 2, 8));
+    assert(!writer.write_rows(rows.data(), 2, 8));
+    assert(writer.write_rows(rows.data(), 1, 8));
+    assert(writer.finish());
+
+    const unsigned char signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    assert(png.size() > 8 + 25 + 12);
+    assert(std::memcmp(png.data(), signature, sizeof(signature)) == 0);
+    assert(std::memcmp(png.data() + 12, "IHDR", 4) == 0);
+    assert(png[19] == 2 && png[23] == 3 && png[24] == 8 && png[25] == 6);
+    assert(std::memcmp(png.data() + png.size() - 8, "IEND", 4) == 0);
+    std::cout << "test_png_stream_writer passed" << std::endl;
+}
+
+void test_encode_png_parallel() {
+    std::vector<unsigned char> png;
+    const std::vector<unsigned char> pixel(4, 0xFF);
+    if (!sprat::core::PngStreamWriter::available()) {
+        assert(!sprat::core::encode_png_parallel(pixel.data(), 1, 1, 4, 1, png));
+        std::cout << "test_encode_png_parallel skipped (no zlib)" << std::endl;
+        return;
+    }
+    assert(!sprat::core::encode_png_parallel(pixel.data(), 0, 1, 4, 1, png));
+
+    // Large enough to span several deflate pieces.
+    const int width = 640;
+    const int height = 900;
+    std::vector<unsigned char> rgba(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0; i < rgba.size(); ++i) {
+        rgba[i] = static_cast<unsigned char>((i * 7) ^ (i >> 11));
+    }
+    std::vector<unsigned char> serial;
+    std::vector<unsigned char> parallel;
+    assert(sprat::core::encode_png_parallel(rgba.data(), width, height, static_cast<size_t>(width) * 4, 1, serial));
+    assert(sprat::core::encode_png_parallel(rgba.data(), width, height, static_cast<size_t>(width) * 4, 4, parallel));
+    assert(serial == parallel);
+
+    const unsigned char signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    assert(std::memcmp(serial.data(), signature, sizeof(signature)) == 0);
+    assert(std::memcmp(serial.data() + 12, "IHDR", 4) == 0);
+    assert(std::memcmp(serial.data() + 33 + 4, "IDAT", 4) == 0);
+    assert(std::memcmp(serial.data() + serial.size() - 8, "IEND", 4) == 0);
+
+    // The stitched pieces must decode back to the source pixels.
+    int decoded_w = 0;
+    int decoded_h = 0;
+    int decoded_channels = 0;
+    unsigned char* decoded = stbi_load_from_memory(serial.data(), static_cast<int>(serial.size()),
+                                                   &decoded_w, &decoded_h, &decoded_channels, 4);
+    assert(decoded != nullptr);
+    assert(decoded_w == width && decoded_h == height);
+    assert(std::memcmp(decoded, rgba.data(), rgba.size()) == 0);
+    stbi_image_free(decoded);
+
+    // Zopfli pieces need the Zopfli deflate library; two pieces keep it quick.
+    const int zopfli_height = 420;
+    const size_t zopfli_bytes = static_cast<size_t>(width) * zopfli_height * 4;
+    std::vector<unsigned char> zopfli_serial;
+    std::vector<unsigned char> zopfli_parallel;
+    if (sprat::core::encode_png_zopfli_parallel(rgba.data(), width, zopfli_height,
+                                                static_cast<size_t>(width) * 4, 1, zopfli_serial)) {
+        assert(sprat::core::encode_png_zopfli_parallel(rgba.data(), width, zopfli_height,
+                                                       static_cast<size_t>(width) * 4, 4, zopfli_parallel));
+        assert(zopfli_serial == zopfli_parallel);
+        decoded = stbi_load_from_memory(zopfli_serial.data(), static_cast<int>(zopfli_serial.size()),
+                                        &decoded_w, &decoded_h, &decoded_channels, 4);
+        assert(decoded != nullptr);
+        assert(decoded_w == width && decoded_h == zopfli_height);
+        assert(std::memcmp(decoded, rgba.data(), zopfli_bytes) == 0);
+        stbi_image_free(decoded);
+    }
+    std::cout << "test_encode_png_parallel passed" << std::endl;
+}
+
+void test_pixel_cache_memory_budget() {
+    const std::filesystem::path cache_dir =
+        std::filesystem::temp_directory_path() / "sprat_core_test_pixel_cache";
+    std::filesystem::remove_all(cache_dir);
+    const std::filesystem::path small_source = cache_dir / "small.png";
+    const std::filesystem::path large_source = cache_dir / "large.png";
+    const std::vector<unsigned char> pixels(4 * 4 * 4, 0x5a);
+    const sprat::core::PixelCacheRegion small{.image_w = 2, .image_h = 2, .w = 2, .h = 2};
+    const sprat::core::PixelCacheRegion large{.image_w = 4, .image_h = 4, .w = 4, .h = 4};
+
+    sprat::core::set_pixel_cache_in_memory(true, 64);
+    // The small entry fits the budget; the large one would exceed it and
+    // goes to the cache directory.
+    assert(sprat::core::store_cached_pixels(cache_dir, small_source, 10, 1, small, pixels.data(), 8));
+    assert(!std::filesystem::exists(cache_dir));
+    assert(sprat::core::store_cached_pixels(cache_dir, large_source, 20, 2, large, pixels.data(), 16));
+    assert(std::distance(std::filesystem::directory_iterator(cache_dir), std::filesystem::directory_iterator()) == 1);
+
+    sprat::core::CachedPixels cached;
+    assert(cached.open(cache_dir, small_source, 10, 1));
+    assert(cached.region().w == 2 && cached.pixels()[0] == 0x5a);
+    assert(cached.open(cache_dir, large_source, 20, 2));
+    assert(cached.region().w == 4 && cached.pixels()[63] == 0x5a);
+    assert(!cached.open(cache_dir, small_source, 10, 2));
+    cached = sprat::core::CachedPixels();
+
+    // Disabling the memory tier drops its entries but keeps the spilled ones.
+    sprat::core::set_pixel_cache_in_memory(false);
+    assert(!cached.open(cache_dir, small_source, 10, 1));
+    assert(cached.open(cache_dir, large_source, 20, 2));
+    cached = sprat::core::CachedPixels();
+    std::filesystem::remove_all(cache_dir);
+    std::cout << "test_pixel_cache_memory_budget passed" << std::endl;
+}
+
+void test_profiler() {
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path() / "sprat_core_test_profile.json";
+    std::filesystem::remove(path);
+    {
+        sprat::core::ProfileScope ignored("ignored");
+        sprat::core::profile_count("ignored.count");
+    }
+    {
+        sprat::core::ProfileSession session("core_test");
+        session.start(path.string());
+        assert(sprat::core::profiling_enabled());
+        {
+            // A nested run records into the outer session.
+            sprat::core::ProfileSession nested("nested");
+            nested.start(path.string());
+            sprat::core::ProfileScope scope("stage");
+            scope.arg("items", 3);
+            sprat::core::profile_count("stage.items", 2);
+            sprat::core::profile_count("stage.items", 5);
+            sprat::core::profile_peak("stage.peak", 9);
+            sprat::core::profile_peak("stage.peak", 4);
+        }
+        assert(sprat::core::profiling_enabled());
+        // Threads that run one after another share a single trace lane.
+        for (int i = 0; i < 8; ++i) {
+            std::thread([]() { sprat::core::ProfileScope lane("lane"); }).join();
+        }
+    }
+    assert(!sprat::core::profiling_enabled());
+
+    std::ifstream in(path, std::ios::binary);
+    const std::string json((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    assert(json.find("\"traceEvents\"") != std::string::npos);
+    assert(json.find("\"name\":\"stage\",\"ph\":\"X\"") != std::string::npos);
+    assert(json.find("\"args\":{\"items\":3}") != std::string::npos);
+    assert(json.find("\"stage.items\":7") != std::string::npos);
+    assert(json.find("\"stage.peak\":9") != std::string::npos);
+    assert(json.find("\"tool\":\"core_test\"") != std::string::npos);
+    assert(json.find("ignored") == std::string::npos);
+    const std::string lane_event = "\"name\":\"lane\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+    std::string lane_tid;
+    int lane_events = 0;
+    for (size_t at = json.find(lane_event); at != std::string::npos; at = json.find(lane_event, at + 1)) {
+        const size_t tid_begin = at + lane_event.size();
+        const std::string tid = json.substr(tid_begin, json.find(',', tid_begin) - tid_begin);
+        assert(lane_tid.empty() || tid == lane_tid);
+        lane_tid = tid;
+        ++lane_events;
+    }
+    assert(lane_events == 8);
+    in.close();
+    std::filesystem::remove(path);
+    std::cout << "test_profiler passed" << std::endl;
+}
+
+void test_scan_image_directory() {
+    namespace fs = std::filesystem;
+    const fs::path root = fs::temp_directory_path() / "sprat_core_test_scan";
+    fs::remove_all(root);
+    for (int d = 0; d < 6; ++d) {
+        const fs::path dir = root / ("dir" + std::to_string(d)) / ("nested" + std::to_string(d % 2));
+        fs::create_directories(dir);
+        for (int f = 0; f < 12; ++f) {
+            std::ofstream(dir / ("f" + std::to_string(f) + (f % 4 == 3 ? ".txt" : ".png"))) << f;
+            std::ofstream(dir.parent_path() / ("g" + std::to_string(f) + ".png")) << f;
+        }
+    }
+    std::ofstream(root / "top.png") << "top";
+    fs::create_directories(root / "empty");
+
+    const std::string skipped = (fs::path("dir2") / "nested0" / "f5.png").string();
+    const std::string skipped_top = "top.png";
+    std::atomic<int> filtered{0};
+    auto keep = [&](const fs::path& path, std::string_view relative) {
+        ++filtered;
+        assert(fs::path(relative) == fs::relative(path, root));
+        return path.extension() == ".png" && relative != skipped && relative != skipped_top;
+    };
+
+    // The walk order the scan promises to reproduce.
+    std::vector<fs::path> expected;
+    for (const auto& entry : fs::recursive_directory_iterator(root)) {
+        const fs::path relative = fs::relative(entry.path(), root);
+        if (entry.is_regular_file() && entry.path().extension() == ".png" &&
+            relative.string() != skipped && relative.string() != skipped_top) {
+            expected.push_back(entry.path());
+        }
+    }
+    assert(expected.size() == (6 * 12) + (6 * 9) - 1);
+
+    for (unsigned int threads : {1U, 2U, 8U}) {
+        filtered = 0;
+        std::vector<sprat::core::ScannedFile> scanned;
+        fs::path failed;
+        assert(sprat::core::scan_image_directory(root, threads, keep, scanned, failed));
+        assert(filtered == (6 * 12 * 2) + 1);
+        assert(scanned.size() == expected.size());
+        for (size_t i = 0; i < scanned.size(); ++i) {
+            assert(scanned[i].path == expected[i]);
+            assert(scanned[i].file_size > 0);
+            assert(scanned[i].mtime_ticks == fs::last_write_time(expected[i]).time_since_epoch().count());
+        }
+    }
+
+    std::vector<sprat::core::ScannedFile> scanned;
+    fs::path failed;
+    assert(!sprat::core::scan_image_directory(root / "missing", 4, keep, scanned, failed));
+    assert(failed == root / "missing");
+    fs::remove_all(root);
+    std::cout << "test_scan_image_directory passed" << std::endl;
+}
+
 int main() {
     test_parse_positive_int();
     test_parse_non_negative_int();
@@ -177,6 +816,17 @@ int main() {
     test_format_index_pattern();
     test_validate_output_pattern();
     test_compare_natural();
+    test_mapped_file();
+    test_probe_image_dimensions();
+    test_xxh64();
+    test_find_opaque_bounds();
+    test_atlas_kernels();
+    test_group_near_duplicate_hashes();
+    test_png_stream_writer();
+    test_encode_png_parallel();
+    test_pixel_cache_memory_budget();
+    test_profiler();
+    test_scan_image_directory();
     std::cout << "All core tests passed!" << std::endl;
     return 0;
 }
@@ -0,0 +1,97 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+if [ "${SPRAT_TEST_DEBUG:-0}" = "1" ]; then
+    set -x
+fi
+
+if [ "$#" -ne 2 ]; then
+    echo "Usage: frames_threads_test.sh <spratpack-bin> <spratframes-bin>" >&2
+    exit 1
+fi
+
+spratpack_bin="$1"
+spratframes_bin="$2"
+
+tmp_dir="$(mktemp -d)"
+if [ "${SPRAT_TEST_DEBUG:-0}" = "1" ]; then
+    echo "frames_threads_test tmp_dir: $tmp_dir" >&2
+else
+    trap 'rm -rf "$tmp_dir"' EXIT
+fi
+
+# Path conversion for Windows
+if [[ "$(uname)" == MINGW* || "$(uname)" == MSYS* ]]; then
+    tmp_dir_win="$(cygpath -m "$tmp_dir")"
+    fix_path() {
+        echo "${1/$tmp_dir/$tmp_dir_win}"
+    }
+else
+    fix_path() {
+        echo "$1"
+    }
+fi
+
+decode_png() {
+    if base64 --version 2>&1 | grep -q "GNU"; then
+        base64 -d "$1" > "$2"
+    else
+        base64 -D -i "$1" -o "$2"
+    fi
+}
+
+# 2x2 opaque red and blue PNGs
+cat > "$tmp_dir/red.b64" <<'EOF_PNG'
+iVBORw0KGgoAAAANSUhEUgAAAAIAAAACCAYAAABytg0kAAAAEUlEQVR4nGP4z8DwH4QZYAwAR8oH+WdZbrcAAAAASUVORK5CYII=
+EOF_PNG
+cat > "$tmp_dir/blue.b64" <<'EOF_PNG'
+iVBORw0KGgoAAAANSUhEUgAAAAIAAAACCAYAAABytg0kAAAAEElEQVR4nGNgYPj/H4KhDAA/0gf5tBJPzQAAAABJRU5ErkJggg==
+EOF_PNG
+decode_png "$tmp_dir/red.b64" "$tmp_dir/red.png"
+decode_png "$tmp_dir/blue.b64" "$tmp_dir/blue.png"
+red="$(fix_path "$tmp_dir/red.png")"
+blue="$(fix_path "$tmp_dir/blue.png")"
+
+# A tall sheet, so several threads each label their own row strip. Frames sit
+# on and across the strip boundaries, and the pair at 4,160 / 6,162 touches
+# only diagonally, so it must come out as one frame. The top-left pixel stays
+# transparent so no background color is detected.
+cat > "$tmp_dir/layout.txt" <<EOF_LAYOUT
+atlas 16,300
+sprite "$red" 2,0 2,2
+sprite "$blue" 4,74 2,2
+sprite "$red" 8,149 2,2
+sprite "$red" 4,160 2,2
+sprite "$blue" 6,162 2,2
+sprite "$blue" 0,224 2,2
+sprite "$red" 12,298 2,2
+EOF_LAYOUT
+"$spratpack_bin" < "$tmp_dir/layout.txt" > "$tmp_dir/sheet.png"
+sheet="$(fix_path "$tmp_dir/sheet.png")"
+
+# --- Test 1: Every thread count finds the same frames ---
+"$spratframes_bin" "$sheet" --threads 1 > "$tmp_dir/t1.spratframes"
+if [ "$(grep -c '^sprite ' "$tmp_dir/t1.spratframes")" -ne 6 ]; then
+    echo "Test 1 FAIL: expected 6 frames" >&2
+    cat "$tmp_dir/t1.spratframes" >&2
+    exit 1
+fi
+grep -q '^sprite 4,160 4,4$' "$tmp_dir/t1.spratframes"
+for threads in 2 3 4 16; do
+    "$spratframes_bin" "$sheet" --threads "$threads" > "$tmp_dir/t$threads.spratframes"
+    if ! cmp -s "$tmp_dir/t1.spratframes" "$tmp_dir/t$threads.spratframes"; then
+        echo "Test 1 FAIL: --threads $threads output differs from --threads 1" >&2
+        exit 1
+    fi
+done
+
+# --- Test 2: Tolerance joins frames across strip boundaries the same way ---
+"$spratframes_bin" "$sheet" --tolerance 6 --threads 1 > "$tmp_dir/tol1.spratframes"
+"$spratframes_bin" "$sheet" --tolerance 6 --threads 4 > "$tmp_dir/tol4.spratframes"
+if ! cmp -s "$tmp_dir/tol1.spratframes" "$tmp_dir/tol4.spratframes"; then
+    echo "Test 2 FAIL: tolerance output depends on --threads" >&2
+    exit 1
+fi
+grep -q '^sprite 0,144 15,25$' "$tmp_dir/tol1.spratframes"
+
+echo "frames_threads_test passed"
@@ -0,0 +1,107 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+if [ "${SPRAT_TEST_DEBUG:-0}" = "1" ]; then
+    set -x
+fi
+
+if [ "$#" -ne 1 ]; then
+    echo "Usage: gpu_compress_threads_test.sh <spratpack-bin>" >&2
+    exit 1
+fi
+
+spratpack_bin="$1"
+
+tmp_dir="$(mktemp -d)"
+if [ "${SPRAT_TEST_DEBUG:-0}" = "1" ]; then
+    echo "gpu_compress_threads_test tmp_dir: $tmp_dir" >&2
+else
+    trap 'rm -rf "$tmp_dir"' EXIT
+fi
+
+# Path conversion for Windows
+if [[ "$(uname)" == MINGW* || "$(uname)" == MSYS* ]]; then
+    tmp_dir_win="$(cygpath -m "$tmp_dir")"
+    fix_path() {
+        echo "${1/$tmp_dir/$tmp_dir_win}"
+    }
+else
+    fix_path() {
+        echo "$1"
+    }
+fi
+
+decode_png() {
+    if base64 --version 2>&1 | grep -q "GNU"; then
+        base64 -d "$1" > "$2"
+    else
+        base64 -D -i "$1" -o "$2"
+    fi
+}
+
+# 2x2 opaque red and blue PNGs
+cat > "$tmp_dir/red.b64" <<'EOF_PNG'
+iVBORw0KGgoAAAANSUhEUgAAAAIAAAACCAYAAABytg0kAAAAEUlEQVR4nGP4z8DwH4QZYAwAR8oH+WdZbrcAAAAASUVORK5CYII=
+EOF_PNG
+cat > "$tmp_dir/blue.b64" <<'EOF_PNG'
+iVBORw0KGgoAAAANSUhEUgAAAAIAAAACCAYAAABytg0kAAAAEElEQVR4nGNgYPj/H4KhDAA/0gf5tBJPzQAAAABJRU5ErkJggg==
+EOF_PNG
+decode_png "$tmp_dir/red.b64" "$tmp_dir/red.png"
+decode_png "$tmp_dir/blue.b64" "$tmp_dir/blue.png"
+red="$(fix_path "$tmp_dir/red.png")"
+blue="$(fix_path "$tmp_dir/blue.png")"
+
+# A sparse 64x64 atlas: most blocks stay empty, and sprites straddle block
+# edges so the extrude and dilate margins reach neighbouring blocks.
+layout="$tmp_dir/layout.txt"
+echo "atlas 64,64" > "$layout"
+for i in $(seq 0 11); do
+    x=$(((i * 13) % 61))
+    y=$(((i * 7) % 61))
+    if [ $((i % 2)) -eq 0 ]; then
+        echo "sprite \"$red\" $x,$y 2,2" >> "$layout"
+    else
+        echo "sprite \"$blue\" $x,$y 2,2" >> "$layout"
+    fi
+done
+
+if ! "$spratpack_bin" --gpu-compress dxt1 < "$layout" > "$tmp_dir/probe.dds" 2> "$tmp_dir/probe.err"; then
+    if grep -q "not compiled in" "$tmp_dir/probe.err"; then
+        echo "spratpack was built without libsquish; skipping gpu compress tests."
+        exit 0
+    fi
+    cat "$tmp_dir/probe.err" >&2
+    exit 1
+fi
+
+# --- Test 1: the block-parallel compressor matches the serial path ---
+for format in dxt1 dxt5; do
+    for extra in "" "--extrude 1" "--dilate 2"; do
+        # shellcheck disable=SC2086
+        "$spratpack_bin" --gpu-compress "$format" --threads 1 $extra < "$layout" > "$tmp_dir/serial.dds"
+        if [ "$(head -c 4 "$tmp_dir/serial.dds")" != "DDS " ]; then
+            echo "Test 1 FAIL: $format $extra output is not a DDS file" >&2
+            exit 1
+        fi
+        for threads in 2 3 8; do
+            # shellcheck disable=SC2086
+            "$spratpack_bin" --gpu-compress "$format" --threads "$threads" $extra < "$layout" > "$tmp_dir/parallel.dds"
+            if ! cmp -s "$tmp_dir/serial.dds" "$tmp_dir/parallel.dds"; then
+                echo "Test 1 FAIL: $format $extra with --threads $threads differs from --threads 1" >&2
+                exit 1
+            fi
+        done
+    done
+done
+
+# --- Test 2: DXT1 is 8 bytes and DXT5 16 bytes per 4x4 block ---
+"$spratpack_bin" --gpu-compress dxt1 < "$layout" > "$tmp_dir/dxt1.dds"
+"$spratpack_bin" --gpu-compress dxt5 < "$layout" > "$tmp_dir/dxt5.dds"
+dxt1_size="$(wc -c < "$tmp_dir/dxt1.dds" | tr -d ' ')"
+dxt5_size="$(wc -c < "$tmp_dir/dxt5.dds" | tr -d ' ')"
+if [ "$dxt1_size" -ne $((128 + 16 * 16 * 8)) ] || [ "$dxt5_size" -ne $((128 + 16 * 16 * 16)) ]; then
+    echo "Test 2 FAIL: unexpected DDS sizes $dxt1_size and $dxt5_size" >&2
+    exit 1
+fi
+
+echo "All gpu compress thread tests passed."
@@ -154,4 +154,29 @@ if grep -q '"b.png"' "$layout3"; then
     exit 1
 fi
 
+# --- Test 4: A renamed sprite reuses its old slot without growing the atlas ---
+mv "$frames_dir/d.png" "$frames_dir/e.png"
+
+layout4="$tmp_dir/layout4.txt"
+"$spratlayout_bin" "$(fix_path "$frames_dir")" --incremental --mode compact --profiles-config "$(fix_path "$profiles_cfg")" > "$layout4"
+
+pos_d="$(grep '"d.png"' "$layout3" | sed 's/^sprite "[^"]*"//')"
+pos_e="$(grep '"e.png"' "$layout4" | sed 's/^sprite "[^"]*"//')"
+if [ -z "$pos_e" ] || [ "$pos_d" != "$pos_e" ]; then
+    echo "Test 4 FAIL: e.png did not take over the slot of d.png" >&2
+    echo "  layout3 d.png:$pos_d" >&2
+    echo "  layout4 e.png:$pos_e" >&2
+    exit 1
+fi
+if [ "$(grep '^atlas ' "$layout3")" != "$(grep '^atlas ' "$layout4")" ]; then
+    echo "Test 4 FAIL: Atlas size changed after a rename" >&2
+    exit 1
+fi
+for name in a.png c.png; do
+    if [ "$(grep "\"$name\"" "$layout3")" != "$(grep "\"$name\"" "$layout4")" ]; then
+        echo "Test 4 FAIL: Position changed for $name after rename" >&2
+        exit 1
+    fi
+done
+
 echo "All incremental packing tests passed."
@@ -1,6 +1,7 @@
 #include "../src/core/layout_parser.h"
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <cassert>
 #include <sstream>
 #include <vector>
@@ -80,6 +81,41 @@ void test_parse_layout() {
     std::cout << "test_parse_layout passed" << std::endl;
 }
 
+void test_parse_layout_from_text() {
+    // Same document through both entry points; the in-memory one tokenizes
+    // without a stream, including CRLF endings and a missing final newline.
+    const std::string data = "atlas 64 64\r\n"
+                             "root \"assets\"\n"
+                             "sprite \"a.png\"  0,0 8,8 slice=1,2,3,4,repeat,mirror\r\n"
+                             "sprite \"b.png\" 0 0 8 8 1 1\n"
+                             "- marker \"hit\" point 1,1\n"
+                             "alias \"c.png\" \"a.png\"";
+    sprat::core::Layout from_text;
+    sprat::core::Layout from_stream;
+    std::string error;
+    assert(sprat::core::parse_layout(std::string_view(data), from_text, error));
+    std::istringstream iss(data);
+    assert(sprat::core::parse_layout(iss, from_stream, error));
+
+    assert(from_text.atlases.size() == 1 && from_text.atlases[0].height == 64);
+    assert(from_text.root == "assets");
+    assert(from_text.sprites.size() == 2 && from_stream.sprites.size() == 2);
+    for (size_t i = 0; i < from_text.sprites.size(); ++i) {
+        assert(from_text.sprites[i].path == from_stream.sprites[i].path);
+        assert(from_text.sprites[i].slice_h == from_stream.sprites[i].slice_h);
+        assert(from_text.sprites[i].src_x == from_stream.sprites[i].src_x);
+    }
+    assert(from_text.sprites[0].slice_h == "repeat" && from_text.sprites[0].slice_v == "mirror");
+    assert(from_text.sprites[1].has_trim && from_text.sprites[1].src_y == 1);
+    assert(from_text.aliases.size() == 1 && from_text.aliases[0].second == "a.png");
+
+    error.clear();
+    assert(!sprat::core::parse_layout(std::string_view("atlas 8,8\nsprite \"a.png\" 0,0 8,8 1,1\n"), from_text, error));
+    assert(error.find("position/size") != std::string::npos);
+
+    std::cout << "test_parse_layout_from_text passed" << std::endl;
+}
+
 void test_parse_layout_rejects_non_positive_atlas_dimensions() {
     sprat::core::Layout layout;
     std::string error;
@@ -254,6 +290,7 @@ int main() {
     test_parse_sprite_line();
     test_parse_extrude_line();
     test_parse_layout();
+    test_parse_layout_from_text();
     test_parse_layout_rejects_non_positive_atlas_dimensions();
     test_parse_layout_rejects_negative_sprite_dimensions();
     test_parse_layout_rejects_sprite_out_of_bounds();
@@ -60,6 +60,19 @@ if ! tar -tf "$tar_file" | grep -q "atlas_2.png"; then
     exit 1
 fi
 
+# Packing several atlases at once keeps TAR entries in atlas order
+parallel_tar="$tmp_dir/atlases_parallel.tar"
+"$spratpack_bin" --threads 4 < "$layout_file" > "$parallel_tar"
+entries="$(tar -tf "$parallel_tar" | tr '\n' ' ')"
+if [ "$entries" != "atlas_0.png atlas_1.png atlas_2.png " ]; then
+    echo "Unexpected TAR entry order with --threads 4: $entries" >&2
+    exit 1
+fi
+if ! cmp -s "$tar_file" "$parallel_tar"; then
+    echo "TAR output with --threads 4 differs from the default run" >&2
+    exit 1
+fi
+
 # Test picking a specific index
 index_file="$tmp_dir/index_1.png"
 "$spratpack_bin" --atlas-index 1 < "$layout_file" > "$index_file"
@@ -71,4 +84,60 @@ if [ "$signature" != "89504e470d0a1a0a" ]; then
     exit 1
 fi
 
+# Generates a w x h sprite from the 1x1 pixel for each "WxH" argument.
+make_sprites() {
+    local dir="$1"
+    shift
+    mkdir -p "$dir"
+    local i=0
+    for size in "$@"; do
+        printf 'atlas %s,%s\nsprite "%s" 0,0 1,1\n' "${size%x*}" "${size#*x}" "$frames_dir/f1.png" |
+            "$spratpack_bin" > "$dir/s$(printf '%02d' "$i").png"
+        i=$((i + 1))
+    done
+}
+
+# Multipack layouts are identical for every thread count
+sizes=()
+for i in $(seq 0 29); do
+    sizes+=("$((2 + (i * 7) % 9))x$((2 + (i * 5) % 9))")
+done
+make_sprites "$tmp_dir/mixed" "${sizes[@]}"
+for optimize in gpu space; do
+    "$spratlayout_bin" "$tmp_dir/mixed" --mode compact --multipack --max-width 16 --max-height 16 \
+        --optimize "$optimize" --threads 1 > "$tmp_dir/mixed_${optimize}_1.txt"
+    if [ "$(grep -c '^atlas ' "$tmp_dir/mixed_${optimize}_1.txt")" -lt 2 ]; then
+        echo "Expected several atlases for --optimize $optimize" >&2
+        exit 1
+    fi
+    for threads in 2 4 16; do
+        "$spratlayout_bin" "$tmp_dir/mixed" --mode compact --multipack --max-width 16 --max-height 16 \
+            --optimize "$optimize" --threads "$threads" > "$tmp_dir/mixed_${optimize}_$threads.txt"
+        if ! cmp -s "$tmp_dir/mixed_${optimize}_1.txt" "$tmp_dir/mixed_${optimize}_$threads.txt"; then
+            echo "--optimize $optimize layout with --threads $threads differs from --threads 1" >&2
+            exit 1
+        fi
+    done
+done
+
+# Both targets need two pages here; gpu keeps every page side at 11 or
+# less, space takes two 12-high pages for less total area (192 vs 202).
+make_sprites "$tmp_dir/plans" 4x3 9x9 7x4 4x8
+"$spratlayout_bin" "$tmp_dir/plans" --mode compact --multipack --max-width 12 --max-height 12 \
+    --optimize gpu > "$tmp_dir/plans_gpu.txt"
+"$spratlayout_bin" "$tmp_dir/plans" --mode compact --multipack --max-width 12 --max-height 12 \
+    --optimize space > "$tmp_dir/plans_space.txt"
+gpu_pages="$(grep '^atlas ' "$tmp_dir/plans_gpu.txt" | tr '\n' ' ')"
+space_pages="$(grep '^atlas ' "$tmp_dir/plans_space.txt" | tr '\n' ' ')"
+if [ "$gpu_pages" != "atlas 11,11 atlas 9,9 " ]; then
+    echo "Unexpected gpu multipack pages: $gpu_pages" >&2
+    cat "$tmp_dir/plans_gpu.txt" >&2
+    exit 1
+fi
+if [ "$space_pages" != "atlas 9,12 atlas 7,12 " ]; then
+    echo "Unexpected space multipack pages: $space_pages" >&2
+    cat "$tmp_dir/plans_space.txt" >&2
+    exit 1
+fi
+
 echo "Multipack test passed!"
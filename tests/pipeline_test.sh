@@ -483,3 +483,60 @@ if [ "$rotate_signature" != "89504e470d0a1a0a" ]; then
     echo "Rotated layout output is not a PNG file" >&2
     exit 1
 fi
+
+# Overlapping sprites keep their painter's order when blits run in parallel,
+# and repeated placements of one source share a single decode.
+overlap_layout="$tmp_dir/overlap_layout.txt"
+cat > "$overlap_layout" <<EOF2
+atlas 4,3
+sprite "$(fix_path "$rotate_source")" 0,0 3,2
+sprite "$(fix_path "$frames_dir/frame_a.png")" 1,1 1,1
+sprite "$(fix_path "$frames_dir/frame_a.png")" 3,2 1,1
+EOF2
+"$spratpack_bin" --threads 1 < "$overlap_layout" > "$tmp_dir/overlap_serial.png"
+"$spratpack_bin" --threads 4 < "$overlap_layout" > "$tmp_dir/overlap_parallel.png"
+if ! cmp -s "$tmp_dir/overlap_serial.png" "$tmp_dir/overlap_parallel.png"; then
+    echo "Parallel blitting changed the output of overlapping sprites" >&2
+    exit 1
+fi
+
+# The trace counts actual decodes: the overlap layout places frame_a twice but
+# decodes it once, and a --pixel-cache pipeline decodes each source only in
+# spratlayout.
+overlap_trace="$tmp_dir/overlap_trace.json"
+"$spratpack_bin" --threads 4 --trace "$(fix_path "$overlap_trace")" < "$overlap_layout" > /dev/null 2>&1
+if ! grep -q '"decode.images":2[,}]*$' "$overlap_trace"; then
+    echo "Expected two decodes for three placements of two sources" >&2
+    exit 1
+fi
+
+decode_cache_dir="$tmp_dir/decode_cache"
+mkdir -p "$decode_cache_dir"
+layout_trace="$tmp_dir/layout_trace.json"
+pack_trace="$tmp_dir/pack_trace.json"
+TMPDIR="$decode_cache_dir" "$spratlayout_bin" "$(fix_path "$frames_dir")" --trim-transparent --pixel-cache \
+    --trace "$(fix_path "$layout_trace")" > "$tmp_dir/decode_layout.txt"
+TMPDIR="$decode_cache_dir" "$spratpack_bin" --pixel-cache --trace "$(fix_path "$pack_trace")" \
+    < "$tmp_dir/decode_layout.txt" > /dev/null
+if ! grep -q '"decode.images":2[,}]*$' "$layout_trace" || grep -q '"decode.images"' "$pack_trace"; then
+    echo "Expected each source to be decoded once per pipeline run" >&2
+    exit 1
+fi
+
+# COMPACT search reports how many width/heuristic tasks it skipped or aborted
+# early because they could not beat the best layout found so far.
+prune_dir="$tmp_dir/prune_frames"
+prune_cache_dir="$tmp_dir/prune_cache"
+mkdir -p "$prune_dir" "$prune_cache_dir"
+for i in $(seq 1 40); do
+    printf 'atlas %d,%d\nsprite "%s" 0,0 1,1\n' $(( (i * 7) % 23 + 3 )) $(( (i * 11) % 19 + 3 )) \
+        "$(fix_path "$frames_dir/frame_a.png")" | "$spratpack_bin" > "$prune_dir/sprite_$i.png"
+done
+prune_trace="$tmp_dir/prune_trace.json"
+TMPDIR="$prune_cache_dir" "$spratlayout_bin" "$(fix_path "$prune_dir")" --mode compact --threads 1 \
+    --trace "$(fix_path "$prune_trace")" > /dev/null
+pruned_tasks="$(grep -E '^"compact\.(skipped|aborted)_tasks":' "$prune_trace" | tr -dc '0-9\n' | awk '{ sum += $1 } END { print sum + 0 }')"
+if [ "$pruned_tasks" -eq 0 ]; then
+    echo "Expected the compact search to prune tasks that cannot win" >&2
+    exit 1
+fi
@@ -0,0 +1,144 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+if [ "${SPRAT_TEST_DEBUG:-0}" = "1" ]; then
+    set -x
+fi
+
+if [ "$#" -ne 2 ]; then
+    echo "Usage: pixel_cache_test.sh <spratlayout-bin> <spratpack-bin>" >&2
+    exit 1
+fi
+
+spratlayout_bin="$1"
+spratpack_bin="$2"
+
+tmp_dir="$(mktemp -d)"
+if [ "${SPRAT_TEST_DEBUG:-0}" = "1" ]; then
+    echo "pixel_cache_test tmp_dir: $tmp_dir" >&2
+else
+    trap 'rm -rf "$tmp_dir"' EXIT
+fi
+
+# Path conversion for Windows
+if [[ "$(uname)" == MINGW* || "$(uname)" == MSYS* ]]; then
+    tmp_dir_win="$(cygpath -m "$tmp_dir")"
+    fix_path() {
+        echo "${1/$tmp_dir/$tmp_dir_win}"
+    }
+else
+    fix_path() {
+        echo "$1"
+    }
+fi
+
+frames_dir="$tmp_dir/frames"
+mkdir -p "$frames_dir"
+
+# Keep layout and pixel caches inside the test directory
+cache_dir="$tmp_dir/cache"
+mkdir -p "$cache_dir"
+export TMPDIR="$cache_dir"
+export TMP="$(fix_path "$cache_dir")"
+export TEMP="$(fix_path "$cache_dir")"
+
+decode_png() {
+    if base64 --version 2>&1 | grep -q "GNU"; then
+        base64 -d "$1" > "$2"
+    else
+        base64 -D -i "$1" -o "$2"
+    fi
+}
+
+# 2x2 opaque red and blue PNGs
+cat > "$tmp_dir/red.b64" <<'EOF_PNG'
+iVBORw0KGgoAAAANSUhEUgAAAAIAAAACCAYAAABytg0kAAAAEUlEQVR4nGP4z8DwH4QZYAwAR8oH+WdZbrcAAAAASUVORK5CYII=
+EOF_PNG
+cat > "$tmp_dir/blue.b64" <<'EOF_PNG'
+iVBORw0KGgoAAAANSUhEUgAAAAIAAAACCAYAAABytg0kAAAAEElEQVR4nGNgYPj/H4KhDAA/0gf5tBJPzQAAAABJRU5ErkJggg==
+EOF_PNG
+decode_png "$tmp_dir/red.b64" "$frames_dir/a.png"
+decode_png "$tmp_dir/blue.b64" "$frames_dir/b.png"
+
+frames_arg="$(fix_path "$frames_dir")"
+
+# --- Test 1: spratlayout fills the pixel cache ---
+layout="$tmp_dir/layout.txt"
+"$spratlayout_bin" "$frames_arg" --trim-transparent --pixel-cache > "$layout"
+
+entry_count="$(find "$cache_dir" -name '*.rgba' | wc -l | tr -d ' ')"
+if [ "$entry_count" -ne 2 ]; then
+    echo "Test 1 FAIL: expected 2 pixel cache entries, got $entry_count" >&2
+    exit 1
+fi
+
+# --- Test 2: cached pixels produce the same atlas as decoding ---
+"$spratpack_bin" < "$layout" > "$tmp_dir/decoded.png"
+"$spratpack_bin" --pixel-cache < "$layout" > "$tmp_dir/cached.png"
+if ! cmp -s "$tmp_dir/decoded.png" "$tmp_dir/cached.png"; then
+    echo "Test 2 FAIL: atlas packed from pixel cache differs" >&2
+    exit 1
+fi
+
+# --- Test 3: a changed source is decoded again instead of using stale pixels ---
+cp "$frames_dir/b.png" "$frames_dir/a.png"
+touch -t 203001010000 "$frames_dir/a.png"
+"$spratpack_bin" < "$layout" > "$tmp_dir/changed_decoded.png"
+"$spratpack_bin" --pixel-cache < "$layout" > "$tmp_dir/changed_cached.png"
+if cmp -s "$tmp_dir/decoded.png" "$tmp_dir/changed_decoded.png"; then
+    echo "Test 3 FAIL: changing a source should change the atlas" >&2
+    exit 1
+fi
+if ! cmp -s "$tmp_dir/changed_decoded.png" "$tmp_dir/changed_cached.png"; then
+    echo "Test 3 FAIL: stale pixel cache entry was used" >&2
+    exit 1
+fi
+
+# --- Test 4: untrimmed layouts are cached by spratpack itself ---
+rm -f "$cache_dir"/sprat/pixels/*.rgba
+untrimmed="$tmp_dir/untrimmed.txt"
+"$spratlayout_bin" "$frames_arg" > "$untrimmed"
+"$spratpack_bin" < "$untrimmed" > "$tmp_dir/untrimmed_decoded.png"
+"$spratpack_bin" --pixel-cache < "$untrimmed" > "$tmp_dir/untrimmed_fill.png"
+"$spratpack_bin" --pixel-cache < "$untrimmed" > "$tmp_dir/untrimmed_cached.png"
+entry_count="$(find "$cache_dir" -name '*.rgba' | wc -l | tr -d ' ')"
+if [ "$entry_count" -ne 2 ]; then
+    echo "Test 4 FAIL: expected spratpack to store 2 pixel cache entries, got $entry_count" >&2
+    exit 1
+fi
+if ! cmp -s "$tmp_dir/untrimmed_decoded.png" "$tmp_dir/untrimmed_fill.png" ||
+   ! cmp -s "$tmp_dir/untrimmed_decoded.png" "$tmp_dir/untrimmed_cached.png"; then
+    echo "Test 4 FAIL: atlas packed from spratpack pixel cache differs" >&2
+    exit 1
+fi
+
+tmp_count="$(find "$cache_dir" -name '*.tmp' | wc -l | tr -d ' ')"
+if [ "$tmp_count" -ne 0 ]; then
+    echo "Test 4 FAIL: $tmp_count temporary pixel cache files were left behind" >&2
+    exit 1
+fi
+
+# --- Test 5: corrupted and truncated entries are rejected and decoded again ---
+# A truncated entry fails the size check; a flipped pixel byte is only caught
+# by the full checksum, which SPRAT_PIXEL_CACHE_VERIFY enables.
+entries=()
+while IFS= read -r entry; do
+    entries+=("$entry")
+done < <(find "$cache_dir" -name '*.rgba' | sort)
+# Flip the first pixel byte (after the 72-byte header) without changing the size.
+printf '\x7f' | dd of="${entries[0]}" bs=1 seek=72 conv=notrunc 2>/dev/null
+entry_size="$(wc -c < "${entries[1]}" | tr -d ' ')"
+head -c "$((entry_size - 1))" "${entries[1]}" > "$tmp_dir/truncated.rgba"
+mv "$tmp_dir/truncated.rgba" "${entries[1]}"
+SPRAT_PIXEL_CACHE_VERIFY=1 "$spratpack_bin" --pixel-cache --trace "$(fix_path "$tmp_dir/damaged_trace.json")" \
+    < "$untrimmed" > "$tmp_dir/untrimmed_damaged.png"
+if ! cmp -s "$tmp_dir/untrimmed_decoded.png" "$tmp_dir/untrimmed_damaged.png"; then
+    echo "Test 5 FAIL: damaged pixel cache entries were used" >&2
+    exit 1
+fi
+if ! grep -q '"decode.images":2[,}]*$' "$tmp_dir/damaged_trace.json"; then
+    echo "Test 5 FAIL: expected both damaged entries to be decoded again" >&2
+    exit 1
+fi
+
+echo "All pixel cache tests passed."
@@ -0,0 +1,153 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+if [ "${SPRAT_TEST_DEBUG:-0}" = "1" ]; then
+    set -x
+fi
+
+if [ "$#" -ne 1 ]; then
+    echo "Usage: serve_test.sh <spratlayout-bin>" >&2
+    exit 1
+fi
+
+spratlayout_bin="$1"
+
+tmp_dir="$(mktemp -d)"
+if [ "${SPRAT_TEST_DEBUG:-0}" = "1" ]; then
+    echo "serve_test tmp_dir: $tmp_dir" >&2
+else
+    trap 'rm -rf "$tmp_dir"' EXIT
+fi
+
+# Path conversion for Windows
+if [[ "$(uname)" == MINGW* || "$(uname)" == MSYS* ]]; then
+    tmp_dir_win="$(cygpath -m "$tmp_dir")"
+    fix_path() {
+        echo "${1/$tmp_dir/$tmp_dir_win}"
+    }
+else
+    fix_path() {
+        echo "$1"
+    }
+fi
+
+frames_dir="$tmp_dir/frames"
+mkdir -p "$frames_dir"
+
+# Isolate test from user configuration
+mkdir -p "$tmp_dir/.config/sprat"
+profiles_cfg="$tmp_dir/.config/sprat/spratprofiles.cfg"
+cat > "$profiles_cfg" <<EOF
+[profile fast]
+mode=fast
+
+[profile desktop]
+mode=compact
+optimize=gpu
+EOF
+export HOME="$tmp_dir"
+if [[ "$(uname)" == MINGW* || "$(uname)" == MSYS* ]]; then
+    export USERPROFILE="$(cygpath -w "$tmp_dir")"
+fi
+
+# Create a 1x1 PNG via base64
+cat > "$tmp_dir/pixel.b64" <<'EOF'
+iVBORw0KGgoAAAANSUhEUgAAAAEAAAABCAQAAAC1HAwCAAAAC0lEQVR42mP8/x8AAwMCAO7ZxaoAAAAASUVORK5CYII=
+EOF
+
+if base64 --version 2>&1 | grep -q "GNU"; then
+    base64 -d "$tmp_dir/pixel.b64" > "$frames_dir/a.png"
+else
+    base64 -D -i "$tmp_dir/pixel.b64" -o "$frames_dir/a.png"
+fi
+cp "$frames_dir/a.png" "$frames_dir/b.png"
+cp "$frames_dir/a.png" "$frames_dir/c.png"
+
+profiles_arg="$(fix_path "$profiles_cfg")"
+frames_arg="$(fix_path "$frames_dir")"
+
+# Reads the framed reply number $2 (1-based) from response file $1 and writes
+# "<exit_code> <output_bytes> <error_bytes>" to stdout, the payload to $3.
+read_reply() {
+    local file="$1"
+    local index="$2"
+    local out="$3"
+    local offset=0
+    local header=""
+    local i
+    for ((i = 1; i <= index; ++i)); do
+        header="$(tail -c +"$((offset + 1))" "$file" | head -n 1)"
+        read -r tag code out_len err_len <<< "$header"
+        if [ "$tag" != "result" ]; then
+            echo "Invalid reply header: $header" >&2
+            exit 1
+        fi
+        offset=$((offset + ${#header} + 1))
+        if [ "$i" -eq "$index" ]; then
+            tail -c +"$((offset + 1))" "$file" | head -c "$out_len" > "$out"
+            echo "$code $out_len $err_len"
+            return
+        fi
+        offset=$((offset + out_len + err_len))
+    done
+}
+
+normalize_eol() {
+    tr -d '\r' < "$1"
+}
+
+# --- Test 1: Served layouts match direct invocations ---
+direct_default="$tmp_dir/direct_default.txt"
+direct_compact="$tmp_dir/direct_compact.txt"
+"$spratlayout_bin" "$frames_arg" --profiles-config "$profiles_arg" > "$direct_default"
+"$spratlayout_bin" "$frames_arg" --mode compact --rotate --profiles-config "$profiles_arg" > "$direct_compact"
+
+response="$tmp_dir/response.bin"
+{
+    printf '"%s" --profiles-config "%s"\n' "$frames_arg" "$profiles_arg"
+    printf '"%s" --mode compact --rotate --profiles-config "%s"\n' "$frames_arg" "$profiles_arg"
+    printf '"%s" --profiles-config "%s"\n' "$frames_arg" "$profiles_arg"
+    printf '"%s" --mode invalid-mode\n' "$frames_arg"
+    printf -- '-\n'
+} | "$spratlayout_bin" --serve > "$response"
+
+served="$tmp_dir/served.txt"
+read -r code _ _ <<< "$(read_reply "$response" 1 "$served")"
+if [ "$code" -ne 0 ] || ! diff -u <(normalize_eol "$direct_default") <(normalize_eol "$served") > /dev/null; then
+    echo "Test 1 FAIL: served default layout differs from direct run" >&2
+    exit 1
+fi
+
+read -r code _ _ <<< "$(read_reply "$response" 2 "$served")"
+if [ "$code" -ne 0 ] || ! diff -u <(normalize_eol "$direct_compact") <(normalize_eol "$served") > /dev/null; then
+    echo "Test 1 FAIL: served compact layout differs from direct run" >&2
+    exit 1
+fi
+
+# --- Test 2: Repeated requests are answered from warm caches ---
+read -r code _ _ <<< "$(read_reply "$response" 3 "$served")"
+if [ "$code" -ne 0 ] || ! diff -u <(normalize_eol "$direct_default") <(normalize_eol "$served") > /dev/null; then
+    echo "Test 2 FAIL: repeated served layout differs from direct run" >&2
+    exit 1
+fi
+
+# --- Test 3: Failing requests report errors without stopping the server ---
+read -r code _ err_len <<< "$(read_reply "$response" 4 "$served")"
+if [ "$code" -eq 0 ] || [ "$err_len" -eq 0 ]; then
+    echo "Test 3 FAIL: invalid request should fail with an error message" >&2
+    exit 1
+fi
+
+read -r code _ err_len <<< "$(read_reply "$response" 5 "$served")"
+if [ "$code" -eq 0 ] || [ "$err_len" -eq 0 ]; then
+    echo "Test 3 FAIL: stdin input inside a served request should be rejected" >&2
+    exit 1
+fi
+
+# --- Test 4: --serve takes no positional input ---
+if "$spratlayout_bin" "$frames_arg" --serve < /dev/null > /dev/null 2>&1; then
+    echo "Test 4 FAIL: --serve with a folder argument should fail" >&2
+    exit 1
+fi
+
+echo "All serve mode tests passed."
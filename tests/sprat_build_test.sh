@@ -0,0 +1,125 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+if [ "${SPRAT_TEST_DEBUG:-0}" = "1" ]; then
+    set -x
+fi
+
+if [ "$#" -ne 1 ]; then
+    echo "Usage: sprat_build_test.sh <sprat-bin>" >&2
+    exit 1
+fi
+
+sprat_bin="$1"
+
+tmp_dir="$(mktemp -d)"
+if [ "${SPRAT_TEST_DEBUG:-0}" = "1" ]; then
+    echo "sprat_build_test tmp_dir: $tmp_dir" >&2
+else
+    trap 'rm -rf "$tmp_dir"' EXIT
+fi
+
+# Path conversion for Windows
+if [[ "$(uname)" == MINGW* || "$(uname)" == MSYS* ]]; then
+    tmp_dir_win="$(cygpath -m "$tmp_dir")"
+    fix_path() {
+        echo "${1/$tmp_dir/$tmp_dir_win}"
+    }
+else
+    fix_path() {
+        echo "$1"
+    }
+fi
+
+frames_dir="$tmp_dir/frames"
+mkdir -p "$frames_dir"
+
+# Keep layout and pixel caches inside the test directory
+cache_dir="$tmp_dir/cache"
+mkdir -p "$cache_dir"
+export TMPDIR="$cache_dir"
+export TMP="$(fix_path "$cache_dir")"
+export TEMP="$(fix_path "$cache_dir")"
+
+decode_png() {
+    if base64 --version 2>&1 | grep -q "GNU"; then
+        base64 -d "$1" > "$2"
+    else
+        base64 -D -i "$1" -o "$2"
+    fi
+}
+
+# 2x2 opaque red and blue PNGs
+cat > "$tmp_dir/red.b64" <<'EOF_PNG'
+iVBORw0KGgoAAAANSUhEUgAAAAIAAAACCAYAAABytg0kAAAAEUlEQVR4nGP4z8DwH4QZYAwAR8oH+WdZbrcAAAAASUVORK5CYII=
+EOF_PNG
+cat > "$tmp_dir/blue.b64" <<'EOF_PNG'
+iVBORw0KGgoAAAANSUhEUgAAAAIAAAACCAYAAABytg0kAAAAEElEQVR4nGNgYPj/H4KhDAA/0gf5tBJPzQAAAABJRU5ErkJggg==
+EOF_PNG
+decode_png "$tmp_dir/red.b64" "$frames_dir/a.png"
+decode_png "$tmp_dir/blue.b64" "$frames_dir/b.png"
+cp "$frames_dir/a.png" "$frames_dir/c.png"
+
+frames_arg="$(fix_path "$frames_dir")"
+
+# --- Test 1: sprat build matches the piped tools ---
+piped_dir="$tmp_dir/piped"
+mkdir -p "$piped_dir"
+"$sprat_bin" layout "$frames_arg" --trim-transparent > "$piped_dir/layout.txt"
+"$sprat_bin" pack -o "$(fix_path "$piped_dir")/atlas.png" < "$piped_dir/layout.txt"
+"$sprat_bin" convert --transform json --atlas atlas.png --output-dir "$(fix_path "$piped_dir")" < "$piped_dir/layout.txt"
+
+built_dir="$tmp_dir/built"
+"$sprat_bin" build "$frames_arg" --trim-transparent --output-dir "$(fix_path "$built_dir")" \
+    --save-layout "$(fix_path "$built_dir")/layout.txt" --pack --convert --transform json
+
+for name in layout.txt atlas.png json.json; do
+    if ! cmp -s "$piped_dir/$name" "$built_dir/$name"; then
+        echo "Test 1 FAIL: $name from sprat build differs from the piped tools" >&2
+        exit 1
+    fi
+done
+
+# --- Test 2: the fused run keeps pixels in memory, not in the pixel cache ---
+# With a cold layout cache, spratpack finds every image spratlayout decoded
+# in the in-memory tier.
+trace_file="$tmp_dir/build_trace.json"
+cold_cache_dir="$tmp_dir/cold_cache"
+mkdir -p "$cold_cache_dir"
+TMPDIR="$cold_cache_dir" TMP="$(fix_path "$cold_cache_dir")" TEMP="$(fix_path "$cold_cache_dir")" \
+    "$sprat_bin" build "$frames_arg" --trim-transparent --output-dir "$(fix_path "$tmp_dir/traced")" --pack \
+    --trace "$(fix_path "$trace_file")"
+entry_count="$(find "$cache_dir" "$cold_cache_dir" -name '*.rgba' | wc -l | tr -d ' ')"
+if [ "$entry_count" -ne 0 ]; then
+    echo "Test 2 FAIL: expected no pixel cache files, got $entry_count" >&2
+    exit 1
+fi
+decoded="$(grep -E '^"decode\.images":' "$trace_file" | tr -dc '0-9')"
+hits="$(grep -E '^"pixel_cache\.hits":' "$trace_file" | tr -dc '0-9' || true)"
+if [ -z "$hits" ] || [ "$hits" -ne "$decoded" ] || grep -q '"pixel_cache.misses"' "$trace_file"; then
+    echo "Test 2 FAIL: expected $decoded pixel cache hits and no misses, got '${hits}'" >&2
+    exit 1
+fi
+
+# --- Test 3: several atlases get numbered file names ---
+multi_dir="$tmp_dir/multi"
+"$sprat_bin" build "$frames_arg" --multipack --max-width 2 --max-height 2 \
+    --output-dir "$(fix_path "$multi_dir")" --pack --threads 2
+for name in atlas_0.png atlas_1.png atlas_2.png json.json; do
+    if [ ! -s "$multi_dir/$name" ]; then
+        echo "Test 3 FAIL: missing $name" >&2
+        exit 1
+    fi
+done
+
+# --- Test 4: errors of a stage are reported ---
+if "$sprat_bin" build "$frames_arg" --mode nope --output-dir "$(fix_path "$tmp_dir/bad")" 2>/dev/null; then
+    echo "Test 4 FAIL: invalid layout option should fail the build" >&2
+    exit 1
+fi
+if "$sprat_bin" nope 2>/dev/null >/dev/null; then
+    echo "Test 4 FAIL: unknown command should fail" >&2
+    exit 1
+fi
+
+echo "All sprat build tests passed."
@@ -0,0 +1,143 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+if [ "${SPRAT_TEST_DEBUG:-0}" = "1" ]; then
+    set -x
+fi
+
+if [ "$#" -ne 2 ]; then
+    echo "Usage: unpack_threads_test.sh <spratpack-bin> <spratunpack-bin>" >&2
+    exit 1
+fi
+
+spratpack_bin="$1"
+spratunpack_bin="$2"
+
+tmp_dir="$(mktemp -d)"
+if [ "${SPRAT_TEST_DEBUG:-0}" = "1" ]; then
+    echo "unpack_threads_test tmp_dir: $tmp_dir" >&2
+else
+    trap 'rm -rf "$tmp_dir"' EXIT
+fi
+
+# Path conversion for Windows
+if [[ "$(uname)" == MINGW* || "$(uname)" == MSYS* ]]; then
+    tmp_dir_win="$(cygpath -m "$tmp_dir")"
+    fix_path() {
+        echo "${1/$tmp_dir/$tmp_dir_win}"
+    }
+else
+    fix_path() {
+        echo "$1"
+    }
+fi
+
+decode_png() {
+    if base64 --version 2>&1 | grep -q "GNU"; then
+        base64 -d "$1" > "$2"
+    else
+        base64 -D -i "$1" -o "$2"
+    fi
+}
+
+# 2x2 opaque red and blue PNGs
+cat > "$tmp_dir/red.b64" <<'EOF_PNG'
+iVBORw0KGgoAAAANSUhEUgAAAAIAAAACCAYAAABytg0kAAAAEUlEQVR4nGP4z8DwH4QZYAwAR8oH+WdZbrcAAAAASUVORK5CYII=
+EOF_PNG
+cat > "$tmp_dir/blue.b64" <<'EOF_PNG'
+iVBORw0KGgoAAAANSUhEUgAAAAIAAAACCAYAAABytg0kAAAAEElEQVR4nGNgYPj/H4KhDAA/0gf5tBJPzQAAAABJRU5ErkJggg==
+EOF_PNG
+decode_png "$tmp_dir/red.b64" "$tmp_dir/red.png"
+decode_png "$tmp_dir/blue.b64" "$tmp_dir/blue.png"
+red="$(fix_path "$tmp_dir/red.png")"
+blue="$(fix_path "$tmp_dir/blue.png")"
+
+cat > "$tmp_dir/layout.txt" <<EOF_LAYOUT
+atlas 8,8
+sprite "$red" 0,0 2,2
+sprite "$blue" 2,0 2,2
+sprite "$blue" 0,4 2,2
+sprite "$red" 6,6 2,2
+EOF_LAYOUT
+"$spratpack_bin" < "$tmp_dir/layout.txt" > "$tmp_dir/sheet.png"
+sheet="$(fix_path "$tmp_dir/sheet.png")"
+
+# Many overlapping frames, some rotated and some in subdirectories, so the
+# workers finish out of order.
+frames="$tmp_dir/sheet.spratframes"
+: > "$frames"
+for i in $(seq 0 39); do
+    x=$((i % 5))
+    y=$(((i / 5) % 4))
+    w=$((1 + i % 4))
+    h=$((1 + (i / 4) % 4))
+    rotated=""
+    if [ $((i % 3)) -eq 0 ]; then
+        rotated=" rotated"
+    fi
+    echo "sprite \"dir$((i % 3))/frame_$i\" $x,$y $w,$h$rotated" >> "$frames"
+done
+frames_path="$(fix_path "$frames")"
+
+# --- Test 1: Directory output is identical for every thread count ---
+"$spratunpack_bin" "$sheet" -f "$frames_path" -o "$(fix_path "$tmp_dir/out1")" -j 1 > /dev/null
+for threads in 2 4 16; do
+    "$spratunpack_bin" "$sheet" -f "$frames_path" -o "$(fix_path "$tmp_dir/out$threads")" -j "$threads" > /dev/null
+    if ! diff -r "$tmp_dir/out1" "$tmp_dir/out$threads" > /dev/null; then
+        echo "Test 1 FAIL: -j $threads output differs from -j 1" >&2
+        exit 1
+    fi
+done
+if [ "$(find "$tmp_dir/out1" -name '*.png' | wc -l)" -ne 40 ]; then
+    echo "Test 1 FAIL: expected 40 frames" >&2
+    exit 1
+fi
+
+# --- Test 2: Tar entries keep frame order and match the directory output ---
+sed 's/^sprite "\([^"]*\)".*/\1.png/' "$frames" > "$tmp_dir/expected.list"
+for threads in 1 4; do
+    "$spratunpack_bin" "$sheet" -f "$frames_path" -j "$threads" > "$tmp_dir/out$threads.tar"
+    tar -tf "$tmp_dir/out$threads.tar" > "$tmp_dir/tar$threads.list"
+    if ! diff "$tmp_dir/expected.list" "$tmp_dir/tar$threads.list" > /dev/null; then
+        echo "Test 2 FAIL: -j $threads tar entries are out of order" >&2
+        exit 1
+    fi
+    mkdir "$tmp_dir/tar$threads"
+    tar -xf "$tmp_dir/out$threads.tar" -C "$tmp_dir/tar$threads"
+    if ! diff -r "$tmp_dir/out1" "$tmp_dir/tar$threads" > /dev/null; then
+        echo "Test 2 FAIL: -j $threads tar contents differ from directory output" >&2
+        exit 1
+    fi
+done
+
+# --- Test 3: Duplicate frame names resolve like a single-threaded run ---
+# Every "dup" frame targets the same file; the last one in the list must win.
+dup_frames="$tmp_dir/dup.spratframes"
+: > "$dup_frames"
+for i in $(seq 0 31); do
+    echo "sprite \"dup\" $((i % 4)),$(((i / 4) % 4)) $((1 + i % 3)),$((1 + i % 2))" >> "$dup_frames"
+done
+echo 'sprite "dup" 6,6 2,2' >> "$dup_frames"
+echo 'sprite "last" 6,6 2,2' >> "$dup_frames"
+dup_frames_path="$(fix_path "$dup_frames")"
+for threads in 1 4 16; do
+    "$spratunpack_bin" "$sheet" -f "$dup_frames_path" -o "$(fix_path "$tmp_dir/dup$threads")" -j "$threads" > /dev/null
+    if [ "$(find "$tmp_dir/dup$threads" -name '*.png' | wc -l)" -ne 2 ]; then
+        echo "Test 3 FAIL: -j $threads expected dup.png and last.png" >&2
+        exit 1
+    fi
+    if ! cmp -s "$tmp_dir/dup$threads/dup.png" "$tmp_dir/dup$threads/last.png"; then
+        echo "Test 3 FAIL: -j $threads dup.png is not the last duplicate frame" >&2
+        exit 1
+    fi
+done
+
+# --- Test 4: A frame outside the atlas fails the archive cleanly ---
+echo 'sprite "outside" 6,6 4,4' >> "$frames"
+if "$spratunpack_bin" "$sheet" -f "$frames_path" -j 4 > "$tmp_dir/bad.tar" 2> "$tmp_dir/bad.err"; then
+    echo "Test 4 FAIL: out-of-bounds frame should fail the archive" >&2
+    exit 1
+fi
+grep -q 'Failed to add sprite "outside"' "$tmp_dir/bad.err"
+
+echo "unpack_threads_test passed"